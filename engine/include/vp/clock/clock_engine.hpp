@@ -24,6 +24,7 @@
 #include "vp/vp_data.hpp"
 #include "vp/component.hpp"
 #include "vp/time/time_engine.hpp"
+#include "vp/telemetry/telemetry_engine.hpp"
 
 namespace vp {
 
@@ -116,10 +117,16 @@ namespace vp {
 
     bool has_events() { return this->nb_enqueued_to_cycle || this->delayed_queue; }
 
+    // Number of events executed, sampled by the telemetry engine
+    vp::telemetry_counter nb_events;
+
   protected:
 
     void flush_delayed_queue();
 
+    // Executes the event while measuring its host time
+    void exec_profiled(clock_event *event);
+
     inline void enqueue_to_cycle(clock_event *event, int64_t cycles)
     {
       // The position of one round of the circular buffer is always aligned
@@ -28,6 +28,7 @@ namespace vp {
   class clock_event;
   class component;
   class component_clock;
+  class host_profile_site;
 
   #define CLOCK_EVENT_PAYLOAD_SIZE 64
   #define CLOCK_EVENT_NB_ARGS 8
@@ -46,7 +47,7 @@ namespace vp {
     clock_event(component_clock *comp, clock_event_meth_t *meth);
 
     clock_event(component_clock *comp, void *_this, clock_event_meth_t *meth) 
-      : comp(comp), _this(_this), meth(meth), enqueued(false) {}
+      : comp(comp), _this(_this), meth(meth), enqueued(false), profile_site(NULL) {}
 
     inline int get_payload_size() { return CLOCK_EVENT_PAYLOAD_SIZE; }
     inline uint8_t *get_payload() { return payload; }
@@ -67,6 +68,9 @@ namespace vp {
     clock_event *next;
     bool enqueued;
     int64_t cycle;
+    // Site of the host profiler, NULL until the event is executed with the
+    // host profile enabled
+    host_profile_site *profile_site;
   };    
 
 };
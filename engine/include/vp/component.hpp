@@ -46,6 +46,12 @@ using namespace std;
 #define VP_ERROR_SIZE (1<<16)
 extern char vp_error[];
 
+// False when the platform is simulated in functional mode, where models
+// should skip all their timing modeling (latencies, bandwidth, stalls) to
+// go as fast as possible. Models must check it dynamically as the platform
+// can switch to timed mode at any time.
+extern bool vp_timing_enabled;
+
 namespace vp {
 
   class config;
@@ -296,11 +302,22 @@ namespace vp {
     virtual string run() { return "error"; }
     virtual int run_status() { return 0; }
 
+    // Called before the simulator process is forked, and then in the child
+    // process, as only the forking thread is duplicated. Components owning
+    // threads or per-run files must restore them in the child.
+    virtual void fork_prepare() {}
+    virtual void fork_child() {}
+
 
     void set_config(const char *config);
 
+    void set_config(js::config *config);
+
     inline js::config *get_js_config() { return comp_js_config; }
 
+    // Same as get_js_config()->get(path), resolved through the config index
+    js::config *get_js_config(std::string path);
+
     inline config *get_config(std::string name);
 
 
@@ -337,6 +354,10 @@ namespace vp {
 
     void reset_all(bool active, bool from_itf=false);
 
+    void fork_prepare_all();
+
+    void fork_child_all();
+
     void new_master_port(std::string name, master_port *port);
 
     void new_master_port(void *comp, std::string name, master_port *port);
@@ -21,9 +21,12 @@
 #ifndef __VP_COMP_MODEL_CONFIG_HPP__
 #define __VP_COMP_MODEL_CONFIG_HPP__
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 
 #include "vp/jsmn.h"
 
@@ -31,6 +34,60 @@ using namespace std;
 
 namespace vp {
 
+  // Index of config trees, resolving paths with the same rules as
+  // config_object::get_from_list without walking the trees.
+  // Keys are interned, the childs of a node are found by key, and the nodes
+  // of each key are listed in tree order so that "**" only looks at the
+  // nodes having the searched key. Paths are compiled once and the result of
+  // each lookup is kept, as config trees are never modified once built.
+  // This works for any config class having get_childs(), like vp::config and
+  // js::config.
+  class config_index
+  {
+  public:
+    // Same as config->get(path), the tree of the config being indexed the
+    // first time it is seen
+    template<class T> T *get(T *config, const std::string &path);
+
+    // Indexes a tree. A tree containing already indexed ones can be added,
+    // its nodes then replace theirs.
+    template<class T> void add(T *root);
+
+    // Unique identifier of a key, shared by all indexes
+    static int intern(const std::string &key);
+
+  private:
+    typedef struct
+    {
+      void *config;
+      int key;
+      int first_child;
+      int nb_childs;
+      int end;          // First node after the subtree of this node
+    } node_t;
+
+    template<class T> int add_node(T *config, int key);
+    int new_node(void *config, int key);
+    void set_childs(int node, std::vector<int> &childs);
+    int compile(const std::string &path);
+    void *lookup(void *config, const std::string &path);
+    int resolve(int node, const int *keys, int nb_keys);
+    int get_child(int node, int key);
+
+    std::vector<node_t> nodes;
+    std::vector<int> childs;
+    std::unordered_map<void *, int> nodes_map;
+    // Child of each node and key, the key being node << 32 | key
+    std::unordered_map<uint64_t, int> childs_map;
+    // Nodes of each key, in tree order
+    std::unordered_map<int, std::vector<int>> key_nodes;
+    std::unordered_map<std::string, int> paths_map;
+    std::vector<std::vector<int>> paths;
+    // Result of each lookup, the key being node << 32 | path
+    std::unordered_map<uint64_t, void *> results;
+    std::mutex mutex;
+  };
+
   class config
   {
 
@@ -122,6 +179,47 @@ namespace vp {
     bool value;
   };
 
+  template<class T> T *config_index::get(T *config, const std::string &path)
+  {
+    if (config == NULL)
+      return NULL;
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if (this->nodes_map.find(config) != this->nodes_map.end())
+        return (T *)this->lookup(config, path);
+    }
+
+    this->add(config);
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return (T *)this->lookup(config, path);
+  }
+
+  template<class T> void config_index::add(T *root)
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->add_node(root, -1);
+  }
+
+  // Nodes are numbered in tree order, with the childs in the order
+  // get_from_list goes through them
+  template<class T> int config_index::add_node(T *config, int key)
+  {
+    int node = this->new_node(config, key);
+    std::vector<int> child_nodes;
+
+    auto &&config_childs = config->get_childs();
+    for (auto &x: config_childs)
+    {
+      child_nodes.push_back(this->add_node(x.second, intern(x.first)));
+    }
+
+    this->set_childs(node, child_nodes);
+
+    return node;
+  }
+
 };  
 
 #endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_CONTEXT_HPP__
+#define __VP_CONTEXT_HPP__
+
+#include <stddef.h>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+namespace vp {
+
+  // Execution context with its own stack, used to run models written as
+  // sequential code, like DPI tasks, on top of the event-driven engine.
+  //
+  // Contexts are switched in user-space by only saving and restoring the
+  // callee-saved registers, without the signal mask handling done by
+  // swapcontext, which costs a system call per switch. Stacks are taken from
+  // a pool, so that creating and terminating contexts is cheap.
+  class context
+  {
+  public:
+    context();
+    ~context();
+
+    // Prepare the context so that the next switch to it calls entry(arg) on
+    // a new stack. When entry returns, the context switches back to the one
+    // which switched to it last, and is then done.
+    void init(void (*entry)(void *), void *arg, size_t stack_size=65536);
+
+    // Save the current execution into this context and resume the other one
+    void switch_to(context *to);
+
+    // True once the entry function of the context has returned
+    inline bool is_done() { return this->done; }
+
+    // Release the stack of a context which is done or not started
+    void release();
+
+  private:
+    static void entry_stub(void *arg);
+#if !defined(__x86_64__)
+    static void ucontext_stub(unsigned int arg_hi, unsigned int arg_lo);
+#endif
+
+    void (*entry)(void *);
+    void *arg;
+    context *caller;
+    bool done;
+    void *stack;
+    size_t stack_size;
+#if defined(__x86_64__)
+    void *sp;
+#else
+    ucontext_t ucontext;
+#endif
+  };
+
+};
+
+#endif
@@ -36,23 +36,27 @@ namespace vp {
 
   inline int component::get_config_int(std::string name, int index)
   {
-    return get_js_config()->get(name)->get_elem(index)->get_int();
+    return get_js_config(name)->get_elem(index)->get_int();
   }
 
 
+  // Missing properties are handled by the config itself
   inline int component::get_config_int(std::string name)
   {
-    return get_js_config()->get_child_int(name);
+    js::config *config = get_js_config(name);
+    return config != NULL ? config->get_int() : get_js_config()->get_child_int(name);
   }
 
   inline bool component::get_config_bool(std::string name)
   {
-    return get_js_config()->get_child_bool(name);
+    js::config *config = get_js_config(name);
+    return config != NULL ? config->get_bool() : get_js_config()->get_child_bool(name);
   }
 
   inline std::string component::get_config_str(std::string name)
   {
-    return get_js_config()->get_child_str(name);
+    js::config *config = get_js_config(name);
+    return config != NULL ? config->get_str() : get_js_config()->get_child_str(name);
   }
 
   inline int64_t component::get_time() { return this->get_time_engine()->get_time(); }
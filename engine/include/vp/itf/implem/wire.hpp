@@ -102,6 +102,22 @@ namespace vp {
     return _this->sync_back_meth_freq_cross((component *)_this->slave_context_for_freq_cross, value);
   }
 
+  template<class T>
+  inline void wire_master<T>::sync_profile_stub(wire_master<T> *_this, T value)
+  {
+    host_profile_node *node = vp_host_profiler->enter(_this->sync_profile_site);
+    _this->sync_meth_profile(_this->slave_context_for_profile, value);
+    vp_host_profiler->leave(node);
+  }
+
+  template<class T>
+  inline void wire_master<T>::sync_back_profile_stub(wire_master<T> *_this, T *value)
+  {
+    host_profile_node *node = vp_host_profiler->enter(_this->sync_back_profile_site);
+    _this->sync_back_meth_profile(_this->slave_context_for_profile, value);
+    vp_host_profiler->leave(node);
+  }
+
   template<class T>
   inline void wire_master<T>::finalize()
   {
@@ -120,6 +136,27 @@ namespace vp {
       this->slave_context_for_freq_cross = this->get_remote_context();
       this->set_remote_context(this);
     }
+
+    // Same for the host profile, the stubs measure the time spent in the
+    // slave, which is named after its sync methods
+    if (vp_host_profiler)
+    {
+      wire_slave<T> *port = this->slave_port;
+      void *sync = port->sync_meth_mux ? (void *)port->sync_meth_mux : (void *)port->sync_meth;
+      void *sync_back = port->sync_back_mux ? (void *)port->sync_back_mux : (void *)port->sync_back;
+
+      this->sync_profile_site = vp_host_profiler->get_site(port->get_owner(), "wire_sync", sync);
+      this->sync_back_profile_site = vp_host_profiler->get_site(port->get_owner(), "wire_sync_back", sync_back);
+
+      this->sync_meth_profile = this->sync_meth;
+      this->sync_meth = (void (*)(void *, T))&wire_master<T>::sync_profile_stub;
+
+      this->sync_back_meth_profile = this->sync_back_meth;
+      this->sync_back_meth = (void (*)(void *, T *))&wire_master<T>::sync_back_profile_stub;
+
+      this->slave_context_for_profile = this->get_remote_context();
+      this->set_remote_context(this);
+    }
   }
 
 
@@ -22,6 +22,7 @@
 #define __VP_ITF_IMPLEM_WIRE_CLASS_HPP__
 
 #include "vp/vp.hpp"
+#include "vp/profiler/host_profiler.hpp"
 
 namespace vp {
 
@@ -63,6 +64,8 @@ namespace vp {
     static inline void sync_muxed(wire_master *_this, T value);
     static inline void sync_freq_cross_stub(wire_master *_this, T value);
     static inline void sync_back_freq_cross_stub(wire_master *_this, T *value);
+    static inline void sync_profile_stub(wire_master *_this, T value);
+    static inline void sync_back_profile_stub(wire_master *_this, T *value);
     static inline void sync_back_muxed(wire_master *_this, T *value);
     void (*sync_meth)(void *, T value);
     void (*sync_meth_mux)(void *, T value, int id);
@@ -72,6 +75,9 @@ namespace vp {
     void (*sync_meth_freq_cross)(void *, T value);
     void (*sync_back_meth_freq_cross)(void *, T *value);
 
+    void (*sync_meth_profile)(void *, T value);
+    void (*sync_back_meth_profile)(void *, T *value);
+
     void (*master_sync_meth)(void *comp, T value);
     void (*master_sync_meth_mux)(void *comp, T value, int id);
 
@@ -86,6 +92,10 @@ namespace vp {
 
     void *slave_context_for_freq_cross;
 
+    void *slave_context_for_profile;
+    host_profile_site *sync_profile_site;
+    host_profile_site *sync_back_profile_site;
+
     int master_sync_mux_id;
   };
 
@@ -22,6 +22,7 @@
 #define __VP_ITF_IO_HPP__
 
 #include "vp/vp.hpp"
+#include "vp/profiler/host_profiler.hpp"
 
 namespace vp {
 
@@ -36,11 +37,38 @@ namespace vp {
     IO_REQ_PENDING
   } io_req_status_e;
 
+  // Backdoor requests give direct access to the storage of the target, for
+  // example to load binaries without simulating the accesses. They are sent
+  // with a size of 0 and no data. A target supporting them returns in the
+  // data the host pointer corresponding to the address, and in the actual
+  // size the number of bytes which can be accessed from it, without any
+  // timing or other side effect. The storage must be a private anonymous
+  // mapping, so that whole pages can be replaced by zero pages. Targets not
+  // supporting them leave the data to NULL.
+  //
+  // Bulk requests carry a list of segments, each one being a normal access,
+  // so that a burst split by an interleaver can be handled by each target
+  // in a single call. The address of a bulk request is the one of its first
+  // segment and its size the total size of the segments. They are only sent
+  // to slave ports which declared they support them; for the others, the
+  // master port sends the segments one by one as normal requests, stopping
+  // at the first invalid one. As the segments share the same request, they
+  // must then be handled synchronously, and a target answering one of them
+  // asynchronously is reported as a fatal error by the master component.
   typedef enum
   {
-    IO_REQ_FLAGS_DEBUG = (1<<0)
+    IO_REQ_FLAGS_DEBUG = (1<<0),
+    IO_REQ_FLAGS_BACKDOOR = (1<<1),
+    IO_REQ_FLAGS_BULK = (1<<2)
   } io_req_flags_e;
 
+  typedef struct
+  {
+    uint64_t addr;
+    uint8_t *data;
+    uint64_t size;
+  } io_req_segment_t;
+
   #define IO_REQ_PAYLOAD_SIZE 64
   #define IO_REQ_NB_ARGS 16
 
@@ -110,6 +138,26 @@ namespace vp {
         this->flags &= ~IO_REQ_FLAGS_DEBUG;
     }
 
+    inline bool is_backdoor() { return this->flags & IO_REQ_FLAGS_BACKDOOR; }
+    inline void set_backdoor(bool backdoor)
+    {
+      if (backdoor)
+        this->flags |= IO_REQ_FLAGS_BACKDOOR;
+      else
+        this->flags &= ~IO_REQ_FLAGS_BACKDOOR;
+    }
+
+    inline bool is_bulk() { return this->flags & IO_REQ_FLAGS_BULK; }
+    inline io_req_segment_t *get_segments() { return this->segments; }
+    inline int get_nb_segments() { return this->nb_segments; }
+
+    // Turns the request into a bulk request on the given segments, or back
+    // into a normal request if there is no segment
+    inline void set_segments(io_req_segment_t *segments, int nb_segments);
+
+    // Sends the segments of a bulk request one by one as normal requests
+    inline io_req_status_e split(io_req_meth_t *meth, void *context, component *comp);
+
     inline int arg_alloc() { return current_arg++; }
     inline void arg_free() { current_arg--; }
 
@@ -131,6 +179,8 @@ namespace vp {
     bool is_write;
     io_req_status_e status;
     io_slave *resp_port;
+    io_req_segment_t *segments;
+    int nb_segments;
 
 
   private:
@@ -165,6 +215,9 @@ namespace vp {
     // Return if this master port is bound.
     bool is_bound();
 
+    // Return if the slave port accepts bulk requests
+    inline bool is_bulk() { return this->remote_bulk; }
+
     // Can be called by master component to send an IO request.  
     inline io_req_status_e req(io_req *req);
 
@@ -248,6 +301,9 @@ namespace vp {
     // setup instead
     io_req_status_e (*req_meth_freq_cross)(void *, io_req *);
 
+    // req_meth when the host profile is enabled as a stub is setup instead
+    io_req_status_e (*req_meth_profile)(void *, io_req *);
+
 
     /*
      * Stubs
@@ -263,6 +319,10 @@ namespace vp {
     // domain before we call it.
     static inline io_req_status_e req_freq_cross_stub(io_master *_this, io_req *req);
 
+    // This is a stub setup when the host profile is enabled so that we can
+    // measure the host time spent in the slave.
+    static inline io_req_status_e req_profile_stub(io_master *_this, io_req *req);
+
 
     /*
      * Internal data
@@ -281,10 +341,17 @@ namespace vp {
     // so that the stub is working well.
     void *slave_context_for_freq_cross = NULL;
 
+    // Slave context and host profiler site when the host profile is enabled.
+    void *slave_context_for_profile = NULL;
+    host_profile_site *profile_site = NULL;
+
     // This data is the multiplex ID that we need to send to the slave when the slave port
     // is multiplexed.
     int slave_req_mux_id = -1;
 
+    // True if the slave port accepts bulk requests
+    bool remote_bulk = false;
+
 
     // Several IO master ports are often connected to the same slave port
     // while the slave will need to reply to the master.
@@ -337,6 +404,9 @@ namespace vp {
     // when calling the callback, and can be used to multiplex a slave port
     inline void set_req_meth_muxed(io_req_meth_muxed_t *meth, int id);
 
+    // Declares that the request callback handles bulk requests
+    inline void set_bulk(bool bulk) { this->bulk = bulk; }
+
 
 
     /*
@@ -418,6 +488,9 @@ namespace vp {
     // Multiplexed ID set by the slave when port is multiplxed
     int req_mux_id;
 
+    // True if the request callback handles bulk requests
+    bool bulk = false;
+
 
     // Master context when the binding is crossing frequency domains.
     // We keep here a copy of the master context when the binding is crossing frequency
@@ -437,12 +510,67 @@ namespace vp {
 
 
 
+  inline void io_req::set_segments(io_req_segment_t *segments, int nb_segments)
+  {
+    this->segments = segments;
+    this->nb_segments = nb_segments;
+    if (nb_segments)
+      this->flags |= IO_REQ_FLAGS_BULK;
+    else
+      this->flags &= ~IO_REQ_FLAGS_BULK;
+  }
+
+
+
+  inline io_req_status_e io_req::split(io_req_meth_t *meth, void *context, component *comp)
+  {
+    uint64_t addr = this->addr;
+    uint8_t *data = this->data;
+    uint64_t size = this->size;
+    io_req_status_e status = IO_REQ_OK;
+
+    this->flags &= ~IO_REQ_FLAGS_BULK;
+
+    for (int i=0; i<this->nb_segments; i++)
+    {
+      this->addr = this->segments[i].addr;
+      this->data = this->segments[i].data;
+      this->size = this->segments[i].size;
+
+      status = meth(context, this);
+      if (status != IO_REQ_OK)
+      {
+        // The target now owns the request until it replies, so the next
+        // segments can not be sent with it
+        if (status == IO_REQ_PENDING || status == IO_REQ_DENIED)
+        {
+          if (comp == NULL)
+            abort();
+          comp->warning.fatal("Bulk request segment answered asynchronously by a target not supporting bulk requests (segment: %d, nb_segments: %d, addr: 0x%llx, size: 0x%llx)\n",
+            i, this->nb_segments, (unsigned long long)this->addr, (unsigned long long)this->size);
+        }
+        break;
+      }
+    }
+
+    this->flags |= IO_REQ_FLAGS_BULK;
+    this->addr = addr;
+    this->data = data;
+    this->size = size;
+
+    return status;
+  }
+
+
+
   inline io_req_status_e io_master::req(io_req *req)
   {
     // We need to store our response port in the request
     // as the slave port is serving several master ports and need
     // to reply to us.
     req->resp_port = slave_port;
+    if (unlikely(req->is_bulk()) && !this->remote_bulk)
+      return req->split(this->req_meth, this->get_remote_context(), this->get_owner());
     return this->req_meth(this->get_remote_context(), req);
   }
 
@@ -452,6 +580,8 @@ namespace vp {
   {
     // We don't redefine the slave port, as the request must be forwarded,
     // this way the slave will reply directly to the previous initiator
+    if (unlikely(req->is_bulk()) && !this->remote_bulk)
+      return req->split(this->req_meth, this->get_remote_context(), this->get_owner());
     return this->req_meth(this->get_remote_context(), req);
   }
 
@@ -461,6 +591,8 @@ namespace vp {
   {
     // Case where the response port is given by the called
     req->resp_port = port;
+    if (unlikely(req->is_bulk()) && !port->bulk)
+      return req->split(port->req_meth, (void *)port->get_remote_context(), this->get_owner());
     return port->req_meth((void *)port->get_remote_context(), req);
   }
 
@@ -514,6 +646,7 @@ namespace vp {
   {
     io_slave *port = (io_slave *)_port;
     this->remote_port = port;
+    this->remote_bulk = port->bulk;
 
     vp_assert(port != NULL, this->get_owner()->get_trace(),
       "Binding to NULL slave port\n");
@@ -566,6 +699,16 @@ namespace vp {
 
 
 
+  inline io_req_status_e io_master::req_profile_stub(io_master *_this, io_req *req)
+  {
+    host_profile_node *node = vp_host_profiler->enter(_this->profile_site);
+    io_req_status_e status = _this->req_meth_profile(_this->slave_context_for_profile, req);
+    vp_host_profiler->leave(node);
+    return status;
+  }
+
+
+
   inline void io_master::finalize()
   {
     vp_assert(this->get_owner() != NULL, NULL,
@@ -592,6 +735,19 @@ namespace vp {
       this->slave_context_for_freq_cross = this->get_remote_context();
       this->set_remote_context(this);
     }
+
+    // Same for the host profile, the stub measures the time spent in the slave,
+    // which is named after its request method
+    if (vp_host_profiler)
+    {
+      io_slave *port = (io_slave *)this->remote_port;
+      void *meth = port->req_meth_mux ? (void *)port->req_meth_mux : (void *)port->req_meth;
+      this->profile_site = vp_host_profiler->get_site(port->get_owner(), "io_req", meth);
+      this->req_meth_profile = this->req_meth;
+      this->req_meth = (io_req_meth_t *)&io_master::req_profile_stub;
+      this->slave_context_for_profile = this->get_remote_context();
+      this->set_remote_context(this);
+    }
   }
 
 
@@ -60,6 +60,8 @@ namespace vp {
 
     std::vector<power_trace *> traces;
 
+    std::vector<power_source *> sources;
+
     power_engine *power_manager = NULL;
   };
 
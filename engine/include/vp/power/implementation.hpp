@@ -61,8 +61,18 @@ inline void vp::power_trace::flush()
   this->account_leakage_power();
 }
 
+inline void vp::power_trace::check_sample()
+{
+  // The power sampler closes its bins lazily, before the first energy change
+  // after the end of a bin
+  if (unlikely(this->engine && this->top->get_time() >= this->engine->sample_time))
+    this->engine->sample();
+}
+
 inline void vp::power_trace::incr(double quantum, bool is_leakage)
 {
+  this->check_sample();
+
   this->get_value();
 
   if (is_leakage)
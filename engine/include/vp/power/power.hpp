@@ -23,23 +23,25 @@
 
 #include "json.hpp"
 #include "vp/vp_data.hpp"
+#include "vp/power/power_table.hpp"
 
 namespace vp {
 
-  #define VP_POWER_DEFAULT_TEMP  25
-  #define VP_POWER_DEFAULT_VOLT  1.2
-  #define VP_POWER_DEFAULT_FREQ  50
-
-  class Linear_table;
-
   class power_engine;
 
+  class power_recorder;
+
   class power_trace
   {
+    friend class power_recorder;
+    friend class component_power;
+
   public:
     int init(component *top, std::string name);
 
-    inline bool get_active() { return trace.get_event_active(); }
+    // Also true while the activity is recorded, so that models account
+    // their events even if the trace is not dumped
+    inline bool get_active() { return this->recording || trace.get_event_active(); }
 
     inline void account_quantum(double quantum);
 
@@ -70,13 +72,21 @@ namespace vp {
 
     void get(double *dynamic, double *leakage);
 
+    // Dynamic and leakage energy since the last clear, including the energy
+    // of the constant power of this trace and of the traces below it, up to
+    // the given time, which is not yet accounted
+    double get_energy(int64_t time);
+
     vp::trace     trace;
 
   private:
     void account_power();
     void account_leakage_power();
+    double get_pending_energy(int64_t time);
+    inline void check_sample();
 
     component *top;
+    power_engine *engine = NULL;
     power_trace *top_trace = NULL;
     std::vector<power_trace *> child_traces;
     double value;
@@ -92,16 +102,18 @@ namespace vp {
     int64_t current_leakage_power_timestamp;
 
     bool dumped;
+    bool recording = false;
   };
 
   class power_source
   {
     friend class component_power;
+    friend class power_recorder;
 
   public:
-    inline void account_event() { this->trace->account_quantum(this->quantum); }
-    inline void power_on() { if (!this->is_on) this->trace->set_power(this->quantum, this->is_leakage); this->is_on = true; }
-    inline void power_off() { if (this->is_on) this->trace->set_power(-this->quantum, this->is_leakage); this->is_on = false; }
+    inline void account_event() { if (this->recorder) this->record_event(); this->trace->account_quantum(this->quantum); }
+    inline void power_on() { if (!this->is_on) { if (this->recorder) this->record_update(); this->trace->set_power(this->quantum, this->is_leakage); } this->is_on = true; }
+    inline void power_off() { if (this->is_on) { if (this->recorder) this->record_update(); this->trace->set_power(-this->quantum, this->is_leakage); } this->is_on = false; }
 
     inline double get_quantum() { return this->quantum; }
 
@@ -111,12 +123,27 @@ namespace vp {
     void setup(double temp, double volt, double freq);
 
   private:
-    Linear_table *table = NULL;
+    void record_event();
+    void record_update();
+    void record_flush();
+
+    power_table *table = NULL;
     double quantum;
     component *top;
     power_trace *trace;
     bool is_on = false;
     bool is_leakage;
+    std::string name;
+
+    // Activity of the current window, only accounted while a capture is
+    // recorded
+    power_recorder *recorder = NULL;
+    int record_id;
+    int64_t record_window;
+    int64_t record_window_end;
+    int64_t record_timestamp;
+    int64_t record_nb_events;
+    int64_t record_on_time;
   };
 
 };
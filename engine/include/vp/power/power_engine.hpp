@@ -39,6 +39,14 @@ namespace vp {
     virtual void stop_capture() {}
 
     virtual void reg_trace(vp::power_trace *trace) {}
+
+    virtual void reg_source(vp::power_source *source) {}
+
+    // Called by the traces when their energy is about to change at or after
+    // sample_time
+    virtual void sample() {}
+
+    int64_t sample_time = INT64_MAX;
   };
 
 };
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_POWER_POWER_RECORD_HPP__
+#define __VP_POWER_POWER_RECORD_HPP__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Power record, containing the activity of each power source, so that the
+// power report can be computed again for other operating points without
+// simulating again.
+//
+// The file starts with the magic and the window length in ps, followed by
+// records, each one starting with a byte giving its type:
+// - CAPTURE_START: int64 time at which the capture was started.
+// - WINDOW: int32 source, int32 window, int64 number of events, int64 time
+//   in ps during which the source was on. Only windows where the source was
+//   active are recorded.
+// - TRACE: int32 trace, int32 top trace or -1, uint32 name length, name. The
+//   traces of a group of the report are recorded one after the other, the
+//   top trace first.
+// - SOURCE: int32 source, int32 trace, uint8 is_leakage, uint32 name length,
+//   name, and the power table of the source.
+// - CAPTURE_STOP: int64 time at which the capture was stopped.
+// Traces and sources are recorded at the end of each capture.
+
+#define POWER_RECORD_MAGIC "GVPOWER1"
+
+typedef enum
+{
+  POWER_RECORD_CAPTURE_START,
+  POWER_RECORD_WINDOW,
+  POWER_RECORD_TRACE,
+  POWER_RECORD_SOURCE,
+  POWER_RECORD_CAPTURE_STOP
+} power_record_e;
+
+namespace vp {
+
+  class power_trace;
+  class power_source;
+
+  // Writes the power record during the simulation. Power sources account
+  // their events and on-time per window while a capture is active.
+  class power_recorder
+  {
+  public:
+    int open(std::string path, int64_t window_length);
+    void close();
+
+    void start_capture(int64_t time, std::vector<power_trace *> &traces, std::vector<power_source *> &sources);
+    void stop_capture(int64_t time, std::vector<power_trace *> &traces, std::vector<power_source *> &sources);
+
+    void dump_window(int source, int64_t window, int64_t nb_events, int64_t on_time);
+
+    // Window length in ps, 0 for one window per capture
+    int64_t window_length;
+
+  private:
+    void dump_string(std::string str);
+
+    FILE *file = NULL;
+  };
+
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_POWER_POWER_TABLE_HPP__
+#define __VP_POWER_POWER_TABLE_HPP__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+namespace vp {
+
+  // Operating point at which the power models are evaluated during simulation
+  #define VP_POWER_DEFAULT_TEMP  25
+  #define VP_POWER_DEFAULT_VOLT  1.2
+  #define VP_POWER_DEFAULT_FREQ  50
+
+  // Value of a linear power model, energy per event or power, for each
+  // temperature and voltage where it was characterized. Values at other
+  // operating points are linearly interpolated.
+  // This only depends on the standard library so that it is also used by the
+  // tools evaluating recorded power activity offline.
+  class power_table
+  {
+  public:
+    struct volt_point
+    {
+      double volt;
+      double value;
+    };
+
+    struct temp_point
+    {
+      double temp;
+      std::vector<volt_point> volts;
+    };
+
+    inline double get(double temp, double volt, double frequency);
+
+    // Binary form of the table, used in power records
+    inline void dump(FILE *file);
+    inline int load(FILE *file);
+
+    std::vector<temp_point> temps;
+
+  private:
+    template<typename P, typename F>
+    static inline int interpolate(std::vector<P> &points, double key, F point_key, double *ratio, int *high);
+  };
+
+};
+
+
+
+// Return the index of the point just below the key and the one just above.
+// They are the same if the key matches a point or is out of the range.
+template<typename P, typename F>
+inline int vp::power_table::interpolate(std::vector<P> &points, double key, F point_key, double *ratio, int *high)
+{
+  int low_index = -1, high_index = -1;
+
+  for (unsigned int i=0; i<points.size(); i++)
+  {
+    if (point_key(points[i]) == key)
+    {
+      low_index = high_index = i;
+      break;
+    }
+
+    if (point_key(points[i]) > key)
+    {
+      high_index = i;
+      break;
+    }
+
+    low_index = i;
+  }
+
+  if (high_index == -1)
+    high_index = low_index;
+
+  if (low_index == -1)
+    low_index = high_index;
+
+  if (high_index == low_index)
+  {
+    *ratio = 0;
+  }
+  else
+  {
+    double low = point_key(points[low_index]);
+    double high = point_key(points[high_index]);
+    *ratio = (key - low) / (high - low);
+  }
+
+  *high = high_index;
+  return low_index;
+}
+
+inline double vp::power_table::get(double temp, double volt, double frequency)
+{
+  // Only frequency independent values are supported for now
+  double temp_ratio;
+  int high_temp;
+  int low_temp = interpolate(this->temps, temp, [](temp_point &p) { return p.temp; }, &temp_ratio, &high_temp);
+
+  if (low_temp < 0)
+    return 0;
+
+  double values[2];
+  int temp_index[2] = { low_temp, high_temp };
+
+  for (int i=0; i<2; i++)
+  {
+    std::vector<volt_point> &volts = this->temps[temp_index[i]].volts;
+    double volt_ratio;
+    int high_volt;
+    int low_volt = interpolate(volts, volt, [](volt_point &p) { return p.volt; }, &volt_ratio, &high_volt);
+
+    if (low_volt < 0)
+      values[i] = 0;
+    else
+      values[i] = (volts[high_volt].value - volts[low_volt].value)*volt_ratio + volts[low_volt].value;
+  }
+
+  return (values[1] - values[0])*temp_ratio + values[0];
+}
+
+inline void vp::power_table::dump(FILE *file)
+{
+  uint32_t nb_temps = this->temps.size();
+  fwrite(&nb_temps, sizeof(nb_temps), 1, file);
+
+  for (auto &temp: this->temps)
+  {
+    uint32_t nb_volts = temp.volts.size();
+    fwrite(&temp.temp, sizeof(temp.temp), 1, file);
+    fwrite(&nb_volts, sizeof(nb_volts), 1, file);
+    fwrite(temp.volts.data(), sizeof(volt_point), nb_volts, file);
+  }
+}
+
+inline int vp::power_table::load(FILE *file)
+{
+  uint32_t nb_temps;
+  if (fread(&nb_temps, sizeof(nb_temps), 1, file) != 1)
+    return -1;
+
+  this->temps.resize(nb_temps);
+
+  for (auto &temp: this->temps)
+  {
+    uint32_t nb_volts;
+    if (fread(&temp.temp, sizeof(temp.temp), 1, file) != 1 || fread(&nb_volts, sizeof(nb_volts), 1, file) != 1)
+      return -1;
+
+    temp.volts.resize(nb_volts);
+    if (fread(temp.volts.data(), sizeof(volt_point), nb_volts, file) != nb_volts)
+      return -1;
+  }
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_PROFILER_HOST_PROFILER_HPP__
+#define __VP_PROFILER_HOST_PROFILER_HPP__
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace vp {
+
+  class component;
+
+  // Model entry point measured by the host profiler, i.e. an event handler,
+  // the request method of an IO slave port or the sync method of a wire
+  // slave port
+  class host_profile_site
+  {
+  public:
+    vp::component *comp;
+    // "event", "io_req", "wire_sync" or "wire_sync_back"
+    const char *kind;
+    // Handler, whose symbol is used to name the site in the reports
+    void *meth;
+  };
+
+  // Node of the tree of calls between sites, one per calling context, so
+  // that the reports can give the time spent in each site excluding the
+  // sites it called
+  class host_profile_node
+  {
+  public:
+    host_profile_site *site;
+    host_profile_node *parent;
+    std::unordered_map<host_profile_site *, host_profile_node *> childs;
+    uint64_t count = 0;
+    uint64_t ticks = 0;
+    uint64_t start;
+  };
+
+  // Measures the host time spent in each model entry point dispatched by the
+  // engine, with the time stamp counter. It is only created when the host
+  // profile is enabled, the engine and the ports check it when they dispatch
+  // a call, or when they are bound, so that nothing is measured otherwise.
+  // The cost of the measurement itself is accounted to the caller.
+  class host_profiler
+  {
+  public:
+    host_profiler(std::string prefix);
+
+    host_profile_site *get_site(vp::component *comp, const char *kind, void *meth);
+
+    // Must be called around the call to the site, enter returns the node to
+    // be given to leave
+    host_profile_node *enter(host_profile_site *site);
+    void leave(host_profile_node *node);
+
+    // Writes <prefix>.txt, the time per component and per site, and
+    // <prefix>.folded, the folded stacks, e.g. for flamegraph.pl
+    int dump();
+
+    static inline uint64_t get_ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#else
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+  private:
+    std::string get_site_name(host_profile_site *site);
+
+    std::string prefix;
+    pthread_mutex_t mutex;
+    std::map<std::pair<vp::component *, void *>, host_profile_site *> sites;
+    // One call tree per thread calling models
+    std::vector<host_profile_node *> roots;
+
+    // Used to convert ticks to seconds
+    uint64_t start_ticks;
+    struct timespec start_time;
+  };
+
+};
+
+// Host profiler of the engine, NULL if the host profile is not enabled
+extern vp::host_profiler *vp_host_profiler;
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_TELEMETRY_ENGINE_HPP__
+#define __VP_TELEMETRY_ENGINE_HPP__
+
+#include "vp/component.hpp"
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace vp {
+
+  typedef enum
+  {
+    // Monotonic count, published as a rate per second of host time
+    TELEMETRY_RATE,
+    // Instantaneous value, published as it is
+    TELEMETRY_LEVEL
+  } telemetry_kind_e;
+
+  // Counter sampled by the telemetry engine.
+  // It is only written by the simulation thread and only read by the
+  // telemetry thread, so that relaxed accesses are enough. They are plain
+  // loads and stores, the simulation thread never waits for the telemetry
+  // one.
+  class telemetry_counter
+  {
+  public:
+    inline void inc(int64_t incr=1)
+    {
+      this->value.store(this->value.load(std::memory_order_relaxed) + incr, std::memory_order_relaxed);
+    }
+
+    inline void set(int64_t value) { this->value.store(value, std::memory_order_relaxed); }
+
+    inline int64_t get() { return this->value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> value{0};
+  };
+
+  // Telemetry service, registered as "telemetry". It periodically samples
+  // the registered counters, from its own thread and at an interval of host
+  // time, to report the simulation performance while it is running.
+  class telemetry_engine : public component
+  {
+  public:
+    telemetry_engine(const char *config);
+
+    // The counter is published as <path>/<name>, after being multiplied by
+    // the scale, e.g. 1e-6 to report instructions per second as MIPS
+    virtual void reg_counter(std::string path, std::string name, telemetry_counter *counter,
+      telemetry_kind_e kind=TELEMETRY_RATE, double scale=1.0) {}
+  };
+
+};
+
+#endif
@@ -40,6 +40,8 @@ namespace vp {
 
     void start();
 
+    void stop();
+
     void run_loop();
 
     string run();
@@ -60,6 +62,13 @@ namespace vp {
 
     inline void stop_engine(int status);
 
+    // Must be called from the engine thread. The engine stops after the
+    // current event and run() returns "paused". The simulation can then be
+    // resumed by calling run() again.
+    inline void pause();
+
+    void fork_child();
+
     inline vp::time_engine *get_time_engine() { return this; }
 
     bool dequeue(time_engine_client *client);
@@ -83,6 +92,7 @@ namespace vp {
     bool locked_run_req;
     bool run_req;
     bool stop_req;
+    bool pause_req = false;
     bool finished = false;
     bool init = false;
 
@@ -96,6 +106,7 @@ namespace vp {
     pthread_t run_thread;
 
     int64_t time = 0;
+    int64_t pause_time = INT64_MAX;
     int stop_status = -1;
     int retain_count = 0;
     bool no_exit;
@@ -166,6 +177,16 @@ namespace vp {
     stop_engine();
   }
 
+  inline void vp::time_engine::pause()
+  {
+    pthread_mutex_lock(&mutex);
+    run_req = false;
+    stop_req = true;
+    pause_req = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+  }
+
   inline void vp::time_engine::wait_running()
   {
     pthread_mutex_lock(&mutex);
@@ -22,6 +22,9 @@
 #define __VP_TRACE_EVENT_DUMPER_HPP__
 
 #include <stdio.h>
+#include <pthread.h>
+#include <thread>
+#include <vector>
 #include <unordered_map>
 
 namespace vp {
@@ -80,6 +83,28 @@ namespace vp {
     std::map<std::string, Event_file *> event_files;
   };
 
+  #define VCD_CHUNK_SIZE  (256*1024)
+  #define VCD_NB_CHUNKS   16
+  #define VCD_BATCH_SIZE  (1<<20)
+  #define VCD_PAGE_BITS   10
+  #define VCD_NB_PAGES    1024
+
+  // State of a trace in a VCD file
+  class Vcd_trace
+  {
+  public:
+    // Identifier in base 94, using printable characters
+    char code[8];
+    int code_len;
+    bool is_real;
+    bool is_string;
+    // Last value dumped, to not dump it again if it did not change
+    bool has_value = false;
+    bool is_x;
+    int bytes = 0;
+    uint8_t *value = NULL;
+  };
+
   class Vcd_file : public Event_file
   {
   public:
@@ -90,6 +115,43 @@ namespace vp {
 
   private:
     string parse_path(string path, bool begin);
+    void encode(int64_t timestamp, Vcd_trace *trace, uint8_t *event, int width);
+    void encode_batch(uint8_t *batch, int size);
+    void submit_batch();
+    void worker_routine();
+    inline char *reserve(int size);
+    void write_data(const char *data, int size);
+    void flush_chunks();
+
+    int fd;
+    // Traces are indexed by their global id. Pages are never moved so that
+    // the dumping thread can access them while new traces are added.
+    Vcd_trace **pages[VCD_NB_PAGES] = { NULL };
+    int nb_traces = 0;
+
+    // Definitions are dumped by the encoder, as they may be added while it
+    // is running
+    std::string header;
+    bool header_pending = false;
+    int64_t pending_timestamp = -1;
+
+    // Output is accumulated into chunks which are written together
+    char *chunks[VCD_NB_CHUNKS];
+    int chunk_capacity[VCD_NB_CHUNKS];
+    int chunk_size[VCD_NB_CHUNKS];
+    int current_chunk = 0;
+
+    // When several files are dumped, each one can be encoded by its own
+    // thread, which receives the events by batch
+    bool parallel = false;
+    std::thread *worker = NULL;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    std::vector<std::pair<uint8_t *, int>> ready_batches;
+    std::vector<uint8_t *> free_batches;
+    uint8_t *batch = NULL;
+    int batch_size = 0;
+    bool end = false;
   };
 
   class Lxt2_file : public Event_file
@@ -149,10 +149,17 @@ namespace vp {
   #ifdef VP_TRACE_ACTIVE
   	if (is_active && comp->traces.get_trace_manager()->get_trace_level() >= this->level)
     {
-      dump_header();
       va_list ap;
       va_start(ap, fmt);
-      if (vfprintf(this->trace_file, fmt, ap) < 0) {}
+      if (comp->traces.get_trace_manager()->log)
+      {
+        this->log_msg(fmt, ap);
+      }
+      else
+      {
+        dump_header();
+        if (vfprintf(this->trace_file, fmt, ap) < 0) {}
+      }
       va_end(ap);  
     }
   #endif
@@ -163,10 +170,17 @@ namespace vp {
   #ifdef VP_TRACE_ACTIVE
     if (is_active && comp->traces.get_trace_manager()->get_trace_level() >= level)
     {
-      dump_header();
       va_list ap;
       va_start(ap, fmt);
-      if (vfprintf(this->trace_file, fmt, ap) < 0) {}
+      if (comp->traces.get_trace_manager()->log)
+      {
+        this->log_msg(fmt, ap);
+      }
+      else
+      {
+        dump_header();
+        if (vfprintf(this->trace_file, fmt, ap) < 0) {}
+      }
       va_end(ap);  
     }
   #endif
@@ -36,6 +36,7 @@ namespace vp {
 
     friend class component_trace;
     friend class trace_engine;
+    friend class trace_log;
 
   public:
 
@@ -62,6 +63,7 @@ namespace vp {
     inline string get_name() { return this->name; }
 
     void dump_header();
+    void log_msg(const char *fmt, va_list ap);
     void dump_warning_header();
     void dump_fatal_header();
 
@@ -96,6 +98,12 @@ namespace vp {
     trace *next;
     trace *prev;
     int64_t pending_timestamp;
+
+    // Last formats logged through the deferred trace log which were found
+    // in read-only memory or not, so that a trace logging the same format
+    // again does not look it up
+    const char *log_static_fmt = NULL;
+    const char *log_dynamic_fmt = NULL;
   };    
 
 
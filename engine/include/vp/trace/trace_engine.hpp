@@ -24,14 +24,38 @@
 #include "vp/vp_data.hpp"
 #include "vp/component.hpp"
 #include "vp/trace/trace.hpp"
+#include "vp/trace/trace_log.hpp"
+#include "vp/telemetry/telemetry_engine.hpp"
 #include <pthread.h>
 #include <thread>
+#include <functional>
 
 namespace vp {
 
   #define TRACE_EVENT_BUFFER_SIZE (1<<16)
   #define TRACE_EVENT_NB_BUFFER   4
 
+  typedef enum {
+    TRACE_TRIGGER_PC,
+    TRACE_TRIGGER_SYMBOL,
+    TRACE_TRIGGER_ADDR,
+    TRACE_TRIGGER_MAGIC,
+    TRACE_TRIGGER_CYCLES
+  } trace_trigger_type_e;
+
+  // Condition opening or closing a trace window. Triggers are only described
+  // here, they are checked by the models which can observe them, e.g. the
+  // cores for PCs, data accesses and cycles.
+  class trace_trigger
+  {
+  public:
+    int window;
+    bool open;
+    trace_trigger_type_e type;
+    uint64_t value;
+    std::string symbol;
+  };
+
   class trace_engine : public component
   {
   public:
@@ -39,6 +63,11 @@ namespace vp {
 
     void stop();
 
+    // The event dumping thread is stopped before the platform is forked and
+    // started again in the child
+    void fork_prepare();
+    void fork_child();
+
     virtual void reg_trace(vp::trace *trace, int event, string path, string name) = 0;
 
     virtual int get_max_path_len() = 0;
@@ -58,10 +87,41 @@ namespace vp {
 
     vp::trace *get_trace_from_id(int id);
 
+    // Trace windows. The traces and events of a window are only active
+    // between its opening and closing triggers, so that the trace overhead
+    // is confined to the regions of interest.
+    virtual int get_window(std::string name) = 0;
+    virtual void set_window(int window, bool open) = 0;
+    virtual int add_trigger(std::string window, bool open, trace_trigger_type_e type, uint64_t value, std::string symbol="") = 0;
+    virtual std::vector<trace_trigger *> &get_triggers() = 0;
+
+    // The callback is called each time a window is opened or closed, or the
+    // triggers are modified
+    virtual void reg_window_listener(std::function<void()> callback) = 0;
+
+    // Set when trace messages are deferred to the logging thread
+    trace_log *log = NULL;
+
+    // True when traces are only enabled by windows and all of them are
+    // closed, in which case models can use their release paths
+    inline bool is_idle() { return this->idle; }
+
+    // True when trace messages can currently be printed, because trace
+    // paths are given or a window with trace paths is open, so that models
+    // writing to the terminal can keep their output in order with them
+    inline bool has_msg_traces() { return this->msg_traces; }
+
   protected:
+    bool idle = false;
+    bool msg_traces = false;
+
     std::map<std::string, trace *> traces_map;
     std::vector<trace *> traces_array;
 
+    // Number of event buffers being filled or waiting to be dumped, sampled
+    // by the telemetry engine
+    vp::telemetry_counter nb_busy_buffers;
+
   private:
     void enqueue_pending(vp::trace *trace, int64_t timestamp, uint8_t *event);
     char *get_event_buffer(int bytes);
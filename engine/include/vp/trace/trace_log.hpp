@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_TRACE_TRACE_LOG_HPP__
+#define __VP_TRACE_TRACE_LOG_HPP__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Binary trace log, decoded by gvsoc-trace-log.
+// The file starts with the magic, followed by records, each one starting
+// with a byte giving its type:
+// - TRACE: int32 trace, uint32 name length, name. Recorded before the first
+//   message of the trace.
+// - FORMAT: uint32 format, uint32 length, format. Recorded before the first
+//   message using the format.
+// - MESSAGE: int32 trace, uint32 format, int64 time, int64 cycles, uint32
+//   number of 8-byte arguments, arguments (see trace_log_format.hpp).
+
+#define TRACE_LOG_MAGIC "GVTLOG01"
+
+typedef enum
+{
+  TRACE_LOG_TRACE,
+  TRACE_LOG_FORMAT,
+  TRACE_LOG_MESSAGE
+} trace_log_record_e;
+
+namespace vp {
+
+  class trace;
+  class trace_log;
+
+  // Ring buffer of a simulation thread. Only this thread writes messages
+  // and only the logging thread reads them, so that the positions are
+  // enough to synchronize them.
+  class trace_log_buffer
+  {
+  public:
+    trace_log *log;
+    char *data;
+    uint64_t size;
+    std::atomic<uint64_t> write_pos;
+    std::atomic<uint64_t> read_pos;
+
+    // Formats are only referenced by pointer when they are in read-only
+    // memory, as other ones may be modified before being logged. This is
+    // only looked up when a trace logs another format than its last ones.
+    std::unordered_map<const char *, bool> static_formats;
+    std::vector<uint64_t> args;
+  };
+
+  // Deferred trace messages. Instead of being formatted and written by the
+  // simulation thread, messages are stored raw in a ring buffer, with the
+  // trace, the timestamp, the format and the arguments, and a logging thread
+  // formats and writes them to the trace files, or writes them to a binary
+  // log to be decoded later.
+  class trace_log
+  {
+  public:
+    // Messages are written to the binary log if the path is not empty
+    int open(std::string binary_path);
+    void close();
+
+    void log(vp::trace *trace, int64_t time, int64_t cycles, const char *fmt, va_list ap);
+
+    // Waits until all the messages logged so far are written, so that
+    // messages printed directly can be kept in order
+    void flush();
+
+    // Stops the logging thread before the platform is forked, and starts
+    // it again in the child
+    void fork_prepare();
+    void fork_child();
+
+  private:
+    void stop_thread();
+    trace_log_buffer *get_buffer();
+    bool is_static(trace_log_buffer *buffer, const char *fmt);
+    bool consume(trace_log_buffer *buffer);
+    void write_message(vp::trace *trace, int64_t time, int64_t cycles, const char *fmt, bool is_static, uint64_t *args, int nb_args);
+    uint32_t get_format_id(const char *fmt, bool is_static);
+    void routine();
+    static void *routine_stub(void *arg);
+
+    std::string binary_path;
+    FILE *binary_file = NULL;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool running = false;
+    bool end = false;
+    // Set when the thread was stopped to fork the platform
+    bool forked = false;
+    std::vector<trace_log_buffer *> buffers;
+
+    // Logging thread state
+    std::string line;
+    std::unordered_map<const char *, uint32_t> format_ids;
+    std::unordered_map<std::string, uint32_t> dynamic_format_ids;
+    std::vector<bool> dumped_traces;
+  };
+
+};
+
+#endif
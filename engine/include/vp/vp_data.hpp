@@ -23,6 +23,7 @@
 #define __VP_VP_DATA_HPP__
 
 #include "vp/component.hpp"
+#include "vp/telemetry/telemetry_engine.hpp"
 #include "vp/clock/clock_event.hpp"
 #include "vp/clock/clock_engine.hpp"
 #include "vp/power/power.hpp"
@@ -17,8 +17,10 @@
 # Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
  
 import imp
+import importlib
 import ctypes
 import ctypes.util
+import json
 import json_tools as js
 
 
@@ -58,6 +60,8 @@ class port(object):
             self.comp.trace.msg('Binding composite master port (master: %s->%s, slave: %s->%s)' % (self.get_comp().name, self.name, port.get_comp().name, port.name))
             self.slaves.append(port)
             port.is_bound = True
+            if description is not None:
+                description.add_binding(self, port, config)
 
     def is_master(self):
         return True
@@ -433,6 +437,9 @@ class component(component_trace):
 
         self.json_config = self.get_json_config(config)
 
+        if description is not None:
+            description.index_json_config(config, self.json_config)
+
         if hasattr(self, 'implementation'):
             self.impl = self.implementation_class(getattr(self, 'implementation'), config, parent=self, debug=debug)
 
@@ -476,6 +483,11 @@ class component(component_trace):
     def get_json(self):
         return self.json_config
 
+    def get_config(self, name=None):
+        if name is None:
+            return self.config
+        return self.config.get_config(name)
+
     def get_module(self, name, path=None):
         for x in name.split('.'):
             if path is not None:
@@ -509,6 +521,7 @@ class component(component_trace):
         self.trace.msg('New component (name: %s, class: %s)' % (name, component))
 
         comp = self.get_component(component)(name, config, parent=self, debug=self.debug)
+        comp.vp_class = component
         self.sub_comps.append(comp)
         self.sub_comps_dict[name] = comp
 
@@ -517,6 +530,12 @@ class component(component_trace):
     def build(self):
         pass
 
+    # Entries added to the description of the component, for what the native
+    # builder would otherwise have to compute from the config, see
+    # describe_platform
+    def describe(self):
+        return {}
+
     def build_all(self):
 
         for build in self.sub_comps:
@@ -524,11 +543,22 @@ class component(component_trace):
 
         self.trace.msg('Building component')
 
+        if description is not None:
+            description.building.append(self)
+
         self.build()
 
+        if description is not None:
+            description.building.pop()
+
         if self.impl is not None:
             self.impl.build()
 
+        # When the platform is only described, clock and reset are bound by
+        # the native builder, which is the only one knowing the model ports
+        if description is not None:
+            return
+
         ports = [ ['clock', False], ['reset', False] ]
 
         for port_desc in ports:
@@ -780,6 +810,198 @@ class component(component_trace):
 
 
 
+class description_entry_point(object):
+
+    def __call__(self, *args):
+        return 0
+
+
+class description_module(object):
+
+    # Stands for the model library, so that python classes can still set up
+    # and call its entry points from their build method. What they do there
+    # is done by the native builder.
+    def __getattr__(self, name):
+        entry_point = description_entry_point()
+        setattr(self, name, entry_point)
+        return entry_point
+
+
+class description_port(object):
+
+    def __init__(self, comp, name):
+        self.comp = comp
+        self.name = name
+        self.is_bound = False
+
+    def get_comp(self):
+        return self.comp
+
+    def bind_to(self, port, config=None):
+        self.is_bound = True
+        port.is_bound = True
+        description.add_binding(self, port, config)
+
+    def is_master(self):
+        return True
+
+    def is_slave(self):
+        return True
+
+
+class description_implementation_class(object):
+
+    # Used instead of the model library when the platform is only described.
+    # The model ports are only known once the model is built, so any port is
+    # accepted here and checked by the native builder.
+
+    def __init__(self, name, config, parent, debug, path=None):
+        self.parent = parent
+        self.name = name.replace('/', '.')
+        self.instance = None
+        self.module = description_module()
+        self.ports = {}
+
+    def build(self):
+        pass
+
+    def get_port(self, name):
+        # Python ports have priority as they can not be model ports
+        if self.parent.ports.get(name) is not None:
+            return None
+
+        port = self.ports.get(name)
+        if port is None:
+            port = description_port(self.parent, name)
+            self.ports[name] = port
+        return port
+
+
+class platform_description(object):
+
+    def __init__(self, config):
+        self.building = []
+        self.bindings = {}
+        self.config_paths = {}
+        self.index_config(config, '')
+
+    def index_config(self, config, path):
+        self.config_paths[id(config)] = path
+
+        get_items = getattr(config, 'items', None)
+        if get_items is not None:
+            for name, child in get_items():
+                self.index_config(child, name if path == '' else path + '/' + name)
+
+    # Composites are giving their childs a sub-tree of their json config,
+    # which is a copy of the platform config, so it is indexed as well
+    def index_json_config(self, config, json_config):
+        path = self.config_paths.get(id(config))
+        if path is not None:
+            self.index_config(json_config, path)
+
+    def get_port_path(self, comp, port):
+        names = []
+        port_comp = port.get_comp()
+        while port_comp is not comp:
+            if port_comp is None:
+                raise Exception('Binding outside of the component (component: %s, port: %s->%s)' %
+                    (comp.get_path(), port.get_comp().get_path(), port.name))
+            names.insert(0, port_comp.name)
+            port_comp = port_comp.get_parent()
+
+        return ('self' if len(names) == 0 else '/'.join(names)) + '->' + port.name
+
+    # Bindings are given to the component whose build method is creating
+    # them, relative to it, so that the builder creates them in the same
+    # order
+    def add_binding(self, master, slave, config):
+        if len(self.building) == 0:
+            raise Exception('Bindings can only be described from a build method (master: %s->%s)' %
+                (master.get_comp().get_path(), master.name))
+
+        comp = self.building[-1]
+        binding = [self.get_port_path(comp, master), self.get_port_path(comp, slave)]
+        if config is not None:
+            binding.append(json.dumps(config))
+
+        self.bindings.setdefault(id(comp), []).append(binding)
+
+    def new(self, name, vp_class, config):
+        comp = importlib.import_module(vp_class.replace('/', '.')).component(name, config, debug=False)
+        comp.vp_class = vp_class
+        return comp
+
+    def describe(self, comp):
+        desc = {}
+        desc['name'] = comp.name
+        desc['class'] = comp.vp_class
+        if comp.impl is not None:
+            desc['implementation'] = comp.impl.name
+
+        # The config is given by its path in the platform config unless
+        # python created or completed it, e.g. with defaults computed by a
+        # build method, in which case it is given as the model gets it
+        if comp.config is not None:
+            json_config = comp.get_json().get_dict()
+            path = self.config_paths.get(id(comp.config))
+            if path is not None and json_config == comp.config.get_dict():
+                desc['config_path'] = path
+            else:
+                desc['config'] = json_config
+
+        desc.update(comp.describe())
+
+        desc['comps'] = [self.describe(child) for child in comp.sub_comps]
+        desc['ports'] = list(comp.ports.keys())
+        desc['bindings'] = self.bindings.get(id(comp), [])
+
+        return desc
+
+
+# Set while the platform is described, see describe_platform
+description = None
+
+
+def describe_platform(config):
+    """Describe the platform which would be built from this config, so that
+    the native builder can instantiate it without python.
+
+    The python classes are instantiated and built as for a run, except that
+    the model libraries are not loaded. The description gives for each
+    component its class, its implementation, its config, and the components,
+    ports and bindings created by its build method, plus the entries its
+    describe method returns. It also contains the platform config, so that
+    it is the only file the builder needs.
+    """
+    global description
+
+    description = platform_description(config)
+    component.implementation_class = description_implementation_class
+
+    try:
+        gvsoc_config = config.get('gvsoc')
+
+        engines = {}
+        engines['power_engine'] = description.describe(description.new(None, 'vp.power_engine', gvsoc_config))
+        engines['time_engine'] = description.describe(description.new(None, 'vp.time_domain', config))
+        engines['trace_engine'] = description.describe(description.new(None, 'vp.trace_engine', gvsoc_config))
+        engines['telemetry_engine'] = description.describe(description.new(None, 'vp.telemetry_engine', gvsoc_config))
+
+        top = config.get_child_str('system_tree/vp_class')
+        if top is None:
+            raise Exception("The specified configuration does not contain any top component")
+
+        system = description.describe(description.new('sys', top, config.get('system_tree')))
+
+    finally:
+        description = None
+        component.implementation_class = default_implementation_class
+
+    return { 'config': config.get_dict(), 'engines': engines, 'system': system }
+
+
+
 def map_config(base=0, size=0, add_offset=0, remove_offset=0):    
     binding_conf = {}
     binding_conf['base'] = base
@@ -1203,9 +1203,9 @@ class Runner(Platform):
         self.gen_rom_stimuli = False
 
         if self.args.debug_syms:
+            # The cores read the debug information directly from the binaries
             for binary in self.get_json().get('**/runner/binaries').get_dict():
-                debug_binary = binary + '.debugInfo'
-                self.get_json().set('**/debug_binaries', debug_binary)
+                self.get_json().set('**/debug_binaries', binary)
 
         comps_conf = self.get_json().get('**/fs/files')
 
@@ -1246,11 +1246,6 @@ class Runner(Platform):
 
     def prepare(self):
 
-        if self.args.debug_syms:
-            for binary in self.get_json().get('**/runner/binaries').get_dict():
-                if os.system('pulp-pc-info --file %s --all-file %s' % (binary, binary + '.debugInfo')) != 0:
-                    raise Exception('Error while generating debug symbols information, make sure the toolchain and the binaries are accessible ')
-
         comps = []
         raw_fs = self.get_json().get_str('**/flash/raw_fs')
         comps_conf = self.get_json().get('**/flash/fs/files')
@@ -1381,7 +1376,11 @@ class Runner(Platform):
 
         gen_gtkw_files(self.get_json(), gvsoc_config)
 
-        debug_mode = gvsoc_config.get_bool('trace-enable') or gvsoc_config.get_bool('vcd/active') or len(gvsoc_config.get('trace').get()) != 0 or len(gvsoc_config.get('event').get()) != 0
+        # Trace windows need the debug build, where the traces they open are
+        # compiled in
+        trace_windows = gvsoc_config.get('trace_windows')
+
+        debug_mode = gvsoc_config.get_bool('trace-enable') or gvsoc_config.get_bool('vcd/active') or len(gvsoc_config.get('trace').get()) != 0 or len(gvsoc_config.get('event').get()) != 0 or (trace_windows is not None and trace_windows.get_items() is not None and len(trace_windows.get_items()) != 0)
 
         power_engine = vp.power_engine.component(name=None, config=gvsoc_config, debug=debug_mode)
 
@@ -1397,6 +1396,12 @@ class Runner(Platform):
             config=gvsoc_config
         )
 
+        time_engine.new(
+            name=None,
+            component='vp.telemetry_engine',
+            config=gvsoc_config
+        )
+
         top_comp = time_engine.new(
             name='sys',
             component=top,
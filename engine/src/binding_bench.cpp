@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Number of requests per second sent by a master to a memory through a
+// port bound at runtime, with the memory loaded as a shared library like
+// the models of the dynamic build (gvsoc-binding-bench), or linked with
+// link-time optimization like in the monolithic simulator
+// (gvsoc-binding-bench-static). The memory is measured alone and calling
+// the engine on each request.
+//
+// Usage: gvsoc-binding-bench [<number of requests>]
+
+#include "binding_bench.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef BINDING_BENCH_STATIC
+#include <dlfcn.h>
+#endif
+
+
+static int64_t nb_iter;
+
+static int64_t engine_cycles;
+
+extern "C" void binding_bench_engine_account(binding_bench_req_t *req, int64_t cycles)
+{
+  req->latency += cycles;
+  engine_cycles += cycles;
+}
+
+static int64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static binding_bench_constructor_t *get_constructor()
+{
+#ifdef BINDING_BENCH_STATIC
+  return binding_bench_model_new;
+#else
+  void *handle = dlopen("libgvsoc-binding-bench-model.so", RTLD_NOW | RTLD_GLOBAL);
+  if (handle == NULL)
+  {
+    fprintf(stderr, "Failed to load memory model: %s\n", dlerror());
+    exit(1);
+  }
+  return (binding_bench_constructor_t *)dlsym(handle, "binding_bench_model_new");
+#endif
+}
+
+static void run(const char *name, binding_bench_constructor_t *constructor)
+{
+  binding_bench_port_t port;
+  constructor(&port, name);
+
+  // In the simulator, the port is filled while binding the components
+  // described in the configuration, so the compiler can't know which method
+  // is called. The barrier keeps it from seeing it here too.
+  __asm__ __volatile__ ("" : "+r" (port.req_meth), "+r" (port.context));
+
+  uint32_t value = 0;
+  binding_bench_req_t req;
+  req.data = (uint8_t *)&value;
+  req.size = 4;
+  req.latency = 0;
+
+  int64_t start = get_time_ns();
+  for (int64_t i=0; i<nb_iter; i++)
+  {
+    req.addr = i << 2;
+    req.is_write = i & 1;
+    port.req_meth(port.context, &req);
+    value++;
+  }
+  int64_t duration = get_time_ns() - start;
+
+  printf("%-12s %12.0f requests/s, %6.2f ns/request\n", name, (double)nb_iter * 1000000000 / duration,
+    (double)duration / nb_iter);
+}
+
+int main(int argc, char *argv[])
+{
+  nb_iter = argc > 1 ? atoll(argv[1]) : 100000000;
+
+  binding_bench_constructor_t *constructor = get_constructor();
+
+  run("memory", constructor);
+  run("memory_timed", constructor);
+
+  return engine_cycles == nb_iter ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_BINDING_BENCH_HPP__
+#define __VP_BINDING_BENCH_HPP__
+
+#include <stdint.h>
+
+// Reduced version of vp::io_req and of a slave port, so that the benchmark
+// does not depend on the rest of the engine
+typedef struct
+{
+  uint64_t addr;
+  uint8_t *data;
+  uint64_t size;
+  bool is_write;
+  int64_t latency;
+} binding_bench_req_t;
+
+typedef int (binding_bench_req_meth_t)(void *context, binding_bench_req_t *req);
+
+typedef struct
+{
+  void *context;
+  binding_bench_req_meth_t *req_meth;
+} binding_bench_port_t;
+
+// Constructor of the model, which fills the port to be bound to the master
+typedef void (binding_bench_constructor_t)(binding_bench_port_t *port, const char *name);
+
+extern "C" binding_bench_constructor_t binding_bench_model_new;
+
+// Engine function called by the model on each request, like the models
+// calling the engine to account for the timing
+extern "C" void binding_bench_engine_account(binding_bench_req_t *req, int64_t cycles);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Memory model of gvsoc-binding-bench, compiled either as a shared library
+// loaded at runtime or into the monolithic benchmark
+
+#include "binding_bench.hpp"
+#include <string.h>
+#include <stdlib.h>
+
+#define MEMORY_SIZE 0x10000
+
+typedef struct
+{
+  uint8_t mem_data[MEMORY_SIZE];
+} memory_t;
+
+static int memory_req(void *context, binding_bench_req_t *req)
+{
+  memory_t *memory = (memory_t *)context;
+  uint64_t offset = req->addr & (MEMORY_SIZE - 1);
+
+  if (req->is_write)
+    memcpy(&memory->mem_data[offset], req->data, req->size);
+  else
+    memcpy(req->data, &memory->mem_data[offset], req->size);
+
+  return 0;
+}
+
+static int memory_timed_req(void *context, binding_bench_req_t *req)
+{
+  binding_bench_engine_account(req, 1);
+  return memory_req(context, req);
+}
+
+extern "C" void binding_bench_model_new(binding_bench_port_t *port, const char *name)
+{
+  port->context = calloc(1, sizeof(memory_t));
+  port->req_meth = strcmp(name, "memory_timed") == 0 ? memory_timed_req : memory_req;
+}
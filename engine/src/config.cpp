@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <vp/config.hpp>
+
+// Wildcards in compiled paths
+#define CONFIG_KEY_ANY        -1    // "*"
+#define CONFIG_KEY_ANY_DEPTH  -2    // "**"
+
+
+// Index used by vp::config_object::get
+static vp::config_index vp_config_index;
+
+static std::unordered_map<std::string, int> keys_map;
+static std::mutex keys_mutex;
+
+
+std::vector<std::string> split_name(const std::string& s, char delimiter)
+{
+   std::vector<std::string> tokens;
+   std::string token;
+   std::istringstream tokenStream(s);
+   while (std::getline(tokenStream, token, delimiter))
+   {
+      tokens.push_back(token);
+   }
+   return tokens;
+}
+
+vp::config *vp::config::create_config(jsmntok_t *tokens, int *_size)
+{
+  jsmntok_t *current = tokens;
+  config *config = NULL;
+
+  switch (current->type)
+  {
+    case JSMN_PRIMITIVE:
+      if (strcmp(current->str, "True") == 0 || strcmp(current->str, "False") == 0 || strcmp(current->str, "true") == 0 || strcmp(current->str, "false") == 0)
+      {
+        config = new config_bool(current);
+      }
+      else
+      {
+        config = new config_number(current);
+      }
+      current++;
+      break;
+
+    case JSMN_OBJECT: {
+      int size;
+      config = new config_object(current, &size);
+      current += size;
+      break;
+    }
+
+    case JSMN_ARRAY: {
+      int size;
+      config = new config_array(current, &size);
+      current += size;
+      break;
+    }
+
+    case JSMN_STRING:
+      config = new config_string(current);
+      current++;
+      break;
+
+    case JSMN_UNDEFINED:
+      break;
+  }
+
+  if (_size) {
+    *_size = current - tokens;
+  }
+
+  return config;
+}
+
+vp::config *vp::config_string::get_from_list(std::vector<std::string> name_list)
+{
+  if (name_list.size() == 0) return this;
+  return NULL;
+}
+
+vp::config *vp::config_number::get_from_list(std::vector<std::string> name_list)
+{
+  if (name_list.size() == 0) return this;
+  return NULL;
+}
+
+vp::config *vp::config_bool::get_from_list(std::vector<std::string> name_list)
+{
+  if (name_list.size() == 0) return this;
+  return NULL;
+}
+
+vp::config *vp::config_array::get_from_list(std::vector<std::string> name_list)
+{
+  if (name_list.size() == 0) return this;
+  return NULL;
+}
+
+vp::config *vp::config_object::get_from_list(std::vector<std::string> name_list)
+{
+  if (name_list.size() == 0) return this;
+
+  vp::config *result = NULL;
+  std::string name;
+  int name_pos = 0;
+
+  for (auto& x: name_list) {
+    if (x != "*" && x != "**")
+    {
+      name = x;
+      break;
+    }
+    name_pos++;
+  }
+
+  for (auto& x: childs) {
+
+    if (name == x.first)
+    {
+      result = x.second->get_from_list(std::vector<std::string>(name_list.begin () + name_pos + 1, name_list.begin () + name_list.size()));
+      if (name_pos == 0 || result != NULL) return result;
+
+    }
+    else if (name_list[0] == "*")
+    {
+      result = x.second->get_from_list(std::vector<std::string>(name_list.begin () + 1, name_list.begin () + name_list.size()));
+      if (result != NULL) return result;
+    }
+    else if (name_list[0] == "**")
+    {
+      result = x.second->get_from_list(name_list);
+      if (result != NULL) return result;
+    }
+  }
+
+  return result;
+}
+
+vp::config *vp::config_object::get(std::string name)
+{
+  return vp_config_index.get((vp::config *)this, name);
+}
+
+vp::config_string::config_string(jsmntok_t *tokens)
+{
+  value = tokens->str;
+}
+
+vp::config_number::config_number(jsmntok_t *tokens)
+{
+  value = atof(tokens->str);
+}
+
+vp::config_bool::config_bool(jsmntok_t *tokens)
+{
+  value = strcmp(tokens->str, "True") == 0 || strcmp(tokens->str, "true") == 0;
+}
+
+vp::config_array::config_array(jsmntok_t *tokens, int *_size)
+{
+  jsmntok_t *current = tokens;
+  jsmntok_t *top = current++;
+  
+  for (int i=0; i<top->size; i++)
+  {
+    int child_size;
+    elems.push_back(create_config(current, &child_size));
+    current += child_size;
+  }
+
+
+  if (_size) {
+    *_size = current - tokens;
+  }
+}
+
+vp::config_object::config_object(jsmntok_t *tokens, int *_size)
+{
+  jsmntok_t *current = tokens;
+  jsmntok_t *t = current++;
+
+  for (int i=0; i<t->size; i++)
+  {
+    jsmntok_t *child_name = current++;
+    int child_size;
+    config *child_config = create_config(current, &child_size);
+    current += child_size;
+
+    if (child_config != NULL)
+    {
+      childs[child_name->str] = child_config;
+
+    }
+  }
+
+  if (_size) {
+    *_size = current - tokens;
+  }
+}
+
+
+int vp::config_index::intern(const std::string &key)
+{
+  std::lock_guard<std::mutex> lock(keys_mutex);
+
+  auto it = keys_map.find(key);
+  if (it != keys_map.end())
+    return it->second;
+
+  int id = keys_map.size();
+  keys_map[key] = id;
+  return id;
+}
+
+int vp::config_index::new_node(void *config, int key)
+{
+  int node = this->nodes.size();
+  this->nodes.push_back({ config, key, 0, 0, 0 });
+  this->nodes_map[config] = node;
+  if (key >= 0)
+    this->key_nodes[key].push_back(node);
+  return node;
+}
+
+void vp::config_index::set_childs(int node, std::vector<int> &childs)
+{
+  node_t *desc = &this->nodes[node];
+  desc->first_child = this->childs.size();
+  desc->nb_childs = childs.size();
+  desc->end = this->nodes.size();
+
+  for (int child: childs)
+  {
+    this->childs.push_back(child);
+    this->childs_map[((uint64_t)node << 32) | this->nodes[child].key] = child;
+  }
+}
+
+int vp::config_index::compile(const std::string &path)
+{
+  auto it = this->paths_map.find(path);
+  if (it != this->paths_map.end())
+    return it->second;
+
+  std::vector<int> keys;
+  for (auto &name: split_name(path, '/'))
+  {
+    if (name == "*")
+      keys.push_back(CONFIG_KEY_ANY);
+    else if (name == "**")
+      keys.push_back(CONFIG_KEY_ANY_DEPTH);
+    else
+      keys.push_back(intern(name));
+  }
+
+  int id = this->paths.size();
+  this->paths.push_back(keys);
+  this->paths_map[path] = id;
+  return id;
+}
+
+int vp::config_index::get_child(int node, int key)
+{
+  auto it = this->childs_map.find(((uint64_t)node << 32) | key);
+  return it == this->childs_map.end() ? -1 : it->second;
+}
+
+void *vp::config_index::lookup(void *config, const std::string &path)
+{
+  int node = this->nodes_map[config];
+  int path_id = this->compile(path);
+  uint64_t result_key = ((uint64_t)node << 32) | path_id;
+
+  auto it = this->results.find(result_key);
+  if (it != this->results.end())
+    return it->second;
+
+  std::vector<int> &keys = this->paths[path_id];
+  int result = this->resolve(node, keys.data(), keys.size());
+  void *config_result = result == -1 ? NULL : this->nodes[result].config;
+
+  this->results[result_key] = config_result;
+
+  return config_result;
+}
+
+// Same steps as get_from_list, a path element being matched against the
+// first non-wildcard element
+int vp::config_index::resolve(int node, const int *keys, int nb_keys)
+{
+  if (nb_keys == 0)
+    return node;
+
+  int name_pos = 0;
+  while (name_pos < nb_keys && keys[name_pos] < 0)
+    name_pos++;
+
+  int name = name_pos < nb_keys ? keys[name_pos] : intern("");
+  const int *rest = keys + name_pos + 1;
+  int nb_rest = std::max(nb_keys - name_pos - 1, 0);
+
+  if (name_pos == 0)
+  {
+    int child = this->get_child(node, name);
+    return child == -1 ? -1 : this->resolve(child, rest, nb_rest);
+  }
+
+  if (keys[0] == CONFIG_KEY_ANY)
+  {
+    node_t *desc = &this->nodes[node];
+    for (int i=0; i<desc->nb_childs; i++)
+    {
+      int child = this->childs[desc->first_child + i];
+      int result;
+      if (this->nodes[child].key == name)
+        result = this->resolve(child, rest, nb_rest);
+      else
+        result = this->resolve(child, keys + 1, nb_keys - 1);
+
+      if (result != -1)
+        return result;
+    }
+    return -1;
+  }
+
+  // "**" goes through the subtree in tree order, stopping at the nodes with
+  // the searched key, so only these nodes are looked at, skipping the ones
+  // below a node which was already tried
+  auto it = this->key_nodes.find(name);
+  if (it == this->key_nodes.end())
+    return -1;
+
+  std::vector<int> &candidates = it->second;
+  int end = this->nodes[node].end;
+  auto current = std::lower_bound(candidates.begin(), candidates.end(), node + 1);
+
+  while (current != candidates.end() && *current < end)
+  {
+    int result = this->resolve(*current, rest, nb_rest);
+    if (result != -1)
+      return result;
+
+    current = std::lower_bound(current, candidates.end(), this->nodes[*current].end);
+  }
+
+  return -1;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Time of the config lookups done by the components during elaboration,
+// with the tree walk of get_from_list and with the config index, on a
+// platform configuration generated by pulp-run, ideally the one of the
+// largest chip. Each object of the configuration looks up its keys and the
+// keys of its childs, directly and through "**", like the components do in
+// their constructors. The results of both methods are checked to be the same.
+//
+// Usage: gvsoc-config-bench <config file> [<number of iterations>]
+
+#include <vp/config.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fstream>
+#include <sstream>
+
+
+typedef struct
+{
+  vp::config *config;
+  std::string path;
+  std::vector<std::string> path_list;
+} lookup_t;
+
+
+static int64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static std::vector<std::string> split(const std::string &s, char delimiter)
+{
+  std::vector<std::string> tokens;
+  std::string token;
+  std::istringstream token_stream(s);
+  while (std::getline(token_stream, token, delimiter))
+  {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+static void add_lookup(std::vector<lookup_t> &lookups, vp::config *config, std::string path)
+{
+  lookups.push_back({ config, path, split(path, '/') });
+}
+
+static void get_lookups(std::vector<lookup_t> &lookups, vp::config *config, int *nb_nodes)
+{
+  (*nb_nodes)++;
+
+  for (auto &x: config->get_childs())
+  {
+    add_lookup(lookups, config, x.first);
+    add_lookup(lookups, config, "**/" + x.first);
+
+    for (auto &y: x.second->get_childs())
+    {
+      add_lookup(lookups, config, x.first + "/" + y.first);
+      add_lookup(lookups, config, "*/" + y.first);
+    }
+
+    get_lookups(lookups, x.second, nb_nodes);
+  }
+}
+
+static vp::config *import_config(const char *path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+    return NULL;
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string content = buffer.str();
+
+  jsmn_parser parser;
+
+  jsmn_init(&parser);
+  int nb_tokens = jsmn_parse(&parser, content.c_str(), content.size(), NULL, 0);
+  if (nb_tokens <= 0)
+    return NULL;
+
+  std::vector<jsmntok_t> tokens(nb_tokens);
+
+  jsmn_init(&parser);
+  nb_tokens = jsmn_parse(&parser, content.c_str(), content.size(), tokens.data(), nb_tokens);
+  if (nb_tokens <= 0)
+    return NULL;
+
+  // Strings are kept by the config
+  char *str = strdup(content.c_str());
+  for (int i=0; i<nb_tokens; i++)
+  {
+    jsmntok_t *tok = &tokens[i];
+    tok->str = &str[tok->start];
+    str[tok->end] = 0;
+  }
+
+  return new vp::config_object(tokens.data());
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s <config file> [<number of iterations>]\n", argv[0]);
+    return -1;
+  }
+
+  int nb_iter = argc > 2 ? atoi(argv[2]) : 10;
+
+  int64_t start = get_time_ns();
+  vp::config *config = import_config(argv[1]);
+  if (config == NULL)
+  {
+    fprintf(stderr, "Unable to parse config file: %s\n", argv[1]);
+    return -1;
+  }
+  int64_t parse_time = get_time_ns() - start;
+
+  std::vector<lookup_t> lookups;
+  int nb_nodes = 0;
+  get_lookups(lookups, config, &nb_nodes);
+
+  std::vector<vp::config *> results(lookups.size());
+
+  start = get_time_ns();
+  for (int i=0; i<nb_iter; i++)
+  {
+    for (size_t j=0; j<lookups.size(); j++)
+    {
+      results[j] = lookups[j].config->get_from_list(lookups[j].path_list);
+    }
+  }
+  int64_t walk_time = get_time_ns() - start;
+
+  // The first iteration also builds the index and compiles the paths
+  int nb_errors = 0;
+  start = get_time_ns();
+  for (size_t j=0; j<lookups.size(); j++)
+  {
+    if (lookups[j].config->get(lookups[j].path) != results[j])
+      nb_errors++;
+  }
+  int64_t index_first_time = get_time_ns() - start;
+
+  start = get_time_ns();
+  for (int i=0; i<nb_iter; i++)
+  {
+    for (size_t j=0; j<lookups.size(); j++)
+    {
+      lookups[j].config->get(lookups[j].path);
+    }
+  }
+  int64_t index_time = get_time_ns() - start;
+
+  printf("Config:             %d nodes, parsed in %.3f ms\n", nb_nodes, parse_time / 1e6);
+  printf("Lookups:            %ld per iteration, %d iterations\n", lookups.size(), nb_iter);
+  printf("Tree walk:          %.3f ms per iteration\n", walk_time / 1e6 / nb_iter);
+  printf("Index, first time:  %.3f ms\n", index_first_time / 1e6);
+  printf("Index:              %.3f ms per iteration\n", index_time / 1e6 / nb_iter);
+
+  if (nb_errors)
+  {
+    printf("Mismatching lookups: %d\n", nb_errors);
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include <vp/context.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+
+#if defined(__x86_64__)
+
+// Saves the callee-saved registers and the floating-point control words on
+// the current stack, stores the stack pointer into *from_sp and restores the
+// same state from to_sp. The first switch to a new context returns into
+// vp_context_start, which calls the function in r12 with the argument in r13.
+extern "C" void vp_context_switch(void **from_sp, void *to_sp);
+extern "C" void vp_context_start();
+
+asm(
+  ".pushsection .text\n"
+  ".globl vp_context_switch\n"
+  ".type vp_context_switch, @function\n"
+  "vp_context_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $16, %rsp\n"
+  "  stmxcsr 8(%rsp)\n"
+  "  fnstcw (%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr 8(%rsp)\n"
+  "  fldcw (%rsp)\n"
+  "  addq $16, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size vp_context_switch, .-vp_context_switch\n"
+  ".globl vp_context_start\n"
+  ".type vp_context_start, @function\n"
+  "vp_context_start:\n"
+  "  movq %r13, %rdi\n"
+  "  callq *%r12\n"
+  "  ud2\n"
+  ".size vp_context_start, .-vp_context_start\n"
+  ".popsection\n"
+);
+
+#endif
+
+
+// Stacks of terminated contexts, sorted by size, reused by new ones. They are
+// mapped with a guard page below them so that an overflow faults instead of
+// corrupting memory.
+static std::mutex stack_pool_mutex;
+static std::map<size_t, std::vector<void *>> stack_pool;
+
+static void *stack_alloc(size_t size)
+{
+  {
+    std::lock_guard<std::mutex> lock(stack_pool_mutex);
+    std::vector<void *> &stacks = stack_pool[size];
+    if (stacks.size())
+    {
+      void *stack = stacks.back();
+      stacks.pop_back();
+      return stack;
+    }
+  }
+
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  void *area = mmap(NULL, size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (area == MAP_FAILED)
+  {
+    perror("Failed to allocate context stack");
+    abort();
+  }
+
+  mprotect(area, page_size, PROT_NONE);
+
+  return (void *)((uint8_t *)area + page_size);
+}
+
+static void stack_free(void *stack, size_t size)
+{
+  std::lock_guard<std::mutex> lock(stack_pool_mutex);
+  stack_pool[size].push_back(stack);
+}
+
+
+vp::context::context() : caller(NULL), done(false), stack(NULL), stack_size(0)
+{
+}
+
+vp::context::~context()
+{
+  this->release();
+}
+
+void vp::context::release()
+{
+  if (this->stack)
+  {
+    stack_free(this->stack, this->stack_size);
+    this->stack = NULL;
+  }
+}
+
+void vp::context::entry_stub(void *arg)
+{
+  context *_this = (context *)arg;
+
+  _this->entry(_this->arg);
+
+  _this->done = true;
+  _this->switch_to(_this->caller);
+}
+
+#if defined(__x86_64__)
+
+void vp::context::init(void (*entry)(void *), void *arg, size_t stack_size)
+{
+  this->release();
+
+  this->entry = entry;
+  this->arg = arg;
+  this->done = false;
+  this->stack_size = stack_size;
+  this->stack = stack_alloc(stack_size);
+
+  // Initial frame popped by vp_context_switch, from the lowest address:
+  // x87 control word, mxcsr, r15, r14, r13, r12, rbx, rbp and the return
+  // address. vp_context_start is then entered with an aligned stack.
+  uintptr_t top = ((uintptr_t)this->stack + stack_size) & ~(uintptr_t)15;
+  uint64_t *frame = (uint64_t *)(top - 88);
+
+  *(uint16_t *)&frame[0] = 0x037f;
+  *(uint32_t *)&frame[1] = 0x1f80;
+  frame[2] = 0;                                // r15
+  frame[3] = 0;                                // r14
+  frame[4] = (uint64_t)this;                   // r13
+  frame[5] = (uint64_t)&context::entry_stub;   // r12
+  frame[6] = 0;                                // rbx
+  frame[7] = 0;                                // rbp
+  frame[8] = (uint64_t)&vp_context_start;
+
+  this->sp = (void *)frame;
+}
+
+void vp::context::switch_to(context *to)
+{
+  to->caller = this;
+  vp_context_switch(&this->sp, to->sp);
+}
+
+#else
+
+// Other architectures fall back to ucontext, which restores the signal mask
+// on each switch
+
+void vp::context::ucontext_stub(unsigned int arg_hi, unsigned int arg_lo)
+{
+  uintptr_t arg = ((uintptr_t)arg_hi << 16 << 16) | arg_lo;
+  context::entry_stub((void *)arg);
+}
+
+void vp::context::init(void (*entry)(void *), void *arg, size_t stack_size)
+{
+  this->release();
+
+  this->entry = entry;
+  this->arg = arg;
+  this->done = false;
+  this->stack_size = stack_size;
+  this->stack = stack_alloc(stack_size);
+
+  getcontext(&this->ucontext);
+  this->ucontext.uc_stack.ss_sp = this->stack;
+  this->ucontext.uc_stack.ss_size = stack_size;
+  this->ucontext.uc_link = NULL;
+
+  uintptr_t value = (uintptr_t)this;
+  makecontext(&this->ucontext, (void (*)())context::ucontext_stub, 2, (unsigned int)(value >> 16 >> 16), (unsigned int)value);
+}
+
+void vp::context::switch_to(context *to)
+{
+  to->caller = this;
+  swapcontext(&this->ucontext, &to->ucontext);
+}
+
+#endif
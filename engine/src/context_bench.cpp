@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Number of context switches per second, with vp::context and with
+// swapcontext, measured like a DPI task yielding to the engine on each clock.
+//
+// Usage: gvsoc-context-bench [<number of switches>]
+
+#include <vp/context.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <ucontext.h>
+
+
+static int64_t nb_iter;
+
+static vp::context main_context;
+static vp::context task_context;
+
+static ucontext_t main_ucontext;
+static ucontext_t task_ucontext;
+
+
+static int64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void task_entry(void *arg)
+{
+  for (int64_t i=0; i<nb_iter; i++)
+  {
+    task_context.switch_to(&main_context);
+  }
+}
+
+static void task_uentry()
+{
+  for (int64_t i=0; i<nb_iter; i++)
+  {
+    swapcontext(&task_ucontext, &main_ucontext);
+  }
+}
+
+static void print_result(const char *name, int64_t duration)
+{
+  // Each iteration switches to the task and back to the engine
+  printf("%-12s %12.0f switches/s, %6.1f ns/switch\n", name, (double)nb_iter * 2 * 1000000000 / duration,
+    (double)duration / nb_iter / 2);
+}
+
+int main(int argc, char *argv[])
+{
+  nb_iter = argc > 1 ? atoll(argv[1]) : 10000000;
+
+  task_context.init(task_entry, NULL);
+
+  int64_t start = get_time_ns();
+  while (!task_context.is_done())
+  {
+    main_context.switch_to(&task_context);
+  }
+  print_result("vp::context", get_time_ns() - start);
+
+  static char stack[65536];
+  getcontext(&task_ucontext);
+  task_ucontext.uc_stack.ss_sp = stack;
+  task_ucontext.uc_stack.ss_size = sizeof(stack);
+  task_ucontext.uc_link = &main_ucontext;
+  makecontext(&task_ucontext, task_uentry, 0);
+
+  start = get_time_ns();
+  for (int64_t i=0; i<nb_iter+1; i++)
+  {
+    swapcontext(&main_ucontext, &task_ucontext);
+  }
+  print_result("swapcontext", get_time_ns() - start);
+
+  return 0;
+}
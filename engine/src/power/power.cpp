@@ -20,181 +20,36 @@
 
 #include "vp/vp.hpp"
 #include "vp/trace/trace.hpp"
+#include "vp/power/power_table.hpp"
+#include "vp/power/power_record.hpp"
 
-namespace vp {
 
-  class Linear_volt_table
-  {
-  public:
-    Linear_volt_table(double temp, js::config *config);
-    inline double get(double frequency) { return any; }
-
-    double volt;
-
-  private:
-    double any;
-  };
-
-
-
-  class Linear_temp_table
-  {
-  public:
-    Linear_temp_table(double temp, js::config *config);
-    double get(double volt, double frequency);
-
-    double temp;
-
-  private:
-    std::vector<Linear_volt_table *> volt_tables;
-  };
-
-
-
-  class Linear_table
-  {
-  public:
-    Linear_table(js::config *config);
-    double get(double temp, double volt, double frequency);
-
-  private:
-    std::vector<Linear_temp_table *> temp_tables;
-  };
-
-};
-
-
-
-vp::Linear_volt_table::Linear_volt_table(double volt, js::config *config)
-{
-  this->volt = volt;
-
-  for (auto& x:config->get_childs())
-  {
-    if (x.first == "any")
-    {
-      this->any = std::stod(x.second->get_str());
-    }
-    else
-    {
-      throw std::logic_error("Only any frequency is allowed for now");
-    }
-  }
-}
-
-double vp::Linear_temp_table::get(double volt, double frequency)
+// Linear power models give for each temperature, the values for each voltage,
+// and for each voltage, the value for any frequency
+static void parse_linear_table(js::config *config, vp::power_table *table)
 {
-  int low_index = -1, high_index = -1;
-
-  // Go through the temperatures to find the one just below and the one
-  // just above
-  for (unsigned int i=0; i<this->volt_tables.size(); i++)
-  {
-    if (this->volt_tables[i]->volt == volt)
-    {
-      low_index = high_index = i;
-      break;
-    }
-
-    if (this->volt_tables[i]->volt > volt)
-    {
-      high_index = i;
-      break;
-    }
-
-    low_index = i;
-  }
-
-  if (high_index == -1)
-    high_index = low_index;
-
-  if (low_index == -1)
-    low_index = high_index;
-
-  double value;
-  if (high_index == low_index)
-  {
-    value = this->volt_tables[low_index]->get(frequency);
-  }
-  else
-  {
-    double low_volt = this->volt_tables[low_index]->volt;
-    double high_volt = this->volt_tables[high_index]->volt;
-
-    double value_at_low_volt = this->volt_tables[low_index]->get(frequency);
-    double value_at_high_volt = this->volt_tables[high_index]->get(frequency);
-
-    double volt_ratio = (volt - low_volt) / (high_volt - low_volt);
-    value = (value_at_high_volt - value_at_low_volt)*volt_ratio + value_at_low_volt;
-  }
-  return value;
-}
-
-vp::Linear_temp_table::Linear_temp_table(double temp, js::config *config)
-{
-  this->temp = temp;
-
   for (auto& x:config->get_childs())
   {
-    volt_tables.push_back(new Linear_volt_table(std::stod(x.first), x.second));
-  }
-}
-
-vp::Linear_table::Linear_table(js::config *config)
-{
-  for (auto& x:config->get_childs())
-  {
-    temp_tables.push_back(new Linear_temp_table(std::stod(x.first), x.second));
-  }
-}
-
-double vp::Linear_table::get(double temp, double volt, double frequency)
-{
-  int low_temp_index = -1, high_temp_index = -1;
-
-  // Go through the temperatures to find the one just below and the one
-  // just above
-  for (unsigned int i=0; i<this->temp_tables.size(); i++)
-  {
-    if (this->temp_tables[i]->temp == temp)
-    {
-      low_temp_index = high_temp_index = i;
-      break;
-    }
+    vp::power_table::temp_point temp;
+    temp.temp = std::stod(x.first);
 
-    if (this->temp_tables[i]->temp > temp)
+    for (auto& y:x.second->get_childs())
     {
-      high_temp_index = i;
-      break;
+      for (auto& z:y.second->get_childs())
+      {
+        if (z.first == "any")
+        {
+          temp.volts.push_back({ std::stod(y.first), std::stod(z.second->get_str()) });
+        }
+        else
+        {
+          throw std::logic_error("Only any frequency is allowed for now");
+        }
+      }
     }
 
-    low_temp_index = i;
-  }
-
-  if (high_temp_index == -1)
-    high_temp_index = low_temp_index;
-
-  if (low_temp_index == -1)
-    low_temp_index = high_temp_index;
-
-  double value;
-
-  if (high_temp_index == low_temp_index)
-  {
-    value = this->temp_tables[low_temp_index]->get(volt, frequency);
-  }
-  else
-  {
-    double low_temp = this->temp_tables[low_temp_index]->temp;
-    double high_temp = this->temp_tables[high_temp_index]->temp;
-
-    double value_at_low_temp = this->temp_tables[low_temp_index]->get(volt, frequency);
-    double value_at_high_temp = this->temp_tables[high_temp_index]->get(volt, frequency);
-
-    double temp_ratio = (temp - low_temp) / (high_temp - low_temp);
-    value = (value_at_high_temp - value_at_low_temp)*temp_ratio + value_at_low_temp;
+    table->temps.push_back(temp);
   }
-  return value;
 }
 
 vp::component_power::component_power(vp::component &top)
@@ -215,8 +70,14 @@ void vp::component_power::pre_start()
 {
   for (auto trace: this->traces)
   {
+    trace->engine = this->get_engine();
     this->get_engine()->reg_trace(trace);
   }
+
+  for (auto source: this->sources)
+  {
+    this->get_engine()->reg_source(source);
+  }
 }
 
 
@@ -238,6 +99,8 @@ int vp::component_power::new_event(std::string name, power_source *source, js::c
 
   source->setup(VP_POWER_DEFAULT_TEMP, VP_POWER_DEFAULT_VOLT, VP_POWER_DEFAULT_FREQ);
 
+  this->sources.push_back(source);
+
   return 0;
 }
 
@@ -354,8 +217,28 @@ void vp::power_trace::account_leakage_power()
   }
 }
 
+double vp::power_trace::get_pending_energy(int64_t time)
+{
+  double energy = this->current_power * (time - this->current_power_timestamp) +
+    this->current_leakage_power * (time - this->current_leakage_power_timestamp);
+
+  for (auto x: this->child_traces)
+  {
+    energy += x->get_pending_energy(time);
+  }
+
+  return energy;
+}
+
+double vp::power_trace::get_energy(int64_t time)
+{
+  return this->total + this->total_leakage + this->get_pending_energy(time);
+}
+
 void vp::power_trace::set_power(double quantum, bool is_leakage)
 {
+  this->check_sample();
+
   if (is_leakage)
   {
     this->account_leakage_power();
@@ -388,6 +271,62 @@ void vp::power_source::setup(double temp, double volt, double freq)
 }
 
 
+void vp::power_source::record_event()
+{
+  if (this->top->get_time() >= this->record_window_end)
+    this->record_update();
+
+  this->record_nb_events++;
+}
+
+
+void vp::power_source::record_update()
+{
+  int64_t time = this->top->get_time();
+  int64_t window_length = this->recorder->window_length;
+
+  // Close the windows which ended since the last update, the on-time being
+  // split between them
+  while (time >= this->record_window_end)
+  {
+    if (this->is_on)
+      this->record_on_time += this->record_window_end - this->record_timestamp;
+
+    this->record_flush();
+
+    this->record_timestamp = this->record_window_end;
+    this->record_window++;
+    this->record_window_end += window_length;
+
+    // Windows where the source is idle are not recorded, directly go to the
+    // current one
+    if (!this->is_on && time >= this->record_window_end)
+    {
+      int64_t nb_windows = (time - this->record_window_end) / window_length + 1;
+      this->record_window += nb_windows;
+      this->record_window_end += nb_windows * window_length;
+      this->record_timestamp = this->record_window_end - window_length;
+    }
+  }
+
+  if (this->is_on)
+    this->record_on_time += time - this->record_timestamp;
+
+  this->record_timestamp = time;
+}
+
+
+void vp::power_source::record_flush()
+{
+  if (this->record_nb_events || this->record_on_time)
+  {
+    this->recorder->dump_window(this->record_id, this->record_window, this->record_nb_events, this->record_on_time);
+    this->record_nb_events = 0;
+    this->record_on_time = 0;
+  }
+}
+
+
 
 int vp::power_source::init(component *top, std::string name, js::config *config, vp::power_trace *trace, bool is_leakage)
 {
@@ -395,6 +334,7 @@ int vp::power_source::init(component *top, std::string name, js::config *config,
   this->top = top;
   this->trace = trace;
   this->is_leakage = is_leakage;
+  this->name = top->get_path() + "/" + name;
 
   try
   {
@@ -443,7 +383,8 @@ int vp::power_source::init(component *top, std::string name, js::config *config,
         return -1;
       }
 
-      this->table = new Linear_table(values);
+      this->table = new power_table();
+      parse_linear_table(values, this->table);
     }
     else
     {
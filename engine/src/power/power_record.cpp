@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "vp/vp.hpp"
+#include "vp/power/power_table.hpp"
+#include "vp/power/power_record.hpp"
+#include <string.h>
+#include <errno.h>
+#include <unordered_map>
+
+
+int vp::power_recorder::open(std::string path, int64_t window_length)
+{
+  this->window_length = window_length;
+
+  this->file = fopen(path.c_str(), "w");
+  if (this->file == NULL)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Failed to open power record (path: %s, error: %s)", path.c_str(), strerror(errno));
+    return -1;
+  }
+
+  fwrite(POWER_RECORD_MAGIC, 1, strlen(POWER_RECORD_MAGIC), this->file);
+  fwrite(&this->window_length, sizeof(this->window_length), 1, this->file);
+
+  return 0;
+}
+
+
+void vp::power_recorder::close()
+{
+  if (this->file)
+  {
+    fclose(this->file);
+    this->file = NULL;
+  }
+}
+
+
+void vp::power_recorder::start_capture(int64_t time, std::vector<power_trace *> &traces, std::vector<power_source *> &sources)
+{
+  uint8_t type = POWER_RECORD_CAPTURE_START;
+  fwrite(&type, 1, 1, this->file);
+  fwrite(&time, sizeof(time), 1, this->file);
+
+  for (auto trace: traces)
+  {
+    trace->recording = true;
+  }
+
+  int id = 0;
+  for (auto source: sources)
+  {
+    source->recorder = this;
+    source->record_id = id++;
+    source->record_window = 0;
+    source->record_window_end = this->window_length ? time + this->window_length : INT64_MAX;
+    source->record_timestamp = time;
+    source->record_nb_events = 0;
+    source->record_on_time = 0;
+  }
+}
+
+
+void vp::power_recorder::stop_capture(int64_t time, std::vector<power_trace *> &traces, std::vector<power_source *> &sources)
+{
+  for (auto source: sources)
+  {
+    if (source->recorder)
+    {
+      source->record_update();
+      source->record_flush();
+      source->recorder = NULL;
+    }
+  }
+
+  // Traces are recorded group by group, in the order in which they appear in
+  // the power report
+  std::unordered_map<power_trace *, int> trace_ids;
+  std::vector<power_trace *> ordered_traces;
+
+  for (auto trace: traces)
+  {
+    trace->recording = false;
+
+    power_trace *top = trace->get_top_trace();
+
+    if (trace_ids.find(top) == trace_ids.end())
+    {
+      trace_ids[top] = ordered_traces.size();
+      ordered_traces.push_back(top);
+    }
+
+    for (auto child: top->child_traces)
+    {
+      if (trace_ids.find(child) == trace_ids.end())
+      {
+        trace_ids[child] = ordered_traces.size();
+        ordered_traces.push_back(child);
+      }
+    }
+  }
+
+  for (unsigned int i=0; i<ordered_traces.size(); i++)
+  {
+    power_trace *trace = ordered_traces[i];
+    uint8_t type = POWER_RECORD_TRACE;
+    int32_t id = i;
+    int32_t top_id = trace->top_trace ? trace_ids[trace->top_trace] : -1;
+
+    fwrite(&type, 1, 1, this->file);
+    fwrite(&id, sizeof(id), 1, this->file);
+    fwrite(&top_id, sizeof(top_id), 1, this->file);
+    this->dump_string(trace->trace.get_name());
+  }
+
+  int32_t id = 0;
+  for (auto source: sources)
+  {
+    uint8_t type = POWER_RECORD_SOURCE;
+    auto it = trace_ids.find(source->trace);
+    int32_t trace_id = it == trace_ids.end() ? -1 : it->second;
+    uint8_t is_leakage = source->is_leakage;
+
+    fwrite(&type, 1, 1, this->file);
+    fwrite(&id, sizeof(id), 1, this->file);
+    fwrite(&trace_id, sizeof(trace_id), 1, this->file);
+    fwrite(&is_leakage, 1, 1, this->file);
+    this->dump_string(source->name);
+    source->table->dump(this->file);
+
+    id++;
+  }
+
+  uint8_t type = POWER_RECORD_CAPTURE_STOP;
+  fwrite(&type, 1, 1, this->file);
+  fwrite(&time, sizeof(time), 1, this->file);
+
+  fflush(this->file);
+}
+
+
+void vp::power_recorder::dump_window(int source, int64_t window, int64_t nb_events, int64_t on_time)
+{
+  uint8_t type = POWER_RECORD_WINDOW;
+  int32_t record[2] = { source, (int32_t)window };
+  int64_t activity[2] = { nb_events, on_time };
+
+  fwrite(&type, 1, 1, this->file);
+  fwrite(record, sizeof(record), 1, this->file);
+  fwrite(activity, sizeof(activity), 1, this->file);
+}
+
+
+void vp::power_recorder::dump_string(std::string str)
+{
+  uint32_t size = str.size();
+  fwrite(&size, sizeof(size), 1, this->file);
+  fwrite(str.c_str(), 1, size, this->file);
+}
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Computes the power report of a capture from a power record, for one or
+// several operating points, without simulating again.
+// The energy of each source is its number of events and its on-time
+// multiplied by its power model at the operating point. The time of the
+// capture is the simulated one, so the frequency only changes the power
+// models which depend on it.
+
+#include "vp/power/power_table.hpp"
+#include "vp/power/power_record.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <map>
+#include <string>
+#include <vector>
+
+
+struct operating_point
+{
+    double temp;
+    double volt;
+    double freq;
+};
+
+struct trace_desc
+{
+    std::string name;
+    int top;
+};
+
+struct source_desc
+{
+    int trace;
+    bool is_leakage;
+    std::string name;
+    vp::power_table table;
+};
+
+struct window_desc
+{
+    int32_t source;
+    int32_t window;
+    int64_t nb_events;
+    int64_t on_time;
+};
+
+struct capture
+{
+    int64_t start;
+    int64_t stop;
+    std::vector<window_desc> windows;
+    std::vector<trace_desc> traces;
+    std::vector<source_desc> sources;
+};
+
+
+static int read_string(FILE *file, std::string *str)
+{
+    uint32_t size;
+    if (fread(&size, sizeof(size), 1, file) != 1)
+        return -1;
+
+    str->resize(size);
+    if (size && fread(&(*str)[0], 1, size, file) != size)
+        return -1;
+
+    return 0;
+}
+
+// Read all the complete captures of the record
+static int read_record(FILE *file, int64_t *window_length, std::vector<capture *> &captures)
+{
+    char magic[sizeof(POWER_RECORD_MAGIC) - 1];
+
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, POWER_RECORD_MAGIC, sizeof(magic)) != 0 ||
+        fread(window_length, sizeof(*window_length), 1, file) != 1)
+    {
+        fprintf(stderr, "Not a power record\n");
+        return -1;
+    }
+
+    capture *current = NULL;
+    uint8_t type;
+
+    while (fread(&type, 1, 1, file) == 1)
+    {
+        int error = 0;
+
+        if (type == POWER_RECORD_CAPTURE_START)
+        {
+            delete current;
+            current = new capture();
+            error = fread(&current->start, sizeof(current->start), 1, file) != 1;
+        }
+        else if (current == NULL)
+        {
+            error = 1;
+        }
+        else if (type == POWER_RECORD_WINDOW)
+        {
+            int32_t record[2];
+            int64_t activity[2];
+            error = fread(record, sizeof(record), 1, file) != 1 || fread(activity, sizeof(activity), 1, file) != 1;
+            current->windows.push_back({ record[0], record[1], activity[0], activity[1] });
+        }
+        else if (type == POWER_RECORD_TRACE)
+        {
+            int32_t ids[2];
+            trace_desc trace;
+            error = fread(ids, sizeof(ids), 1, file) != 1 || read_string(file, &trace.name) ||
+                ids[0] != (int)current->traces.size() || ids[1] >= ids[0];
+            trace.top = ids[1];
+            current->traces.push_back(trace);
+        }
+        else if (type == POWER_RECORD_SOURCE)
+        {
+            int32_t ids[2];
+            uint8_t is_leakage;
+            current->sources.resize(current->sources.size() + 1);
+            source_desc &source = current->sources.back();
+            error = fread(ids, sizeof(ids), 1, file) != 1 || fread(&is_leakage, 1, 1, file) != 1 ||
+                read_string(file, &source.name) || source.table.load(file) ||
+                ids[0] != (int)current->sources.size() - 1 || ids[1] >= (int)current->traces.size();
+            source.trace = ids[1];
+            source.is_leakage = is_leakage;
+        }
+        else if (type == POWER_RECORD_CAPTURE_STOP)
+        {
+            error = fread(&current->stop, sizeof(current->stop), 1, file) != 1;
+            if (!error)
+            {
+                captures.push_back(current);
+                current = NULL;
+            }
+        }
+        else
+        {
+            error = 1;
+        }
+
+        if (error)
+        {
+            fprintf(stderr, "Power record is corrupted or truncated (record type: %d)\n", type);
+            break;
+        }
+    }
+
+    delete current;
+
+    return 0;
+}
+
+
+// Energy of each trace, accounted the same way as during the simulation: the
+// events of all sources and the on-time of dynamic sources give the dynamic
+// energy, and the on-time of leakage sources the leakage energy. Each trace
+// also includes the energy of the traces below it.
+static void compute_energy(capture *capture, std::vector<double> &quanta, std::vector<window_desc *> &windows,
+    std::vector<double> &dynamic, std::vector<double> &leakage)
+{
+    dynamic.assign(capture->traces.size(), 0);
+    leakage.assign(capture->traces.size(), 0);
+
+    for (auto window: windows)
+    {
+        if (window->source < 0 || window->source >= (int)capture->sources.size())
+            continue;
+
+        source_desc &source = capture->sources[window->source];
+        double quantum = quanta[window->source];
+
+        if (source.trace < 0)
+            continue;
+
+        dynamic[source.trace] += window->nb_events * quantum;
+
+        if (source.is_leakage)
+            leakage[source.trace] += window->on_time * quantum;
+        else
+            dynamic[source.trace] += window->on_time * quantum;
+    }
+
+    // Top traces are always recorded before the traces below them
+    for (int i=capture->traces.size()-1; i>=0; i--)
+    {
+        int top = capture->traces[i].top;
+        if (top >= 0)
+        {
+            dynamic[top] += dynamic[i];
+            leakage[top] += leakage[i];
+        }
+    }
+}
+
+// Same format as the report produced by the power engine
+static void write_report(FILE *file, capture *capture, std::vector<double> &dynamic, std::vector<double> &leakage)
+{
+    double duration = capture->stop - capture->start;
+    std::vector<bool> dumped(capture->traces.size(), false);
+
+    fprintf(file, "Trace path; Dynamic power (W); Leakage power (W); Total (W);");
+
+    for (unsigned int i=0; i<capture->traces.size(); i++)
+    {
+        if (dumped[i])
+            continue;
+
+        int top = capture->traces[i].top >= 0 ? capture->traces[i].top : i;
+
+        fprintf(file, "Trace path; Dynamic power (W); Leakage power (W); Total (W); Percentage\n");
+
+        double top_dynamic = dynamic[top] / duration;
+        double top_leakage = leakage[top] / duration;
+        double total = top_dynamic + top_leakage;
+
+        fprintf(file, "%s; %.12f; %.12f; %.12f; 1.0\n", capture->traces[top].name.c_str(), top_dynamic, top_leakage, total);
+        dumped[top] = true;
+
+        for (unsigned int j=top+1; j<capture->traces.size(); j++)
+        {
+            if (capture->traces[j].top != top)
+                continue;
+
+            double child_dynamic = dynamic[j] / duration;
+            double child_leakage = leakage[j] / duration;
+
+            fprintf(file, "%s; %.12f; %.12f; %.12f; %.6f\n", capture->traces[j].name.c_str(), child_dynamic, child_leakage,
+                child_dynamic + child_leakage, (child_dynamic + child_leakage) / total);
+            dumped[j] = true;
+        }
+
+        fprintf(file, "\n");
+    }
+}
+
+// Power of the traces which are not below another one, for each window
+static void write_windows(FILE *file, capture *capture, int64_t window_length, std::vector<double> &quanta)
+{
+    std::map<int32_t, std::vector<window_desc *>> windows;
+    for (auto &window: capture->windows)
+    {
+        windows[window.window].push_back(&window);
+    }
+
+    fprintf(file, "Window start (ps); Trace path; Dynamic power (W); Leakage power (W); Total (W)\n");
+
+    for (auto &x: windows)
+    {
+        std::vector<double> dynamic, leakage;
+        compute_energy(capture, quanta, x.second, dynamic, leakage);
+
+        int64_t start = capture->start + x.first * window_length;
+        int64_t end = start + window_length > capture->stop ? capture->stop : start + window_length;
+        double duration = end - start;
+
+        for (unsigned int i=0; i<capture->traces.size(); i++)
+        {
+            if (capture->traces[i].top < 0)
+            {
+                fprintf(file, "%ld; %s; %.12f; %.12f; %.12f\n", start, capture->traces[i].name.c_str(),
+                    dynamic[i] / duration, leakage[i] / duration, (dynamic[i] + leakage[i]) / duration);
+            }
+        }
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--op=<temp>,<volt>,<freq>]... [--capture=<index>] [--output=<prefix>] [--windows] <power record>\n", name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Writes <prefix>.csv, or <prefix>_<temp>_<volt>_<freq>.csv for each operating point if there are several.\n");
+    fprintf(stderr, "The default operating point is the one used during simulation, the default capture the last one, and the\n");
+    fprintf(stderr, "default prefix power_report. With --windows, the power of each window is also written to <file>_windows.csv.\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<operating_point> ops;
+    std::string prefix = "power_report";
+    int capture_index = -1;
+    bool dump_windows = false;
+    std::vector<std::string> args;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (strncmp(argv[i], "--op=", 5) == 0)
+        {
+            operating_point op;
+            if (sscanf(argv[i] + 5, "%lf,%lf,%lf", &op.temp, &op.volt, &op.freq) != 3)
+            {
+                usage(argv[0]);
+                return -1;
+            }
+            ops.push_back(op);
+        }
+        else if (strncmp(argv[i], "--capture=", 10) == 0)
+            capture_index = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--output=", 9) == 0)
+            prefix = argv[i] + 9;
+        else if (strcmp(argv[i], "--windows") == 0)
+            dump_windows = true;
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() != 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (ops.size() == 0)
+        ops.push_back({ VP_POWER_DEFAULT_TEMP, VP_POWER_DEFAULT_VOLT, VP_POWER_DEFAULT_FREQ });
+
+    FILE *file = fopen(args[0].c_str(), "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open power record %s (error: %s)\n", args[0].c_str(), strerror(errno));
+        return -1;
+    }
+
+    int64_t window_length;
+    std::vector<capture *> captures;
+    if (read_record(file, &window_length, captures))
+        return -1;
+
+    fclose(file);
+
+    if (capture_index < 0)
+        capture_index = captures.size() - 1;
+
+    if (capture_index < 0 || capture_index >= (int)captures.size())
+    {
+        fprintf(stderr, "Capture %d not found, the record contains %ld complete captures\n", capture_index, captures.size());
+        return -1;
+    }
+
+    capture *capture = captures[capture_index];
+
+    std::vector<window_desc *> windows;
+    for (auto &window: capture->windows)
+    {
+        windows.push_back(&window);
+    }
+
+    for (auto &op: ops)
+    {
+        std::string path = prefix;
+        if (ops.size() > 1)
+        {
+            char suffix[128];
+            snprintf(suffix, sizeof(suffix), "_%g_%g_%g", op.temp, op.volt, op.freq);
+            path += suffix;
+        }
+
+        std::vector<double> quanta;
+        for (auto &source: capture->sources)
+        {
+            quanta.push_back(source.table.get(op.temp, op.volt, op.freq));
+        }
+
+        std::vector<double> dynamic, leakage;
+        compute_energy(capture, quanta, windows, dynamic, leakage);
+
+        FILE *report = fopen((path + ".csv").c_str(), "w");
+        if (report == NULL)
+        {
+            fprintf(stderr, "Failed to open %s.csv (error: %s)\n", path.c_str(), strerror(errno));
+            return -1;
+        }
+        write_report(report, capture, dynamic, leakage);
+        fclose(report);
+
+        if (dump_windows && window_length)
+        {
+            report = fopen((path + "_windows.csv").c_str(), "w");
+            if (report == NULL)
+            {
+                fprintf(stderr, "Failed to open %s_windows.csv (error: %s)\n", path.c_str(), strerror(errno));
+                return -1;
+            }
+            write_windows(report, capture, window_length, quanta);
+            fclose(report);
+        }
+    }
+
+    return 0;
+}
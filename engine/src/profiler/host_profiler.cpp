@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "vp/vp.hpp"
+#include "vp/profiler/host_profiler.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <algorithm>
+
+
+vp::host_profiler *vp_host_profiler = NULL;
+
+// Current node of the calling thread, NULL until it calls a site
+static thread_local vp::host_profile_node *current_node = NULL;
+
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t self;
+  uint64_t total;
+  // Number of nodes of this site in the stack being walked, the total time
+  // of recursive calls is only accounted once
+  int depth;
+} site_stats_t;
+
+
+vp::host_profiler::host_profiler(std::string prefix)
+: prefix(prefix)
+{
+  pthread_mutex_init(&this->mutex, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &this->start_time);
+  this->start_ticks = get_ticks();
+}
+
+vp::host_profile_site *vp::host_profiler::get_site(vp::component *comp, const char *kind, void *meth)
+{
+  pthread_mutex_lock(&this->mutex);
+
+  host_profile_site *&site = this->sites[std::make_pair(comp, meth)];
+  if (site == NULL)
+  {
+    site = new host_profile_site();
+    site->comp = comp;
+    site->kind = kind;
+    site->meth = meth;
+  }
+
+  pthread_mutex_unlock(&this->mutex);
+
+  return site;
+}
+
+vp::host_profile_node *vp::host_profiler::enter(host_profile_site *site)
+{
+  host_profile_node *parent = current_node;
+  if (parent == NULL)
+  {
+    parent = new host_profile_node();
+    parent->site = NULL;
+    parent->parent = NULL;
+
+    pthread_mutex_lock(&this->mutex);
+    this->roots.push_back(parent);
+    pthread_mutex_unlock(&this->mutex);
+  }
+
+  host_profile_node *&node = parent->childs[site];
+  if (node == NULL)
+  {
+    node = new host_profile_node();
+    node->site = site;
+    node->parent = parent;
+  }
+
+  current_node = node;
+  node->start = get_ticks();
+
+  return node;
+}
+
+void vp::host_profiler::leave(host_profile_node *node)
+{
+  node->ticks += get_ticks() - node->start;
+  node->count++;
+  current_node = node->parent;
+}
+
+std::string vp::host_profiler::get_site_name(host_profile_site *site)
+{
+  std::string name;
+  Dl_info info;
+
+  if (dladdr(site->meth, &info) != 0 && info.dli_sname != NULL)
+  {
+    int status;
+    char *demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+    name = demangled ? demangled : info.dli_sname;
+    free(demangled);
+
+    // Remove the arguments, they are the same for all sites of a kind
+    if (name.size() && name.back() == ')')
+    {
+      int depth = 0;
+      for (int i=name.size()-1; i>=0; i--)
+      {
+        if (name[i] == ')')
+          depth++;
+        else if (name[i] == '(' && --depth == 0)
+        {
+          name = name.substr(0, i);
+          break;
+        }
+      }
+    }
+  }
+  else
+  {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%p", site->meth);
+    name = buffer;
+  }
+
+  return std::string(site->kind) + " " + name;
+}
+
+static void walk(vp::host_profile_node *node, std::string stack, std::map<vp::host_profile_site *, site_stats_t> &stats,
+  std::map<std::string, uint64_t> &folded, std::map<vp::host_profile_site *, std::string> &frames)
+{
+  uint64_t self = node->ticks;
+  for (auto &x: node->childs)
+  {
+    self -= std::min(self, x.second->ticks);
+  }
+
+  site_stats_t *site_stats = &stats[node->site];
+  site_stats->count += node->count;
+  site_stats->self += self;
+  if (site_stats->depth == 0)
+    site_stats->total += node->ticks;
+
+  stack = stack == "" ? frames[node->site] : stack + ";" + frames[node->site];
+  folded[stack] += self;
+
+  site_stats->depth++;
+  for (auto &x: node->childs)
+  {
+    walk(x.second, stack, stats, folded, frames);
+  }
+  site_stats->depth--;
+}
+
+int vp::host_profiler::dump()
+{
+  struct timespec end_time;
+  clock_gettime(CLOCK_MONOTONIC, &end_time);
+  uint64_t end_ticks = get_ticks();
+
+  double duration = (end_time.tv_sec - this->start_time.tv_sec) + (end_time.tv_nsec - this->start_time.tv_nsec) / 1e9;
+  double ticks_per_sec = duration > 0 ? (end_ticks - this->start_ticks) / duration : 1e9;
+
+  pthread_mutex_lock(&this->mutex);
+
+  std::map<host_profile_site *, std::string> frames;
+  for (auto &x: this->sites)
+  {
+    host_profile_site *site = x.second;
+    std::string path = site->comp->get_path();
+    frames[site] = (path == "" ? "/" : path) + ":" + this->get_site_name(site);
+  }
+
+  std::map<host_profile_site *, site_stats_t> stats;
+  std::map<std::string, uint64_t> folded;
+  for (auto root: this->roots)
+  {
+    for (auto &x: root->childs)
+    {
+      walk(x.second, "", stats, folded, frames);
+    }
+  }
+
+  pthread_mutex_unlock(&this->mutex);
+
+  std::string folded_path = this->prefix + ".folded";
+  FILE *file = fopen(folded_path.c_str(), "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open host profile (path: %s)\n", folded_path.c_str());
+    return -1;
+  }
+
+  // Counts are in ns
+  for (auto &x: folded)
+  {
+    uint64_t ns = x.second * 1e9 / ticks_per_sec;
+    if (ns)
+      fprintf(file, "%s %lu\n", x.first.c_str(), ns);
+  }
+  fclose(file);
+
+  std::string report_path = this->prefix + ".txt";
+  file = fopen(report_path.c_str(), "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open host profile (path: %s)\n", report_path.c_str());
+    return -1;
+  }
+
+  uint64_t total_self = 0;
+  std::map<std::string, std::pair<uint64_t, uint64_t>> comps;
+  std::vector<std::pair<uint64_t, host_profile_site *>> sites;
+  for (auto &x: stats)
+  {
+    std::string path = x.first->comp->get_path();
+    comps[path == "" ? "/" : path].first += x.second.self;
+    comps[path == "" ? "/" : path].second += x.second.count;
+    sites.push_back(std::make_pair(x.second.self, x.first));
+    total_self += x.second.self;
+  }
+
+  std::vector<std::pair<uint64_t, std::string>> comps_sorted;
+  for (auto &x: comps)
+  {
+    comps_sorted.push_back(std::make_pair(x.second.first, x.first));
+  }
+
+  std::sort(comps_sorted.rbegin(), comps_sorted.rend());
+  std::sort(sites.rbegin(), sites.rend());
+
+  double total = total_self / ticks_per_sec;
+
+  fprintf(file, "Host time: %.3f s, in models: %.3f s\n\n", duration, total);
+
+  fprintf(file, "%10s %7s %14s  %s\n", "Self (s)", "%", "Calls", "Component");
+  for (auto &x: comps_sorted)
+  {
+    double self = x.first / ticks_per_sec;
+    fprintf(file, "%10.3f %6.2f%% %14lu  %s\n", self, total > 0 ? 100.0 * self / total : 0.0,
+      comps[x.second].second, x.second.c_str());
+  }
+
+  fprintf(file, "\n%10s %7s %10s %14s %10s  %s\n", "Self (s)", "%", "Total (s)", "Calls", "Self (ns)", "Handler");
+  for (auto &x: sites)
+  {
+    site_stats_t *site_stats = &stats[x.second];
+    double self = site_stats->self / ticks_per_sec;
+    fprintf(file, "%10.3f %6.2f%% %10.3f %14lu %10.1f  %s\n", self, total > 0 ? 100.0 * self / total : 0.0,
+      site_stats->total / ticks_per_sec, site_stats->count,
+      site_stats->count ? self * 1e9 / site_stats->count : 0.0, frames[x.second].c_str());
+  }
+
+  fclose(file);
+
+  return 0;
+}
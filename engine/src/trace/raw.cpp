@@ -25,7 +25,12 @@
 
 vp::Raw_file::Raw_file(vp::Event_dumper *dumper, string path)
 {
-    trace_dumper_client *td = new trace_dumper_client(path);
+    // Traces are written in chunked format if a chunk size is given, so that
+    // they can be read from any timestamp
+    js::config *config = dumper->comp->get_js_config("**/vcd/chunk_size");
+    int chunk_size = config != NULL ? config->get_int() : 0;
+
+    trace_dumper_client *td = new trace_dumper_client(path, chunk_size);
     this->dumper = td;
 
     if (td->open(ED_CONF_TIMESCALE_PS))
@@ -15,11 +15,17 @@
  */
 
 #include "trace_dumper.hpp"
+#include "../fst/lz4.h"
 #include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
-trace_dumper_trace::trace_dumper_trace(trace_dumper_client *client, int id, ed_trace_type_e type, int width)
-: type(type), width(width), client(client)
+trace_dumper_trace::trace_dumper_trace(trace_dumper_client *client, std::string path, int id, ed_trace_type_e type, int width)
+: type(type), width(width), client(client), path(path), raw_id(id), last_chunk(-1)
 {
     this->id = encode_id(id, &this->id_size);
 }
@@ -28,24 +34,50 @@ trace_dumper_trace::trace_dumper_trace(trace_dumper_client *client, int id, ed_t
 void trace_dumper_trace::dump(int64_t timestamp, uint8_t *value, int width)
 {
     this->client->dump_trace(timestamp, this->id, this->id_size, this->type, value, width);
+
+    // Remember in which chunks the trace appears, to quickly find it when
+    // reading it
+    int chunk = this->client->get_current_chunk();
+    if (chunk != this->last_chunk)
+    {
+        this->last_chunk = chunk;
+        this->chunks.push_back(chunk);
+    }
 }
 
 
-trace_dumper_client::trace_dumper_client(std::string file)
-: filepath(file), current_timestamp(-1)
+trace_dumper_client::trace_dumper_client(std::string file, int chunk_size)
+: filepath(file), current_timestamp(-1), chunk_size(chunk_size), chunk_first_timestamp(-1), offset(0)
 {
 }    
 
 
+int trace_dumper_client::write(const void *data, int size)
+{
+    if (this->chunk_size)
+    {
+        this->chunk.insert(this->chunk.end(), (uint8_t *)data, (uint8_t *)data + size);
+        return 0;
+    }
+
+    this->file.write((char *)data, size);
+    if (this->file.fail())
+        return -1;
+
+    return 0;
+}
+
+
 int trace_dumper_client::open(ed_conf_timescale_e timescale)
 {
     this->file.open(this->filepath);
     if (this->file.fail())
         return -1;
 
-    ed_header_t header = {.type=ED_TYPE_CONF};
+    ed_header_t header = {.type=this->chunk_size ? (uint8_t)ED_TYPE_CHUNKED_CONF : (uint8_t)ED_TYPE_CONF};
     ed_conf_t conf = { .version=ED_CONF_LAST_VERSION, .timescale=timescale };
 
+    // The configuration is never part of a chunk
     this->file.write((char *)&header, sizeof(header));
     if (this->file.fail())
         return -1;
@@ -54,33 +86,123 @@ int trace_dumper_client::open(ed_conf_timescale_e timescale)
     if (this->file.fail())
         return -1;
 
+    this->offset = sizeof(header) + sizeof(conf);
+
+    if (this->chunk_size)
+        this->chunk.reserve(this->chunk_size + 4096);
+
+    return 0;
+}
+
+
+int trace_dumper_client::flush_chunk()
+{
+    if (this->chunk.size() == 0)
+        return 0;
+
+    int bound = LZ4_compressBound(this->chunk.size());
+    if ((int)this->compressed.size() < bound)
+        this->compressed.resize(bound);
+
+    int size = LZ4_compress_default((char *)this->chunk.data(), this->compressed.data(), this->chunk.size(), bound);
+    if (size <= 0)
+        return -1;
+
+    this->file.write(this->compressed.data(), size);
+    if (this->file.fail())
+        return -1;
+
+    ed_chunk_t chunk = {
+        .offset=this->offset, .size=(uint32_t)size, .raw_size=(uint32_t)this->chunk.size(),
+        .first_timestamp=this->chunk_first_timestamp, .last_timestamp=this->current_timestamp
+    };
+    this->chunks.push_back(chunk);
+
+    this->offset += size;
+    this->chunk.clear();
+
+    // Next chunk starts with an absolute timestamp
+    this->current_timestamp = -1;
+    this->chunk_first_timestamp = -1;
+
+    return 0;
+}
+
+
+int trace_dumper_client::write_index()
+{
+    ed_chunked_trailer_t trailer;
+
+    trailer.chunks_offset = this->offset;
+    trailer.nb_chunks = this->chunks.size();
+
+    if (this->chunks.size())
+    {
+        this->file.write((char *)this->chunks.data(), this->chunks.size() * sizeof(ed_chunk_t));
+        if (this->file.fail())
+            return -1;
+    }
+
+    trailer.traces_offset = this->offset + this->chunks.size() * sizeof(ed_chunk_t);
+    trailer.nb_traces = this->traces.size();
+
+    for (auto trace: this->traces)
+    {
+        ed_reg_trace_t reg_trace = { .type=trace->type, .width=(uint32_t)trace->width, .path_len=(uint32_t)trace->path.size(), .id=(uint32_t)trace->raw_id };
+        uint32_t nb_chunks = trace->chunks.size();
+
+        this->file.write((char *)&reg_trace, sizeof(reg_trace));
+        this->file.write(trace->path.c_str(), trace->path.size());
+        this->file.write((char *)&nb_chunks, sizeof(nb_chunks));
+        if (nb_chunks)
+            this->file.write((char *)trace->chunks.data(), nb_chunks * sizeof(uint32_t));
+        if (this->file.fail())
+            return -1;
+    }
+
+    memcpy(trailer.magic, ED_CHUNKED_MAGIC, sizeof(trailer.magic));
+
+    this->file.write((char *)&trailer, sizeof(trailer));
+    if (this->file.fail())
+        return -1;
+
     return 0;
 }
 
 
 void trace_dumper_client::close()
 {
+    if (this->chunk_size)
+    {
+        this->flush_chunk();
+        this->write_index();
+    }
+
     this->file.close();
 }
 
 
 trace_dumper_trace *trace_dumper_client::reg_trace(std::string path, uint32_t id, ed_trace_type_e type, uint32_t width)
 {
-    trace_dumper_trace *trace = new trace_dumper_trace(this, id, type, width);
+    trace_dumper_trace *trace = new trace_dumper_trace(this, path, id, type, width);
+
+    // In chunked format, traces are only described in the index
+    if (this->chunk_size)
+    {
+        this->traces.push_back(trace);
+        return trace;
+    }
 
     ed_header_t header = {.type=ED_TYPE_REG_TRACE};
     ed_reg_trace_t reg_trace = { .type=type, .width=width, .path_len=(uint32_t)path.size(), .id=id };
 
-    this->file.write((char *)&header, sizeof(header));
-    if (this->file.fail())
+    if (this->write(&header, sizeof(header)))
         return NULL;
 
-    this->file.write((char *)&reg_trace, sizeof(reg_trace));
-    if (this->file.fail())
+    if (this->write(&reg_trace, sizeof(reg_trace)))
         return NULL;
 
-    this->file.write((char *)path.c_str(), path.size());
-    if (this->file.fail())
+    if (this->write(path.c_str(), path.size()))
         return NULL;
 
     return trace;
@@ -92,18 +214,27 @@ int trace_dumper_client::dump_trace(int64_t timestamp, int id, int id_size, ed_t
     // First dump the timestamp if it is different from previous one
     if (timestamp > this->current_timestamp)
     {
+        // Chunks are only cut between timestamps so that all the events of a
+        // timestamp are in the same chunk
+        if (this->chunk_size && (int)this->chunk.size() >= this->chunk_size)
+        {
+            if (this->flush_chunk())
+                return -1;
+        }
+
+        if (this->chunk_first_timestamp == -1)
+            this->chunk_first_timestamp = timestamp;
+
         uint64_t diff = this->current_timestamp >= 0 ? timestamp - this->current_timestamp : timestamp;
         ed_header_t header;
         int ts_size;
 
         header.type = td_get_timestamp(diff, &ts_size);
 
-        this->file.write((char *)&header, sizeof(header));
-        if (this->file.fail())
+        if (this->write(&header, sizeof(header)))
             return -1;
 
-        this->file.write((char *)&diff, ts_size);
-        if (this->file.fail())
+        if (this->write(&diff, ts_size))
             return -1;
 
         this->current_timestamp = timestamp;
@@ -117,30 +248,25 @@ int trace_dumper_client::dump_trace(int64_t timestamp, int id, int id_size, ed_t
         {
             ed_header_t header = { .type = *value == 0 ? ED_TYPE_TRACE_SET_0 : ED_TYPE_TRACE_SET_1 };
 
-            this->file.write((char *)&header, sizeof(header));
-            if (this->file.fail())
+            if (this->write(&header, sizeof(header)))
                 return -1;
 
-            this->file.write((char *)&id, id_size);
-            if (this->file.fail())
+            if (this->write(&id, id_size))
                 return -1;
         }
         else
         {
             ed_header_t header = { .type = ED_TYPE_TRACE };
 
-            this->file.write((char *)&header, sizeof(header));
-            if (this->file.fail())
+            if (this->write(&header, sizeof(header)))
                 return -1;
 
-            this->file.write((char *)&id, id_size);
-            if (this->file.fail())
+            if (this->write(&id, id_size))
                 return -1;
 
             int size = (width + 7) / 8;
 
-            this->file.write((char *)value, size);
-            if (this->file.fail())
+            if (this->write(value, size))
                 return -1;
         }
     }
@@ -148,38 +274,31 @@ int trace_dumper_client::dump_trace(int64_t timestamp, int id, int id_size, ed_t
     {
         ed_header_t header = { .type = ED_TYPE_TRACE };
 
-        this->file.write((char *)&header, sizeof(header));
-        if (this->file.fail())
+        if (this->write(&header, sizeof(header)))
             return -1;
 
-        this->file.write((char *)&id, id_size);
-        if (this->file.fail())
+        if (this->write(&id, id_size))
             return -1;
 
-        this->file.write((char *)value, width);
-        if (this->file.fail())
+        if (this->write(value, width))
             return -1;
     }
     else if (type == ED_TRACE_VARLEN)
     {
         ed_header_t header = { .type = ED_TYPE_TRACE };
 
-        this->file.write((char *)&header, sizeof(header));
-        if (this->file.fail())
+        if (this->write(&header, sizeof(header)))
             return -1;
 
-        this->file.write((char *)&id, id_size);
-        if (this->file.fail())
+        if (this->write(&id, id_size))
             return -1;
 
         int size = (width + 7) / 8;
 
-        this->file.write((char *)&size, 4);
-        if (this->file.fail())
+        if (this->write(&size, 4))
             return -1;
 
-        this->file.write((char *)value, size);
-        if (this->file.fail())
+        if (this->write(value, size))
             return -1;
     }
 
@@ -261,15 +380,12 @@ int trace_dumper_server::get_packet(trace_packet *packet)
             return -1;
         }
 
-        if (packet->data)
-            delete packet->data;
-
         if (packet->header.type == ED_TYPE_TRACE)
         {
             if (packet->trace->type == ED_TRACE_BITFIELD || packet->trace->type == ED_TRACE_REAL)
             {
                 size = (packet->trace->width + 7) / 8;
-                packet->data = new uint8_t[size];
+                packet->alloc_data(size);
                 this->file.read((char *)packet->data, size);
                 if (this->file.fail())
                     return -1;
@@ -280,7 +396,7 @@ int trace_dumper_server::get_packet(trace_packet *packet)
                 if (this->file.fail())
                     return -1;
 
-                packet->data = new uint8_t[size];
+                packet->alloc_data(size);
 
                 this->file.read((char *)packet->data, size);
                 if (this->file.fail())
@@ -289,7 +405,8 @@ int trace_dumper_server::get_packet(trace_packet *packet)
         }
         else
         {
-            packet->data = new uint8_t[1];
+            size = 1;
+            packet->alloc_data(1);
             *(packet->data) = packet->header.type == ED_TYPE_TRACE_SET_1;
         }
 
@@ -300,17 +417,324 @@ int trace_dumper_server::get_packet(trace_packet *packet)
 }
 
 
+trace_dumper_reader::trace_dumper_reader(std::string file)
+: filepath(file), fd(-1), data(NULL), size(0), chunks(NULL), nb_chunks(0), filter(NULL), current_chunk(-1),
+  current_chunk_pos(-1), current(NULL), current_end(NULL), timestamp(0), seek_timestamp(-1)
+{
+}
+
+
+trace_dumper_reader::~trace_dumper_reader()
+{
+    this->close();
+}
+
+
+int trace_dumper_reader::open()
+{
+    this->fd = ::open(this->filepath.c_str(), O_RDONLY);
+    if (this->fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(this->fd, &st))
+        return -1;
+
+    this->size = st.st_size;
+    if (this->size < sizeof(ed_header_t) + sizeof(ed_conf_t) + sizeof(ed_chunked_trailer_t))
+        return -1;
+
+    this->data = (uint8_t *)mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+    if (this->data == MAP_FAILED)
+    {
+        this->data = NULL;
+        return -1;
+    }
+
+    if (((ed_header_t *)this->data)->type != ED_TYPE_CHUNKED_CONF)
+        return -1;
+
+    memcpy(&this->conf, this->data + sizeof(ed_header_t), sizeof(this->conf));
+
+    ed_chunked_trailer_t trailer;
+    memcpy(&trailer, this->data + this->size - sizeof(trailer), sizeof(trailer));
+    if (memcmp(trailer.magic, ED_CHUNKED_MAGIC, sizeof(trailer.magic)) != 0)
+        return -1;
+
+    if (trailer.chunks_offset + trailer.nb_chunks * sizeof(ed_chunk_t) > this->size ||
+        trailer.traces_offset > this->size)
+        return -1;
+
+    // The index is not aligned in the file, copy it
+    this->nb_chunks = trailer.nb_chunks;
+    this->chunks = new ed_chunk_t[this->nb_chunks];
+    memcpy(this->chunks, this->data + trailer.chunks_offset, this->nb_chunks * sizeof(ed_chunk_t));
+
+    uint8_t *ptr = this->data + trailer.traces_offset;
+    uint8_t *end = this->data + this->size - sizeof(trailer);
+
+    for (unsigned int i=0; i<trailer.nb_traces; i++)
+    {
+        ed_reg_trace_t reg_trace;
+        uint32_t nb_chunks;
+
+        if (ptr + sizeof(reg_trace) > end)
+            return -1;
+        memcpy(&reg_trace, ptr, sizeof(reg_trace));
+        ptr += sizeof(reg_trace);
+
+        if (ptr + reg_trace.path_len + sizeof(nb_chunks) > end)
+            return -1;
+        std::string path((char *)ptr, reg_trace.path_len);
+        ptr += reg_trace.path_len;
+
+        memcpy(&nb_chunks, ptr, sizeof(nb_chunks));
+        ptr += sizeof(nb_chunks);
+
+        if (ptr + nb_chunks * sizeof(uint32_t) > end)
+            return -1;
+
+        Trace *trace = new Trace(path, reg_trace.id, reg_trace.type, reg_trace.width);
+        trace->chunks.resize(nb_chunks);
+        memcpy(trace->chunks.data(), ptr, nb_chunks * sizeof(uint32_t));
+        ptr += nb_chunks * sizeof(uint32_t);
+
+        this->traces[trace->id] = trace;
+        this->traces_by_path[trace->path] = trace;
+        this->traces_list.push_back(trace);
+    }
+
+    return 0;
+}
+
+
+void trace_dumper_reader::close()
+{
+    if (this->data)
+    {
+        munmap(this->data, this->size);
+        this->data = NULL;
+    }
+
+    if (this->fd != -1)
+    {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+
+    delete[] this->chunks;
+    this->chunks = NULL;
+    this->nb_chunks = 0;
+}
+
+
+Trace *trace_dumper_reader::get_trace(std::string path)
+{
+    auto it = this->traces_by_path.find(path);
+    return it == this->traces_by_path.end() ? NULL : it->second;
+}
+
+
+Trace *trace_dumper_reader::get_trace(int id)
+{
+    auto it = this->traces.find(id);
+    return it == this->traces.end() ? NULL : it->second;
+}
+
+
+int trace_dumper_reader::load_chunk(int index, uint8_t *buffer)
+{
+    ed_chunk_t *chunk = &this->chunks[index];
+
+    if (chunk->offset + chunk->size > this->size)
+        return -1;
+
+    int size = LZ4_decompress_safe((char *)this->data + chunk->offset, (char *)buffer, chunk->size, chunk->raw_size);
+    if (size != (int)chunk->raw_size)
+        return -1;
+
+    return 0;
+}
+
+
+int trace_dumper_reader::load_current_chunk(int pos)
+{
+    int nb_pos = this->filter ? this->filter->chunks.size() : this->nb_chunks;
+    if (pos >= nb_pos)
+        return -1;
+
+    int index = this->filter ? this->filter->chunks[pos] : pos;
+    ed_chunk_t *chunk = &this->chunks[index];
+
+    this->chunk_buffer.resize(chunk->raw_size);
+    if (this->load_chunk(index, this->chunk_buffer.data()))
+        return -1;
+
+    this->current_chunk = index;
+    this->current_chunk_pos = pos;
+    this->current = this->chunk_buffer.data();
+    this->current_end = this->current + chunk->raw_size;
+    // Each chunk starts with an absolute timestamp
+    this->timestamp = 0;
+
+    return 0;
+}
+
+
+int trace_dumper_reader::find_chunk(int64_t timestamp, std::vector<uint32_t> *chunks)
+{
+    // First chunk whose last timestamp is after the one we look for, chunks
+    // being sorted by time
+    int low = 0;
+    int high = chunks ? chunks->size() : this->nb_chunks;
+
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        int index = chunks ? (*chunks)[mid] : mid;
+        if (this->chunks[index].last_timestamp < timestamp)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+
+int trace_dumper_reader::seek(int64_t timestamp, Trace *trace)
+{
+    this->filter = trace;
+    this->seek_timestamp = timestamp;
+    this->current = NULL;
+
+    int pos = this->find_chunk(timestamp, trace ? &trace->chunks : NULL);
+
+    return this->load_current_chunk(pos);
+}
+
+
+int trace_dumper_reader::decode_packet(uint8_t **buffer, uint8_t *end, int64_t *timestamp, trace_packet *packet)
+{
+    uint8_t *ptr = *buffer;
+
+    while (ptr < end)
+    {
+        uint8_t type = *ptr++;
+
+        if (type == ED_TYPE_TIMESTAMP8 || type == ED_TYPE_TIMESTAMP16 ||
+            type == ED_TYPE_TIMESTAMP32 || type == ED_TYPE_TIMESTAMP64)
+        {
+            int width = type == ED_TYPE_TIMESTAMP8 ? 1 : type == ED_TYPE_TIMESTAMP16 ? 2 : type == ED_TYPE_TIMESTAMP32 ? 4 : 8;
+            uint64_t diff = 0;
+
+            if (ptr + width > end)
+                break;
+
+            memcpy(&diff, ptr, width);
+            ptr += width;
+            *timestamp += diff;
+        }
+        else if (type == ED_TYPE_TRACE || type == ED_TYPE_TRACE_SET_0 || type == ED_TYPE_TRACE_SET_1)
+        {
+            uint32_t id = decode_id_from_buffer(&ptr, end);
+            uint32_t size;
+
+            packet->header.type = type;
+            packet->timestamp = *timestamp;
+            packet->trace = this->get_trace(id);
+            if (packet->trace == NULL)
+                break;
+
+            if (type == ED_TYPE_TRACE)
+            {
+                if (packet->trace->type == ED_TRACE_BITFIELD || packet->trace->type == ED_TRACE_REAL)
+                {
+                    size = (packet->trace->width + 7) / 8;
+                }
+                else
+                {
+                    if (ptr + 4 > end)
+                        break;
+                    memcpy(&size, ptr, 4);
+                    ptr += 4;
+                }
+
+                if (ptr + size > end)
+                    break;
+
+                packet->alloc_data(size);
+                memcpy(packet->data, ptr, size);
+                ptr += size;
+            }
+            else
+            {
+                size = 1;
+                packet->alloc_data(1);
+                *(packet->data) = type == ED_TYPE_TRACE_SET_1;
+            }
+
+            packet->size = size;
+            *buffer = ptr;
+            return 0;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    *buffer = end;
+    return -1;
+}
+
+
+int trace_dumper_reader::get_packet(trace_packet *packet)
+{
+    while(1)
+    {
+        if (this->current == NULL || this->decode_packet(&this->current, this->current_end, &this->timestamp, packet))
+        {
+            if (this->load_current_chunk(this->current_chunk_pos + 1))
+                return -1;
+            continue;
+        }
+
+        if ((int64_t)packet->timestamp < this->seek_timestamp)
+            continue;
+
+        if (this->filter && packet->trace != this->filter)
+            continue;
+
+        return 0;
+    }
+}
+
+
 trace_packet::trace_packet()
-: data(NULL)
+: data(NULL), data_capacity(0)
 {
 
 }
 
 
+uint8_t *trace_packet::alloc_data(int size)
+{
+    if (size > this->data_capacity)
+    {
+        if (this->data)
+            delete[] this->data;
+        this->data = new uint8_t[size];
+        this->data_capacity = size;
+    }
+    return this->data;
+}
+
+
 trace_packet::~trace_packet()
 {
     if (this->data)
-        delete this->data;
+        delete[] this->data;
 }
 
 
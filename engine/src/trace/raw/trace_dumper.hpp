@@ -22,6 +22,7 @@
 #include <string>
 #include <fstream>
 #include <unordered_map>
+#include <vector>
 
 class Trace
 {
@@ -32,6 +33,9 @@ public:
 	int id;
 	uint32_t type;
 	int width;
+
+	// Chunks where the trace appears, for the chunked format
+	std::vector<uint32_t> chunks;
 };
 
 class trace_packet
@@ -40,6 +44,9 @@ public:
 	trace_packet();
 	~trace_packet();
 	void dump();
+	// Return the data buffer, only reallocated when it is too small, so that
+	// decoding many packets does not allocate for each of them
+	uint8_t *alloc_data(int size);
 
 	ed_header_t header;
 	ed_conf_t conf;
@@ -48,14 +55,17 @@ public:
     uint64_t timestamp;
 	uint8_t *data;
 	int size;
+	int data_capacity;
 };
 
 class trace_dumper_client;
 
 class trace_dumper_trace
 {
+    friend class trace_dumper_client;
+
 public:
-    trace_dumper_trace(trace_dumper_client *client, int id, ed_trace_type_e type, int width);
+    trace_dumper_trace(trace_dumper_client *client, std::string path, int id, ed_trace_type_e type, int width);
 
     void dump(int64_t timestamp, uint8_t *value, int width);
 
@@ -65,6 +75,12 @@ private:
     int width;
     trace_dumper_client *client;
     int id_size;
+
+    // For the index of the chunked format
+    std::string path;
+    int raw_id;
+    int last_chunk;
+    std::vector<uint32_t> chunks;
 };
 
 class trace_dumper_server
@@ -84,10 +100,74 @@ private:
 
 
 
+// Reader for the chunked format. The file is mapped and only the chunks
+// which are needed are decompressed, chunks being found through the index.
+class trace_dumper_reader
+{
+public:
+    trace_dumper_reader(std::string filepath);
+    ~trace_dumper_reader();
+
+    int open();
+    void close();
+
+    // Go to the first event at or after the timestamp, for all traces or only
+    // for the specified one. Following calls to get_packet start from there.
+    int seek(int64_t timestamp, Trace *trace=NULL);
+
+    // Get the next trace event. Returns -1 if there is no more event.
+    int get_packet(trace_packet *packet);
+
+    Trace *get_trace(std::string path);
+    Trace *get_trace(int id);
+    std::vector<Trace *> &get_traces() { return this->traces_list; }
+    ed_conf_timescale_e get_timescale() { return (ed_conf_timescale_e)this->conf.timescale; }
+
+    int get_nb_chunks() { return this->nb_chunks; }
+    ed_chunk_t *get_chunk(int index) { return &this->chunks[index]; }
+
+    // Decompress the chunk into the specified buffer, which must be at least
+    // raw_size bytes. Can be called from several threads.
+    int load_chunk(int index, uint8_t *buffer);
+
+    // Decode one packet from a decompressed chunk. Timestamp packets only
+    // update the timestamp and are not returned. Returns -1 at chunk end.
+    int decode_packet(uint8_t **buffer, uint8_t *end, int64_t *timestamp, trace_packet *packet);
+
+private:
+    int load_current_chunk(int index);
+    int find_chunk(int64_t timestamp, std::vector<uint32_t> *chunks);
+
+	std::string filepath;
+    int fd;
+    uint8_t *data;
+    size_t size;
+    ed_conf_t conf;
+    ed_chunk_t *chunks;
+    int nb_chunks;
+    std::unordered_map<int, Trace *> traces;
+    std::unordered_map<std::string, Trace *> traces_by_path;
+    std::vector<Trace *> traces_list;
+
+    // Current position
+    Trace *filter;
+    int current_chunk;
+    int current_chunk_pos;
+    std::vector<uint8_t> chunk_buffer;
+    uint8_t *current;
+    uint8_t *current_end;
+    int64_t timestamp;
+    int64_t seek_timestamp;
+};
+
+
+
 class trace_dumper_client
 {
 public:
-    trace_dumper_client(std::string filepath);
+    // If chunk_size is not 0, the file is written in chunked format, with
+    // chunks of about this size before compression
+    trace_dumper_client(std::string filepath, int chunk_size=0);
 
     int open(ed_conf_timescale_e timescale=ED_CONF_TIMESCALE_PS);
     void close();
@@ -96,10 +176,24 @@ public:
 
     int dump_trace(int64_t timestamp, int id, int id_size, ed_trace_type_e type, uint8_t *value, int width);
 
+    int get_current_chunk() { return this->chunks.size(); }
+
 private:
+    int write(const void *data, int size);
+    int flush_chunk();
+    int write_index();
+
 	std::string filepath;
 	std::ofstream file;
 	int64_t current_timestamp;
+
+    int chunk_size;
+    std::vector<uint8_t> chunk;
+    std::vector<ed_chunk_t> chunks;
+    std::vector<trace_dumper_trace *> traces;
+    std::vector<char> compressed;
+    int64_t chunk_first_timestamp;
+    uint64_t offset;
 };
 
 
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2019 GreenWaves Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a chunked raw trace to FST or VCD.
+// Chunks are decompressed and their values formatted by several threads,
+// while the main thread writes them in order to the output file.
+
+#include "trace_dumper.hpp"
+#include "../fst/fstapi.h"
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <thread>
+#include <unistd.h>
+
+
+class converter
+{
+public:
+    converter(trace_dumper_reader *reader, bool is_vcd, int first_chunk, int last_chunk, int64_t from, int64_t to);
+
+    int open(std::string path);
+    void convert(int nb_jobs);
+    void close();
+
+private:
+    void worker_routine();
+    void format_chunk(int index, std::vector<uint8_t> *output);
+    void add_scope(std::string path, bool begin);
+    void write_chunk(std::vector<uint8_t> *output);
+
+    trace_dumper_reader *reader;
+    bool is_vcd;
+    int first_chunk;
+    int last_chunk;
+    int64_t from;
+    int64_t to;
+
+    void *fst;
+    FILE *vcd;
+    std::vector<Trace *> traces;
+    std::unordered_map<Trace *, int> trace_index;
+    std::vector<fstHandle> fst_vars;
+    std::vector<std::string> vcd_codes;
+    int64_t last_timestamp;
+
+    // Chunks are processed in a window so that the formatted chunks waiting
+    // to be written do not take too much memory
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int next_chunk;
+    int written_chunk;
+    int window;
+    std::vector<std::vector<uint8_t> *> results;
+};
+
+
+converter::converter(trace_dumper_reader *reader, bool is_vcd, int first_chunk, int last_chunk, int64_t from, int64_t to)
+: reader(reader), is_vcd(is_vcd), first_chunk(first_chunk), last_chunk(last_chunk), from(from), to(to),
+  fst(NULL), vcd(NULL), last_timestamp(-1)
+{
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->cond, NULL);
+}
+
+
+void converter::add_scope(std::string path, bool begin)
+{
+    std::string delim = "/";
+
+    auto start = 0U;
+    auto end = path.find(delim);
+    while (end != std::string::npos)
+    {
+        if (end != start)
+        {
+            if (this->is_vcd)
+            {
+                if (begin)
+                    fprintf(this->vcd, "$scope module %s $end\n", path.substr(start, end - start).c_str());
+                else
+                    fprintf(this->vcd, "$upscope $end\n");
+            }
+            else
+            {
+                if (begin)
+                    fstWriterSetScope(this->fst, FST_ST_VCD_MODULE, path.substr(start, end - start).c_str(), NULL);
+                else
+                    fstWriterSetUpscope(this->fst);
+            }
+        }
+        start = end + delim.length();
+        end = path.find(delim, start);
+    }
+}
+
+
+int converter::open(std::string path)
+{
+    int timescale = this->reader->get_timescale() == ED_CONF_TIMESCALE_PS ? -12 : -9;
+
+    if (this->is_vcd)
+    {
+        this->vcd = fopen(path.c_str(), "w");
+        if (this->vcd == NULL)
+            return -1;
+
+        fprintf(this->vcd, "$timescale 1%s $end\n", timescale == -12 ? "ps" : "ns");
+    }
+    else
+    {
+        this->fst = fstWriterCreate(path.c_str(), 1);
+        if (this->fst == NULL)
+            return -1;
+
+        fstWriterSetTimescale(this->fst, timescale);
+    }
+
+    for (auto trace: this->reader->get_traces())
+    {
+        std::string name = trace->path.substr(trace->path.rfind('/') + 1);
+
+        this->add_scope(trace->path, true);
+
+        if (this->is_vcd)
+        {
+            int index = this->vcd_codes.size();
+            std::string code;
+            do
+            {
+                code += (char)('!' + index % 94);
+                index /= 94;
+            } while (index);
+
+            if (trace->type == ED_TRACE_REAL)
+                fprintf(this->vcd, "$var real 64 %s %s $end\n", code.c_str(), name.c_str());
+            else
+                fprintf(this->vcd, "$var wire %d %s %s $end\n", trace->width, code.c_str(), name.c_str());
+
+            this->vcd_codes.push_back(code);
+        }
+        else
+        {
+            fstHandle var;
+            if (trace->type == ED_TRACE_REAL)
+                var = fstWriterCreateVar(this->fst, FST_VT_VCD_REAL, FST_VD_INOUT, 64, name.c_str(), 0);
+            else if (trace->type == ED_TRACE_VARLEN)
+                var = fstWriterCreateVar(this->fst, FST_VT_GEN_STRING, FST_VD_INOUT, 0, name.c_str(), 0);
+            else
+                var = fstWriterCreateVar(this->fst, FST_VT_VCD_WIRE, FST_VD_INOUT, trace->width, name.c_str(), 0);
+
+            this->fst_vars.push_back(var);
+        }
+
+        this->add_scope(trace->path, false);
+
+        this->trace_index[trace] = this->traces.size();
+        this->traces.push_back(trace);
+    }
+
+    if (this->is_vcd)
+        fprintf(this->vcd, "$enddefinitions $end\n");
+
+    return 0;
+}
+
+
+// Formatted chunk is a sequence of records made of the timestamp, the trace
+// index, the value size and the value, already in the output format
+void converter::format_chunk(int index, std::vector<uint8_t> *output)
+{
+    std::vector<uint8_t> buffer(this->reader->get_chunk(index)->raw_size);
+    if (this->reader->load_chunk(index, buffer.data()))
+    {
+        fprintf(stderr, "Failed to decompress chunk %d\n", index);
+        return;
+    }
+
+    uint8_t *ptr = buffer.data();
+    uint8_t *end = ptr + buffer.size();
+    int64_t timestamp = 0;
+    trace_packet packet;
+    std::string value;
+
+    while (this->reader->decode_packet(&ptr, end, &timestamp, &packet) == 0)
+    {
+        if (timestamp < this->from || (this->to != -1 && timestamp > this->to))
+            continue;
+
+        Trace *trace = packet.trace;
+        int trace_id = this->trace_index[trace];
+
+        value.clear();
+
+        if (trace->type == ED_TRACE_REAL)
+        {
+            double real = packet.size == 4 ? *(float *)packet.data : *(double *)packet.data;
+            if (this->is_vcd)
+            {
+                char str[32];
+                snprintf(str, sizeof(str), "r%.16g ", real);
+                value = str;
+            }
+            else
+            {
+                value.assign((char *)&real, sizeof(real));
+            }
+        }
+        else if (trace->type == ED_TRACE_VARLEN)
+        {
+            if (this->is_vcd)
+                value = "s";
+            value.append((char *)packet.data, strnlen((char *)packet.data, packet.size));
+            if (this->is_vcd)
+                value += " ";
+        }
+        else
+        {
+            if (this->is_vcd && trace->width > 1)
+                value = "b";
+            for (int i=trace->width-1; i>=0; i--)
+            {
+                int bit = i / 8 < (int)packet.size ? (packet.data[i/8] >> (i%8)) & 1 : 0;
+                value += (char)('0' + bit);
+            }
+            if (this->is_vcd && trace->width > 1)
+                value += " ";
+        }
+
+        if (this->is_vcd)
+        {
+            value += this->vcd_codes[trace_id];
+            value += "\n";
+        }
+
+        uint32_t size = value.size();
+        output->insert(output->end(), (uint8_t *)&timestamp, (uint8_t *)&timestamp + sizeof(timestamp));
+        output->insert(output->end(), (uint8_t *)&trace_id, (uint8_t *)&trace_id + sizeof(trace_id));
+        output->insert(output->end(), (uint8_t *)&size, (uint8_t *)&size + sizeof(size));
+        output->insert(output->end(), value.begin(), value.end());
+    }
+}
+
+
+void converter::write_chunk(std::vector<uint8_t> *output)
+{
+    uint8_t *ptr = output->data();
+    uint8_t *end = ptr + output->size();
+
+    while (ptr < end)
+    {
+        int64_t timestamp;
+        int trace_id;
+        uint32_t size;
+
+        memcpy(&timestamp, ptr, sizeof(timestamp));
+        ptr += sizeof(timestamp);
+        memcpy(&trace_id, ptr, sizeof(trace_id));
+        ptr += sizeof(trace_id);
+        memcpy(&size, ptr, sizeof(size));
+        ptr += sizeof(size);
+
+        if (timestamp != this->last_timestamp)
+        {
+            this->last_timestamp = timestamp;
+            if (this->is_vcd)
+                fprintf(this->vcd, "#%ld\n", timestamp);
+            else
+                fstWriterEmitTimeChange(this->fst, timestamp);
+        }
+
+        if (this->is_vcd)
+        {
+            fwrite(ptr, 1, size, this->vcd);
+        }
+        else if (this->traces[trace_id]->type == ED_TRACE_VARLEN)
+        {
+            fstWriterEmitVariableLengthValueChange(this->fst, this->fst_vars[trace_id], ptr, size);
+        }
+        else
+        {
+            // FST is expecting a null-terminated string for wires
+            std::string value((char *)ptr, size);
+            fstWriterEmitValueChange(this->fst, this->fst_vars[trace_id], this->traces[trace_id]->type == ED_TRACE_REAL ? (void *)ptr : (void *)value.c_str());
+        }
+
+        ptr += size;
+    }
+}
+
+
+void converter::worker_routine()
+{
+    pthread_mutex_lock(&this->mutex);
+
+    while(1)
+    {
+        while (this->next_chunk <= this->last_chunk && this->next_chunk >= this->written_chunk + this->window)
+        {
+            pthread_cond_wait(&this->cond, &this->mutex);
+        }
+
+        if (this->next_chunk > this->last_chunk)
+            break;
+
+        int index = this->next_chunk++;
+
+        pthread_mutex_unlock(&this->mutex);
+
+        std::vector<uint8_t> *output = new std::vector<uint8_t>();
+        this->format_chunk(index, output);
+
+        pthread_mutex_lock(&this->mutex);
+        this->results[index - this->first_chunk] = output;
+        pthread_cond_broadcast(&this->cond);
+    }
+
+    pthread_mutex_unlock(&this->mutex);
+}
+
+
+void converter::convert(int nb_jobs)
+{
+    if (this->last_chunk < this->first_chunk)
+        return;
+
+    this->next_chunk = this->first_chunk;
+    this->written_chunk = this->first_chunk;
+    this->window = nb_jobs * 2;
+    this->results.resize(this->last_chunk - this->first_chunk + 1, NULL);
+
+    std::vector<std::thread *> threads;
+    for (int i=0; i<nb_jobs; i++)
+    {
+        threads.push_back(new std::thread(&converter::worker_routine, this));
+    }
+
+    for (int index=this->first_chunk; index<=this->last_chunk; index++)
+    {
+        pthread_mutex_lock(&this->mutex);
+        while (this->results[index - this->first_chunk] == NULL)
+        {
+            pthread_cond_wait(&this->cond, &this->mutex);
+        }
+        std::vector<uint8_t> *output = this->results[index - this->first_chunk];
+        this->results[index - this->first_chunk] = NULL;
+        pthread_mutex_unlock(&this->mutex);
+
+        this->write_chunk(output);
+        delete output;
+
+        pthread_mutex_lock(&this->mutex);
+        this->written_chunk = index + 1;
+        pthread_cond_broadcast(&this->cond);
+        pthread_mutex_unlock(&this->mutex);
+    }
+
+    for (auto thread: threads)
+    {
+        thread->join();
+        delete thread;
+    }
+}
+
+
+void converter::close()
+{
+    if (this->is_vcd)
+        fclose(this->vcd);
+    else
+        fstWriterClose(this->fst);
+}
+
+
+static void usage(char *name)
+{
+    fprintf(stderr, "Usage: %s [--jobs=<nb>] [--from=<timestamp>] [--to=<timestamp>] <input> <output.fst|output.vcd>\n", name);
+}
+
+
+int main(int argc, char **argv)
+{
+    int nb_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int64_t from = 0;
+    int64_t to = -1;
+    std::vector<std::string> args;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (strncmp(argv[i], "--jobs=", 7) == 0)
+            nb_jobs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--from=", 7) == 0)
+            from = strtoll(argv[i] + 7, NULL, 0);
+        else if (strncmp(argv[i], "--to=", 5) == 0)
+            to = strtoll(argv[i] + 5, NULL, 0);
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() != 2 || nb_jobs <= 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    std::string output = args[1];
+    bool is_vcd = output.size() >= 4 && output.substr(output.size() - 4) == ".vcd";
+
+    trace_dumper_reader *reader = new trace_dumper_reader(args[0]);
+    if (reader->open())
+    {
+        fprintf(stderr, "Failed to open chunked trace %s (error: %s)\n", args[0].c_str(), strerror(errno));
+        return -1;
+    }
+
+    // Only the chunks overlapping the window are converted
+    int first_chunk = 0;
+    while (first_chunk < reader->get_nb_chunks() && reader->get_chunk(first_chunk)->last_timestamp < from)
+        first_chunk++;
+
+    int last_chunk = reader->get_nb_chunks() - 1;
+    while (to != -1 && last_chunk >= first_chunk && reader->get_chunk(last_chunk)->first_timestamp > to)
+        last_chunk--;
+
+    converter *conv = new converter(reader, is_vcd, first_chunk, last_chunk, from, to);
+
+    if (conv->open(output))
+    {
+        fprintf(stderr, "Failed to open output %s (error: %s)\n", output.c_str(), strerror(errno));
+        return -1;
+    }
+
+    conv->convert(nb_jobs);
+    conv->close();
+
+    return 0;
+}
@@ -42,6 +42,7 @@ typedef enum
     ED_TYPE_TRACE         = 0x7,
     ED_TYPE_TRACE_SET_0   = 0x8,
     ED_TYPE_TRACE_SET_1   = 0x9,
+    ED_TYPE_CHUNKED_CONF  = 0xa,
 } ed_header_type_e;
 
 typedef enum
@@ -71,5 +72,36 @@ typedef struct
 } ed_reg_trace_t;
 
 
+// Chunked format.
+// The file starts with an ED_TYPE_CHUNKED_CONF header followed by ed_conf_t,
+// then contains the chunks, each one being an LZ4-compressed packet stream
+// starting with an absolute timestamp so that it can be decoded alone, and
+// ends with the index:
+// - the chunk table, an array of ed_chunk_t sorted by time,
+// - the trace table, for each trace an ed_reg_trace_t, its path, the number
+//   of chunks where it appears and the indexes of these chunks,
+// - the ed_chunked_trailer_t.
+
+#define ED_CHUNKED_MAGIC "GVTRIDX1"
+
+typedef struct
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t raw_size;
+	int64_t first_timestamp;
+	int64_t last_timestamp;
+} ed_chunk_t;
+
+typedef struct
+{
+	uint64_t chunks_offset;
+	uint64_t traces_offset;
+	uint32_t nb_chunks;
+	uint32_t nb_traces;
+	char magic[8];
+} ed_chunked_trailer_t;
+
+
 
 #endif
\ No newline at end of file
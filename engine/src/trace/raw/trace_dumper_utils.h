@@ -76,6 +76,29 @@ static inline uint32_t decode_id(std::ifstream *file, int *id_size)
 }
 
 
+static inline uint32_t decode_id_from_buffer(uint8_t **buffer, uint8_t *end)
+{
+    uint32_t id = 0;
+    int offset = 0;
+    uint8_t *ptr = *buffer;
+
+    while(ptr < end)
+    {
+        uint8_t byte = *ptr++;
+
+        id = id | ((byte & 0x7f) << offset);
+        offset += 7;
+
+        if (byte < 128)
+            break;
+    }
+
+    *buffer = ptr;
+
+    return id;
+}
+
+
 static inline unsigned int td_get_timestamp(uint64_t diff, int *ts_size)
 {
     unsigned int type;
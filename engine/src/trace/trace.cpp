@@ -107,14 +107,35 @@ void vp::trace::dump_header()
   fprintf(this->trace_file, "%ld: %ld: [\033[34m%-*.*s\033[0m] ", time, cycles, max_trace_len, max_trace_len, name.c_str());
 }
 
+void vp::trace::log_msg(const char *fmt, va_list ap)
+{
+  int64_t time = -1;
+  int64_t cycles = -1;
+  if (comp->get_clock())
+  {
+    time = comp->get_clock()->get_time();
+    cycles = comp->get_clock()->get_cycles();
+  }
+
+  comp->traces.get_trace_manager()->log->log(this, time, cycles, fmt, ap);
+}
+
 void vp::trace::dump_warning_header()
 {
+  // Warnings are printed directly, the deferred messages must be printed
+  // first to keep them in order
+  if (comp->traces.get_trace_manager()->log)
+    comp->traces.get_trace_manager()->log->flush();
+
   int max_trace_len = comp->traces.get_trace_manager()->get_max_path_len();
   fprintf(this->trace_file, "%ld: %ld: [\033[31m%-*.*s\033[0m] ", comp->get_clock()->get_time(), comp->get_clock()->get_cycles(), max_trace_len, max_trace_len, name.c_str());
 }
 
 void vp::trace::dump_fatal_header()
 {
+  if (comp && comp->traces.get_trace_manager() && comp->traces.get_trace_manager()->log)
+    comp->traces.get_trace_manager()->log->flush();
+
   fprintf(this->trace_file, "[\033[31m%s\033[0m] ", name.c_str());
 }
 
@@ -140,6 +161,7 @@ char *vp::trace_engine::get_event_buffer(int bytes)
     current_buffer = event_buffers[0];
     event_buffers.erase(event_buffers.begin());
     current_buffer_size = 0;
+    this->nb_busy_buffers.set(TRACE_EVENT_NB_BUFFER - event_buffers.size());
     pthread_mutex_unlock(&mutex);
   }
 
@@ -152,14 +174,50 @@ char *vp::trace_engine::get_event_buffer(int bytes)
 
 void vp::trace_engine::stop()
 {
-  this->check_pending_events(-1);
+  if (this->thread)
+  {
+    this->check_pending_events(-1);
+    this->flush();
+    pthread_mutex_lock(&mutex);
+    this->end = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    this->thread->join();
+    delete this->thread;
+    this->thread = NULL;
+  }
+  if (this->log)
+    this->log->close();
+  fflush(NULL);
+}
+
+void vp::trace_engine::fork_prepare()
+{
+  // Events already produced are dumped by the parent, pending ones stay
+  // pending in the children. The thread is stopped so that it does not hold
+  // any lock while the platform is forked.
   this->flush();
   pthread_mutex_lock(&mutex);
   this->end = 1;
   pthread_cond_broadcast(&cond);
   pthread_mutex_unlock(&mutex);
   this->thread->join();
-  fflush(NULL);
+  delete this->thread;
+  this->thread = NULL;
+
+  if (this->log)
+    this->log->fork_prepare();
+}
+
+void vp::trace_engine::fork_child()
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&cond, NULL);
+  this->end = 0;
+  this->thread = new std::thread(&trace_engine::vcd_routine, this);
+
+  if (this->log)
+    this->log->fork_child();
 }
 
 void vp::trace_engine::flush()
@@ -443,6 +501,7 @@ void vp::trace_engine::vcd_routine()
 
     pthread_mutex_lock(&this->mutex);
     event_buffers.push_back(event_buffer_start);
+    this->nb_busy_buffers.set(TRACE_EVENT_NB_BUFFER - event_buffers.size());
     pthread_cond_broadcast(&cond);
     pthread_mutex_unlock(&this->mutex);
   }
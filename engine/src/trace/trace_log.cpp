@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "vp/vp.hpp"
+#include "vp/trace/trace_log.hpp"
+#include "trace_log_format.hpp"
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <link.h>
+
+// Size of the ring buffer of each simulation thread, must be a power of 2
+#define TRACE_LOG_BUFFER_SIZE (1<<22)
+
+// Marks the end of the ring buffer when a message does not fit before it
+#define TRACE_LOG_PADDING 0xffffffff
+
+// Message as stored in the ring buffer, followed by its arguments, and by
+// its format when it is not static
+typedef struct
+{
+  uint32_t size;
+  uint32_t nb_args;
+  vp::trace *trace;
+  const char *fmt;
+  int64_t time;
+  int64_t cycles;
+} trace_log_message_t;
+
+
+static thread_local vp::trace_log_buffer *thread_buffer = NULL;
+
+
+int vp::trace_log::open(std::string binary_path)
+{
+  this->binary_path = binary_path;
+
+  if (binary_path != "")
+  {
+    this->binary_file = fopen(binary_path.c_str(), "w");
+    if (this->binary_file == NULL)
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Failed to open trace log (path: %s, error: %s)", binary_path.c_str(), strerror(errno));
+      return -1;
+    }
+
+    fwrite(TRACE_LOG_MAGIC, 1, strlen(TRACE_LOG_MAGIC), this->binary_file);
+  }
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+
+  this->end = false;
+  this->running = true;
+  pthread_create(&this->thread, NULL, trace_log::routine_stub, (void *)this);
+
+  return 0;
+}
+
+
+void vp::trace_log::stop_thread()
+{
+  // The thread writes all the pending messages before leaving
+  pthread_mutex_lock(&this->mutex);
+  this->end = true;
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->mutex);
+  pthread_join(this->thread, NULL);
+  this->running = false;
+}
+
+
+void vp::trace_log::close()
+{
+  if (this->running)
+    this->stop_thread();
+  else if (!this->forked)
+    return;
+
+  if (this->binary_file)
+  {
+    fclose(this->binary_file);
+    this->binary_file = NULL;
+  }
+}
+
+
+void vp::trace_log::fork_prepare()
+{
+  // The logging thread is stopped once it has written the pending messages,
+  // so that they are not written again by the children, and so that it
+  // does not hold any lock, e.g. of the trace files, while the platform is
+  // forked. The parent does not run the platform anymore, so only the
+  // children start it again.
+  if (this->running)
+  {
+    this->stop_thread();
+    this->forked = true;
+  }
+}
+
+
+void vp::trace_log::fork_child()
+{
+  if (!this->forked)
+    return;
+
+  this->format_ids.clear();
+  this->dynamic_format_ids.clear();
+  this->dumped_traces.clear();
+
+  if (this->binary_file)
+  {
+    if (freopen(this->binary_path.c_str(), "w", this->binary_file) == NULL)
+      throw std::logic_error("Unable to open file: " + this->binary_path);
+    fwrite(TRACE_LOG_MAGIC, 1, strlen(TRACE_LOG_MAGIC), this->binary_file);
+  }
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+  this->end = false;
+  this->running = true;
+  pthread_create(&this->thread, NULL, trace_log::routine_stub, (void *)this);
+}
+
+
+vp::trace_log_buffer *vp::trace_log::get_buffer()
+{
+  if (thread_buffer == NULL || thread_buffer->log != this)
+  {
+    trace_log_buffer *buffer = new trace_log_buffer();
+    buffer->log = this;
+    buffer->size = TRACE_LOG_BUFFER_SIZE;
+    buffer->data = new char[buffer->size];
+    buffer->write_pos = 0;
+    buffer->read_pos = 0;
+
+    pthread_mutex_lock(&this->mutex);
+    this->buffers.push_back(buffer);
+    pthread_mutex_unlock(&this->mutex);
+
+    thread_buffer = buffer;
+  }
+
+  return thread_buffer;
+}
+
+
+static int is_static_callback(struct dl_phdr_info *info, size_t size, void *data)
+{
+  uintptr_t addr = *(uintptr_t *)data;
+
+  for (int i=0; i<info->dlpi_phnum; i++)
+  {
+    const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+    if (phdr->p_type == PT_LOAD && !(phdr->p_flags & PF_W))
+    {
+      uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+      if (addr >= start && addr < start + phdr->p_memsz)
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+bool vp::trace_log::is_static(trace_log_buffer *buffer, const char *fmt)
+{
+  auto it = buffer->static_formats.find(fmt);
+  if (it != buffer->static_formats.end())
+    return it->second;
+
+  // String literals are in read-only segments, while formats built at
+  // runtime are on the stack or in the heap. Libraries are never unloaded
+  // during the simulation, so the result can be kept.
+  uintptr_t addr = (uintptr_t)fmt;
+  bool result = dl_iterate_phdr(is_static_callback, &addr) != 0;
+  buffer->static_formats[fmt] = result;
+  return result;
+}
+
+
+void vp::trace_log::log(vp::trace *trace, int64_t time, int64_t cycles, const char *fmt, va_list ap)
+{
+  trace_log_buffer *buffer = this->get_buffer();
+
+  buffer->args.clear();
+  trace_log_store_args(buffer->args, fmt, ap);
+
+  bool is_static;
+  if (fmt == trace->log_static_fmt)
+    is_static = true;
+  else if (fmt == trace->log_dynamic_fmt)
+    is_static = false;
+  else
+  {
+    is_static = this->is_static(buffer, fmt);
+    if (is_static)
+      trace->log_static_fmt = fmt;
+    else
+      trace->log_dynamic_fmt = fmt;
+  }
+
+  uint64_t fmt_size = is_static ? 0 : (strlen(fmt) + 8) & ~7;
+  uint64_t size = sizeof(trace_log_message_t) + buffer->args.size() * 8 + fmt_size;
+
+  if (size > buffer->size / 2)
+  {
+    // Too big for the ring buffer, the message is written directly, once
+    // the previous ones are written
+    pthread_mutex_lock(&this->mutex);
+    this->consume(buffer);
+    this->write_message(trace, time, cycles, fmt, is_static, buffer->args.data(), buffer->args.size());
+    pthread_mutex_unlock(&this->mutex);
+    return;
+  }
+
+  uint64_t write_pos = buffer->write_pos.load(std::memory_order_relaxed);
+  uint64_t offset = write_pos & (buffer->size - 1);
+  uint64_t padding = offset + size > buffer->size ? buffer->size - offset : 0;
+
+  while (write_pos + padding + size - buffer->read_pos.load(std::memory_order_acquire) > buffer->size)
+  {
+    pthread_cond_signal(&this->cond);
+    sched_yield();
+  }
+
+  if (padding)
+  {
+    trace_log_message_t *message = (trace_log_message_t *)(buffer->data + offset);
+    message->size = padding;
+    message->nb_args = TRACE_LOG_PADDING;
+    offset = 0;
+  }
+
+  trace_log_message_t *message = (trace_log_message_t *)(buffer->data + offset);
+  message->size = size;
+  message->nb_args = buffer->args.size();
+  message->trace = trace;
+  message->fmt = is_static ? fmt : NULL;
+  message->time = time;
+  message->cycles = cycles;
+
+  char *args = (char *)(message + 1);
+  memcpy(args, buffer->args.data(), buffer->args.size() * 8);
+  if (!is_static)
+    strcpy(args + buffer->args.size() * 8, fmt);
+
+  write_pos += padding + size;
+  buffer->write_pos.store(write_pos, std::memory_order_release);
+
+  // The logging thread is also polling, this is just to avoid filling the
+  // buffer when messages are produced faster than the polling period
+  if (write_pos - buffer->read_pos.load(std::memory_order_relaxed) > buffer->size / 4)
+    pthread_cond_signal(&this->cond);
+}
+
+
+void vp::trace_log::flush()
+{
+  if (!this->running)
+    return;
+
+  pthread_mutex_lock(&this->mutex);
+  std::vector<trace_log_buffer *> buffers = this->buffers;
+  pthread_mutex_unlock(&this->mutex);
+
+  for (auto buffer: buffers)
+  {
+    while (buffer->read_pos.load(std::memory_order_acquire) != buffer->write_pos.load(std::memory_order_relaxed))
+    {
+      pthread_cond_signal(&this->cond);
+      sched_yield();
+    }
+  }
+
+  fflush(NULL);
+}
+
+
+bool vp::trace_log::consume(trace_log_buffer *buffer)
+{
+  uint64_t read_pos = buffer->read_pos.load(std::memory_order_relaxed);
+  uint64_t write_pos = buffer->write_pos.load(std::memory_order_acquire);
+
+  if (read_pos == write_pos)
+    return false;
+
+  while (read_pos != write_pos)
+  {
+    trace_log_message_t *message = (trace_log_message_t *)(buffer->data + (read_pos & (buffer->size - 1)));
+
+    if (message->nb_args != TRACE_LOG_PADDING)
+    {
+      uint64_t *args = (uint64_t *)(message + 1);
+      const char *fmt = message->fmt ? message->fmt : (const char *)(args + message->nb_args);
+      this->write_message(message->trace, message->time, message->cycles, fmt, message->fmt != NULL, args, message->nb_args);
+    }
+
+    read_pos += message->size;
+  }
+
+  buffer->read_pos.store(read_pos, std::memory_order_release);
+
+  return true;
+}
+
+
+uint32_t vp::trace_log::get_format_id(const char *fmt, bool is_static)
+{
+  uint32_t id = this->format_ids.size() + this->dynamic_format_ids.size();
+
+  if (is_static)
+  {
+    auto it = this->format_ids.find(fmt);
+    if (it != this->format_ids.end())
+      return it->second;
+    this->format_ids[fmt] = id;
+  }
+  else
+  {
+    auto it = this->dynamic_format_ids.find(fmt);
+    if (it != this->dynamic_format_ids.end())
+      return it->second;
+    this->dynamic_format_ids[fmt] = id;
+  }
+
+  uint8_t type = TRACE_LOG_FORMAT;
+  uint32_t len = strlen(fmt);
+  fwrite(&type, 1, 1, this->binary_file);
+  fwrite(&id, sizeof(id), 1, this->binary_file);
+  fwrite(&len, sizeof(len), 1, this->binary_file);
+  fwrite(fmt, 1, len, this->binary_file);
+
+  return id;
+}
+
+
+void vp::trace_log::write_message(vp::trace *trace, int64_t time, int64_t cycles, const char *fmt, bool is_static, uint64_t *args, int nb_args)
+{
+  if (this->binary_file)
+  {
+    if (trace->id >= (int)this->dumped_traces.size())
+      this->dumped_traces.resize(trace->id + 1, false);
+
+    if (!this->dumped_traces[trace->id])
+    {
+      uint8_t type = TRACE_LOG_TRACE;
+      int32_t id = trace->id;
+      uint32_t len = trace->name.size();
+      fwrite(&type, 1, 1, this->binary_file);
+      fwrite(&id, sizeof(id), 1, this->binary_file);
+      fwrite(&len, sizeof(len), 1, this->binary_file);
+      fwrite(trace->name.c_str(), 1, len, this->binary_file);
+      this->dumped_traces[trace->id] = true;
+    }
+
+    uint32_t format_id = this->get_format_id(fmt, is_static);
+
+    uint8_t type = TRACE_LOG_MESSAGE;
+    int32_t trace_id = trace->id;
+    uint32_t nb_args_32 = nb_args;
+    fwrite(&type, 1, 1, this->binary_file);
+    fwrite(&trace_id, sizeof(trace_id), 1, this->binary_file);
+    fwrite(&format_id, sizeof(format_id), 1, this->binary_file);
+    fwrite(&time, sizeof(time), 1, this->binary_file);
+    fwrite(&cycles, sizeof(cycles), 1, this->binary_file);
+    fwrite(&nb_args_32, sizeof(nb_args_32), 1, this->binary_file);
+    fwrite(args, 8, nb_args, this->binary_file);
+  }
+  else
+  {
+    int max_trace_len = trace->comp->traces.get_trace_manager()->get_max_path_len();
+    std::string name = trace->name.substr(0, max_trace_len);
+    name.resize(max_trace_len, ' ');
+
+    this->line = std::to_string(time) + ": " + std::to_string(cycles) + ": [\033[34m" + name + "\033[0m] ";
+    trace_log_format(this->line, fmt, args, nb_args);
+
+    fwrite(this->line.c_str(), 1, this->line.size(), trace->trace_file);
+  }
+}
+
+
+void vp::trace_log::routine()
+{
+  pthread_mutex_lock(&this->mutex);
+
+  while (1)
+  {
+    bool consumed = false;
+    for (auto buffer: this->buffers)
+    {
+      consumed |= this->consume(buffer);
+    }
+
+    if (!consumed)
+    {
+      if (this->end)
+        break;
+
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += 1000000;
+      if (ts.tv_nsec >= 1000000000)
+      {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&this->cond, &this->mutex, &ts);
+    }
+  }
+
+  pthread_mutex_unlock(&this->mutex);
+
+  fflush(NULL);
+}
+
+
+void *vp::trace_log::routine_stub(void *arg)
+{
+  ((vp::trace_log *)arg)->routine();
+  return NULL;
+}
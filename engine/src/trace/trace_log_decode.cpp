@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Decodes a binary trace log into the same text as the one printed by the
+// platform when messages are not logged in binary.
+
+#include "vp/trace/trace_log.hpp"
+#include "trace_log_format.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+#include <string>
+#include <vector>
+
+
+static int read_string(FILE *file, std::string *str)
+{
+    uint32_t size;
+    if (fread(&size, sizeof(size), 1, file) != 1)
+        return -1;
+
+    str->resize(size);
+    if (size && fread(&(*str)[0], 1, size, file) != size)
+        return -1;
+
+    return 0;
+}
+
+struct message_desc
+{
+    int32_t trace;
+    uint32_t format;
+    int64_t time;
+    int64_t cycles;
+    uint32_t nb_args;
+};
+
+// Reads the next record, and returns its type, or -1 at the end of the log
+static int read_record(FILE *file, std::vector<std::string> &traces, std::vector<std::string> &formats,
+    message_desc *message, std::vector<uint64_t> &args)
+{
+    uint8_t type;
+    int32_t id;
+    std::string str;
+
+    if (fread(&type, 1, 1, file) != 1)
+        return -1;
+
+    int error = 0;
+
+    switch (type)
+    {
+        case TRACE_LOG_TRACE:
+            error = fread(&id, sizeof(id), 1, file) != 1 || id < 0 || read_string(file, &str);
+            if (!error)
+            {
+                if (id >= (int)traces.size())
+                    traces.resize(id + 1);
+                traces[id] = str;
+            }
+            break;
+
+        case TRACE_LOG_FORMAT:
+            error = fread(&id, sizeof(id), 1, file) != 1 || id < 0 || read_string(file, &str);
+            if (!error)
+            {
+                if (id >= (int)formats.size())
+                    formats.resize(id + 1);
+                formats[id] = str;
+            }
+            break;
+
+        case TRACE_LOG_MESSAGE:
+            error = fread(&message->trace, sizeof(message->trace), 1, file) != 1 ||
+                fread(&message->format, sizeof(message->format), 1, file) != 1 ||
+                fread(&message->time, sizeof(message->time), 1, file) != 1 ||
+                fread(&message->cycles, sizeof(message->cycles), 1, file) != 1 ||
+                fread(&message->nb_args, sizeof(message->nb_args), 1, file) != 1;
+            if (!error)
+            {
+                args.resize(message->nb_args);
+                error = message->nb_args && fread(args.data(), 8, message->nb_args, file) != message->nb_args;
+            }
+            error |= message->trace < 0 || message->trace >= (int)traces.size() || message->format >= formats.size();
+            break;
+
+        default:
+            error = 1;
+            break;
+    }
+
+    if (error)
+    {
+        fprintf(stderr, "Trace log is corrupted or truncated (record type: %d)\n", type);
+        return -1;
+    }
+
+    return type;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--trace=<regex>]... [--output=<file>] <trace log>\n", name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Prints the messages of the traces matching one of the regular expressions, or all of them by default.\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<regex_t *> trace_regex;
+    std::vector<std::string> args;
+    std::string output_path;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (strncmp(argv[i], "--trace=", 8) == 0)
+        {
+            regex_t *regex = new regex_t();
+            if (regcomp(regex, argv[i] + 8, 0))
+            {
+                fprintf(stderr, "Invalid regular expression: %s\n", argv[i] + 8);
+                return -1;
+            }
+            trace_regex.push_back(regex);
+        }
+        else if (strncmp(argv[i], "--output=", 9) == 0)
+            output_path = argv[i] + 9;
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() != 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    FILE *file = fopen(args[0].c_str(), "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open trace log %s (error: %s)\n", args[0].c_str(), strerror(errno));
+        return -1;
+    }
+
+    FILE *output = stdout;
+    if (output_path != "")
+    {
+        output = fopen(output_path.c_str(), "w");
+        if (output == NULL)
+        {
+            fprintf(stderr, "Failed to open %s (error: %s)\n", output_path.c_str(), strerror(errno));
+            return -1;
+        }
+    }
+
+    char magic[sizeof(TRACE_LOG_MAGIC) - 1];
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, TRACE_LOG_MAGIC, sizeof(magic)) != 0)
+    {
+        fprintf(stderr, "Not a trace log\n");
+        return -1;
+    }
+
+    std::vector<std::string> traces;
+    std::vector<std::string> formats;
+    std::vector<uint64_t> msg_args;
+    message_desc message;
+
+    // The trace paths are aligned on the longest one, which is only known
+    // once all traces are read
+    while (read_record(file, traces, formats, &message, msg_args) != -1)
+    {
+    }
+
+    size_t max_path_len = 0;
+    std::vector<bool> enabled;
+    for (auto &trace: traces)
+    {
+        bool match = trace_regex.size() == 0;
+        for (auto regex: trace_regex)
+        {
+            if (regexec(regex, trace.c_str(), 0, NULL, 0) == 0)
+                match = true;
+        }
+        enabled.push_back(match);
+
+        if (match && trace.size() > max_path_len)
+            max_path_len = trace.size();
+    }
+
+    fseek(file, sizeof(magic), SEEK_SET);
+
+    std::string line;
+    int type;
+    while ((type = read_record(file, traces, formats, &message, msg_args)) != -1)
+    {
+        if (type != TRACE_LOG_MESSAGE || !enabled[message.trace])
+            continue;
+
+        std::string name = traces[message.trace];
+        name.resize(max_path_len, ' ');
+
+        line = std::to_string(message.time) + ": " + std::to_string(message.cycles) + ": [\033[34m" + name + "\033[0m] ";
+
+        if (trace_log_format(line, formats[message.format].c_str(), msg_args.data(), msg_args.size()))
+            line += "<truncated arguments>\n";
+
+        fwrite(line.c_str(), 1, line.size(), output);
+    }
+
+    fclose(file);
+    if (output != stdout)
+        fclose(output);
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "trace_log_format.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+const char *trace_log_next_spec(const char *fmt, trace_log_spec *spec)
+{
+  const char *current = strchr(fmt, '%');
+  if (current == NULL)
+    return NULL;
+
+  spec->start = current++;
+  spec->nb_stars = 0;
+  spec->precision = -1;
+  spec->precision_star = false;
+  spec->len = TRACE_LOG_LEN_DEFAULT;
+
+  while (*current && strchr("-+ #0'", *current))
+    current++;
+
+  if (*current == '*')
+  {
+    spec->nb_stars++;
+    current++;
+  }
+  else
+  {
+    while (*current >= '0' && *current <= '9')
+      current++;
+  }
+
+  if (*current == '.')
+  {
+    current++;
+    if (*current == '*')
+    {
+      spec->nb_stars++;
+      spec->precision_star = true;
+      current++;
+    }
+    else
+    {
+      spec->precision = 0;
+      while (*current >= '0' && *current <= '9')
+        spec->precision = spec->precision * 10 + *current++ - '0';
+    }
+  }
+
+  spec->length = current;
+
+  while (*current && strchr("hlLqjzt", *current))
+  {
+    if (*current == 'h')
+      spec->len = spec->len == TRACE_LOG_LEN_DEFAULT ? TRACE_LOG_LEN_SHORT : TRACE_LOG_LEN_CHAR;
+    else if (*current == 'l')
+      spec->len = spec->len == TRACE_LOG_LEN_DEFAULT ? TRACE_LOG_LEN_LONG : TRACE_LOG_LEN_LONG_LONG;
+    else if (*current == 'L')
+      spec->len = TRACE_LOG_LEN_LONG_DOUBLE;
+    else
+      spec->len = TRACE_LOG_LEN_LONG_LONG;
+    current++;
+  }
+
+  spec->conversion = *current;
+
+  switch (*current)
+  {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+      spec->type = TRACE_LOG_ARG_INT;
+      break;
+    case 'c':
+      spec->type = TRACE_LOG_ARG_CHAR;
+      break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      spec->type = TRACE_LOG_ARG_DOUBLE;
+      break;
+    case 's':
+      spec->type = TRACE_LOG_ARG_STRING;
+      break;
+    case 'p':
+      spec->type = TRACE_LOG_ARG_POINTER;
+      break;
+    case 'n':
+      spec->type = TRACE_LOG_ARG_COUNT;
+      break;
+    default:
+      // Also covers %% and a '%' ending the format
+      spec->type = TRACE_LOG_ARG_NONE;
+      break;
+  }
+
+  spec->end = *current ? current + 1 : current;
+
+  return spec->end;
+}
+
+
+void trace_log_store_args(std::vector<uint64_t> &args, const char *fmt, va_list ap)
+{
+  trace_log_spec spec;
+
+  while ((fmt = trace_log_next_spec(fmt, &spec)) != NULL)
+  {
+    if (spec.type == TRACE_LOG_ARG_NONE)
+      continue;
+
+    int precision = spec.precision;
+
+    for (int i=0; i<spec.nb_stars; i++)
+    {
+      int value = va_arg(ap, int);
+      args.push_back((int64_t)value);
+      if (spec.precision_star && i == spec.nb_stars - 1)
+        precision = value;
+    }
+
+    switch (spec.type)
+    {
+      case TRACE_LOG_ARG_INT:
+      {
+        // The value is printed as long long, unsigned conversions must not
+        // see the sign extension of smaller types
+        bool is_signed = spec.conversion == 'd' || spec.conversion == 'i';
+        int64_t value;
+        if (spec.len == TRACE_LOG_LEN_LONG_LONG)
+          value = va_arg(ap, long long);
+        else if (spec.len == TRACE_LOG_LEN_LONG)
+          value = is_signed ? va_arg(ap, long) : (int64_t)va_arg(ap, unsigned long);
+        else
+        {
+          int arg = va_arg(ap, int);
+          if (spec.len == TRACE_LOG_LEN_CHAR)
+            value = is_signed ? (int64_t)(signed char)arg : (int64_t)(unsigned char)arg;
+          else if (spec.len == TRACE_LOG_LEN_SHORT)
+            value = is_signed ? (int64_t)(short)arg : (int64_t)(unsigned short)arg;
+          else
+            value = is_signed ? (int64_t)arg : (int64_t)(unsigned int)arg;
+        }
+        args.push_back(value);
+        break;
+      }
+
+      case TRACE_LOG_ARG_CHAR:
+        args.push_back((int64_t)va_arg(ap, int));
+        break;
+
+      case TRACE_LOG_ARG_DOUBLE:
+      {
+        double value;
+        if (spec.len == TRACE_LOG_LEN_LONG_DOUBLE)
+          value = va_arg(ap, long double);
+        else
+          value = va_arg(ap, double);
+        uint64_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        args.push_back(raw);
+        break;
+      }
+
+      case TRACE_LOG_ARG_STRING:
+      {
+        const char *str = va_arg(ap, const char *);
+        if (str == NULL)
+          str = "(null)";
+        // The precision may bound a string which is not null-terminated
+        size_t len = precision >= 0 ? strnlen(str, precision) : strlen(str);
+        size_t index = args.size();
+        args.push_back(len);
+        args.resize(index + 1 + (len + 8) / 8);
+        memcpy(&args[index + 1], str, len);
+        ((char *)&args[index + 1])[len] = 0;
+        break;
+      }
+
+      case TRACE_LOG_ARG_POINTER:
+        args.push_back((uint64_t)va_arg(ap, void *));
+        break;
+
+      case TRACE_LOG_ARG_COUNT:
+        (void)va_arg(ap, void *);
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+
+template<typename T>
+static void format_arg(std::string &out, std::string &spec, int nb_stars, int *stars, T value)
+{
+  char buffer[256];
+  char *str = buffer;
+  int size = sizeof(buffer);
+
+  while (1)
+  {
+    int len;
+    if (nb_stars == 2)
+      len = snprintf(str, size, spec.c_str(), stars[0], stars[1], value);
+    else if (nb_stars == 1)
+      len = snprintf(str, size, spec.c_str(), stars[0], value);
+    else
+      len = snprintf(str, size, spec.c_str(), value);
+
+    if (len < 0)
+      break;
+
+    if (len < size)
+    {
+      out.append(str, len);
+      break;
+    }
+
+    if (str != buffer)
+      delete[] str;
+    size = len + 1;
+    str = new char[size];
+  }
+
+  if (str != buffer)
+    delete[] str;
+}
+
+
+int trace_log_format(std::string &out, const char *fmt, const uint64_t *args, int nb_args)
+{
+  trace_log_spec spec;
+  const char *next;
+  int index = 0;
+
+  while ((next = trace_log_next_spec(fmt, &spec)) != NULL)
+  {
+    out.append(fmt, spec.start - fmt);
+    fmt = next;
+
+    if (spec.type == TRACE_LOG_ARG_NONE)
+    {
+      out.append(spec.start + 1, spec.end - spec.start - 1);
+      continue;
+    }
+
+    if (spec.type == TRACE_LOG_ARG_COUNT)
+      continue;
+
+    if (index + spec.nb_stars + 1 > nb_args)
+      return -1;
+
+    int stars[2];
+    for (int i=0; i<spec.nb_stars; i++)
+    {
+      stars[i] = (int)args[index++];
+    }
+
+    // The length modifier is replaced by the one of the stored value
+    std::string spec_str(spec.start, spec.length - spec.start);
+
+    switch (spec.type)
+    {
+      case TRACE_LOG_ARG_INT:
+        spec_str += "ll";
+        spec_str += spec.conversion;
+        format_arg(out, spec_str, spec.nb_stars, stars, (long long)args[index++]);
+        break;
+
+      case TRACE_LOG_ARG_CHAR:
+        spec_str += spec.conversion;
+        format_arg(out, spec_str, spec.nb_stars, stars, (int)args[index++]);
+        break;
+
+      case TRACE_LOG_ARG_DOUBLE:
+      {
+        double value;
+        memcpy(&value, &args[index++], sizeof(value));
+        spec_str += spec.conversion;
+        format_arg(out, spec_str, spec.nb_stars, stars, value);
+        break;
+      }
+
+      case TRACE_LOG_ARG_STRING:
+      {
+        uint64_t len = args[index++];
+        int nb_words = (len + 8) / 8;
+        if (index + nb_words > nb_args)
+          return -1;
+        spec_str += 's';
+        format_arg(out, spec_str, spec.nb_stars, stars, (const char *)&args[index]);
+        index += nb_words;
+        break;
+      }
+
+      case TRACE_LOG_ARG_POINTER:
+        spec_str += 'p';
+        format_arg(out, spec_str, spec.nb_stars, stars, (void *)args[index++]);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  out.append(fmt);
+
+  return 0;
+}
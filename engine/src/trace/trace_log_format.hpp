@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_TRACE_TRACE_LOG_FORMAT_HPP__
+#define __VP_TRACE_TRACE_LOG_FORMAT_HPP__
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+
+// Arguments of a deferred trace message are stored raw, in the order in
+// which the format consumes them, each one on 8 bytes:
+// - integers, characters and pointers as int64, after being converted to
+//   the type given by the length modifier and the conversion, as printf
+//   does, so that they can be printed as long long,
+// - floating point values as double,
+// - strings as an int64 length, followed by the characters and a null
+//   character, padded to 8 bytes.
+// Widths and precisions given with '*' are stored as integers before the
+// value they apply to. The same parser is used to store the arguments on the
+// simulation side and to format them on the logging side.
+
+typedef enum
+{
+  TRACE_LOG_ARG_NONE,     // %% or unknown conversion, nothing is consumed
+  TRACE_LOG_ARG_INT,
+  TRACE_LOG_ARG_CHAR,
+  TRACE_LOG_ARG_DOUBLE,
+  TRACE_LOG_ARG_STRING,
+  TRACE_LOG_ARG_POINTER,
+  TRACE_LOG_ARG_COUNT     // %n, consumed but not stored
+} trace_log_arg_e;
+
+typedef enum
+{
+  TRACE_LOG_LEN_DEFAULT,
+  TRACE_LOG_LEN_CHAR,
+  TRACE_LOG_LEN_SHORT,
+  TRACE_LOG_LEN_LONG,
+  TRACE_LOG_LEN_LONG_LONG,
+  TRACE_LOG_LEN_LONG_DOUBLE
+} trace_log_len_e;
+
+// One conversion of a format
+typedef struct
+{
+  const char *start;      // The '%' character
+  const char *length;     // First character of the length modifier
+  const char *end;        // Character following the conversion
+  int nb_stars;
+  int precision;          // Literal precision or -1
+  bool precision_star;
+  trace_log_len_e len;
+  trace_log_arg_e type;
+  char conversion;
+} trace_log_spec;
+
+// Returns the next conversion, starting from fmt, or NULL if there is none
+const char *trace_log_next_spec(const char *fmt, trace_log_spec *spec);
+
+// Appends the arguments consumed by the format to the buffer
+void trace_log_store_args(std::vector<uint64_t> &args, const char *fmt, va_list ap);
+
+// Appends the message to the string, returns -1 if the arguments are
+// truncated
+int trace_log_format(std::string &out, const char *fmt, const uint64_t *args, int nb_args);
+
+#endif
@@ -14,36 +14,65 @@
  * limitations under the License.
  */
 
-/* 
+/*
  * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
  */
 
 #include "vp/vp.hpp"
 #include "vp/trace/event_dumper.hpp"
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+// Binary string of each nibble, so that values are formatted 4 bits at a time
+static const char vcd_nibbles[16][4] = {
+  {'0','0','0','0'}, {'0','0','0','1'}, {'0','0','1','0'}, {'0','0','1','1'},
+  {'0','1','0','0'}, {'0','1','0','1'}, {'0','1','1','0'}, {'0','1','1','1'},
+  {'1','0','0','0'}, {'1','0','0','1'}, {'1','0','1','0'}, {'1','0','1','1'},
+  {'1','1','0','0'}, {'1','1','0','1'}, {'1','1','1','0'}, {'1','1','1','1'}
+};
+
+// Size of a batch record header, see Vcd_file::dump
+#define VCD_RECORD_HEADER (sizeof(vp::Vcd_trace *) + sizeof(int64_t) + sizeof(int32_t))
 
-static unsigned int get_bit(uint8_t *value, int i) {
-  return (value[i/8] >> (i%8)) & 1;
-}
 
 vp::Vcd_file::Vcd_file(vp::Event_dumper *dumper, string path)
 {
-  file = fopen(path.c_str(), "w");
-  if (file == NULL)
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1)
   {
     dumper->comp->get_engine()->fatal("Error while opening VCD file (path: %s, error: %s)\n", path.c_str(), strerror(errno));
   }
 
-  fprintf(file, "%s", "\n\
-$timescale 1ps $end\n\
-");
+  for (int i=0; i<VCD_NB_CHUNKS; i++)
+  {
+    this->chunks[i] = new char[VCD_CHUNK_SIZE];
+    this->chunk_capacity[i] = VCD_CHUNK_SIZE;
+    this->chunk_size[i] = 0;
+  }
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+
+  this->header = "\n$timescale 1ps $end\n";
+  this->header_pending = true;
+
+  js::config *config = dumper->comp->get_js_config("**/vcd/parallel");
+  this->parallel = config != NULL && config->get_bool();
+
+  if (this->parallel)
+  {
+    this->batch = new uint8_t[VCD_BATCH_SIZE];
+    this->worker = new std::thread(&Vcd_file::worker_routine, this);
+  }
 }
 
 
 string vp::Vcd_file::parse_path(string path, bool begin)
 {
   std::string delim = "/";
-  
+
   auto start = 0U;
   auto end = path.find(delim);
   while (end != std::string::npos)
@@ -51,9 +80,9 @@ string vp::Vcd_file::parse_path(string path, bool begin)
     if (end != start)
     {
       if (begin) {
-        fprintf(file, "$scope module %s $end\n", path.substr(start, end - start).c_str());
+        this->header += "$scope module " + path.substr(start, end - start) + " $end\n";
       } else {
-        fprintf(file, "$upscope $end\n");
+        this->header += "$upscope $end\n";
       }
     }
     start = end + delim.length();
@@ -64,74 +93,401 @@ string vp::Vcd_file::parse_path(string path, bool begin)
 
 void vp::Vcd_file::add_trace(string path, int id, int width, bool is_real, bool is_string)
 {
+  Vcd_trace *trace = new Vcd_trace();
+
+  // Identifiers only need to be unique in this file, so they are allocated
+  // from a local index to keep them as short as possible
+  int index = this->nb_traces++;
+  int len = 0;
+  do
+  {
+    trace->code[len++] = '!' + index % 94;
+    index /= 94;
+  } while (index);
+  trace->code_len = len;
+  trace->is_real = is_real;
+  trace->is_string = is_string;
+
+  int page = id >> VCD_PAGE_BITS;
+  if (page >= VCD_NB_PAGES)
+  {
+    throw std::logic_error("Too many VCD traces");
+  }
+
+  pthread_mutex_lock(&this->mutex);
+
+  if (this->pages[page] == NULL)
+  {
+    this->pages[page] = new Vcd_trace *[1<<VCD_PAGE_BITS]();
+  }
+  this->pages[page][id & ((1<<VCD_PAGE_BITS) - 1)] = trace;
+
   string name = parse_path(path, true);
-  
+  string code(trace->code, trace->code_len);
+
   if (is_real)
-    fprintf(file, "$var real 64 %d %s $end\n", id, name.c_str());
+    this->header += "$var real 64 " + code + " " + name + " $end\n";
   else
-    fprintf(file, "$var wire %d %d %s $end\n", width, id, name.c_str());
+    this->header += "$var wire " + std::to_string(width) + " " + code + " " + name + " $end\n";
 
   parse_path(string(path), false);
+
+  __atomic_store_n(&this->header_pending, true, __ATOMIC_RELEASE);
+
+  pthread_mutex_unlock(&this->mutex);
 }
 
-void vp::Vcd_file::dump(int64_t timestamp, int id, uint8_t *event, int width, bool is_real, bool is_string, uint8_t flags, uint8_t *flag_mask)
+inline char *vp::Vcd_file::reserve(int size)
+{
+  int chunk = this->current_chunk;
+
+  if (this->chunk_size[chunk] + size > this->chunk_capacity[chunk])
+  {
+    if (this->chunk_size[chunk] != 0)
+    {
+      chunk++;
+      if (chunk == VCD_NB_CHUNKS)
+      {
+        this->flush_chunks();
+        chunk = 0;
+      }
+      this->current_chunk = chunk;
+    }
+
+    // Only big strings can go beyond a chunk
+    if (size > this->chunk_capacity[chunk])
+    {
+      delete[] this->chunks[chunk];
+      this->chunks[chunk] = new char[size];
+      this->chunk_capacity[chunk] = size;
+    }
+  }
+
+  return &this->chunks[chunk][this->chunk_size[chunk]];
+}
+
+void vp::Vcd_file::write_data(const char *data, int size)
+{
+  char *ptr = this->reserve(size);
+  memcpy(ptr, data, size);
+  this->chunk_size[this->current_chunk] += size;
+}
+
+void vp::Vcd_file::flush_chunks()
 {
+  struct iovec iov[VCD_NB_CHUNKS];
+  int nb_iov = 0;
+
+  for (int i=0; i<=this->current_chunk; i++)
+  {
+    if (this->chunk_size[i])
+    {
+      iov[nb_iov].iov_base = this->chunks[i];
+      iov[nb_iov].iov_len = this->chunk_size[i];
+      nb_iov++;
+    }
+    this->chunk_size[i] = 0;
+  }
+  this->current_chunk = 0;
+
+  struct iovec *current = iov;
+  while (nb_iov)
+  {
+    ssize_t size = writev(this->fd, current, nb_iov);
+    if (size == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+
+    while (nb_iov && (size_t)size >= current->iov_len)
+    {
+      size -= current->iov_len;
+      current++;
+      nb_iov--;
+    }
+
+    if (nb_iov)
+    {
+      current->iov_base = (char *)current->iov_base + size;
+      current->iov_len -= size;
+    }
+  }
+}
+
+static inline char *vcd_write_uint(char *ptr, uint64_t value)
+{
+  char buffer[20];
+  int len = 0;
+  do
+  {
+    buffer[len++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+
+  while (len)
+  {
+    *ptr++ = buffer[--len];
+  }
+  return ptr;
+}
+
+void vp::Vcd_file::encode(int64_t timestamp, Vcd_trace *trace, uint8_t *event, int width)
+{
+  if (unlikely(__atomic_load_n(&this->header_pending, __ATOMIC_ACQUIRE)))
+  {
+    pthread_mutex_lock(&this->mutex);
+    this->write_data(this->header.c_str(), this->header.size());
+    this->header = "";
+    this->header_pending = false;
+    pthread_mutex_unlock(&this->mutex);
+  }
+
   if (!header_dumped)
   {
     header_dumped = true;
-    fprintf(file, "%s", "\n\
-$enddefinitions $end\n\
-$dumpvars\n");    
-    fprintf(file, "$end\n");
+    const char *str = "\n$enddefinitions $end\n$dumpvars\n$end\n";
+    this->write_data(str, strlen(str));
   }
 
+  bool is_x = event == NULL;
+  int bytes = is_x ? 0 : trace->is_string ? width/8-1 : (width + 7) / 8;
+  if (bytes < 0)
+    bytes = 0;
+
+  // Skip values which did not change, the viewer is keeping the last value
+  if (trace->has_value && is_x == trace->is_x && bytes == trace->bytes &&
+    (is_x || memcmp(trace->value, event, bytes) == 0))
+  {
+    return;
+  }
+
+  trace->has_value = true;
+  trace->is_x = is_x;
+  if (!is_x)
+  {
+    if (bytes > trace->bytes)
+    {
+      delete[] trace->value;
+      trace->value = new uint8_t[bytes];
+    }
+    memcpy(trace->value, event, bytes);
+  }
+  trace->bytes = bytes;
+
+  // Timestamps are only dumped if at least one value changed
   if (last_timestamp != timestamp) {
     last_timestamp = timestamp;
-    fprintf(file, "#%ld\n", timestamp);
+    char *ptr = this->reserve(22);
+    char *start = ptr;
+    *ptr++ = '#';
+    ptr = vcd_write_uint(ptr, timestamp);
+    *ptr++ = '\n';
+    this->chunk_size[this->current_chunk] += ptr - start;
   }
 
-  if (is_real)
+  if (trace->is_real)
   {
-    fprintf(file, "r%f %d\n", *(double *)event, id);
+    char *ptr = this->reserve(32 + trace->code_len + 2);
+    int len = snprintf(ptr, 32, "r%.16g ", event ? *(double *)event : 0.0);
+    if (len > 31) len = 31;
+    ptr += len;
+    memcpy(ptr, trace->code, trace->code_len);
+    ptr[trace->code_len] = '\n';
+    this->chunk_size[this->current_chunk] += len + trace->code_len + 1;
   }
-  else if (is_string)
+  else if (trace->is_string)
   {
-    fprintf(file, "s");
-    fwrite(event, 1, width/8-1, file);
-    fprintf(file, " %d\n", id);
+    char *ptr = this->reserve(bytes + trace->code_len + 3);
+    char *start = ptr;
+    *ptr++ = 's';
+    if (bytes)
+      memcpy(ptr, event, bytes);
+    ptr += bytes;
+    *ptr++ = ' ';
+    memcpy(ptr, trace->code, trace->code_len);
+    ptr += trace->code_len;
+    *ptr++ = '\n';
+    this->chunk_size[this->current_chunk] += ptr - start;
   }
   else if (width > 1) {
-    int i;
-    char str[width+1+1];
-    char *str_ptr = str;
-    *str_ptr++ = 'b';
+    char *ptr = this->reserve(width + trace->code_len + 3);
+    char *start = ptr;
+    *ptr++ = 'b';
 
     if (event) {
-      for (int i=width-1; i>=0; i--)
+      // Bits which are not part of a full byte are done one by one, then
+      // the rest 4 bits at a time
+      int full_bytes = width / 8;
+      for (int i=width-1; i>=full_bytes*8; i--)
       {
-        *str_ptr++ = get_bit(event, i) + '0';
+        *ptr++ = ((event[i/8] >> (i%8)) & 1) + '0';
+      }
+      for (int i=full_bytes-1; i>=0; i--)
+      {
+        memcpy(ptr, vcd_nibbles[event[i] >> 4], 4);
+        memcpy(ptr + 4, vcd_nibbles[event[i] & 0xf], 4);
+        ptr += 8;
       }
-      *str_ptr = 0;
     }
     else
     {
-      for (i=0; i<width; i++)
-        str[i+1] = 'x';
+      memset(ptr, 'x', width);
+      ptr += width;
     }
 
-    fprintf(file, "%s %d\n", str, id);
+    *ptr++ = ' ';
+    memcpy(ptr, trace->code, trace->code_len);
+    ptr += trace->code_len;
+    *ptr++ = '\n';
+    this->chunk_size[this->current_chunk] += ptr - start;
   }
   else
   {
-    if (event) {
-      fprintf(file, "%u%d\n", get_bit(event, 0), id);
-    } else {
-      fprintf(file, "x%d\n", id);
+    char *ptr = this->reserve(trace->code_len + 2);
+    ptr[0] = event ? (event[0] & 1) + '0' : 'x';
+    memcpy(ptr + 1, trace->code, trace->code_len);
+    ptr[trace->code_len + 1] = '\n';
+    this->chunk_size[this->current_chunk] += trace->code_len + 2;
+  }
+}
+
+void vp::Vcd_file::dump(int64_t timestamp, int id, uint8_t *event, int width, bool is_real, bool is_string, uint8_t flags, uint8_t *flag_mask)
+{
+  Vcd_trace *trace = this->pages[id >> VCD_PAGE_BITS][id & ((1<<VCD_PAGE_BITS) - 1)];
+
+  if (!this->parallel)
+  {
+    this->encode(timestamp, trace, event, width);
+    return;
+  }
+
+  // Record: trace, timestamp, width (-1 for x), value
+  int bytes = event ? (width + 7) / 8 : 0;
+  if (this->batch_size + VCD_RECORD_HEADER + bytes > VCD_BATCH_SIZE)
+  {
+    this->submit_batch();
+  }
+
+  uint8_t *ptr = this->batch + this->batch_size;
+  *(Vcd_trace **)ptr = trace;
+  ptr += sizeof(trace);
+  *(int64_t *)ptr = timestamp;
+  ptr += sizeof(int64_t);
+  *(int32_t *)ptr = event ? width : -width - 1;
+  ptr += sizeof(int32_t);
+  memcpy(ptr, event, bytes);
+
+  this->batch_size += VCD_RECORD_HEADER + bytes;
+}
+
+void vp::Vcd_file::submit_batch()
+{
+  pthread_mutex_lock(&this->mutex);
+
+  if (this->batch_size)
+  {
+    this->ready_batches.push_back(std::pair<uint8_t *, int>(this->batch, this->batch_size));
+    pthread_cond_broadcast(&this->cond);
+
+    if (this->free_batches.size())
+    {
+      this->batch = this->free_batches.back();
+      this->free_batches.pop_back();
     }
+    else
+    {
+      this->batch = new uint8_t[VCD_BATCH_SIZE];
+    }
+    this->batch_size = 0;
   }
+
+  pthread_mutex_unlock(&this->mutex);
+}
+
+void vp::Vcd_file::encode_batch(uint8_t *batch, int size)
+{
+  uint8_t *ptr = batch;
+  uint8_t *end = batch + size;
+
+  while (ptr < end)
+  {
+    Vcd_trace *trace = *(Vcd_trace **)ptr;
+    ptr += sizeof(trace);
+    int64_t timestamp = *(int64_t *)ptr;
+    ptr += sizeof(int64_t);
+    int32_t width = *(int32_t *)ptr;
+    ptr += sizeof(int32_t);
+
+    if (width < 0)
+    {
+      this->encode(timestamp, trace, NULL, -width - 1);
+    }
+    else
+    {
+      this->encode(timestamp, trace, ptr, width);
+      ptr += (width + 7) / 8;
+    }
+  }
+}
+
+void vp::Vcd_file::worker_routine()
+{
+  pthread_mutex_lock(&this->mutex);
+
+  while(1)
+  {
+    while (this->ready_batches.size() == 0 && !this->end)
+    {
+      pthread_cond_wait(&this->cond, &this->mutex);
+    }
+
+    if (this->ready_batches.size() == 0)
+      break;
+
+    std::pair<uint8_t *, int> batch = this->ready_batches[0];
+    this->ready_batches.erase(this->ready_batches.begin());
+
+    pthread_mutex_unlock(&this->mutex);
+
+    this->encode_batch(batch.first, batch.second);
+
+    pthread_mutex_lock(&this->mutex);
+    this->free_batches.push_back(batch.first);
+  }
+
+  pthread_mutex_unlock(&this->mutex);
 }
 
 void vp::Vcd_file::close()
 {
-  fclose(file);
+  if (this->parallel)
+  {
+    this->submit_batch();
+
+    pthread_mutex_lock(&this->mutex);
+    this->end = true;
+    pthread_cond_broadcast(&this->cond);
+    pthread_mutex_unlock(&this->mutex);
+
+    this->worker->join();
+  }
+
+  // Definitions may not have been dumped yet if there was no event, they
+  // must still be closed for the file to be valid
+  if (this->header_pending)
+  {
+    this->write_data(this->header.c_str(), this->header.size());
+  }
+
+  if (!this->header_dumped)
+  {
+    this->header_dumped = true;
+    const char *str = "\n$enddefinitions $end\n$dumpvars\n$end\n";
+    this->write_data(str, strlen(str));
+  }
+
+  this->flush_chunks();
+  ::close(this->fd);
 }
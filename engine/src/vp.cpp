@@ -23,6 +23,7 @@
 #include <string>
 #include <stdio.h>
 #include <vp/vp.hpp>
+#include <vp/profiler/host_profiler.hpp>
 #include <stdio.h>
 #include "string.h"
 #include <iostream>
@@ -35,9 +36,24 @@
 
 char vp_error[VP_ERROR_SIZE];
 
+bool vp_timing_enabled = true;
+
+// Config handle given to the next component constructed without config string.
+// This is used by the native platform builder so that all components share
+// the same parsed config tree instead of parsing each its own copy.
+static js::config *next_comp_js_config = NULL;
+
 vp::component::component(const char *config_string) : traces(*this), power(*this), reset_done_from_itf(false)
 {
-  this->set_config(config_string);
+  if (config_string == NULL)
+  {
+    this->set_config(next_comp_js_config);
+    next_comp_js_config = NULL;
+  }
+  else
+  {
+    this->set_config(config_string);
+  }
 }
 
 
@@ -46,6 +62,20 @@ void vp::component::set_config(const char *config_string)
   comp_js_config = js::import_config_from_string(strdup(config_string));
 }
 
+void vp::component::set_config(js::config *config)
+{
+  comp_js_config = config;
+}
+
+// Shared by all components, as their configs are often parts of the same
+// tree, which is then indexed only once
+static vp::config_index js_config_index;
+
+js::config *vp::component::get_js_config(std::string path)
+{
+  return js_config_index.get(comp_js_config, path);
+}
+
 void vp::component::reg_step_pre_start(std::function<void()> callback)
 {
   this->pre_start_callbacks.push_back(callback);
@@ -96,6 +126,26 @@ void vp::component::reset_all(bool active, bool from_itf)
   }
 }
 
+void vp::component::fork_prepare_all()
+{
+  for (auto& x: this->childs)
+  {
+    x->fork_prepare_all();
+  }
+
+  this->fork_prepare();
+}
+
+void vp::component::fork_child_all()
+{
+  for (auto& x: this->childs)
+  {
+    x->fork_child_all();
+  }
+
+  this->fork_child();
+}
+
 void vp::component_clock::reset_sync(void *__this, bool active)
 {
   component *_this = (component *)__this;
@@ -393,6 +443,16 @@ void vp::clock_engine::flush_delayed_queue()
   }
 }
 
+void vp::clock_engine::exec_profiled(clock_event *event)
+{
+  if (event->profile_site == NULL)
+    event->profile_site = vp_host_profiler->get_site(static_cast<vp::component *>(event->comp), "event", (void *)event->meth);
+
+  vp::host_profile_node *node = vp_host_profiler->enter(event->profile_site);
+  event->meth(event->_this, event);
+  vp_host_profiler->leave(node);
+}
+
 int64_t vp::clock_engine::exec()
 {
   vp_assert(this->has_events(), NULL, "Executing clock engine while it has no event\n");
@@ -415,6 +475,7 @@ int64_t vp::clock_engine::exec()
   // Now take all events available at the current cycle and execute them all without returning
   // to the main engine to execute them faster. 
   clock_event *current = event_queue[current_cycle];
+  int nb_events = 0;
 
   while (likely(current != NULL))
   {
@@ -422,10 +483,16 @@ int64_t vp::clock_engine::exec()
     current->enqueued = false;
     nb_enqueued_to_cycle--;
 
-    current->meth(current->_this, current);
+    if (unlikely(vp_host_profiler != NULL))
+      this->exec_profiled(current);
+    else
+      current->meth(current->_this, current);
     current = event_queue[current_cycle];
+    nb_events++;
   }
 
+  this->nb_events.inc(nb_events);
+
   // Now we need to tell the time engine when is the next event.
   // The most likely is that there is an event in the circular buffer, 
   // in which case we just return the clock period, as we will go through
@@ -467,7 +534,7 @@ int64_t vp::clock_engine::exec()
 
 
 vp::clock_event::clock_event(component_clock *comp, clock_event_meth_t *meth) 
-: comp(comp), _this((void *)static_cast<vp::component *>((vp::component_clock *)(comp))), meth(meth), enqueued(false)
+: comp(comp), _this((void *)static_cast<vp::component *>((vp::component_clock *)(comp))), meth(meth), enqueued(false), profile_site(NULL)
 {
 
 }
@@ -563,193 +630,6 @@ int vp::component::get_services(int size, const char *names[], void *res_service
   return services.size();
 }
 
-std::vector<std::string> split_name(const std::string& s, char delimiter)
-{
-   std::vector<std::string> tokens;
-   std::string token;
-   std::istringstream tokenStream(s);
-   while (std::getline(tokenStream, token, delimiter))
-   {
-      tokens.push_back(token);
-   }
-   return tokens;
-}
-
-vp::config *vp::config::create_config(jsmntok_t *tokens, int *_size)
-{
-  jsmntok_t *current = tokens;
-  config *config = NULL;
-
-  switch (current->type)
-  {
-    case JSMN_PRIMITIVE:
-      if (strcmp(current->str, "True") == 0 || strcmp(current->str, "False") == 0 || strcmp(current->str, "true") == 0 || strcmp(current->str, "false") == 0)
-      {
-        config = new config_bool(current);
-      }
-      else
-      {
-        config = new config_number(current);
-      }
-      current++;
-      break;
-
-    case JSMN_OBJECT: {
-      int size;
-      config = new config_object(current, &size);
-      current += size;
-      break;
-    }
-
-    case JSMN_ARRAY: {
-      int size;
-      config = new config_array(current, &size);
-      current += size;
-      break;
-    }
-
-    case JSMN_STRING:
-      config = new config_string(current);
-      current++;
-      break;
-
-    case JSMN_UNDEFINED:
-      break;
-  }
-
-  if (_size) {
-    *_size = current - tokens;
-  }
-
-  return config;
-}
-
-vp::config *vp::config_string::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
-vp::config *vp::config_number::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
-vp::config *vp::config_bool::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
-vp::config *vp::config_array::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-  return NULL;
-}
-
-vp::config *vp::config_object::get_from_list(std::vector<std::string> name_list)
-{
-  if (name_list.size() == 0) return this;
-
-  vp::config *result = NULL;
-  std::string name;
-  int name_pos = 0;
-
-  for (auto& x: name_list) {
-    if (x != "*" && x != "**")
-    {
-      name = x;
-      break;
-    }
-    name_pos++;
-  }
-
-  for (auto& x: childs) {
-
-    if (name == x.first)
-    {
-      result = x.second->get_from_list(std::vector<std::string>(name_list.begin () + name_pos + 1, name_list.begin () + name_list.size()));
-      if (name_pos == 0 || result != NULL) return result;
-
-    }
-    else if (name_list[0] == "*")
-    {
-      result = x.second->get_from_list(std::vector<std::string>(name_list.begin () + 1, name_list.begin () + name_list.size()));
-      if (result != NULL) return result;
-    }
-    else if (name_list[0] == "**")
-    {
-      result = x.second->get_from_list(name_list);
-      if (result != NULL) return result;
-    }
-  }
-
-  return result;
-}
-
-vp::config *vp::config_object::get(std::string name)
-{
-  return get_from_list(split_name(name, '/'));
-}
-
-vp::config_string::config_string(jsmntok_t *tokens)
-{
-  value = tokens->str;
-}
-
-vp::config_number::config_number(jsmntok_t *tokens)
-{
-  value = atof(tokens->str);
-}
-
-vp::config_bool::config_bool(jsmntok_t *tokens)
-{
-  value = strcmp(tokens->str, "True") == 0 || strcmp(tokens->str, "true") == 0;
-}
-
-vp::config_array::config_array(jsmntok_t *tokens, int *_size)
-{
-  jsmntok_t *current = tokens;
-  jsmntok_t *top = current++;
-  
-  for (int i=0; i<top->size; i++)
-  {
-    int child_size;
-    elems.push_back(create_config(current, &child_size));
-    current += child_size;
-  }
-
-
-  if (_size) {
-    *_size = current - tokens;
-  }
-}
-
-vp::config_object::config_object(jsmntok_t *tokens, int *_size)
-{
-  jsmntok_t *current = tokens;
-  jsmntok_t *t = current++;
-
-  for (int i=0; i<t->size; i++)
-  {
-    jsmntok_t *child_name = current++;
-    int child_size;
-    config *child_config = create_config(current, &child_size);
-    current += child_size;
-
-    if (child_config != NULL)
-    {
-      childs[child_name->str] = child_config;
-
-    }
-  }
-
-  if (_size) {
-    *_size = current - tokens;
-  }
-}
-
 vp::config *vp::component::import_config(const char *config_string)
 {
   if (config_string == NULL) return NULL;
@@ -959,6 +839,16 @@ extern "C" void vp_comp_set_config(void *comp, const char *config)
   ((vp::component *)comp)->set_config(config);
 }
 
+extern "C" void vp_comp_set_next_config_handle(void *config)
+{
+  next_comp_js_config = (js::config *)config;
+}
+
+extern "C" void vp_comp_set_config_handle(void *comp, void *config)
+{
+  ((vp::component *)comp)->set_config((js::config *)config);
+}
+
 extern "C" void vp_comp_conf(void *comp, const char *path, void *parent)
 {
   ((vp::component *)comp)->conf(path, (vp::component *)parent);
@@ -984,6 +874,21 @@ extern "C" void vp_reset(void *comp, int active)
   ((vp::component *)comp)->reset_all(active);
 }
 
+extern "C" void vp_fork_prepare(void *comp)
+{
+  ((vp::component *)comp)->fork_prepare_all();
+}
+
+extern "C" void vp_fork_child(void *comp)
+{
+  ((vp::component *)comp)->fork_child_all();
+}
+
+extern "C" void vp_set_timing(int timing)
+{
+  vp_timing_enabled = timing;
+}
+
 extern "C" void vp_stop(void *comp)
 {
   ((vp::component *)comp)->stop();
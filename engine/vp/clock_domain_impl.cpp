@@ -34,6 +34,8 @@ public:
 
   void pre_start();
 
+  void start();
+
 
 private:
 
@@ -79,6 +81,13 @@ void clock_domain::pre_start()
   out.reg(this);
 }
 
+void clock_domain::start()
+{
+  vp::telemetry_engine *telemetry = (vp::telemetry_engine *)this->get_service("telemetry");
+  if (telemetry)
+    telemetry->reg_counter(this->get_path(), "clock_events", &this->nb_events);
+}
+
 
 vp::clock_engine::clock_engine(const char *config)
   : vp::time_engine_client(config), cycles(0), period(0), freq(0), must_flush_delayed_queue(true)
@@ -20,10 +20,12 @@
 
 #include <vp/vp.hpp>
 #include <vp/power/power_engine.hpp>
+#include <vp/power/power_record.hpp>
 #include <regex.h>
 #include <vector>
 #include <thread>
 #include <string.h>
+#include <zlib.h>
 
 
 class power_manager : public vp::power_engine
@@ -34,22 +36,70 @@ public:
 
   int build();
 
+  void start();
+
+  void stop();
+
+  void sample();
+
   void start_capture();
 
   void stop_capture();
 
   void reg_trace(vp::power_trace *trace);
 
+  void reg_source(vp::power_source *source);
+
 private:
   std::vector<vp::power_trace *> traces;
+  std::vector<vp::power_source *> sources;
+
+  // Records the activity of the sources during the captures, NULL if not
+  // enabled
+  vp::power_recorder *recorder = NULL;
+
+  void profile_dump(int64_t end, int64_t duration);
+
+  // Power profile, where the power of each trace is written for each bin of
+  // a fixed duration, NULL if not enabled
+  gzFile profile = NULL;
+  int64_t profile_period;
+  // Energy of each trace at the end of the last bin
+  std::vector<double> profile_energy;
+  // Energy of each trace in the current bin, accounted before the traces
+  // were cleared by a capture
+  std::vector<double> profile_carry;
 };
 
 void power_manager::start_capture()
 {
+  // Clearing the traces resets their energy, keep what the current bin of
+  // the profile already got
+  if (this->profile)
+  {
+    this->sample();
+
+    for (unsigned int i=0; i<this->traces.size(); i++)
+    {
+      this->profile_carry[i] += this->traces[i]->get_energy(this->get_time()) - this->profile_energy[i];
+    }
+  }
+
   for (auto trace: this->traces)
   {
     trace->clear();
   }
+
+  if (this->profile)
+  {
+    for (unsigned int i=0; i<this->traces.size(); i++)
+    {
+      this->profile_energy[i] = this->traces[i]->get_energy(this->get_time());
+    }
+  }
+
+  if (this->recorder)
+    this->recorder->start_capture(this->get_time(), this->traces, this->sources);
 }
 
 void power_manager::stop_capture()
@@ -68,6 +118,9 @@ void power_manager::stop_capture()
     if (!trace->is_dumped())
       trace->get_top_trace()->dump(file);
   }
+
+  if (this->recorder)
+    this->recorder->stop_capture(this->get_time(), this->traces, this->sources);
 }
 
 void power_manager::reg_trace(vp::power_trace *trace)
@@ -75,6 +128,43 @@ void power_manager::reg_trace(vp::power_trace *trace)
   this->traces.push_back(trace);
 }
 
+void power_manager::reg_source(vp::power_source *source)
+{
+  this->sources.push_back(source);
+}
+
+void power_manager::sample()
+{
+  int64_t time = this->get_time();
+
+  // Close all the bins which ended. The traces did not change since the end
+  // of the first one, so their energy at the end of each bin is known.
+  while (time >= this->sample_time)
+  {
+    this->profile_dump(this->sample_time, this->profile_period);
+    this->sample_time += this->profile_period;
+  }
+}
+
+void power_manager::profile_dump(int64_t end, int64_t duration)
+{
+  char value[32];
+  snprintf(value, sizeof(value), "%ld", end - duration);
+  std::string line = value;
+
+  for (unsigned int i=0; i<this->traces.size(); i++)
+  {
+    double energy = this->traces[i]->get_energy(end);
+    snprintf(value, sizeof(value), ",%.9g", (energy - this->profile_energy[i] + this->profile_carry[i]) / duration);
+    line += value;
+    this->profile_energy[i] = energy;
+    this->profile_carry[i] = 0;
+  }
+
+  line += "\n";
+  gzwrite(this->profile, line.c_str(), line.size());
+}
+
 
 vp::power_engine::power_engine(const char *config)
   : vp::component(config)
@@ -90,9 +180,89 @@ power_manager::power_manager(const char *config)
 
 int power_manager::build()
 {
+  // Path of the power record, where the activity of the power sources is
+  // written so that the report can be computed offline for other operating
+  // points
+  js::config *item_conf = this->get_js_config("**/gvsoc/power_record");
+  if (item_conf != NULL && item_conf->get_str() != "")
+  {
+    // Length in ps of the windows in which the activity is accounted, 0 to
+    // have a single window per capture
+    int64_t window_length = 0;
+    js::config *window_conf = this->get_js_config("**/gvsoc/power_record_window");
+    if (window_conf != NULL)
+      window_length = window_conf->get_int();
+
+    this->recorder = new vp::power_recorder();
+    if (this->recorder->open(item_conf->get_str(), window_length))
+      return -1;
+  }
+
+  // Path of the power profile, a compressed CSV file with the power of each
+  // trace over time, and duration in ps of each of its bins
+  item_conf = this->get_js_config("**/gvsoc/power_profile");
+  if (item_conf != NULL && item_conf->get_str() != "")
+  {
+    this->profile_period = 1000000;
+    js::config *period_conf = this->get_js_config("**/gvsoc/power_profile_period");
+    if (period_conf != NULL)
+      this->profile_period = period_conf->get_int();
+
+    if (this->profile_period <= 0)
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Invalid power profile period (period: %ld)", this->profile_period);
+      return -1;
+    }
+
+    this->profile = gzopen(item_conf->get_str().c_str(), "wb");
+    if (this->profile == NULL)
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Failed to open power profile (path: %s)", item_conf->get_str().c_str());
+      return -1;
+    }
+  }
+
   return 0;
 }
 
+void power_manager::start()
+{
+  if (this->profile)
+  {
+    std::string header = "Time (ps)";
+    for (auto trace: this->traces)
+    {
+      header += "," + trace->trace.get_name();
+    }
+    header += "\n";
+    gzwrite(this->profile, header.c_str(), header.size());
+
+    this->profile_energy.assign(this->traces.size(), 0);
+    this->profile_carry.assign(this->traces.size(), 0);
+    this->sample_time = this->get_time() + this->profile_period;
+  }
+}
+
+void power_manager::stop()
+{
+  if (this->recorder)
+    this->recorder->close();
+
+  if (this->profile)
+  {
+    // The last bin is only partially simulated
+    this->sample();
+
+    int64_t bin_start = this->sample_time - this->profile_period;
+    if (this->get_time() > bin_start)
+      this->profile_dump(this->get_time(), this->get_time() - bin_start);
+
+    this->sample_time = INT64_MAX;
+    gzclose(this->profile);
+    this->profile = NULL;
+  }
+}
+
 extern "C" void *vp_constructor(const char *config)
 {
   void *engine = (void *)new power_manager(config);
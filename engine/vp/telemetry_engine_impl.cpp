@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/telemetry/telemetry_engine.hpp>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+class telemetry_entry
+{
+public:
+  std::string name;
+  vp::telemetry_counter *counter;
+  vp::telemetry_kind_e kind;
+  double scale;
+  // Value of the counter at the previous sample, for rates
+  int64_t last;
+};
+
+
+// Samples the counters from its own thread, and publishes each sample as a
+// line of JSON, to a file which is rolled when it gets too big and to the
+// clients connected to a Unix socket.
+// The simulation thread only updates its counters and never waits for the
+// telemetry thread, except when counters are registered.
+class telemetry_manager : public vp::telemetry_engine
+{
+public:
+
+  telemetry_manager(const char *config);
+
+  int build();
+
+  void start();
+
+  void stop();
+
+  void fork_prepare();
+
+  void fork_child();
+
+  void reg_counter(std::string path, std::string name, vp::telemetry_counter *counter,
+    vp::telemetry_kind_e kind, double scale);
+
+private:
+
+  int open_file();
+  int open_socket();
+  void start_thread();
+  void stop_thread();
+  void sample(double elapsed, double duration);
+  void publish(std::string &line);
+  void routine();
+  static void *routine_stub(void *arg);
+  int64_t get_rss();
+
+  bool active = false;
+  // Sampling interval in ms
+  int64_t interval;
+
+  std::string file_path;
+  FILE *file = NULL;
+  // The file is moved to <path>.1 when it exceeds this size in bytes
+  int64_t file_size;
+
+  std::string socket_path;
+  int socket_fd = -1;
+  std::vector<int> clients;
+
+  std::vector<telemetry_entry *> entries;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool running = false;
+  bool end = false;
+  // Set when the thread was stopped to fork the platform
+  bool forked = false;
+};
+
+
+static double get_host_time()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+vp::telemetry_engine::telemetry_engine(const char *config)
+  : vp::component(config)
+{
+  new_service("telemetry", static_cast<telemetry_engine *>(this));
+}
+
+telemetry_manager::telemetry_manager(const char *config)
+: vp::telemetry_engine(config)
+{
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+}
+
+void telemetry_manager::reg_counter(std::string path, std::string name, vp::telemetry_counter *counter,
+  vp::telemetry_kind_e kind, double scale)
+{
+  if (!this->active)
+    return;
+
+  telemetry_entry *entry = new telemetry_entry();
+  entry->name = path == "" ? name : path + "/" + name;
+  entry->counter = counter;
+  entry->kind = kind;
+  entry->scale = scale;
+  entry->last = counter->get();
+
+  pthread_mutex_lock(&this->mutex);
+  this->entries.push_back(entry);
+  pthread_mutex_unlock(&this->mutex);
+}
+
+int telemetry_manager::open_file()
+{
+  this->file = fopen(this->file_path.c_str(), "w");
+  if (this->file == NULL)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Failed to open telemetry file (path: %s, error: %s)", this->file_path.c_str(), strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int telemetry_manager::open_socket()
+{
+  struct sockaddr_un addr;
+
+  if (this->socket_path.size() >= sizeof(addr.sun_path))
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Telemetry socket path is too long (path: %s)", this->socket_path.c_str());
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, this->socket_path.c_str());
+
+  // A socket left by a previous run would make the bind fail
+  unlink(this->socket_path.c_str());
+
+  this->socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (this->socket_fd < 0 || bind(this->socket_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+    listen(this->socket_fd, 8) < 0)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Failed to open telemetry socket (path: %s, error: %s)", this->socket_path.c_str(), strerror(errno));
+    if (this->socket_fd >= 0)
+      close(this->socket_fd);
+    this->socket_fd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+int telemetry_manager::build()
+{
+  js::config *config = this->get_js_config("**/gvsoc/telemetry/file");
+  if (config != NULL)
+    this->file_path = config->get_str();
+
+  config = this->get_js_config("**/gvsoc/telemetry/socket");
+  if (config != NULL)
+    this->socket_path = config->get_str();
+
+  this->active = this->file_path != "" || this->socket_path != "";
+  if (!this->active)
+    return 0;
+
+  this->interval = 1000;
+  config = this->get_js_config("**/gvsoc/telemetry/interval");
+  if (config != NULL)
+    this->interval = config->get_int();
+
+  if (this->interval <= 0)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Invalid telemetry interval (interval: %ld)", this->interval);
+    return -1;
+  }
+
+  this->file_size = 16 * 1024 * 1024;
+  config = this->get_js_config("**/gvsoc/telemetry/file_size");
+  if (config != NULL)
+    this->file_size = config->get_int();
+
+  if (this->file_path != "" && this->open_file())
+    return -1;
+
+  if (this->socket_path != "" && this->open_socket())
+    return -1;
+
+  return 0;
+}
+
+void telemetry_manager::start()
+{
+  if (this->active)
+    this->start_thread();
+}
+
+void telemetry_manager::start_thread()
+{
+  this->end = false;
+  this->running = true;
+  pthread_create(&this->thread, NULL, telemetry_manager::routine_stub, (void *)this);
+}
+
+void telemetry_manager::stop_thread()
+{
+  pthread_mutex_lock(&this->mutex);
+  this->end = true;
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->mutex);
+  pthread_join(this->thread, NULL);
+  this->running = false;
+}
+
+void telemetry_manager::stop()
+{
+  if (this->running)
+    this->stop_thread();
+  else if (!this->forked)
+    return;
+
+  if (this->file)
+    fclose(this->file);
+  this->file = NULL;
+
+  for (int client: this->clients)
+  {
+    close(client);
+  }
+  this->clients.clear();
+
+  if (this->socket_fd >= 0)
+  {
+    close(this->socket_fd);
+    unlink(this->socket_path.c_str());
+    this->socket_fd = -1;
+  }
+}
+
+void telemetry_manager::fork_prepare()
+{
+  // The thread is stopped so that it does not hold any lock, e.g. of the
+  // file, while the platform is forked. The parent does not run the
+  // platform anymore, so only the children start it again.
+  if (this->running)
+  {
+    this->stop_thread();
+    this->forked = true;
+  }
+}
+
+void telemetry_manager::fork_child()
+{
+  if (!this->forked)
+    return;
+
+  // The telemetry thread does not exist in the child. Each forked platform
+  // publishes to its own file and socket, relative to its working directory,
+  // the parent ones are left to the parent.
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+
+  for (int client: this->clients)
+  {
+    close(client);
+  }
+  this->clients.clear();
+
+  if (this->file && freopen(this->file_path.c_str(), "w", this->file) == NULL)
+    throw std::logic_error("Unable to open file: " + this->file_path);
+
+  if (this->socket_fd >= 0)
+  {
+    close(this->socket_fd);
+    this->socket_fd = -1;
+    if (this->open_socket())
+    {
+      vp_warning_always(&this->warning, "%s\n", vp_error);
+    }
+  }
+
+  for (auto entry: this->entries)
+  {
+    entry->last = entry->counter->get();
+  }
+
+  this->start_thread();
+}
+
+int64_t telemetry_manager::get_rss()
+{
+  // Second field is the number of resident pages
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file == NULL)
+    return -1;
+
+  long size, resident;
+  int result = fscanf(file, "%ld %ld", &size, &resident);
+  fclose(file);
+
+  return result == 2 ? (int64_t)resident * sysconf(_SC_PAGESIZE) : -1;
+}
+
+void telemetry_manager::publish(std::string &line)
+{
+  if (this->file)
+  {
+    fwrite(line.c_str(), 1, line.size(), this->file);
+    fflush(this->file);
+
+    if (this->file_size > 0 && ftell(this->file) >= this->file_size)
+    {
+      std::string rolled_path = this->file_path + ".1";
+      fclose(this->file);
+      rename(this->file_path.c_str(), rolled_path.c_str());
+      this->file = fopen(this->file_path.c_str(), "w");
+    }
+  }
+
+  if (this->socket_fd >= 0)
+  {
+    int client;
+    while ((client = accept4(this->socket_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+      this->clients.push_back(client);
+    }
+
+    // Clients which are not reading fast enough are dropped, as a partial
+    // line can not be sent
+    for (auto it = this->clients.begin(); it != this->clients.end();)
+    {
+      if (send(*it, line.c_str(), line.size(), MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)line.size())
+      {
+        close(*it);
+        it = this->clients.erase(it);
+      }
+      else
+      {
+        it++;
+      }
+    }
+  }
+}
+
+void telemetry_manager::sample(double elapsed, double duration)
+{
+  char buffer[64];
+  std::string line;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  snprintf(buffer, sizeof(buffer), "{\"time\": %ld.%03ld", (long)ts.tv_sec, ts.tv_nsec / 1000000);
+  line += buffer;
+  snprintf(buffer, sizeof(buffer), ", \"elapsed\": %.3f", elapsed);
+  line += buffer;
+  snprintf(buffer, sizeof(buffer), ", \"rss\": %ld", this->get_rss());
+  line += buffer;
+
+  for (auto entry: this->entries)
+  {
+    int64_t value = entry->counter->get();
+    double result;
+
+    if (entry->kind == vp::TELEMETRY_RATE)
+    {
+      result = (value - entry->last) * entry->scale / duration;
+      entry->last = value;
+    }
+    else
+    {
+      result = value * entry->scale;
+    }
+
+    snprintf(buffer, sizeof(buffer), "%.6g", result);
+    line += ", \"" + entry->name + "\": " + buffer;
+  }
+
+  line += "}\n";
+
+  this->publish(line);
+}
+
+void telemetry_manager::routine()
+{
+  double start_time = get_host_time();
+  double last_time = start_time;
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+
+  pthread_mutex_lock(&this->mutex);
+
+  while (!this->end)
+  {
+    // Deadlines are absolute so that the samples do not drift
+    deadline.tv_sec += this->interval / 1000;
+    deadline.tv_nsec += (this->interval % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+    while (!this->end && pthread_cond_timedwait(&this->cond, &this->mutex, &deadline) != ETIMEDOUT);
+
+    if (this->end)
+      break;
+
+    double time = get_host_time();
+    this->sample(time - start_time, time - last_time);
+    last_time = time;
+  }
+
+  pthread_mutex_unlock(&this->mutex);
+}
+
+void *telemetry_manager::routine_stub(void *arg)
+{
+  ((telemetry_manager *)arg)->routine();
+  return NULL;
+}
+
+
+extern "C" void *vp_constructor(const char *config)
+{
+  return (void *)new telemetry_manager(config);
+}
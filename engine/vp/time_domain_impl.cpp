@@ -20,6 +20,7 @@
 
 #include <vp/vp.hpp>
 #include "vp/time/time_engine.hpp"
+#include "vp/profiler/host_profiler.hpp"
 #include <pthread.h>
 #include <signal.h>
 
@@ -156,7 +157,29 @@ string vp::time_engine::run()
     pthread_cond_wait(&cond, &mutex);    
   }
 
-  if (finished) return "finished";
+  if (finished)
+  {
+    pthread_mutex_unlock(&mutex);
+    return "finished";
+  }
+
+  // In case the engine paused itself, e.g. to fork the platform, wait until
+  // it is idle, so that its state is stable, and let the caller decide when
+  // to run it again.
+  if (pause_req)
+  {
+    pause_req = false;
+    stop_req = false;
+
+    while (running)
+    {
+      pthread_cond_wait(&cond, &mutex);
+    }
+
+    pthread_mutex_unlock(&mutex);
+
+    return "paused";
+  }
 
   // In case we get a stop request, first try to kindly stop the engine.
   // Then if it is still running after 100ms, we kill it. This can happen
@@ -188,6 +211,9 @@ string vp::time_engine::run()
         result = "killed";
       }
     }
+
+    // The request has been handled, so that run() can be called again
+    stop_req = false;
   }
 
   pthread_mutex_unlock(&mutex);
@@ -198,7 +224,7 @@ string vp::time_engine::run()
 void vp::time_engine::start()
 {
 
-  js::config *item_conf = this->get_js_config()->get("**/gvsoc/no_exit");
+  js::config *item_conf = this->get_js_config("**/gvsoc/no_exit");
   this->no_exit = item_conf != NULL && item_conf->get_bool();
 
   if (this->no_exit)
@@ -207,6 +233,48 @@ void vp::time_engine::start()
     // from exiting in case there is no more events.
     retain_count++;
   }
+
+  // Time in ps at which the engine is paused, e.g. to fork the platform
+  item_conf = this->get_js_config("**/gvsoc/pause_time");
+  if (item_conf != NULL)
+    this->pause_time = item_conf->get_int();
+
+  // Functional mode, models skip timings until something switches the
+  // platform to timed mode
+  item_conf = this->get_js_config("**/gvsoc/functional");
+  if (item_conf != NULL && item_conf->get_bool())
+    vp_timing_enabled = false;
+
+  // Host profile, written at the end of the simulation to files whose names
+  // are the given prefix followed by their extension. This must be enabled
+  // before the ports are finalized, as they are setting up their profiling
+  // stubs at this time.
+  item_conf = this->get_js_config("**/gvsoc/host_profile");
+  if (item_conf != NULL && item_conf->get_str() != "")
+    vp_host_profiler = new vp::host_profiler(item_conf->get_str());
+
+  pthread_create(&run_thread, NULL, engine_routine, (void *)this);
+}
+
+void vp::time_engine::stop()
+{
+  if (vp_host_profiler)
+    vp_host_profiler->dump();
+}
+
+void vp::time_engine::fork_child()
+{
+  // The engine thread does not exist in the child, create it again as it is
+  // done in start(). The synchronization objects are reinitialized as the
+  // parent may have forked while another thread was holding them.
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&cond, NULL);
+  pthread_mutex_lock(&mutex);
+
+  running = false;
+  // Also forces the creation of the sigint thread
+  init = false;
+
   pthread_create(&run_thread, NULL, engine_routine, (void *)this);
 }
 
@@ -344,6 +412,12 @@ void vp::time_engine::run_loop()
     
         int64_t time = current->exec();
 
+        if (unlikely(this->time >= this->pause_time))
+        {
+          this->pause_time = INT64_MAX;
+          this->pause();
+        }
+
         time_engine_client *next = first_client;
 
         // Shortcut to quickly continue with the same client
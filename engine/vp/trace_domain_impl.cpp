@@ -21,11 +21,29 @@
 #include <vp/vp.hpp>
 #include <vp/itf/clk.hpp>
 #include <vp/trace/trace_engine.hpp>
+#include <vp/time/time_engine.hpp>
 #include <regex.h>
 #include <vector>
 #include <thread>
 #include <string.h>
 
+
+// Set of traces and events which are only active between the opening and
+// closing triggers of the window
+class trace_window
+{
+public:
+  std::string name;
+  bool is_open = false;
+  std::vector<regex_t *> path_regex;
+  std::vector<std::string> path_regex_file;
+  std::vector<regex_t *> events_path_regex;
+  std::string events_file;
+  std::vector<vp::trace *> traces;
+  std::vector<vp::trace *> events;
+};
+
+
 class trace_domain : public vp::trace_engine
 {
 
@@ -40,6 +58,7 @@ public:
 
   int build();
   void start();
+  void fork_child();
 
   int get_max_path_len() { return max_path_len; }
 
@@ -50,8 +69,21 @@ public:
 
   int get_trace_level() { return this->trace_level; }
 
+  int get_window(std::string name);
+  void set_window(int window, bool open);
+  int add_trigger(std::string window, bool open, vp::trace_trigger_type_e type, uint64_t value, std::string symbol="");
+  std::vector<vp::trace_trigger *> &get_triggers() { return this->triggers; }
+  void reg_window_listener(std::function<void()> callback) { this->window_listeners.push_back(callback); }
+
 private:
 
+  FILE *get_trace_file(std::string file_path);
+  vp::Event_trace *get_event_trace(vp::trace *trace, std::string path, std::string file);
+  bool window_reg_trace(trace_window *window, vp::trace *trace, int event, std::string full_path);
+  int parse_windows(js::config *config);
+  int parse_triggers(std::string window, bool open, js::config *config);
+  void check_idle();
+
   std::vector<regex_t *> path_regex;
   std::vector<std::string> path_regex_file;
   std::vector<regex_t *> events_path_regex;
@@ -60,9 +92,21 @@ private:
   vp::trace_level_e trace_level = vp::TRACE;
   std::vector<vp::trace *> init_traces;
   std::map<std::string, FILE *> trace_files;
+  std::vector<trace_window *> windows;
+  std::vector<vp::trace_trigger *> triggers;
+  std::vector<std::function<void()>> window_listeners;
 };
 
 
+static uint64_t get_trigger_value(js::config *config)
+{
+  std::string str = config->get_str();
+  if (str != "")
+    return strtoull(str.c_str(), NULL, 0);
+  return config->get_int();
+}
+
+
 vp::trace_engine::trace_engine(const char *config)
   : event_dumper(this), vp::component(config), first_trace_to_dump(NULL)
 {
@@ -77,6 +121,7 @@ vp::trace_engine::trace_engine(const char *config)
   current_buffer = event_buffers[0];
   event_buffers.erase(event_buffers.begin());
   current_buffer_size = 0;
+  this->nb_busy_buffers.set(1);
   this->first_pending_event = NULL;
 
   thread = new std::thread(&trace_engine::vcd_routine, this);
@@ -116,46 +161,250 @@ void trace_domain::reg_trace(vp::trace *trace, int event, string path, string na
     {
       if (event)
       {
-        vp::Event_trace *event_trace;
-        if (trace->is_real)
-          event_trace = event_dumper.get_trace_real(full_path, this->events_file[index]);
-        else if (trace->is_string)
-          event_trace = event_dumper.get_trace_string(full_path, this->events_file[index]);
-        else
-          event_trace = event_dumper.get_trace(full_path, this->events_file[index], trace->width);
         trace->set_event_active(true);
-        trace->event_trace = event_trace;
+        trace->event_trace = this->get_event_trace(trace, full_path, this->events_file[index]);
       }
       else
       {
-        std::string file_path = path_regex_file[index];
-        if (file_path == "")
-        {
-          trace->trace_file = stdout;
-        }
-        else
-        {
-          if (this->trace_files[file_path] == NULL)
-          {
-            FILE *file = fopen(file_path.c_str(), "w");
-            if (file == NULL)
-              throw std::logic_error("Unable to open file: " + file_path);
-            this->trace_files[file_path] = file;
-          }
-          trace->trace_file = this->trace_files[file_path];
-        }
+        trace->trace_file = this->get_trace_file(path_regex_file[index]);
         trace->set_active(true);
       }
     }
     index++;
   }
+
+  // Traces enabled for the whole simulation are not controlled by windows
+  if (event ? trace->event_trace != NULL : trace->is_active)
+    return;
+
+  for (auto window: this->windows)
+  {
+    if (this->window_reg_trace(window, trace, event, full_path))
+      break;
+  }
+}
+
+vp::Event_trace *trace_domain::get_event_trace(vp::trace *trace, std::string path, std::string file)
+{
+  if (trace->is_real)
+    return event_dumper.get_trace_real(path, file);
+  else if (trace->is_string)
+    return event_dumper.get_trace_string(path, file);
+  else
+    return event_dumper.get_trace(path, file, trace->width);
+}
+
+FILE *trace_domain::get_trace_file(std::string file_path)
+{
+  if (file_path == "")
+    return stdout;
+
+  if (this->trace_files[file_path] == NULL)
+  {
+    FILE *file = fopen(file_path.c_str(), "w");
+    if (file == NULL)
+      throw std::logic_error("Unable to open file: " + file_path);
+    this->trace_files[file_path] = file;
+  }
+  return this->trace_files[file_path];
+}
+
+bool trace_domain::window_reg_trace(trace_window *window, vp::trace *trace, int event, std::string full_path)
+{
+  int index = 0;
+  for (auto& x: event ? window->events_path_regex : window->path_regex)
+  {
+    if (regexec(x, full_path.c_str(), 0, NULL, 0) == 0)
+    {
+      if (event)
+      {
+        trace->event_trace = this->get_event_trace(trace, full_path, window->events_file);
+        trace->set_event_active(window->is_open);
+        window->events.push_back(trace);
+      }
+      else
+      {
+        trace->trace_file = this->get_trace_file(window->path_regex_file[index]);
+        trace->set_active(window->is_open);
+        window->traces.push_back(trace);
+      }
+      return true;
+    }
+    index++;
+  }
+  return false;
+}
+
+int trace_domain::get_window(std::string name)
+{
+  for (unsigned int i=0; i<this->windows.size(); i++)
+  {
+    if (this->windows[i]->name == name)
+      return i;
+  }
+  return -1;
+}
+
+void trace_domain::set_window(int id, bool open)
+{
+  trace_window *window = this->windows[id];
+
+  if (window->is_open == open)
+    return;
+
+  window->is_open = open;
+
+  for (auto x: window->traces)
+  {
+    x->set_active(open);
+  }
+
+  for (auto x: window->events)
+  {
+    x->set_event_active(open);
+  }
+
+  this->check_idle();
+
+  for (auto &x: this->window_listeners)
+  {
+    x();
+  }
+}
+
+int trace_domain::add_trigger(std::string window, bool open, vp::trace_trigger_type_e type, uint64_t value, std::string symbol)
+{
+  int id = this->get_window(window);
+  if (id == -1)
+    return -1;
+
+  vp::trace_trigger *trigger = new vp::trace_trigger();
+  trigger->window = id;
+  trigger->open = open;
+  trigger->type = type;
+  trigger->value = value;
+  trigger->symbol = symbol;
+  this->triggers.push_back(trigger);
+
+  for (auto &x: this->window_listeners)
+  {
+    x();
+  }
+
+  return 0;
+}
+
+int trace_domain::parse_triggers(std::string window, bool open, js::config *config)
+{
+  if (config == NULL)
+    return 0;
+
+  for (auto trigger: config->get_elems())
+  {
+    for (auto x: trigger->get_childs())
+    {
+      if (x.first == "pc")
+        this->add_trigger(window, open, vp::TRACE_TRIGGER_PC, get_trigger_value(x.second));
+      else if (x.first == "symbol")
+        this->add_trigger(window, open, vp::TRACE_TRIGGER_SYMBOL, 0, x.second->get_str());
+      else if (x.first == "addr")
+        this->add_trigger(window, open, vp::TRACE_TRIGGER_ADDR, get_trigger_value(x.second));
+      else if (x.first == "magic")
+        this->add_trigger(window, open, vp::TRACE_TRIGGER_MAGIC, get_trigger_value(x.second));
+      else if (x.first == "cycles")
+        this->add_trigger(window, open, vp::TRACE_TRIGGER_CYCLES, get_trigger_value(x.second));
+      else
+      {
+        snprintf(vp_error, VP_ERROR_SIZE, "Unknown trace trigger (window: %s, trigger: %s)", window.c_str(), x.first.c_str());
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int trace_domain::parse_windows(js::config *config)
+{
+  if (config == NULL)
+    return 0;
+
+  for (auto x: config->get_childs())
+  {
+    trace_window *window = new trace_window();
+    window->name = x.first;
+    window->events_file = "all.vcd";
+    this->windows.push_back(window);
+
+    js::config *traces = x.second->get("traces");
+    if (traces != NULL)
+    {
+      for (auto trace: traces->get_elems())
+      {
+        std::string path = trace->get_str();
+        std::string file_path = "";
+        size_t sep = path.find(':');
+        if (sep != std::string::npos)
+        {
+          file_path = path.substr(sep + 1);
+          path = path.substr(0, sep);
+        }
+        regex_t *regex = new regex_t();
+        regcomp(regex, path.c_str(), 0);
+        window->path_regex.push_back(regex);
+        window->path_regex_file.push_back(file_path);
+      }
+    }
+
+    js::config *events = x.second->get("events");
+    if (events != NULL)
+    {
+      for (auto event: events->get_elems())
+      {
+        regex_t *regex = new regex_t();
+        regcomp(regex, event->get_str().c_str(), 0);
+        window->events_path_regex.push_back(regex);
+      }
+    }
+
+    js::config *events_file = x.second->get("events_file");
+    if (events_file != NULL)
+      window->events_file = events_file->get_str();
+
+    if (this->parse_triggers(x.first, true, x.second->get("start")))
+      return -1;
+    if (this->parse_triggers(x.first, false, x.second->get("stop")))
+      return -1;
+  }
+
+  return 0;
+}
+
+void trace_domain::check_idle()
+{
+  bool idle = this->windows.size() != 0 && this->path_regex.size() == 0 && this->events_path_regex.size() == 0;
+  bool msg_traces = this->path_regex.size() != 0;
+
+  for (auto x: this->windows)
+  {
+    if (x->is_open)
+    {
+      idle = false;
+      if (x->path_regex.size() != 0)
+        msg_traces = true;
+    }
+  }
+
+  this->msg_traces = msg_traces;
+
+  this->idle = idle;
 }
 
 int trace_domain::build()
 {
   new_service("trace", static_cast<trace_engine *>(this));
 
-  auto vcd_traces = get_js_config()->get("vcd/traces");
+  auto vcd_traces = get_js_config("vcd/traces");
 
   if (vcd_traces != NULL)
   {
@@ -178,6 +427,23 @@ int trace_domain::build()
     }
   }
 
+  if (this->parse_windows(get_js_config("trace_windows")))
+    return -1;
+
+  // Trace messages are formatted and written by a logging thread, or
+  // written to a binary log to be decoded later
+  js::config *config = get_js_config("trace_log");
+  std::string log_path = config != NULL ? config->get_str() : "";
+  config = get_js_config("trace_deferred");
+  if (log_path != "" || (config != NULL && config->get_bool()))
+  {
+    this->log = new vp::trace_log();
+    if (this->log->open(log_path))
+      return -1;
+  }
+
+  this->check_idle();
+
   return 0;
 }
 
@@ -187,6 +453,10 @@ void trace_domain::start()
   {
     x->event(NULL);
   }
+
+  vp::telemetry_engine *telemetry = (vp::telemetry_engine *)this->get_service("telemetry");
+  if (telemetry)
+    telemetry->reg_counter("trace", "event_buffers", &this->nb_busy_buffers, vp::TELEMETRY_LEVEL);
 }
 
 void trace_domain::add_path(int events, const char *path)
@@ -221,6 +491,8 @@ void trace_domain::add_path(int events, const char *path)
   }
 
   regcomp(regex, path, 0);
+
+  this->check_idle();
 }
 
 void trace_domain::add_paths(int events, int nb_path, const char **paths)
@@ -255,6 +527,19 @@ void trace_domain::set_trace_level(const char *trace_level)
   }
 }
 
+void trace_domain::fork_child()
+{
+  // Each forked platform gets its own trace files, relative to its working
+  // directory
+  for (auto &x: this->trace_files)
+  {
+    if (x.second != NULL && freopen(x.first.c_str(), "w", x.second) == NULL)
+      throw std::logic_error("Unable to open file: " + x.first);
+  }
+
+  vp::trace_engine::fork_child();
+}
+
 extern "C" void vp_trace_add_paths(void *comp, int events, int nb_path, const char **paths)
 {
   ((trace_domain *)comp)->add_paths(events, nb_path, paths);
@@ -270,6 +555,33 @@ extern "C" int vp_trace_exchange_max_path_len(void *comp, int max_len)
   return ((trace_domain *)comp)->exchange_max_path_len(max_len);
 }
 
+extern "C" int vp_trace_window(void *comp, const char *name, int open)
+{
+  trace_domain *_this = (trace_domain *)comp;
+  int window = _this->get_window(name);
+  if (window == -1)
+    return -1;
+
+  // Windows are modified from the caller thread, the engine must not be
+  // executing events meanwhile
+  vp::time_engine *engine = _this->get_time_engine();
+  engine->lock();
+  _this->set_window(window, open);
+  engine->unlock();
+
+  return 0;
+}
+
+extern "C" int vp_trace_trigger(void *comp, const char *window, int open, int type, uint64_t value, const char *symbol)
+{
+  trace_domain *_this = (trace_domain *)comp;
+  vp::time_engine *engine = _this->get_time_engine();
+  engine->lock();
+  int result = _this->add_trigger(window, open, (vp::trace_trigger_type_e)type, value, symbol ? symbol : "");
+  engine->unlock();
+  return result;
+}
+
 extern "C" void *vp_constructor(const char *config)
 {
   return (void *)new trace_domain(config);
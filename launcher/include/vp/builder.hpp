@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_BUILDER_HPP_
+#define __VP_BUILDER_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/types.h>
+#include "json.hpp"
+
+// Native platform builder.
+// This is doing in C++ what vp_runner.py and vp_core.py are doing in python,
+// i.e. instantiating, building, binding and starting the component tree.
+// The tree is given by the platform description generated by gvsoc-describe,
+// which is the result of the python build methods, so that the python
+// classes do not need to be interpreted here.
+// The description is parsed only once and all components get a handle to
+// their config instead of a string which they must parse again.
+
+class gv_builder;
+class gv_builder_comp;
+
+
+// Entry points exported by a model library. Libraries are opened only once
+// and shared by all the components using the same implementation.
+class gv_builder_module
+{
+public:
+  void *handle;
+
+  void *(*constructor)(const char *config);
+  void (*set_next_config_handle)(void *config);
+  void (*comp_conf)(void *comp, const char *path, void *parent);
+  int (*build)(void *comp);
+  int (*get_ports)(void *comp, bool master, int size, const char *names[], void *ports[]);
+  int (*get_services)(void *comp, int size, const char *names[], void *services[]);
+  void (*set_services)(void *comp, int nb_services, const char *names[], void *services[]);
+  void (*port_bind_to)(void *master, void *slave, const char *config);
+  void (*port_finalize)(void *port);
+  void (*post_post_build)(void *comp);
+  void (*pre_start)(void *comp);
+  void (*start)(void *comp);
+  void (*reset)(void *comp, int active);
+  void (*load)(void *comp);
+  void (*stop)(void *comp);
+  void (*fork_prepare)(void *comp);
+  void (*fork_child)(void *comp);
+  void (*set_timing)(int timing);
+  const char *(*run)(void *comp);
+  int (*run_status)(void *comp);
+  char *(*get_error)();
+
+  // Optional entry points which are used in python by the component classes
+  void (*trace_add_paths)(void *comp, int events, int nb_path, const char **paths);
+  void (*trace_level)(void *comp, const char *level);
+  int (*trace_window)(void *comp, const char *name, int open);
+  int (*trace_trigger)(void *comp, const char *window, int open, int type, uint64_t value, const char *symbol);
+  void (*loader_io_req)(void *comp, uint64_t addr, uint64_t size, bool is_write, uint8_t *data);
+  void (*loader_memset)(void *comp, uint64_t addr, uint64_t size, uint8_t value);
+  int (*loader_load_elf)(void *comp, const char *path, uint64_t *entry);
+  void (*set_time_engine)(void *comp, void *engine);
+  int (*trace_exchange_max_path_len)(void *comp, int max_len);
+};
+
+
+// Models linked into a monolithic simulator. The registry is generated by
+// gvsoc-static-registry, and the engine entry points are the same for all
+// models, they are given by gv_builder_static_engine.
+typedef struct {
+  const char *name;
+  void *(*constructor)(const char *config);
+  void (*trace_add_paths)(void *comp, int events, int nb_path, const char **paths);
+  void (*trace_level)(void *comp, const char *level);
+  int (*trace_window)(void *comp, const char *name, int open);
+  int (*trace_trigger)(void *comp, const char *window, int open, int type, uint64_t value, const char *symbol);
+  void (*loader_io_req)(void *comp, uint64_t addr, uint64_t size, bool is_write, uint8_t *data);
+  void (*loader_memset)(void *comp, uint64_t addr, uint64_t size, uint8_t value);
+  int (*loader_load_elf)(void *comp, const char *path, uint64_t *entry);
+  void (*set_time_engine)(void *comp, void *engine);
+  int (*trace_exchange_max_path_len)(void *comp, int max_len);
+} gv_builder_static_module_t;
+
+extern gv_builder_static_module_t gv_builder_static_modules[] __attribute__((weak));
+extern gv_builder_module gv_builder_static_engine __attribute__((weak));
+
+
+// Same as python ports. A port is either an implementation port, in which
+// case ref is the C++ port, or a python-like port which is just forwarding
+// bindings to the ports it is bound to.
+class gv_builder_port
+{
+public:
+  gv_builder_port(gv_builder_comp *comp, std::string name, void *ref=NULL, bool is_master=false)
+  : comp(comp), name(name), ref(ref), is_impl_master(ref != NULL && is_master), is_impl_slave(ref != NULL && !is_master) {}
+
+  void bind_to(gv_builder_port *port, std::string config="");
+  void get_ports(std::vector<gv_builder_port *> &ports);
+  inline bool is_master() { return !this->is_impl_slave; }
+  inline bool is_slave() { return !this->is_impl_master; }
+
+  gv_builder_comp *comp;
+  std::string name;
+  void *ref;
+  bool is_impl_master;
+  bool is_impl_slave;
+  bool is_bound = false;
+  bool is_bound_to_port = false;
+  // Slave ports with the config of the binding, empty if there is none
+  std::vector<std::pair<gv_builder_port *, std::string>> slaves;
+};
+
+
+class gv_builder_comp
+{
+public:
+  gv_builder_comp(gv_builder *builder, std::string name, gv_builder_comp *parent, js::config *desc, js::config *config)
+  : builder(builder), name(name), parent(parent), desc(desc), config(config) {}
+
+  gv_builder_port *get_port(std::string name);
+  gv_builder_comp *get_comp_from_path(std::string path);
+  void new_port(std::string name);
+
+  gv_builder *builder;
+  std::string name;
+  std::string path;
+  gv_builder_comp *parent;
+  // Description of the component, as generated by gvsoc-describe
+  js::config *desc;
+  js::config *config;
+  gv_builder_module *module = NULL;
+  void *instance = NULL;
+  std::vector<gv_builder_comp *> childs;
+  std::map<std::string, gv_builder_comp *> childs_dict;
+  std::map<std::string, gv_builder_port *> ports;
+  std::map<std::string, gv_builder_port *> impl_master_ports;
+  std::map<std::string, gv_builder_port *> impl_slave_ports;
+};
+
+
+typedef enum {
+  GV_BUILDER_PHASE_PARSE,
+  GV_BUILDER_PHASE_OPEN,
+  GV_BUILDER_PHASE_ELAB,
+  GV_BUILDER_PHASE_BIND,
+  GV_BUILDER_PHASE_POST_POST_BUILD,
+  GV_BUILDER_PHASE_PRE_START,
+  GV_BUILDER_PHASE_START,
+  GV_BUILDER_PHASE_FINAL_BIND,
+  GV_BUILDER_PHASE_RESET,
+  GV_BUILDER_PHASE_LOAD,
+  GV_BUILDER_PHASE_NB
+} gv_builder_phase_e;
+
+
+class gv_builder
+{
+public:
+  gv_builder(std::string desc_path);
+
+  // Parse the platform description, returns -1 in case of error
+  int parse();
+
+  // Instantiate and build the whole platform, until it is ready to run
+  int build();
+
+  // Run the platform until it is over and returns its exit status
+  int run();
+
+  // Stop all components, must be called once the platform is not needed anymore
+  void stop();
+
+  // Run the platform until it is paused, see gvsoc/pause_time in the time
+  // engine and pause_offset in memories. Returns -1 if the platform did not
+  // reach the pause point.
+  int run_until_pause();
+
+  // Run the tests described in the specified file, each one in a child
+  // process forked from this platform, which must have been paused.
+  // Returns the number of failed tests, or -1 in case of error.
+  int fork_server(std::string tests_path);
+
+  // Write data to the platform through the loader
+  int write_memory(uint64_t addr, uint64_t size, uint8_t *data);
+
+  // Load an ELF binary through the loader
+  int load_binary(std::string path);
+
+  // Open or close a trace window, see gvsoc/trace_windows. Must not be called
+  // from the engine thread. Returns -1 if the window does not exist.
+  int trace_window(std::string name, bool open);
+
+  // Add a trigger opening or closing a trace window, the type is one of
+  // vp::trace_trigger_type_e. Returns -1 if the window does not exist.
+  int trace_trigger(std::string window, bool open, int type, uint64_t value, std::string symbol="");
+
+  // Simulate the platform in functional mode, without any timing, until
+  // something switches it to timed mode. Must be called before build.
+  void set_functional(bool functional) { this->functional = functional; }
+
+  std::string get_error() { return this->error; }
+
+  js::config *get_config() { return this->config; }
+
+  gv_builder_comp *get_time_engine() { return this->time_engine; }
+
+  gv_builder_module *get_module(std::string implementation);
+
+  gv_builder_module *get_static_module(std::string implementation);
+
+  gv_builder_comp *new_comp(gv_builder_comp *parent, std::string name, js::config *desc);
+
+  void set_error(std::string error);
+
+  void dump_startup_profile();
+
+private:
+  js::config *get_comp_config(js::config *desc);
+  std::string find_file(std::string name, std::string ext);
+  int build_comp(gv_builder_comp *comp);
+  int build_subtree(gv_builder_comp *comp);
+  int build_bindings(gv_builder_comp *comp);
+  void bind(gv_builder_comp *comp);
+  void final_bind(gv_builder_comp *comp);
+  void post_post_build(gv_builder_comp *comp);
+  void pre_start(gv_builder_comp *comp);
+  void start(gv_builder_comp *comp);
+  int load(gv_builder_comp *comp);
+  int load_elf(gv_builder_comp *comp, std::string path);
+  void stop(gv_builder_comp *comp);
+  pid_t fork_test(js::config *test, std::string dir);
+  int64_t get_time_us();
+  void phase_start();
+  void phase_end(gv_builder_phase_e phase);
+
+  std::string desc_path;
+  std::string error;
+  js::config *desc = NULL;
+  js::config *config = NULL;
+  js::config *gvsoc_config = NULL;
+  bool debug_mode = false;
+  bool functional = false;
+  std::vector<std::string> search_paths;
+
+  std::map<std::string, gv_builder_module *> modules;
+  std::map<std::string, void *> services;
+
+  gv_builder_comp *power_engine = NULL;
+  gv_builder_comp *time_engine = NULL;
+  gv_builder_comp *trace_engine = NULL;
+  gv_builder_comp *telemetry_engine = NULL;
+  gv_builder_comp *top = NULL;
+  gv_builder_comp *loader = NULL;
+
+  bool startup_profile = false;
+  int64_t phase_start_time;
+  int64_t phase_times[GV_BUILDER_PHASE_NB] = { 0 };
+  int nb_comps = 0;
+};
+
+#endif
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __VP_IOREQ_RING_HPP_
+#define __VP_IOREQ_RING_HPP_
+
+// Shared-memory transport of the external io request bindings.
+//
+// The launcher and the injector model exchange gv_ioreq_desc_t records
+// through two single-producer single-consumer rings, one per direction, which
+// live in a memory area shared by both processes. The payload of each record
+// is stored in a byte arena attached to the ring, which is released in order
+// by the consumer, so that no allocation is needed per request.
+//
+// Producers can reserve several records before committing them, and
+// consumers get all the committed records at once, so that requests and
+// responses are exchanged by batches. A consumer first polls the ring for a
+// while and then sleeps on a futex, which the producer only wakes up if the
+// consumer is actually sleeping.
+//
+// Each side is the consumer of one ring and the producer of the other one,
+// so a side must never wait for room in its output ring, as the other side
+// may be waiting for room in the opposite direction. Records which do not fit
+// are instead kept in a gv_ioreq_backlog and sent once the other side has
+// released enough records.
+
+#include "vp/launcher_internal.hpp"
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define GV_IOREQ_RING_SLOTS      1024
+#define GV_IOREQ_RING_ARENA_SIZE (1 << 20)
+// Number of polling iterations before sleeping, when the host has several
+// cores
+#define GV_IOREQ_RING_SPIN       4000
+// Period in microseconds at which a side with records in its backlog checks
+// again if they fit in the ring
+#define GV_IOREQ_RING_RETRY_US   100
+
+
+typedef struct {
+  gv_ioreq_desc_t desc;
+  // Absolute arena positions of the payload, and of its end, including the
+  // bytes skipped to avoid wrapping around the end of the arena
+  uint64_t payload;
+  uint64_t payload_end;
+} gv_ioreq_slot_t;
+
+
+class gv_ioreq_ring
+{
+public:
+
+  inline void init();
+
+  // Producer side. Only one thread at a time can use them.
+
+  // Reserve a record with a payload of the specified size, waiting for the
+  // consumer if the ring is full. The record is only seen by the consumer
+  // once commit is called. Returns NULL if the payload can never fit.
+  inline gv_ioreq_desc_t *reserve(uint64_t size, void **payload);
+  // Same as reserve but returns NULL instead of waiting if the ring is full
+  inline gv_ioreq_desc_t *try_reserve(uint64_t size, void **payload);
+  // Make all the reserved records visible to the consumer
+  inline void commit();
+
+  // Consumer side. Only one thread at a time can use them.
+
+  // Wait until records are available and return how many. Returns 0 if the
+  // timeout, in microseconds, expires first, or if the consumer is notified.
+  inline int wait(int64_t timeout_us=-1);
+  // Return the record at the specified index of the available ones
+  inline gv_ioreq_desc_t *get(int index, void **payload);
+  // Give back to the producer the first records
+  inline void release(int count);
+
+  // Can be called by any thread to make the consumer return from wait
+  inline void notify();
+
+private:
+
+  static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t value, int64_t timeout_us=-1);
+  static inline void futex_wake(std::atomic<uint32_t> *addr);
+  static inline void cpu_relax();
+  static inline int get_spin();
+  inline bool is_full(uint64_t end, std::memory_order order);
+  inline uint64_t get_payload_start(uint64_t size);
+  inline gv_ioreq_desc_t *alloc(uint64_t start, uint64_t end, void **payload);
+
+  // Written by the producer
+  alignas(64) std::atomic<uint64_t> head;
+  uint64_t reserved_head;
+  uint64_t payload_head;
+  std::atomic<uint32_t> data_seq;
+  std::atomic<uint32_t> producer_waiting;
+  // Set by notify
+  std::atomic<uint32_t> notified;
+
+  // Written by the consumer
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint64_t> payload_tail;
+  std::atomic<uint32_t> space_seq;
+  std::atomic<uint32_t> consumer_waiting;
+
+  alignas(64) gv_ioreq_slot_t slots[GV_IOREQ_RING_SLOTS];
+  alignas(64) uint8_t arena[GV_IOREQ_RING_ARENA_SIZE];
+};
+
+
+// Area shared between the launcher and the injector, mapped from the file
+// descriptor given to the injector through its shm_fd option
+typedef struct {
+  gv_ioreq_ring to_fabric;
+  gv_ioreq_ring to_host;
+} gv_ioreq_shm_t;
+
+
+inline void gv_ioreq_ring::init()
+{
+  this->head.store(0);
+  this->reserved_head = 0;
+  this->payload_head = 0;
+  this->data_seq.store(0);
+  this->producer_waiting.store(0);
+  this->notified.store(0);
+  this->tail.store(0);
+  this->payload_tail.store(0);
+  this->space_seq.store(0);
+  this->consumer_waiting.store(0);
+}
+
+inline void gv_ioreq_ring::futex_wait(std::atomic<uint32_t> *addr, uint32_t value, int64_t timeout_us)
+{
+  struct timespec ts = { .tv_sec=timeout_us / 1000000, .tv_nsec=(timeout_us % 1000000) * 1000 };
+  // The futex is not private as it is shared with the other process
+  syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, value, timeout_us >= 0 ? &ts : NULL, NULL, 0);
+}
+
+inline void gv_ioreq_ring::futex_wake(std::atomic<uint32_t> *addr)
+{
+  syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+inline void gv_ioreq_ring::cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+inline int gv_ioreq_ring::get_spin()
+{
+  // Polling only makes sense if the other side can run at the same time
+  static int spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? GV_IOREQ_RING_SPIN : 0;
+  return spin;
+}
+
+// Tells if a record whose payload ends at the specified position can not be
+// reserved yet
+inline bool gv_ioreq_ring::is_full(uint64_t end, std::memory_order order)
+{
+  if (this->reserved_head - this->tail.load(order) >= GV_IOREQ_RING_SLOTS)
+    return true;
+
+  // The bytes skipped at the end of the arena are accounted as used until the
+  // record is released, which is only needed if other payloads are still
+  // there, otherwise a payload bigger than the beginning of the arena
+  // could never fit
+  uint64_t payload_tail = this->payload_tail.load(order);
+  return end - payload_tail > GV_IOREQ_RING_ARENA_SIZE && payload_tail != this->payload_head;
+}
+
+inline uint64_t gv_ioreq_ring::get_payload_start(uint64_t size)
+{
+  // Payloads are kept contiguous by skipping the end of the arena when
+  // they would wrap around
+  uint64_t start = this->payload_head;
+  uint64_t offset = start % GV_IOREQ_RING_ARENA_SIZE;
+  if (offset + size > GV_IOREQ_RING_ARENA_SIZE)
+    start += GV_IOREQ_RING_ARENA_SIZE - offset;
+  return start;
+}
+
+inline gv_ioreq_desc_t *gv_ioreq_ring::alloc(uint64_t start, uint64_t end, void **payload)
+{
+  gv_ioreq_slot_t *slot = &this->slots[this->reserved_head % GV_IOREQ_RING_SLOTS];
+  slot->payload = start;
+  slot->payload_end = end;
+  *payload = (void *)&this->arena[start % GV_IOREQ_RING_ARENA_SIZE];
+
+  this->reserved_head++;
+  this->payload_head = end;
+
+  return &slot->desc;
+}
+
+inline gv_ioreq_desc_t *gv_ioreq_ring::try_reserve(uint64_t size, void **payload)
+{
+  size = (size + 7) & ~7ULL;
+  if (size > GV_IOREQ_RING_ARENA_SIZE)
+    return NULL;
+
+  uint64_t start = this->get_payload_start(size);
+  uint64_t end = start + size;
+
+  if (this->is_full(end, std::memory_order_acquire))
+  {
+    // The consumer can only free space for records it has seen
+    if (this->head.load(std::memory_order_relaxed) != this->reserved_head)
+      this->commit();
+    return NULL;
+  }
+
+  return this->alloc(start, end, payload);
+}
+
+inline gv_ioreq_desc_t *gv_ioreq_ring::reserve(uint64_t size, void **payload)
+{
+  size = (size + 7) & ~7ULL;
+  if (size > GV_IOREQ_RING_ARENA_SIZE)
+    return NULL;
+
+  uint64_t start = this->get_payload_start(size);
+  uint64_t end = start + size;
+
+  int spin = 0;
+  while (this->is_full(end, std::memory_order_acquire))
+  {
+    // The consumer can only free space for records it has seen
+    if (this->head.load(std::memory_order_relaxed) != this->reserved_head)
+      this->commit();
+
+    if (spin < get_spin())
+    {
+      spin++;
+      cpu_relax();
+      continue;
+    }
+
+    uint32_t seq = this->space_seq.load();
+    this->producer_waiting.store(1);
+    if (this->is_full(end, std::memory_order_seq_cst))
+    {
+      futex_wait(&this->space_seq, seq);
+    }
+    this->producer_waiting.store(0);
+  }
+
+  return this->alloc(start, end, payload);
+}
+
+inline void gv_ioreq_ring::commit()
+{
+  this->head.store(this->reserved_head);
+
+  if (this->consumer_waiting.load())
+  {
+    this->data_seq.fetch_add(1);
+    futex_wake(&this->data_seq);
+  }
+}
+
+inline int gv_ioreq_ring::wait(int64_t timeout_us)
+{
+  uint64_t tail = this->tail.load(std::memory_order_relaxed);
+  int spin = 0;
+
+  while (1)
+  {
+    uint64_t head = this->head.load(std::memory_order_acquire);
+    if (head != tail)
+      return head - tail;
+
+    if (this->notified.load(std::memory_order_relaxed) && this->notified.exchange(0))
+      return 0;
+
+    if (spin < get_spin())
+    {
+      spin++;
+      cpu_relax();
+      continue;
+    }
+
+    // The flag is set before checking the ring again so that the producer
+    // either sees it or has already published its records
+    uint32_t seq = this->data_seq.load();
+    this->consumer_waiting.store(1);
+    if (this->head.load() == tail && !this->notified.load())
+      futex_wait(&this->data_seq, seq, timeout_us);
+    this->consumer_waiting.store(0);
+
+    if (timeout_us >= 0)
+    {
+      this->notified.store(0);
+      return this->head.load(std::memory_order_acquire) - tail;
+    }
+  }
+}
+
+inline gv_ioreq_desc_t *gv_ioreq_ring::get(int index, void **payload)
+{
+  gv_ioreq_slot_t *slot = &this->slots[(this->tail.load(std::memory_order_relaxed) + index) % GV_IOREQ_RING_SLOTS];
+  *payload = (void *)&this->arena[slot->payload % GV_IOREQ_RING_ARENA_SIZE];
+  return &slot->desc;
+}
+
+inline void gv_ioreq_ring::release(int count)
+{
+  if (count == 0)
+    return;
+
+  uint64_t tail = this->tail.load(std::memory_order_relaxed) + count;
+
+  this->payload_tail.store(this->slots[(tail - 1) % GV_IOREQ_RING_SLOTS].payload_end, std::memory_order_release);
+  this->tail.store(tail);
+
+  if (this->producer_waiting.load())
+  {
+    this->space_seq.fetch_add(1);
+    futex_wake(&this->space_seq);
+  }
+}
+
+
+inline void gv_ioreq_ring::notify()
+{
+  this->notified.store(1);
+  if (this->consumer_waiting.load())
+  {
+    this->data_seq.fetch_add(1);
+    futex_wake(&this->data_seq);
+  }
+}
+
+
+// Producer side of a ring which never waits for room in the ring. Records
+// which do not fit yet are kept in order in a backlog, and copied to the ring
+// by flush. The consumer of the ring on which the thread calling flush waits
+// is notified when records start to be kept, so that it does not sleep until
+// the next record while its backlog is not empty.
+class gv_ioreq_backlog
+{
+public:
+  gv_ioreq_backlog(gv_ioreq_ring *ring, gv_ioreq_ring *flush_ring) : ring(ring), flush_ring(flush_ring) {}
+
+  // Same as gv_ioreq_ring::reserve, but the record is kept in the backlog if
+  // the ring is full
+  inline gv_ioreq_desc_t *reserve(uint64_t size, void **payload);
+  inline void commit() { this->ring->commit(); }
+  // Copy as many records as possible from the backlog to the ring and commit
+  // them. Returns true if the backlog is empty.
+  inline bool flush();
+
+private:
+  typedef struct {
+    gv_ioreq_desc_t desc;
+    std::vector<uint8_t> payload;
+  } gv_ioreq_pending_t;
+
+  gv_ioreq_ring *ring;
+  gv_ioreq_ring *flush_ring;
+  // References to the elements of a deque stay valid when other elements are
+  // added or removed at its ends
+  std::deque<gv_ioreq_pending_t> pending;
+};
+
+inline gv_ioreq_desc_t *gv_ioreq_backlog::reserve(uint64_t size, void **payload)
+{
+  if (size > GV_IOREQ_RING_ARENA_SIZE)
+    return NULL;
+
+  // Records go to the backlog as soon as one is there to keep them in order
+  if (this->pending.size() == 0)
+  {
+    gv_ioreq_desc_t *desc = this->ring->try_reserve(size, payload);
+    if (desc != NULL)
+      return desc;
+
+    this->flush_ring->notify();
+  }
+
+  this->pending.emplace_back();
+  gv_ioreq_pending_t *entry = &this->pending.back();
+  entry->payload.resize(size);
+  *payload = (void *)entry->payload.data();
+  return &entry->desc;
+}
+
+inline bool gv_ioreq_backlog::flush()
+{
+  while (this->pending.size() != 0)
+  {
+    gv_ioreq_pending_t *entry = &this->pending.front();
+    void *payload;
+    gv_ioreq_desc_t *desc = this->ring->try_reserve(entry->payload.size(), &payload);
+    if (desc == NULL)
+      break;
+
+    *desc = entry->desc;
+    if (entry->payload.size())
+      memcpy(payload, (void *)entry->payload.data(), entry->payload.size());
+    this->pending.pop_front();
+  }
+
+  this->ring->commit();
+
+  return this->pending.size() == 0;
+}
+
+
+// Create the shared area and return its file descriptor, which is inherited
+// by the platform process
+inline int gv_ioreq_shm_create(gv_ioreq_shm_t **shm)
+{
+  int fd = syscall(SYS_memfd_create, "gv_ioreq", 0);
+  if (fd == -1)
+    return -1;
+
+  if (ftruncate(fd, sizeof(gv_ioreq_shm_t)) == -1)
+  {
+    close(fd);
+    return -1;
+  }
+
+  void *area = mmap(NULL, sizeof(gv_ioreq_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (area == MAP_FAILED)
+  {
+    close(fd);
+    return -1;
+  }
+
+  *shm = (gv_ioreq_shm_t *)area;
+  (*shm)->to_fabric.init();
+  (*shm)->to_host.init();
+
+  return fd;
+}
+
+inline gv_ioreq_shm_t *gv_ioreq_shm_map(int fd)
+{
+  void *area = mmap(NULL, sizeof(gv_ioreq_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (area == MAP_FAILED)
+    return NULL;
+  return (gv_ioreq_shm_t *)area;
+}
+
+#endif
@@ -25,11 +25,33 @@
 #include <stdint.h>
 
 typedef enum {
-  GV_CONF_NO_TIMING = 0
+  // Default mode, the platform is simulated with timing from the beginning
+  GV_CONF_NO_TIMING = 0,
+  // The platform is simulated in functional mode, without any timing, until
+  // a trigger switches it to timed mode
+  GV_CONF_FUNCTIONAL = 1
 } gv_conf_timing_e;
 
+typedef enum {
+  // The platform is launched through pulp-run and built from python
+  GV_CONF_LAUNCH_PULP_RUN = 0,
+  // The platform is built natively from the launcher, without going through
+  // python, from the platform description generated by gvsoc-describe
+  GV_CONF_LAUNCH_NATIVE = 1
+} gv_conf_launch_e;
+
+typedef enum {
+  // External io request bindings exchange requests through memory shared
+  // with the platform process
+  GV_CONF_IOREQ_SHM = 0,
+  // External io request bindings exchange requests through pipes
+  GV_CONF_IOREQ_PIPE = 1
+} gv_conf_ioreq_e;
+
 typedef struct {
   gv_conf_timing_e timing;
+  gv_conf_launch_e launch;
+  gv_conf_ioreq_e ioreq;
 } gv_conf_t;
 
 #ifdef __cplusplus
@@ -42,6 +64,14 @@ void *gv_create(gv_conf_t *gv_conf, char *config_file);
 
 int gv_launch(void *handle);
 
+// Wait until the platform is over and return its exit status
+int gv_wait(void *handle);
+
+// Only for native launch. Boot the platform until it is paused and then run
+// each test of the specified file in a process forked from it. gv_wait then
+// returns 0 if all tests passed.
+int gv_fork_server(void *handle, char *tests_file);
+
 void gv_destroy(void *handle);
 
 #ifdef __cplusplus
@@ -0,0 +1,971 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "vp/builder.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <sstream>
+
+
+static std::vector<std::string> split(const std::string &s, char delimiter)
+{
+  std::vector<std::string> tokens;
+  std::string token;
+  std::istringstream token_stream(s);
+  while (std::getline(token_stream, token, delimiter))
+  {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+// Integer properties can be either numbers or strings like "0x1000" as the
+// python runner is often setting them as strings
+static bool get_config_int_value(js::config *config, int64_t *value)
+{
+  if (config == NULL)
+    return false;
+
+  std::string str = config->get_str();
+  if (str != "")
+    *value = strtoll(str.c_str(), NULL, 0);
+  else
+    *value = config->get_int();
+
+  return true;
+}
+
+static bool get_config_bool_value(js::config *config)
+{
+  return config != NULL && config->get_bool();
+}
+
+
+
+void gv_builder_port::bind_to(gv_builder_port *port, std::string config)
+{
+  this->slaves.push_back(std::pair<gv_builder_port *, std::string>(port, config));
+  port->is_bound = true;
+  this->is_bound = true;
+}
+
+void gv_builder_port::get_ports(std::vector<gv_builder_port *> &ports)
+{
+  if (this->is_impl_slave)
+  {
+    ports.push_back(this);
+  }
+  else
+  {
+    for (auto &slave: this->slaves)
+    {
+      slave.first->get_ports(ports);
+    }
+  }
+}
+
+
+
+gv_builder_port *gv_builder_comp::get_port(std::string name)
+{
+  // Implementation ports have priority over python-like ports, as in python
+  auto master = this->impl_master_ports.find(name);
+  if (master != this->impl_master_ports.end())
+    return master->second;
+
+  auto slave = this->impl_slave_ports.find(name);
+  if (slave != this->impl_slave_ports.end())
+    return slave->second;
+
+  auto port = this->ports.find(name);
+  if (port != this->ports.end())
+    return port->second;
+
+  return NULL;
+}
+
+void gv_builder_comp::new_port(std::string name)
+{
+  this->ports[name] = new gv_builder_port(this, name);
+}
+
+gv_builder_comp *gv_builder_comp::get_comp_from_path(std::string path)
+{
+  gv_builder_comp *comp = this;
+  for (auto &name: split(path, '/'))
+  {
+    auto child = comp->childs_dict.find(name);
+    if (child == comp->childs_dict.end())
+      return NULL;
+    comp = child->second;
+  }
+  return comp;
+}
+
+
+
+gv_builder::gv_builder(std::string desc_path)
+: desc_path(desc_path)
+{
+  // Models are searched the same way python is searching modules
+  char *python_path = getenv("PYTHONPATH");
+  if (python_path != NULL)
+  {
+    for (auto &path: split(python_path, ':'))
+    {
+      if (path != "")
+        this->search_paths.push_back(path);
+    }
+  }
+}
+
+int64_t gv_builder::get_time_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void gv_builder::phase_start()
+{
+  this->phase_start_time = this->get_time_us();
+}
+
+void gv_builder::phase_end(gv_builder_phase_e phase)
+{
+  this->phase_times[phase] += this->get_time_us() - this->phase_start_time;
+}
+
+void gv_builder::set_error(std::string error)
+{
+  if (this->error == "")
+    this->error = error;
+}
+
+int gv_builder::parse()
+{
+  this->phase_start();
+
+  this->desc = js::import_config_from_file(this->desc_path);
+  if (this->desc == NULL)
+  {
+    this->set_error("Unable to parse platform description: " + this->desc_path);
+    return -1;
+  }
+
+  // The platform config is part of the description, so that it is parsed
+  // together with it
+  this->config = this->desc->get("config");
+  if (this->config == NULL || this->desc->get("engines") == NULL || this->desc->get("system") == NULL)
+  {
+    this->set_error("File is not a platform description, it must be generated with gvsoc-describe: " + this->desc_path);
+    return -1;
+  }
+
+  this->phase_end(GV_BUILDER_PHASE_PARSE);
+
+  return 0;
+}
+
+std::string gv_builder::find_file(std::string name, std::string ext)
+{
+  std::string rel_path = name;
+  for (auto &c: rel_path)
+  {
+    if (c == '.')
+      c = '/';
+  }
+  rel_path += ext;
+
+  for (auto &path: this->search_paths)
+  {
+    std::string full_path = path + "/" + rel_path;
+    if (access(full_path.c_str(), R_OK) == 0)
+      return full_path;
+  }
+
+  return "";
+}
+
+gv_builder_module *gv_builder::get_static_module(std::string implementation)
+{
+  for (gv_builder_static_module_t *desc=gv_builder_static_modules; desc->name; desc++)
+  {
+    if (implementation == desc->name)
+    {
+      gv_builder_module *module = new gv_builder_module(gv_builder_static_engine);
+      module->handle = NULL;
+      module->constructor = desc->constructor;
+      module->trace_add_paths = desc->trace_add_paths;
+      module->trace_level = desc->trace_level;
+      module->trace_window = desc->trace_window;
+      module->trace_trigger = desc->trace_trigger;
+      module->loader_io_req = desc->loader_io_req;
+      module->loader_memset = desc->loader_memset;
+      module->loader_load_elf = desc->loader_load_elf;
+      module->set_time_engine = desc->set_time_engine;
+      module->trace_exchange_max_path_len = desc->trace_exchange_max_path_len;
+      this->modules[implementation] = module;
+      return module;
+    }
+  }
+
+  this->set_error("Implementation is not part of this simulator: " + implementation);
+  return NULL;
+}
+
+gv_builder_module *gv_builder::get_module(std::string implementation)
+{
+  // Monolithic simulators only contain the optimized version of the models,
+  // this is checked when the builder is started
+  if (gv_builder_static_modules)
+  {
+    auto it = this->modules.find(implementation);
+    if (it != this->modules.end())
+      return it->second;
+
+    return this->get_static_module(implementation);
+  }
+
+  if (this->debug_mode)
+    implementation = "debug." + implementation;
+
+  auto it = this->modules.find(implementation);
+  if (it != this->modules.end())
+    return it->second;
+
+  int64_t start_time = this->get_time_us();
+
+  std::string path = this->find_file(implementation, ".so");
+  if (path == "")
+  {
+    this->set_error("Unable to find implementation: " + implementation);
+    return NULL;
+  }
+
+  // Symbols are resolved lazily as most models are only using a few engine
+  // functions during elaboration
+  void *handle = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+  if (handle == NULL)
+  {
+    this->set_error("Unable to open implementation: " + std::string(dlerror()));
+    return NULL;
+  }
+
+  gv_builder_module *module = new gv_builder_module();
+  module->handle = handle;
+
+  // Engine entry points are found from the model handle, so that we get the
+  // ones of the engine library this model is linked to (debug or not).
+  module->constructor = (void *(*)(const char *))dlsym(handle, "vp_constructor");
+  module->set_next_config_handle = (void (*)(void *))dlsym(handle, "vp_comp_set_next_config_handle");
+  module->comp_conf = (void (*)(void *, const char *, void *))dlsym(handle, "vp_comp_conf");
+  module->build = (int (*)(void *))dlsym(handle, "vp_build");
+  module->get_ports = (int (*)(void *, bool, int, const char **, void **))dlsym(handle, "vp_comp_get_ports");
+  module->get_services = (int (*)(void *, int, const char **, void **))dlsym(handle, "vp_comp_get_services");
+  module->set_services = (void (*)(void *, int, const char **, void **))dlsym(handle, "vp_comp_set_services");
+  module->port_bind_to = (void (*)(void *, void *, const char *))dlsym(handle, "vp_port_bind_to");
+  module->port_finalize = (void (*)(void *))dlsym(handle, "vp_port_finalize");
+  module->post_post_build = (void (*)(void *))dlsym(handle, "vp_post_post_build");
+  module->pre_start = (void (*)(void *))dlsym(handle, "vp_pre_start");
+  module->start = (void (*)(void *))dlsym(handle, "vp_start");
+  module->reset = (void (*)(void *, int))dlsym(handle, "vp_reset");
+  module->load = (void (*)(void *))dlsym(handle, "vp_load");
+  module->stop = (void (*)(void *))dlsym(handle, "vp_stop");
+  module->fork_prepare = (void (*)(void *))dlsym(handle, "vp_fork_prepare");
+  module->fork_child = (void (*)(void *))dlsym(handle, "vp_fork_child");
+  module->set_timing = (void (*)(int))dlsym(handle, "vp_set_timing");
+  module->run = (const char *(*)(void *))dlsym(handle, "vp_run");
+  module->run_status = (int (*)(void *))dlsym(handle, "vp_run_status");
+  module->get_error = (char *(*)())dlsym(handle, "vp_get_error");
+
+  module->trace_add_paths = (void (*)(void *, int, int, const char **))dlsym(handle, "vp_trace_add_paths");
+  module->trace_level = (void (*)(void *, const char *))dlsym(handle, "vp_trace_level");
+  module->trace_window = (int (*)(void *, const char *, int))dlsym(handle, "vp_trace_window");
+  module->trace_trigger = (int (*)(void *, const char *, int, int, uint64_t, const char *))dlsym(handle, "vp_trace_trigger");
+  module->loader_io_req = (void (*)(void *, uint64_t, uint64_t, bool, uint8_t *))dlsym(handle, "loader_io_req");
+  module->loader_memset = (void (*)(void *, uint64_t, uint64_t, uint8_t))dlsym(handle, "loader_memset");
+  module->loader_load_elf = (int (*)(void *, const char *, uint64_t *))dlsym(handle, "loader_load_elf");
+  module->set_time_engine = (void (*)(void *, void *))dlsym(handle, "vp_set_time_engine");
+  module->trace_exchange_max_path_len = (int (*)(void *, int))dlsym(handle, "vp_trace_exchange_max_path_len");
+
+  // Only the loader entry points, and the ones of the engine components,
+  // are not found in every model
+  if (module->constructor == NULL || module->set_next_config_handle == NULL || module->comp_conf == NULL ||
+    module->build == NULL || module->get_ports == NULL || module->get_services == NULL ||
+    module->set_services == NULL || module->port_bind_to == NULL || module->port_finalize == NULL ||
+    module->post_post_build == NULL || module->pre_start == NULL || module->start == NULL ||
+    module->reset == NULL || module->load == NULL || module->stop == NULL || module->fork_prepare == NULL ||
+    module->fork_child == NULL || module->set_timing == NULL || module->run == NULL ||
+    module->run_status == NULL || module->get_error == NULL || module->trace_add_paths == NULL ||
+    module->trace_level == NULL || module->trace_window == NULL || module->trace_trigger == NULL)
+  {
+    this->set_error("Implementation is not a valid model: " + path);
+    return NULL;
+  }
+
+  this->modules[implementation] = module;
+
+  this->phase_times[GV_BUILDER_PHASE_OPEN] += this->get_time_us() - start_time;
+
+  return module;
+}
+
+js::config *gv_builder::get_comp_config(js::config *desc)
+{
+  js::config *config_path = desc->get("config_path");
+  if (config_path == NULL)
+    return desc->get("config");
+
+  std::string path = config_path->get_str();
+  return path == "" ? this->config : this->config->get(path);
+}
+
+gv_builder_comp *gv_builder::new_comp(gv_builder_comp *parent, std::string name, js::config *desc)
+{
+  js::config *config = this->get_comp_config(desc);
+  gv_builder_comp *comp = new gv_builder_comp(this, name, parent, desc, config);
+
+  if (name == "")
+    comp->path = "";
+  else if (parent == NULL || parent->path == "")
+    comp->path = "/" + name;
+  else
+    comp->path = parent->path + "/" + name;
+
+  if (config == NULL && desc->get("config_path") != NULL)
+  {
+    this->set_error("Component configuration not found (path: " + comp->path + ", config: " + desc->get_child_str("config_path") + ")");
+    return NULL;
+  }
+
+  // The implementation was selected by the python class when the platform
+  // was described
+  std::string implementation = desc->get_child_str("implementation");
+
+  if (implementation != "")
+  {
+    comp->module = this->get_module(implementation);
+    if (comp->module == NULL)
+      return NULL;
+
+    comp->module->set_next_config_handle((void *)config);
+    comp->instance = comp->module->constructor(NULL);
+    comp->module->comp_conf(comp->instance, comp->path.c_str(), parent ? parent->instance : NULL);
+  }
+
+  this->nb_comps++;
+
+  if (parent)
+  {
+    parent->childs.push_back(comp);
+    parent->childs_dict[name] = comp;
+  }
+
+  if (this->build_comp(comp))
+    return NULL;
+
+  return comp;
+}
+
+int gv_builder::build_subtree(gv_builder_comp *comp)
+{
+  js::config *comps = comp->desc->get("comps");
+  js::config *ports = comp->desc->get("ports");
+
+  if (comps == NULL || ports == NULL)
+  {
+    this->set_error("Invalid component description, comps or ports missing (path: " + comp->path + ")");
+    return -1;
+  }
+
+  for (auto x: comps->get_elems())
+  {
+    if (this->new_comp(comp, x->get_child_str("name"), x) == NULL)
+      return -1;
+  }
+
+  for (auto x: ports->get_elems())
+  {
+    comp->new_port(x->get_str());
+  }
+
+  return 0;
+}
+
+int gv_builder::build_bindings(gv_builder_comp *comp)
+{
+  // Bindings are given relative to the component whose python build method
+  // created them, in the same order
+  for (auto x: comp->desc->get("bindings")->get_elems())
+  {
+    {
+      std::string master = x->get_elem(0)->get_str();
+      std::string slave = x->get_elem(1)->get_str();
+      std::vector<std::string> master_desc = split(master, '>');
+      std::vector<std::string> slave_desc = split(slave, '>');
+
+      if (master_desc.size() != 2 || slave_desc.size() != 2)
+      {
+        this->set_error("Invalid binding: " + master + " -> " + slave);
+        return -1;
+      }
+
+      // Remove the '-' from the '->' separator
+      std::string master_comp_name = master_desc[0].substr(0, master_desc[0].size() - 1);
+      std::string slave_comp_name = slave_desc[0].substr(0, slave_desc[0].size() - 1);
+
+      gv_builder_comp *master_comp = master_comp_name == "self" ? comp : comp->get_comp_from_path(master_comp_name);
+      gv_builder_comp *slave_comp = slave_comp_name == "self" ? comp : comp->get_comp_from_path(slave_comp_name);
+
+      if (master_comp == NULL)
+      {
+        this->set_error("Unknown master component in binding: " + master_comp_name);
+        return -1;
+      }
+
+      if (slave_comp == NULL)
+      {
+        this->set_error("Unknown slave component in binding: " + slave_comp_name);
+        return -1;
+      }
+
+      gv_builder_port *master_port = master_comp->get_port(master_desc[1]);
+      gv_builder_port *slave_port = slave_comp->get_port(slave_desc[1]);
+
+      if (master_port == NULL)
+      {
+        this->set_error("Unknown master port in binding: " + master);
+        return -1;
+      }
+
+      if (slave_port == NULL)
+      {
+        this->set_error("Unknown slave port in binding: " + slave);
+        return -1;
+      }
+
+      // The config is kept until the ports are bound, it is then given as a
+      // string to the model as python does
+      std::string config = x->get_size() > 2 ? x->get_elem(2)->get_str() : "";
+
+      master_port->bind_to(slave_port, config);
+    }
+  }
+
+  return 0;
+}
+
+int gv_builder::build_comp(gv_builder_comp *comp)
+{
+  // This is following the same steps as python build_all, the python build
+  // method being replaced by what the component classes are doing.
+
+  if (this->build_subtree(comp))
+    return -1;
+
+  if (comp->module && comp->module->trace_add_paths && comp->config != NULL)
+  {
+    comp->module->trace_level(comp->instance, comp->config->get_child_str("trace-level").c_str());
+
+    for (int event=0; event<2; event++)
+    {
+      js::config *paths_config = comp->config->get(event ? "event" : "trace");
+      if (paths_config != NULL)
+      {
+        std::vector<std::string> paths;
+        for (auto x: paths_config->get_elems())
+        {
+          paths.push_back(x->get_str());
+        }
+
+        const char *paths_array[paths.size()];
+        for (unsigned int i=0; i<paths.size(); i++)
+        {
+          paths_array[i] = paths[i].c_str();
+        }
+
+        comp->module->trace_add_paths(comp->instance, event, paths.size(), paths_array);
+      }
+    }
+  }
+
+  if (comp->module)
+  {
+    if (comp->module->build(comp->instance) != 0)
+    {
+      this->set_error("Caught error while building component (path: " + comp->path + "): " + comp->module->get_error());
+      return -1;
+    }
+
+    for (int master=0; master<2; master++)
+    {
+      int size = comp->module->get_ports(comp->instance, master, 0, NULL, NULL);
+      if (size != 0)
+      {
+        const char *names[size];
+        void *ports[size];
+        comp->module->get_ports(comp->instance, master, size, names, ports);
+
+        for (int i=0; i<size; i++)
+        {
+          gv_builder_port *port = new gv_builder_port(comp, names[i], ports[i], master);
+          if (master)
+            comp->impl_master_ports[names[i]] = port;
+          else
+            comp->impl_slave_ports[names[i]] = port;
+        }
+      }
+    }
+
+    int size = comp->module->get_services(comp->instance, 0, NULL, NULL);
+    if (size != 0)
+    {
+      const char *names[size];
+      void *services[size];
+      comp->module->get_services(comp->instance, size, names, services);
+
+      for (int i=0; i<size; i++)
+      {
+        this->services[names[i]] = services[i];
+      }
+    }
+  }
+
+  // Python is binding the model ports before they are declared, they are
+  // only known here once the model is built
+  if (this->build_bindings(comp))
+    return -1;
+
+  // Components without implementation are forwarding clock and reset to
+  // their childs, others are propagating them from C++
+  const char *default_ports[] = { "clock", "reset" };
+  for (auto port_name: default_ports)
+  {
+    comp->new_port(port_name);
+
+    for (auto child: comp->childs)
+    {
+      gv_builder_port *slave_port = child->get_port(port_name);
+      gv_builder_port *master_port = comp->get_port(port_name);
+      if (slave_port == NULL || slave_port->is_bound)
+        continue;
+      if (master_port->is_master() && slave_port->is_slave())
+        master_port->bind_to(slave_port);
+    }
+  }
+
+  return 0;
+}
+
+void gv_builder::bind(gv_builder_comp *comp)
+{
+  for (auto child: comp->childs)
+  {
+    this->bind(child);
+  }
+
+  for (auto &x: comp->impl_master_ports)
+  {
+    gv_builder_port *master = x.second;
+    for (auto &slave: master->slaves)
+    {
+      std::vector<gv_builder_port *> ports;
+      slave.first->get_ports(ports);
+      for (auto port: ports)
+      {
+        master->is_bound_to_port = true;
+        comp->module->port_bind_to(master->ref, port->ref, slave.second != "" ? slave.second.c_str() : NULL);
+      }
+    }
+  }
+}
+
+void gv_builder::final_bind(gv_builder_comp *comp)
+{
+  for (auto child: comp->childs)
+  {
+    this->final_bind(child);
+  }
+
+  for (auto &x: comp->impl_master_ports)
+  {
+    if (x.second->slaves.size() != 0 && x.second->is_bound_to_port)
+      comp->module->port_finalize(x.second->ref);
+  }
+
+  for (auto &x: comp->impl_slave_ports)
+  {
+    if (x.second->is_bound)
+      comp->module->port_finalize(x.second->ref);
+  }
+}
+
+void gv_builder::post_post_build(gv_builder_comp *comp)
+{
+  if (comp->instance)
+  {
+    int size = this->services.size();
+    const char *names[size];
+    void *services[size];
+    int i = 0;
+    for (auto &x: this->services)
+    {
+      names[i] = x.first.c_str();
+      services[i] = x.second;
+      i++;
+    }
+    comp->module->set_services(comp->instance, size, names, services);
+  }
+
+  for (auto child: comp->childs)
+  {
+    this->post_post_build(child);
+  }
+
+  if (comp->instance)
+    comp->module->post_post_build(comp->instance);
+}
+
+void gv_builder::pre_start(gv_builder_comp *comp)
+{
+  for (auto child: comp->childs)
+  {
+    this->pre_start(child);
+  }
+
+  // Do here what the python clock domain and trace engine classes are doing
+  // in their pre_start method, before the implementation one is called
+  if (comp->module && comp->module->set_time_engine)
+    comp->module->set_time_engine(comp->instance, this->time_engine->instance);
+
+  if (comp->module && comp->module->trace_exchange_max_path_len)
+    comp->module->trace_exchange_max_path_len(comp->instance, 32);
+
+  if (comp->instance)
+    comp->module->pre_start(comp->instance);
+}
+
+void gv_builder::start(gv_builder_comp *comp)
+{
+  for (auto child: comp->childs)
+  {
+    this->start(child);
+  }
+
+  if (comp->instance)
+    comp->module->start(comp->instance);
+}
+
+int gv_builder::load_elf(gv_builder_comp *comp, std::string path)
+{
+  uint64_t entry;
+
+  // The loader maps the binary itself and writes the segments directly
+  // into the memories
+  if (comp->module->loader_load_elf == NULL)
+  {
+    this->set_error("Loader can not load ELF binaries (path: " + comp->path + ")");
+    return -1;
+  }
+
+  if (comp->module->loader_load_elf(comp->instance, path.c_str(), &entry))
+  {
+    this->set_error("Unable to load binary: " + path);
+    return -1;
+  }
+
+  // Same as the python loader, the entry point can be written somewhere so
+  // that the boot code can jump to it
+  int64_t set_pc_addr, set_pc_offset;
+  if (get_config_int_value(comp->config->get("set_pc_addr"), &set_pc_addr))
+  {
+    if (get_config_int_value(comp->config->get("set_pc_offset"), &set_pc_offset))
+      entry += set_pc_offset;
+    uint32_t value = entry;
+    comp->module->loader_io_req(comp->instance, set_pc_addr, 4, true, (uint8_t *)&value);
+  }
+
+  return 0;
+}
+
+int gv_builder::load(gv_builder_comp *comp)
+{
+  for (auto child: comp->childs)
+  {
+    if (this->load(child))
+      return -1;
+  }
+
+  // Do here what the python loader class is doing, which is to load the
+  // binaries through the loader implementation. They were resolved by the
+  // python class when the platform was described.
+  if (comp->module && comp->module->loader_io_req && comp->config != NULL)
+  {
+    this->loader = comp;
+
+    std::vector<std::string> binaries;
+    js::config *binaries_desc = comp->desc->get("binaries");
+    if (binaries_desc != NULL)
+    {
+      for (auto x: binaries_desc->get_elems())
+      {
+        binaries.push_back(x->get_str());
+      }
+    }
+
+    for (auto &binary: binaries)
+    {
+      if (this->load_elf(comp, binary))
+        return -1;
+    }
+
+    int64_t start_addr, start_value;
+    if (binaries.size() && get_config_int_value(comp->config->get("start_addr"), &start_addr))
+    {
+      if (!get_config_int_value(comp->config->get("start_value"), &start_value))
+        start_value = 0;
+      uint32_t value = start_value;
+      comp->module->loader_io_req(comp->instance, start_addr, 4, true, (uint8_t *)&value);
+    }
+  }
+
+  if (comp->instance)
+    comp->module->load(comp->instance);
+
+  return 0;
+}
+
+void gv_builder::stop(gv_builder_comp *comp)
+{
+  for (auto child: comp->childs)
+  {
+    this->stop(child);
+  }
+
+  if (comp->instance)
+    comp->module->stop(comp->instance);
+}
+
+int gv_builder::build()
+{
+  if (this->config == NULL && this->parse())
+    return -1;
+
+  this->gvsoc_config = this->config->get("gvsoc");
+  if (this->gvsoc_config == NULL)
+  {
+    this->set_error("The specified configuration does not contain any gvsoc section");
+    return -1;
+  }
+
+  js::config *trace_config = this->gvsoc_config->get("trace");
+  js::config *event_config = this->gvsoc_config->get("event");
+  // Trace windows need the debug build, where the traces they open are
+  // compiled in
+  js::config *windows_config = this->gvsoc_config->get("trace_windows");
+
+  this->debug_mode = get_config_bool_value(this->gvsoc_config->get("trace-enable")) ||
+    get_config_bool_value(this->gvsoc_config->get("vcd/active")) ||
+    (trace_config != NULL && trace_config->get_size() != 0) ||
+    (event_config != NULL && event_config->get_size() != 0) ||
+    (windows_config != NULL && windows_config->get_childs().size() != 0);
+
+  this->startup_profile = get_config_bool_value(this->gvsoc_config->get("startup-profile"));
+
+  if (this->debug_mode && gv_builder_static_modules)
+  {
+    this->set_error("Traces and VCD are not available in this simulator as it only contains optimized models");
+    return -1;
+  }
+
+  this->phase_start();
+
+  // The engines are described as any other component, as they are also
+  // python classes
+  js::config *engines = this->desc->get("engines");
+
+  this->power_engine = this->new_comp(NULL, "", engines->get("power_engine"));
+  if (this->power_engine == NULL)
+    return -1;
+
+  this->time_engine = this->new_comp(this->power_engine, "", engines->get("time_engine"));
+  if (this->time_engine == NULL)
+    return -1;
+
+  this->trace_engine = this->new_comp(this->time_engine, "", engines->get("trace_engine"));
+  if (this->trace_engine == NULL)
+    return -1;
+
+  this->telemetry_engine = this->new_comp(this->time_engine, "", engines->get("telemetry_engine"));
+  if (this->telemetry_engine == NULL)
+    return -1;
+
+  this->top = this->new_comp(this->time_engine, "sys", this->desc->get("system"));
+  if (this->top == NULL)
+    return -1;
+
+  // Library opening is accounted separately
+  this->phase_end(GV_BUILDER_PHASE_ELAB);
+  this->phase_times[GV_BUILDER_PHASE_ELAB] -= this->phase_times[GV_BUILDER_PHASE_OPEN];
+
+  this->phase_start();
+  this->bind(this->power_engine);
+  this->phase_end(GV_BUILDER_PHASE_BIND);
+
+  this->phase_start();
+  this->post_post_build(this->power_engine);
+  this->phase_end(GV_BUILDER_PHASE_POST_POST_BUILD);
+
+  this->phase_start();
+  this->pre_start(this->power_engine);
+  this->phase_end(GV_BUILDER_PHASE_PRE_START);
+
+  this->phase_start();
+  this->start(this->power_engine);
+  this->phase_end(GV_BUILDER_PHASE_START);
+
+  // Done after the time engine has been started, as it is also getting the
+  // mode from the configuration
+  if (this->functional)
+    this->time_engine->module->set_timing(0);
+
+  this->phase_start();
+  this->final_bind(this->power_engine);
+  this->phase_end(GV_BUILDER_PHASE_FINAL_BIND);
+
+  this->phase_start();
+  this->power_engine->module->reset(this->power_engine->instance, 1);
+  if (!get_config_bool_value(this->config->get("**/gvsoc/use_external_bridge")))
+    this->power_engine->module->reset(this->power_engine->instance, 0);
+  this->phase_end(GV_BUILDER_PHASE_RESET);
+
+  this->phase_start();
+  if (this->load(this->power_engine))
+    return -1;
+  this->phase_end(GV_BUILDER_PHASE_LOAD);
+
+  if (this->startup_profile)
+    this->dump_startup_profile();
+
+  return 0;
+}
+
+int gv_builder::run()
+{
+  std::string status = this->time_engine->module->run(this->time_engine->instance);
+
+  this->stop();
+
+  if (status == "killed")
+  {
+    printf("The top engine was not responding and was killed\n");
+    return -1;
+  }
+  else if (status == "error")
+  {
+    return -1;
+  }
+
+  return this->time_engine->module->run_status(this->time_engine->instance);
+}
+
+int gv_builder::run_until_pause()
+{
+  std::string status = this->time_engine->module->run(this->time_engine->instance);
+  if (status != "paused")
+  {
+    this->set_error("Platform did not reach the pause point (status: " + status + ")");
+    return -1;
+  }
+  return 0;
+}
+
+int gv_builder::write_memory(uint64_t addr, uint64_t size, uint8_t *data)
+{
+  if (this->loader == NULL)
+  {
+    this->set_error("Platform does not have any loader");
+    return -1;
+  }
+  this->loader->module->loader_io_req(this->loader->instance, addr, size, true, data);
+  return 0;
+}
+
+int gv_builder::load_binary(std::string path)
+{
+  if (this->loader == NULL)
+  {
+    this->set_error("Platform does not have any loader");
+    return -1;
+  }
+  return this->load_elf(this->loader, path);
+}
+
+int gv_builder::trace_window(std::string name, bool open)
+{
+  if (this->trace_engine->module->trace_window(this->trace_engine->instance, name.c_str(), open))
+  {
+    this->set_error("Unknown trace window: " + name);
+    return -1;
+  }
+  return 0;
+}
+
+int gv_builder::trace_trigger(std::string window, bool open, int type, uint64_t value, std::string symbol)
+{
+  if (this->trace_engine->module->trace_trigger(this->trace_engine->instance, window.c_str(), open, type, value, symbol.c_str()))
+  {
+    this->set_error("Unknown trace window: " + window);
+    return -1;
+  }
+  return 0;
+}
+
+void gv_builder::stop()
+{
+  if (this->power_engine)
+    this->stop(this->power_engine);
+}
+
+void gv_builder::dump_startup_profile()
+{
+  static const char *names[] = {
+    "parse config", "open libraries", "elaborate", "bind", "post post build",
+    "pre start", "start", "final bind", "reset", "load"
+  };
+
+  int64_t total = 0;
+  for (int i=0; i<GV_BUILDER_PHASE_NB; i++)
+  {
+    total += this->phase_times[i];
+  }
+
+  fprintf(stderr, "Startup profile (components: %d, libraries: %ld)\n", this->nb_comps, this->modules.size());
+  for (int i=0; i<GV_BUILDER_PHASE_NB; i++)
+  {
+    fprintf(stderr, "  %-20s %10ld us\n", names[i], this->phase_times[i]);
+  }
+  fprintf(stderr, "  %-20s %10ld us\n", "total", total);
+}
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Fork server, which elaborates and boots the platform once, and then forks
+// a copy-on-write child for each test, starting from the paused platform.
+
+#include "vp/builder.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+static int64_t get_test_int(js::config *config)
+{
+  std::string str = config->get_str();
+  if (str != "")
+    return strtoll(str.c_str(), NULL, 0);
+  return config->get_int();
+}
+
+static bool get_config_bool_value(js::config *config)
+{
+  return config != NULL && config->get_bool();
+}
+
+
+pid_t gv_builder::fork_test(js::config *test, std::string dir)
+{
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+
+  // Overrides are applied from the working directory of the server so that
+  // paths in the tests file are relative to it
+  js::config *binary = test->get("binary");
+  if (binary != NULL && this->load_binary(binary->get_str()))
+  {
+    fprintf(stderr, "%s\n", this->get_error().c_str());
+    _exit(-1);
+  }
+
+  js::config *patches = test->get("patches");
+  if (patches != NULL)
+  {
+    for (auto patch: patches->get_elems())
+    {
+      uint64_t addr = get_test_int(patch->get("addr"));
+      js::config *file_config = patch->get("file");
+
+      if (file_config != NULL)
+      {
+        FILE *file = fopen(file_config->get_str().c_str(), "rb");
+        if (file == NULL)
+        {
+          fprintf(stderr, "Unable to open patch file: %s\n", file_config->get_str().c_str());
+          _exit(-1);
+        }
+        uint8_t buffer[4096];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+          if (this->write_memory(addr, size, buffer))
+            break;
+          addr += size;
+        }
+        fclose(file);
+      }
+      else
+      {
+        uint32_t value = get_test_int(patch->get("value"));
+        this->write_memory(addr, sizeof(value), (uint8_t *)&value);
+      }
+
+      if (this->get_error() != "")
+      {
+        fprintf(stderr, "%s\n", this->get_error().c_str());
+        _exit(-1);
+      }
+    }
+  }
+
+  // All outputs of the test go to its directory
+  if (chdir(dir.c_str()))
+  {
+    fprintf(stderr, "Unable to enter test directory: %s\n", dir.c_str());
+    _exit(-1);
+  }
+
+  int fd = open("stdout.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1)
+  {
+    fprintf(stderr, "Unable to open test output: %s/stdout.log\n", dir.c_str());
+    _exit(-1);
+  }
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+  close(fd);
+
+  js::config *timeout = test->get("timeout");
+  if (timeout != NULL)
+    alarm(get_test_int(timeout));
+
+  this->power_engine->module->fork_child(this->power_engine->instance);
+
+  int status = this->run();
+
+  fflush(NULL);
+  _exit(status);
+}
+
+
+int gv_builder::fork_server(std::string tests_path)
+{
+  js::config *tests_config = js::import_config_from_file(tests_path);
+  if (tests_config == NULL || tests_config->get("tests") == NULL)
+  {
+    this->set_error("Unable to parse tests file: " + tests_path);
+    return -1;
+  }
+
+  // Events are dumped by a thread whose state can not be recovered in the
+  // child
+  if (get_config_bool_value(this->gvsoc_config->get("vcd/active")))
+  {
+    this->set_error("VCD traces can not be used with the fork server");
+    return -1;
+  }
+
+  if (this->run_until_pause())
+    return -1;
+
+  // Everything pending must be flushed now, otherwise it would be output
+  // again by each child
+  this->power_engine->module->fork_prepare(this->power_engine->instance);
+  fflush(NULL);
+
+  unsigned int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  if (tests_config->get("jobs") != NULL)
+    jobs = get_test_int(tests_config->get("jobs"));
+
+  FILE *results = NULL;
+  if (tests_config->get("results") != NULL)
+  {
+    results = fopen(tests_config->get("results")->get_str().c_str(), "w");
+    if (results == NULL)
+    {
+      this->set_error("Unable to open results file: " + tests_config->get("results")->get_str());
+      return -1;
+    }
+  }
+
+  std::vector<js::config *> tests = tests_config->get("tests")->get_elems();
+  std::map<pid_t, js::config *> running;
+  unsigned int next = 0;
+  int failed = 0;
+
+  while (next < tests.size() || running.size() != 0)
+  {
+    if (next < tests.size() && running.size() < jobs)
+    {
+      js::config *test = tests[next++];
+      std::string name = test->get_child_str("name");
+      std::string dir = test->get_child_str("dir");
+      if (dir == "")
+        dir = name;
+
+      if (mkdir(dir.c_str(), 0755) && errno != EEXIST)
+      {
+        fprintf(stderr, "Unable to create test directory: %s\n", dir.c_str());
+        failed++;
+        continue;
+      }
+
+      pid_t pid = this->fork_test(test, dir);
+      if (pid == -1)
+      {
+        fprintf(stderr, "Unable to fork test: %s\n", name.c_str());
+        failed++;
+        continue;
+      }
+
+      running[pid] = test;
+      continue;
+    }
+
+    int wstatus;
+    pid_t pid = waitpid(-1, &wstatus, 0);
+    if (pid == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    auto it = running.find(pid);
+    if (it == running.end())
+      continue;
+
+    std::string name = it->second->get_child_str("name");
+    running.erase(it);
+
+    char status[32];
+    bool passed = false;
+    if (WIFEXITED(wstatus))
+    {
+      int exit_status = (int8_t)WEXITSTATUS(wstatus);
+      passed = exit_status == 0;
+      snprintf(status, sizeof(status), "%d", exit_status);
+    }
+    else
+    {
+      snprintf(status, sizeof(status), "signal %d", WTERMSIG(wstatus));
+    }
+
+    if (!passed)
+      failed++;
+
+    printf("%-40s %s (status: %s)\n", name.c_str(), passed ? "OK" : "KO", status);
+    fflush(stdout);
+
+    if (results)
+      fprintf(results, "%s %s\n", name.c_str(), status);
+  }
+
+  if (results)
+    fclose(results);
+
+  printf("Tests: %ld, failed: %d\n", tests.size(), failed);
+
+  return failed;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Entry point of the monolithic simulator, where the engine and the models
+// of one chip are statically linked together.
+
+#include "vp/builder.hpp"
+#include <stdio.h>
+#include <string.h>
+
+extern "C" void vp_comp_set_next_config_handle(void *config);
+extern "C" void vp_comp_conf(void *comp, const char *path, void *parent);
+extern "C" int vp_build(void *comp);
+extern "C" int vp_comp_get_ports(void *comp, bool master, int size, const char *names[], void *ports[]);
+extern "C" int vp_comp_get_services(void *comp, int size, const char *names[], void *services[]);
+extern "C" void vp_comp_set_services(void *comp, int nb_services, const char *names[], void *services[]);
+extern "C" void vp_port_bind_to(void *master, void *slave, const char *config);
+extern "C" void vp_port_finalize(void *port);
+extern "C" void vp_post_post_build(void *comp);
+extern "C" void vp_pre_start(void *comp);
+extern "C" void vp_start(void *comp);
+extern "C" void vp_reset(void *comp, int active);
+extern "C" void vp_load(void *comp);
+extern "C" void vp_stop(void *comp);
+extern "C" void vp_fork_prepare(void *comp);
+extern "C" void vp_fork_child(void *comp);
+extern "C" void vp_set_timing(int timing);
+extern "C" const char *vp_run(void *comp);
+extern "C" int vp_run_status(void *comp);
+extern "C" char *vp_get_error();
+
+
+gv_builder_module gv_builder_static_engine = {
+  .handle = NULL,
+  .constructor = NULL,
+  .set_next_config_handle = vp_comp_set_next_config_handle,
+  .comp_conf = vp_comp_conf,
+  .build = vp_build,
+  .get_ports = vp_comp_get_ports,
+  .get_services = vp_comp_get_services,
+  .set_services = vp_comp_set_services,
+  .port_bind_to = vp_port_bind_to,
+  .port_finalize = vp_port_finalize,
+  .post_post_build = vp_post_post_build,
+  .pre_start = vp_pre_start,
+  .start = vp_start,
+  .reset = vp_reset,
+  .load = vp_load,
+  .stop = vp_stop,
+  .fork_prepare = vp_fork_prepare,
+  .fork_child = vp_fork_child,
+  .set_timing = vp_set_timing,
+  .run = vp_run,
+  .run_status = vp_run_status,
+  .get_error = vp_get_error,
+  .trace_add_paths = NULL,
+  .trace_level = NULL,
+  .trace_window = NULL,
+  .trace_trigger = NULL,
+  .loader_io_req = NULL,
+  .loader_memset = NULL,
+  .loader_load_elf = NULL,
+  .set_time_engine = NULL,
+  .trace_exchange_max_path_len = NULL
+};
+
+
+int main(int argc, char *argv[])
+{
+  const char *config_file = NULL;
+  const char *tests_file = NULL;
+
+  for (int i=1; i<argc; i++)
+  {
+    if (strncmp(argv[i], "--config-file=", 14) == 0)
+      config_file = argv[i] + 14;
+    else if (strcmp(argv[i], "--config-file") == 0 && i + 1 < argc)
+      config_file = argv[++i];
+    else if (strncmp(argv[i], "--fork-server=", 14) == 0)
+      tests_file = argv[i] + 14;
+  }
+
+  if (config_file == NULL)
+  {
+    fprintf(stderr, "Usage: %s --config-file=<plt_desc.json> [--fork-server=<tests.json>]\n", argv[0]);
+    return -1;
+  }
+
+  gv_builder *builder = new gv_builder(config_file);
+
+  if (builder->parse() || builder->build())
+  {
+    fprintf(stderr, "FATAL ERROR while building virtual platform: %s\n", builder->get_error().c_str());
+    builder->stop();
+    return -1;
+  }
+
+  if (tests_file != NULL)
+  {
+    int failed = builder->fork_server(tests_file);
+    if (failed < 0)
+      fprintf(stderr, "FATAL ERROR while running fork server: %s\n", builder->get_error().c_str());
+    builder->stop();
+    return failed != 0 ? -1 : 0;
+  }
+
+  return builder->run();
+}
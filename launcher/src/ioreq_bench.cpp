@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Latency and throughput of the external io request transports.
+//
+// The host side is this process while the platform side is emulated by a
+// forked process which answers each request immediately, using the same
+// record exchanges as the launcher and the injector model. The latency is
+// measured with a single request in flight, and the throughput with a window
+// of requests in flight.
+//
+// The shared-memory transport is then stressed with both sides sending big
+// requests to each other at the same time, which must all complete although
+// both rings are regularly full.
+//
+// Usage: gvsoc_ioreq_bench [<number of requests>]
+
+#include "vp/ioreq_ring.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <vector>
+
+#define BENCH_WINDOW 128
+
+// Requests in flight from each side, and payload size, of the stress case
+#define STRESS_WINDOW 64
+#define STRESS_SIZE   (192 * 1024)
+// Seconds after which the stress case is considered as deadlocked
+#define STRESS_TIMEOUT 60
+
+
+static int64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+class bench_transport
+{
+public:
+  virtual ~bench_transport() {}
+  // Platform side, answers requests until the host process kills it
+  virtual void fabric_loop() = 0;
+  virtual void send(uint64_t addr, uint64_t size, bool is_write, uint8_t *data) = 0;
+  virtual void commit() = 0;
+  // Returns how many responses were received
+  virtual int receive(uint8_t *data) = 0;
+};
+
+
+class bench_pipe : public bench_transport
+{
+public:
+  bench_pipe()
+  {
+    if (pipe(this->to_fabric) == -1 || pipe(this->to_host) == -1)
+    {
+      perror("pipe");
+      exit(-1);
+    }
+  }
+
+  void fabric_loop()
+  {
+    FILE *rcv_file = fdopen(this->to_fabric[0], "r");
+    FILE *snd_file = fdopen(this->to_host[1], "w");
+    std::vector<uint8_t> data;
+
+    while(1)
+    {
+      gv_ioreq_desc_t req;
+      if (fread(&req, sizeof(req), 1, rcv_file) != 1) return;
+      data.resize(req.size);
+      if (req.is_write && fread(data.data(), req.size, 1, rcv_file) != 1) return;
+      req.type = GV_IOREQ_DESC_TYPE_RESPONSE;
+      if (fwrite(&req, sizeof(req), 1, snd_file) != 1) return;
+      if (!req.is_write && fwrite(data.data(), req.size, 1, snd_file) != 1) return;
+      fflush(snd_file);
+    }
+  }
+
+  void send(uint64_t addr, uint64_t size, bool is_write, uint8_t *data)
+  {
+    if (this->snd_file == NULL)
+    {
+      this->snd_file = fdopen(this->to_fabric[1], "w");
+      this->rcv_file = fdopen(this->to_host[0], "r");
+    }
+
+    gv_ioreq_desc_t desc = { .type=GV_IOREQ_DESC_TYPE_REQUEST, .addr=addr, .size=size, .is_write=is_write };
+    desc.data = data;
+    if (fwrite(&desc, sizeof(desc), 1, this->snd_file) != 1) exit(-1);
+    if (is_write && fwrite(data, size, 1, this->snd_file) != 1) exit(-1);
+    fflush(this->snd_file);
+  }
+
+  void commit() {}
+
+  int receive(uint8_t *data)
+  {
+    gv_ioreq_desc_t desc;
+    if (fread(&desc, sizeof(desc), 1, this->rcv_file) != 1) exit(-1);
+    if (!desc.is_write && fread(data, desc.size, 1, this->rcv_file) != 1) exit(-1);
+    return 1;
+  }
+
+private:
+  int to_fabric[2];
+  int to_host[2];
+  FILE *snd_file = NULL;
+  FILE *rcv_file = NULL;
+};
+
+
+class bench_shm : public bench_transport
+{
+public:
+  bench_shm()
+  {
+    if (gv_ioreq_shm_create(&this->shm) == -1)
+    {
+      perror("shm");
+      exit(-1);
+    }
+  }
+
+  void fabric_loop()
+  {
+    gv_ioreq_ring *ring = &this->shm->to_fabric;
+    gv_ioreq_backlog to_host(&this->shm->to_host, ring);
+    bool pending = false;
+
+    while(1)
+    {
+      int count = ring->wait(pending ? GV_IOREQ_RING_RETRY_US : -1);
+
+      for (int i=0; i<count; i++)
+      {
+        void *payload, *resp_payload;
+        gv_ioreq_desc_t *req = ring->get(0, &payload);
+        gv_ioreq_desc_t *resp = to_host.reserve(req->is_write ? 0 : req->size, &resp_payload);
+        *resp = *req;
+        resp->type = GV_IOREQ_DESC_TYPE_RESPONSE;
+        ring->release(1);
+      }
+
+      pending = !to_host.flush();
+    }
+  }
+
+  void send(uint64_t addr, uint64_t size, bool is_write, uint8_t *data)
+  {
+    void *payload;
+    gv_ioreq_desc_t *desc = this->shm->to_fabric.reserve(is_write ? size : 0, &payload);
+    *desc = { .type=GV_IOREQ_DESC_TYPE_REQUEST, .addr=addr, .size=size, .is_write=is_write };
+    desc->data = data;
+    if (is_write) memcpy(payload, data, size);
+  }
+
+  void commit()
+  {
+    this->shm->to_fabric.commit();
+  }
+
+  int receive(uint8_t *data)
+  {
+    gv_ioreq_ring *ring = &this->shm->to_host;
+    int count = ring->wait();
+    for (int i=0; i<count; i++)
+    {
+      void *payload;
+      gv_ioreq_desc_t *resp = ring->get(i, &payload);
+      if (!resp->is_write) memcpy(data, payload, resp->size);
+    }
+    ring->release(count);
+    return count;
+  }
+
+private:
+  gv_ioreq_shm_t *shm;
+};
+
+
+// One side of the stress case, which behaves like the launcher or the
+// injector: it answers the requests of the other side, and sends its own
+// requests, reads and writes in turn, keeping a window of them in flight.
+// Payloads are filled with the low byte of the address so that each side can
+// check what it receives.
+static bool stress_side(gv_ioreq_ring *input, gv_ioreq_backlog *output, int nb_reqs,
+  std::atomic<int> *done, std::atomic<int> *other_done)
+{
+  int sent = 0;
+  bool pending = false;
+  int64_t start = get_time_ns();
+
+  while (done->load() < nb_reqs || other_done->load() < nb_reqs)
+  {
+    if (get_time_ns() - start > (int64_t)STRESS_TIMEOUT * 1000000000)
+      return false;
+
+    while (sent < nb_reqs && sent - done->load() < STRESS_WINDOW)
+    {
+      bool is_write = sent & 1;
+      void *payload;
+      gv_ioreq_desc_t *desc = output->reserve(is_write ? STRESS_SIZE : 0, &payload);
+      *desc = { .type=GV_IOREQ_DESC_TYPE_REQUEST, .addr=(uint64_t)sent, .size=STRESS_SIZE, .is_write=is_write };
+      if (is_write) memset(payload, sent & 0xff, STRESS_SIZE);
+      sent++;
+    }
+    output->commit();
+
+    int count = input->wait(GV_IOREQ_RING_RETRY_US);
+
+    for (int i=0; i<count; i++)
+    {
+      void *payload;
+      gv_ioreq_desc_t *req = input->get(0, &payload);
+      uint8_t expected = req->addr & 0xff;
+
+      if (req->type == GV_IOREQ_DESC_TYPE_REQUEST)
+      {
+        if (req->is_write && ((uint8_t *)payload)[req->size - 1] != expected)
+          return false;
+
+        void *resp_payload;
+        gv_ioreq_desc_t *resp = output->reserve(req->is_write ? 0 : req->size, &resp_payload);
+        *resp = *req;
+        resp->type = GV_IOREQ_DESC_TYPE_RESPONSE;
+        if (!req->is_write) memset(resp_payload, expected, req->size);
+      }
+      else
+      {
+        if (!req->is_write && ((uint8_t *)payload)[req->size - 1] != expected)
+          return false;
+        done->fetch_add(1);
+      }
+
+      input->release(1);
+    }
+
+    pending = !output->flush();
+  }
+
+  // The other side may still be waiting for the last records
+  while (pending)
+  {
+    pending = !output->flush();
+    if (pending)
+      usleep(GV_IOREQ_RING_RETRY_US);
+  }
+
+  return true;
+}
+
+
+static bool stress_run(int nb_reqs)
+{
+  gv_ioreq_shm_t *shm;
+  if (gv_ioreq_shm_create(&shm) == -1)
+  {
+    perror("shm");
+    exit(-1);
+  }
+
+  // Number of completed requests of each side, seen by both processes
+  std::atomic<int> *done = (std::atomic<int> *)mmap(NULL, sizeof(std::atomic<int>) * 2,
+    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (done == MAP_FAILED)
+  {
+    perror("mmap");
+    exit(-1);
+  }
+  new (&done[0]) std::atomic<int>(0);
+  new (&done[1]) std::atomic<int>(0);
+
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    gv_ioreq_backlog to_host(&shm->to_host, &shm->to_fabric);
+    _exit(stress_side(&shm->to_fabric, &to_host, nb_reqs, &done[1], &done[0]) ? 0 : 1);
+  }
+
+  gv_ioreq_backlog to_fabric(&shm->to_fabric, &shm->to_host);
+  int64_t start = get_time_ns();
+  bool ok = stress_side(&shm->to_host, &to_fabric, nb_reqs, &done[0], &done[1]);
+  int64_t duration = get_time_ns() - start;
+
+  int status;
+  waitpid(pid, &status, 0);
+  ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+  printf("%-6s size %6d: %s, %d requests per side in %.2f s\n", "stress", STRESS_SIZE,
+    ok ? "ok" : "FAILED", nb_reqs, (double)duration / 1000000000);
+
+  return ok;
+}
+
+
+static void bench_run(const char *name, bench_transport *transport, int nb_reqs, uint64_t size)
+{
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    transport->fabric_loop();
+    _exit(0);
+  }
+
+  std::vector<uint8_t> data(size);
+
+  // Latency, one request at a time
+  int64_t start = get_time_ns();
+  for (int i=0; i<nb_reqs; i++)
+  {
+    transport->send(i * size, size, i & 1, data.data());
+    transport->commit();
+    transport->receive(data.data());
+  }
+  int64_t latency = get_time_ns() - start;
+
+  // Throughput, with a window of requests in flight. The window is kept
+  // small enough for the records to fit in the pipe buffers, otherwise both
+  // sides could block on writes.
+  int window = 32768 / (sizeof(gv_ioreq_desc_t) + size);
+  if (window > BENCH_WINDOW) window = BENCH_WINDOW;
+
+  start = get_time_ns();
+  int sent = 0, received = 0;
+  while (received < nb_reqs)
+  {
+    int burst = 0;
+    while (sent < nb_reqs && sent - received < window)
+    {
+      transport->send(sent * size, size, sent & 1, data.data());
+      sent++;
+      burst++;
+    }
+    if (burst) transport->commit();
+
+    received += transport->receive(data.data());
+  }
+  int64_t duration = get_time_ns() - start;
+
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+
+  printf("%-6s size %6ld: latency %8.2f us, throughput %10.0f req/s\n", name, size,
+    (double)latency / nb_reqs / 1000, (double)nb_reqs * 1000000000 / duration);
+}
+
+
+int main(int argc, char *argv[])
+{
+  int nb_reqs = argc > 1 ? atoi(argv[1]) : 100000;
+  uint64_t sizes[] = { 8, 64, 1024 };
+
+  for (uint64_t size: sizes)
+  {
+    bench_pipe pipe_transport;
+    bench_run("pipe", &pipe_transport, nb_reqs, size);
+
+    bench_shm shm_transport;
+    bench_run("shm", &shm_transport, nb_reqs, size);
+  }
+
+  return stress_run(nb_reqs / 100 > STRESS_WINDOW ? nb_reqs / 100 : STRESS_WINDOW * 4) ? 0 : 1;
+}
@@ -20,6 +20,8 @@
 
 #include "vp/launcher.h"
 #include "vp/launcher_internal.hpp"
+#include "vp/builder.hpp"
+#include "vp/ioreq_ring.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -29,6 +31,7 @@
 #include <pthread.h>
 #include <string>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <signal.h>
 #include <sys/prctl.h>
 #include <signal.h>
@@ -40,8 +43,20 @@ typedef struct {
   char **opts;
   int nb_opt;
   char *config_file;
+  gv_conf_launch_e launch;
+  gv_conf_ioreq_e ioreq;
+  gv_builder *builder;
+  char *tests_file;
 } gv_launcher_t;
 
+// Request received from the platform with the shared-memory transport. They
+// are recycled instead of being freed, so that their data buffer is reused.
+typedef struct gv_ioreq_host_req_s {
+  gv_ioreq_desc_t desc;
+  uint64_t capacity;
+  struct gv_ioreq_host_req_s *next;
+} gv_ioreq_host_req_t;
+
 typedef struct {
   int rcv_pipe[2];
   int snd_pipe[2];
@@ -50,6 +65,13 @@ typedef struct {
   FILE *snd_file;
   gv_ioreq_request_t callback;
   void *context;
+  // Shared-memory transport, NULL when pipes are used
+  gv_ioreq_shm_t *shm;
+  // Records sent to the platform, which never wait for room in the ring
+  gv_ioreq_backlog *to_fabric;
+  // Serializes the threads producing records to the platform
+  pthread_mutex_t shm_lock;
+  gv_ioreq_host_req_t *free_reqs;
 } gv_ioreq_binding_t;
 
 static pid_t child_id = -1;
@@ -57,6 +79,8 @@ static pid_t child_id = -1;
 void gv_init(gv_conf_t *gv_conf)
 {
   gv_conf->timing = GV_CONF_NO_TIMING;
+  gv_conf->launch = GV_CONF_LAUNCH_PULP_RUN;
+  gv_conf->ioreq = GV_CONF_IOREQ_SHM;
 }
 
 static void add_option(gv_launcher_t *gv, char *opt) {
@@ -73,9 +97,36 @@ void *gv_create(gv_conf_t *gv_conf, char *config_file)
   gv->opts = NULL;
   gv->nb_opt = 0;
   gv->config_file = strdup(config_file);
+  gv->launch = gv_conf->launch;
+  gv->ioreq = gv_conf->ioreq;
+  gv->builder = NULL;
+  gv->tests_file = NULL;
+
+  if (gv->launch == GV_CONF_LAUNCH_NATIVE)
+  {
+    // Parse the description now so that errors are reported to the caller and
+    // the child process does not have to do it
+    gv->builder = new gv_builder(config_file);
+    if (gv->builder->parse())
+    {
+      fprintf(stderr, "%s\n", gv->builder->get_error().c_str());
+      delete gv->builder;
+      free(gv->config_file);
+      free(gv);
+      return NULL;
+    }
+  }
 
   add_option(gv, (char *)"pulp-run");
 
+  if (gv_conf->timing == GV_CONF_FUNCTIONAL)
+  {
+    if (gv->builder)
+      gv->builder->set_functional(true);
+    else
+      add_option(gv, (char *)"--config-opt=**/gvsoc/functional=true");
+  }
+
   return (void *)gv;
 }
 
@@ -94,6 +145,36 @@ static void gv_process(gv_launcher_t *gv)
   }
 }
 
+static void gv_native_process(gv_launcher_t *gv)
+{
+  gv_builder *builder = gv->builder;
+
+  if (builder->build())
+  {
+    fprintf(stderr, "FATAL ERROR while building virtual platform: %s\n", builder->get_error().c_str());
+    builder->stop();
+    fflush(NULL);
+    _exit(-1);
+  }
+
+  int status;
+  if (gv->tests_file)
+  {
+    status = builder->fork_server(gv->tests_file);
+    if (status < 0)
+      fprintf(stderr, "FATAL ERROR while running fork server: %s\n", builder->get_error().c_str());
+    builder->stop();
+    status = status != 0 ? -1 : 0;
+  }
+  else
+  {
+    status = builder->run();
+  }
+
+  fflush(NULL);
+  _exit(status);
+}
+
 int gv_launch(void *handle)
 {
   gv_launcher_t *gv = (gv_launcher_t *)handle;
@@ -108,7 +189,10 @@ int gv_launch(void *handle)
     // test in case the original parent exited just
     // before the prctl() call
     if (getppid() != ppid_before_fork) exit(1);
-    gv_process(gv);
+    if (gv->launch == GV_CONF_LAUNCH_NATIVE)
+      gv_native_process(gv);
+    else
+      gv_process(gv);
     return 0;
   } else {
     //replyFile = fdopen(replyPipe[0], "r");
@@ -118,6 +202,36 @@ int gv_launch(void *handle)
   return 0;
 }
 
+int gv_fork_server(void *handle, char *tests_file)
+{
+  gv_launcher_t *gv = (gv_launcher_t *)handle;
+
+  if (gv->launch != GV_CONF_LAUNCH_NATIVE)
+    return -1;
+
+  gv->tests_file = strdup(tests_file);
+
+  return gv_launch(handle);
+}
+
+int gv_wait(void *handle)
+{
+  int status;
+
+  if (child_id == -1)
+    return -1;
+
+  if (waitpid(child_id, &status, 0) == -1)
+    return -1;
+
+  child_id = -1;
+
+  if (WIFEXITED(status))
+    return (int8_t)WEXITSTATUS(status);
+
+  return -1;
+}
+
 void gv_destroy(void *handle)
 {
   if (child_id != -1) {
@@ -181,24 +295,156 @@ static void *ioreq_routine(void *arg)
 }
 
 
+static void ioreq_shm_response(void *context, gv_ioreq_t *req)
+{
+  gv_ioreq_host_req_t *host_req = (gv_ioreq_host_req_t *)context;
+  gv_ioreq_desc_t *desc = &host_req->desc;
+  gv_ioreq_binding_t *binding = (gv_ioreq_binding_t *)desc->binding;
+
+  pthread_mutex_lock(&binding->shm_lock);
+
+  void *payload;
+  gv_ioreq_desc_t *resp = binding->to_fabric->reserve(desc->is_write ? 0 : desc->size, &payload);
+  if (resp != NULL)
+  {
+    *resp = *desc;
+    resp->type = GV_IOREQ_DESC_TYPE_RESPONSE;
+    resp->latency = req->latency;
+    resp->timestamp += req->latency;
+    if (!desc->is_write)
+      memcpy(payload, desc->data, desc->size);
+    binding->to_fabric->commit();
+  }
+
+  host_req->next = binding->free_reqs;
+  binding->free_reqs = host_req;
+
+  pthread_mutex_unlock(&binding->shm_lock);
+}
+
+static gv_ioreq_host_req_t *ioreq_shm_alloc(gv_ioreq_binding_t *binding, uint64_t size)
+{
+  pthread_mutex_lock(&binding->shm_lock);
+  gv_ioreq_host_req_t *host_req = binding->free_reqs;
+  if (host_req != NULL)
+    binding->free_reqs = host_req->next;
+  pthread_mutex_unlock(&binding->shm_lock);
+
+  if (host_req == NULL)
+  {
+    host_req = (gv_ioreq_host_req_t *)malloc(sizeof(gv_ioreq_host_req_t));
+    if (host_req == NULL) return NULL;
+    host_req->capacity = 0;
+    host_req->desc.data = NULL;
+  }
+
+  if (host_req->capacity < size)
+  {
+    void *data = realloc(host_req->desc.data, size);
+    if (data == NULL) return NULL;
+    host_req->desc.data = data;
+    host_req->capacity = size;
+  }
+
+  return host_req;
+}
+
+static void *ioreq_shm_routine(void *arg)
+{
+  gv_ioreq_binding_t *binding = (gv_ioreq_binding_t *)arg;
+  gv_ioreq_ring *ring = &binding->shm->to_host;
+  bool pending = false;
+
+  while(1)
+  {
+    // Records which did not fit in the ring are sent again periodically
+    int count = ring->wait(pending ? GV_IOREQ_RING_RETRY_US : -1);
+
+    for (int i=0; i<count; i++)
+    {
+      // Each record is released as soon as it is copied, so that the platform
+      // can go on sending records while the callbacks are executed
+      void *payload;
+      gv_ioreq_desc_t *req = ring->get(0, &payload);
+
+      if (req->type == GV_IOREQ_DESC_TYPE_RESPONSE)
+      {
+        // Fabric side sent us a response for a host->fabric request
+        gv_ioreq_desc_t resp = *req;
+        if (!resp.is_write) memcpy(resp.data, payload, resp.size);
+        ring->release(1);
+
+        if (resp.response_cb != NULL) {
+          resp.response_cb(resp.response_context, &resp.user_req);
+        }
+      }
+      else
+      {
+        gv_ioreq_host_req_t *host_req = ioreq_shm_alloc(binding, req->size);
+        if (host_req == NULL) return NULL;
+
+        void *data = host_req->desc.data;
+        host_req->desc = *req;
+        host_req->desc.data = data;
+        if (req->is_write) memcpy(data, payload, req->size);
+        ring->release(1);
+
+        if (binding->callback != NULL) {
+          binding->callback(binding->context, data, (void *)host_req->desc.addr, host_req->desc.size,
+            host_req->desc.is_write, ioreq_shm_response, (void *)host_req);
+        }
+      }
+    }
+
+    pthread_mutex_lock(&binding->shm_lock);
+    pending = !binding->to_fabric->flush();
+    pthread_mutex_unlock(&binding->shm_lock);
+  }
+}
+
+
 void *gv_ioreq_binding(void *handle, char *path, void *base, size_t size, gv_ioreq_request_t callback, void *context)
 {
   gv_launcher_t *gv = (gv_launcher_t *)handle;
 
+  // External bindings are declared through pulp-run options, which are not
+  // available when the platform is built natively.
+  if (gv->launch == GV_CONF_LAUNCH_NATIVE)
+    return NULL;
+
   gv_ioreq_binding_t *binding = (gv_ioreq_binding_t *)malloc(sizeof(gv_ioreq_binding_t));
   if (binding == NULL) return NULL;
 
   binding->callback = callback;
   binding->context = context;
+  binding->shm = NULL;
+  binding->to_fabric = NULL;
+  binding->snd_file = NULL;
+  binding->free_reqs = NULL;
+
+  std::string str;
+
+  if (gv->ioreq == GV_CONF_IOREQ_SHM)
+  {
+    int shm_fd = gv_ioreq_shm_create(&binding->shm);
+    if (shm_fd == -1) return NULL;
+    binding->to_fabric = new gv_ioreq_backlog(&binding->shm->to_fabric, &binding->shm->to_host);
+    pthread_mutex_init(&binding->shm_lock, NULL);
+
+    str = "--config-opt=**/" + std::string(path) + "/shm_fd=" + std::to_string(shm_fd);
+    add_option(gv, strdup((char *)str.c_str()));
+  }
+  else
+  {
+    if(pipe(binding->snd_pipe) == -1) return NULL;
+    if(pipe(binding->rcv_pipe) == -1) return NULL;
 
-  if(pipe(binding->snd_pipe) == -1) return NULL;
-  if(pipe(binding->rcv_pipe) == -1) return NULL;
-
-  std::string str = "--config-opt=**/" + std::string(path) + "/rcv_fd=" + std::to_string(binding->snd_pipe[0]);
-  add_option(gv, strdup((char *)str.c_str()));
+    str = "--config-opt=**/" + std::string(path) + "/rcv_fd=" + std::to_string(binding->snd_pipe[0]);
+    add_option(gv, strdup((char *)str.c_str()));
 
-  str = "--config-opt=**/" + std::string(path) + "/snd_fd=" + std::to_string(binding->rcv_pipe[1]);
-  add_option(gv, strdup((char *)str.c_str()));
+    str = "--config-opt=**/" + std::string(path) + "/snd_fd=" + std::to_string(binding->rcv_pipe[1]);
+    add_option(gv, strdup((char *)str.c_str()));
+  }
 
   str = "--config-opt=**/" + std::string(path) + "/external_binding/base=" + std::to_string((int64_t)base);
   add_option(gv, strdup((char *)str.c_str()));
@@ -210,10 +456,18 @@ void *gv_ioreq_binding(void *handle, char *path, void *base, size_t size, gv_ior
   add_option(gv, strdup((char *)str.c_str()));
 
   binding->gv = (gv_launcher_t *)handle;
-  binding->snd_file = fdopen(binding->snd_pipe[1], "w");
-  if (binding->snd_file == NULL) return NULL;
 
-  pthread_create(&binding->thread, NULL, ioreq_routine, (void *)binding);
+  if (binding->shm)
+  {
+    pthread_create(&binding->thread, NULL, ioreq_shm_routine, (void *)binding);
+  }
+  else
+  {
+    binding->snd_file = fdopen(binding->snd_pipe[1], "w");
+    if (binding->snd_file == NULL) return NULL;
+
+    pthread_create(&binding->thread, NULL, ioreq_routine, (void *)binding);
+  }
   
   return (gv_ioreq_binding_t *)binding;
 }
@@ -222,6 +476,31 @@ int gv_ioreq(void *_binding, int64_t timestamp, void *data, void *addr, size_t s
 {
   gv_ioreq_binding_t *binding = (gv_ioreq_binding_t *)_binding;
 
+  if (binding->shm)
+  {
+    pthread_mutex_lock(&binding->shm_lock);
+
+    void *payload;
+    gv_ioreq_desc_t *desc = binding->to_fabric->reserve(is_write ? size : 0, &payload);
+    if (desc == NULL)
+    {
+      pthread_mutex_unlock(&binding->shm_lock);
+      return -1;
+    }
+
+    *desc = { .type=GV_IOREQ_DESC_TYPE_REQUEST, .addr=(uint64_t)addr, .size=(uint64_t)size, .is_write=(int64_t)is_write, .timestamp=timestamp,
+      .response_cb=callback, .response_context=context
+    };
+    desc->data = data;
+    if (is_write) memcpy(payload, data, size);
+
+    binding->to_fabric->commit();
+
+    pthread_mutex_unlock(&binding->shm_lock);
+
+    return 0;
+  }
+
   gv_ioreq_desc_t desc = { .type=GV_IOREQ_DESC_TYPE_REQUEST, .addr=(uint64_t)addr, .size=(uint64_t)size, .is_write=(int64_t)is_write, .timestamp=timestamp,
     .response_cb=callback, .response_context=context
   };
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Hit path of the cache model for each specialized geometry and replacement
+// policy, compared to the generic path. The cache is filled with a working
+// set which fits in it, and then accessed at addresses spread over all the
+// ways.
+//
+// Usage: gvsoc-cache-bench [<number of accesses>]
+
+#include "cache_core.hpp"
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+#define BENCH_NB_SETS_BITS 6
+
+
+static int64_t get_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
+static double bench_hits(cache_storage *c, std::vector<uint32_t> &addrs, int64_t nb_accesses)
+{
+  typedef cache_access<LINE_SIZE_BITS, NB_WAYS_BITS, REPLACEMENT> access;
+
+  // Fill the cache with the working set, using the invalid ways so that no
+  // line is evicted whatever the policy
+  for (uint32_t addr: addrs)
+  {
+    uint32_t tag = addr >> access::line_size_bits(c);
+    unsigned int set = tag & (c->nb_sets - 1);
+    int way = access::lookup(c, set, (uint32_t)-1);
+    c->tags[(set << access::nb_ways_bits(c)) + way] = tag;
+    access::touch(c, set, way);
+  }
+
+  unsigned int nb_addrs = addrs.size();
+  uint32_t checksum = 0;
+  int64_t start = get_time_ns();
+
+  for (int64_t i=0; i<nb_accesses; i++)
+  {
+    uint32_t addr = addrs[i & (nb_addrs - 1)];
+    uint32_t tag = addr >> access::line_size_bits(c);
+    unsigned int set = tag & (c->nb_sets - 1);
+    int way = access::lookup(c, set, tag);
+    if (way < 0)
+    {
+      fprintf(stderr, "Unexpected miss (addr: 0x%x)\n", addr);
+      abort();
+    }
+    access::touch(c, set, way);
+    checksum += *access::line_data(c, set, way);
+  }
+
+  int64_t duration = get_time_ns() - start;
+
+  if (checksum == 0xffffffff)
+    printf("\n");
+
+  return (double)duration / nb_accesses;
+}
+
+template<cache_replacement_e REPLACEMENT>
+static void bench_policy(const char *name, int line_size_bits, int nb_ways_bits, int64_t nb_accesses)
+{
+  cache_storage specialized(BENCH_NB_SETS_BITS, nb_ways_bits, line_size_bits);
+  cache_storage generic(BENCH_NB_SETS_BITS, nb_ways_bits, line_size_bits);
+
+  // One address per line, in an order which visits the sets one after the
+  // other, so that consecutive accesses hit different ways
+  std::vector<uint32_t> addrs;
+  unsigned int nb_lines = 1 << (BENCH_NB_SETS_BITS + nb_ways_bits);
+  for (unsigned int i=0; i<nb_lines; i++)
+  {
+    uint32_t line = ((i * 7) & (nb_lines - 1));
+    addrs.push_back((line << line_size_bits) + 0x1c000000);
+  }
+
+  double specialized_ns = -1;
+
+#define CACHE_GEOMETRY_BENCH(line_bits, ways_bits) \
+  if (line_size_bits == line_bits && nb_ways_bits == ways_bits) \
+    specialized_ns = bench_hits<line_bits, ways_bits, REPLACEMENT>(&specialized, addrs, nb_accesses);
+
+  CACHE_GEOMETRIES(CACHE_GEOMETRY_BENCH)
+
+#undef CACHE_GEOMETRY_BENCH
+
+  double generic_ns = bench_hits<CACHE_GENERIC, CACHE_GENERIC, REPLACEMENT>(&generic, addrs, nb_accesses);
+
+  printf("line %3d ways %d %-7s specialized %6.2f ns/hit  generic %6.2f ns/hit\n", 1 << line_size_bits, 1 << nb_ways_bits,
+    name, specialized_ns, generic_ns);
+}
+
+int main(int argc, char *argv[])
+{
+  int64_t nb_accesses = argc > 1 ? atoll(argv[1]) : 20000000;
+
+#define CACHE_GEOMETRY_RUN(line_bits, ways_bits) \
+  bench_policy<CACHE_REPLACEMENT_RANDOM>("random", line_bits, ways_bits, nb_accesses); \
+  bench_policy<CACHE_REPLACEMENT_LRU>("lru", line_bits, ways_bits, nb_accesses); \
+  bench_policy<CACHE_REPLACEMENT_PLRU>("plru", line_bits, ways_bits, nb_accesses);
+
+  CACHE_GEOMETRIES(CACHE_GEOMETRY_RUN)
+
+#undef CACHE_GEOMETRY_RUN
+
+  return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __CACHE_CACHE_CORE_HPP
+#define __CACHE_CACHE_CORE_HPP
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Geometries (line_size_bits, nb_ways_bits) for which the cache access is
+// specialized at compile time. Other geometries go through the generic
+// path, where they are read from the cache storage.
+#define CACHE_GEOMETRIES(X) \
+  X(4, 0) X(4, 1) X(4, 2) X(4, 3) \
+  X(5, 0) X(5, 1) X(5, 2) X(5, 3) \
+  X(6, 0) X(6, 1) X(6, 2) X(6, 3)
+
+// Template value selecting the generic path
+#define CACHE_GENERIC -1
+
+
+typedef enum
+{
+  // Pseudo-random way, from the 8 bits LFSR used on GAP FC icache
+  CACHE_REPLACEMENT_RANDOM,
+  // Least recently used way
+  CACHE_REPLACEMENT_LRU,
+  // Tree-based pseudo least recently used way
+  CACHE_REPLACEMENT_PLRU
+} cache_replacement_e;
+
+
+// Storage of a set-associative cache. The tags of a set are contiguous and
+// kept apart from the data so that all the ways are compared at once, and
+// the data of all the lines is in a single arena.
+class cache_storage
+{
+public:
+  inline cache_storage(unsigned int nb_sets_bits, unsigned int nb_ways_bits, unsigned int line_size_bits);
+  inline ~cache_storage();
+
+  // Invalidate all the lines
+  inline void flush();
+
+  unsigned int nb_sets_bits;
+  unsigned int nb_ways_bits;
+  unsigned int line_size_bits;
+  unsigned int nb_sets;
+  unsigned int nb_ways;
+
+  // Tag of each line, set by set, -1 when the line is invalid. The tag is
+  // the line address.
+  uint32_t *tags;
+  // Data of each line, set by set
+  uint8_t *data;
+  // LRU age of each line, set by set, 0 being the most recently used
+  uint8_t *lru_age;
+  // Pseudo-LRU tree of each set, node i being bit i, root is node 1
+  uint32_t *plru_tree;
+  // Random replacement state
+  uint8_t lfsr;
+};
+
+
+// Access to the cache storage, specialized at compile time for a geometry
+// and a replacement policy. CACHE_GENERIC can be given for line_size_bits
+// and nb_ways_bits to read them from the storage instead.
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
+class cache_access
+{
+public:
+  static inline unsigned int line_size_bits(cache_storage *c) { return LINE_SIZE_BITS >= 0 ? LINE_SIZE_BITS : c->line_size_bits; }
+  static inline unsigned int nb_ways_bits(cache_storage *c) { return NB_WAYS_BITS >= 0 ? NB_WAYS_BITS : c->nb_ways_bits; }
+  static inline unsigned int nb_ways(cache_storage *c) { return 1 << nb_ways_bits(c); }
+
+  // Return the way of the set holding the tag, or -1
+  static inline int lookup(cache_storage *c, unsigned int set, uint32_t tag);
+
+  // Update the replacement state after an access to a way
+  static inline void touch(cache_storage *c, unsigned int set, int way);
+
+  // Return the way to be refilled
+  static inline int victim(cache_storage *c, unsigned int set);
+
+  static inline uint8_t *line_data(cache_storage *c, unsigned int set, int way)
+  {
+    return &c->data[((set << nb_ways_bits(c)) + way) << line_size_bits(c)];
+  }
+};
+
+
+
+inline cache_storage::cache_storage(unsigned int nb_sets_bits, unsigned int nb_ways_bits, unsigned int line_size_bits)
+: nb_sets_bits(nb_sets_bits), nb_ways_bits(nb_ways_bits), line_size_bits(line_size_bits)
+{
+  this->nb_sets = 1 << nb_sets_bits;
+  this->nb_ways = 1 << nb_ways_bits;
+
+  unsigned int nb_lines = this->nb_sets * this->nb_ways;
+
+  // Tags are aligned so that they can be loaded by groups of 4 ways
+  if (posix_memalign((void **)&this->tags, 64, nb_lines * sizeof(uint32_t)) != 0 ||
+    posix_memalign((void **)&this->data, 64, nb_lines << line_size_bits) != 0)
+  {
+    abort();
+  }
+
+  this->lru_age = new uint8_t[nb_lines];
+  this->plru_tree = new uint32_t[this->nb_sets];
+  this->lfsr = 0;
+
+  memset(this->data, 0, nb_lines << line_size_bits);
+
+  this->flush();
+}
+
+inline cache_storage::~cache_storage()
+{
+  free(this->tags);
+  free(this->data);
+  delete[] this->lru_age;
+  delete[] this->plru_tree;
+}
+
+inline void cache_storage::flush()
+{
+  memset(this->tags, 0xff, this->nb_sets * this->nb_ways * sizeof(uint32_t));
+
+  for (unsigned int i=0; i<this->nb_sets; i++)
+  {
+    for (unsigned int j=0; j<this->nb_ways; j++)
+    {
+      this->lru_age[i*this->nb_ways + j] = this->nb_ways - 1 - j;
+    }
+    this->plru_tree[i] = 0;
+  }
+}
+
+
+
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
+inline int cache_access<LINE_SIZE_BITS, NB_WAYS_BITS, REPLACEMENT>::lookup(cache_storage *c, unsigned int set, uint32_t tag)
+{
+  unsigned int ways = nb_ways(c);
+  const uint32_t *tags = &c->tags[set << nb_ways_bits(c)];
+
+#if defined(__SSE2__)
+  if (ways >= 4)
+  {
+    __m128i key = _mm_set1_epi32(tag);
+    for (unsigned int i=0; i<ways; i+=4)
+    {
+      __m128i cmp = _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)&tags[i]), key);
+      int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+    return -1;
+  }
+#endif
+
+  for (unsigned int i=0; i<ways; i++)
+  {
+    if (tags[i] == tag)
+      return i;
+  }
+
+  return -1;
+}
+
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
+inline void cache_access<LINE_SIZE_BITS, NB_WAYS_BITS, REPLACEMENT>::touch(cache_storage *c, unsigned int set, int way)
+{
+  if (REPLACEMENT == CACHE_REPLACEMENT_LRU)
+  {
+    uint8_t *age = &c->lru_age[set << nb_ways_bits(c)];
+    uint8_t way_age = age[way];
+
+    if (way_age == 0)
+      return;
+
+    for (unsigned int i=0; i<nb_ways(c); i++)
+    {
+      age[i] += age[i] < way_age;
+    }
+    age[way] = 0;
+  }
+  else if (REPLACEMENT == CACHE_REPLACEMENT_PLRU)
+  {
+    // Each node on the path of the way is pointed to the other half
+    uint32_t tree = c->plru_tree[set];
+    unsigned int node = 1;
+    for (int level=nb_ways_bits(c)-1; level>=0; level--)
+    {
+      unsigned int bit = (way >> level) & 1;
+      tree = (tree & ~(1U << node)) | ((bit ^ 1) << node);
+      node = (node << 1) | bit;
+    }
+    c->plru_tree[set] = tree;
+  }
+}
+
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
+inline int cache_access<LINE_SIZE_BITS, NB_WAYS_BITS, REPLACEMENT>::victim(cache_storage *c, unsigned int set)
+{
+  if (REPLACEMENT == CACHE_REPLACEMENT_LRU)
+  {
+    uint8_t *age = &c->lru_age[set << nb_ways_bits(c)];
+    for (unsigned int i=0; i<nb_ways(c); i++)
+    {
+      if (age[i] == nb_ways(c) - 1)
+        return i;
+    }
+    return 0;
+  }
+  else if (REPLACEMENT == CACHE_REPLACEMENT_PLRU)
+  {
+    uint32_t tree = c->plru_tree[set];
+    unsigned int node = 1;
+    for (unsigned int level=0; level<nb_ways_bits(c); level++)
+    {
+      node = (node << 1) | ((tree >> node) & 1);
+    }
+    return node - nb_ways(c);
+  }
+  else
+  {
+    int linear_feedback = !(((c->lfsr >> 7) & 1) ^ ((c->lfsr >> 3) & 1) ^ ((c->lfsr >> 2) & 1) ^ ((c->lfsr >> 1) & 1)); // TAPS for XOR feedback
+
+    c->lfsr = (c->lfsr << 1) | (linear_feedback & 1);
+
+    return (c->lfsr >> 1) & (nb_ways(c) - 1);
+  }
+}
+
+#endif
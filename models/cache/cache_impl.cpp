@@ -22,16 +22,7 @@
 #include <vp/itf/io.hpp>
 #include <vector>
 #include <sstream>
-
-
-
-typedef struct
-{
-  uint32_t tag;
-  bool dirty;
-  uint8_t *data;
-  vp::trace tag_event;
-} cache_line_t;
+#include "cache_core.hpp"
 
 
 
@@ -43,6 +34,7 @@ class Cache : public vp::component {
 public:
 
   Cache(const char *config);
+  ~Cache();
 
   unsigned int nb_ways_bits = 2;
   unsigned int line_size_bits = 5;
@@ -60,6 +52,8 @@ public:
 
 private:
 
+  typedef vp::io_req_status_e (*req_meth_t)(void *__this, vp::io_req *req, int port);
+
   vp::trace     trace;
 
   std::vector<vp::io_slave> input_itf;
@@ -72,10 +66,6 @@ private:
   vp::io_req refill_req;
 
   int64_t nextPacketStart;
-  unsigned int R1;
-  unsigned int R2;
-
-  uint8_t lru_out;
 
   uint32_t line_offset_mask;
   uint32_t line_index_mask;
@@ -84,15 +74,21 @@ private:
   vp::trace refill_event;
   std::vector<vp::trace> io_event;
 
-  cache_line_t *lines;
+  cache_replacement_e replacement;
+  cache_storage *storage = NULL;
+  // Tag event of each line, set by set, only used for VCD traces
+  std::vector<vp::trace> tag_events;
 
   static void enable_sync(void *_this, bool active);
   static void flush_sync(void *_this, bool active);
   static void flush_line_sync(void *_this, bool active);
   static void flush_line_addr_sync(void *_this, uint32_t addr);
 
+  template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
   static vp::io_req_status_e req(void *__this, vp::io_req *req, int port);
-  static vp::io_req_status_e req_l16_w4(void *__this, vp::io_req *req, int port);
+
+  template<cache_replacement_e REPLACEMENT>
+  static req_meth_t get_req_meth(unsigned int line_size_bits, unsigned int nb_ways_bits);
 
   inline unsigned int getLineAddr(unsigned int addr) {return addr >> line_size_bits;}
   inline unsigned int get_line_base(unsigned int addr) {return addr & ~((1<<line_size_bits)-1);}
@@ -101,9 +97,8 @@ private:
   inline unsigned int get_line_offset(unsigned int addr) {return addr & ((1 << line_size_bits) - 1);}
   inline unsigned int getAddr(unsigned int index, unsigned int tag) {return (tag << (line_size_bits + nb_sets_bits)) | (index << line_size_bits);}
 
-  cache_line_t *refill(int line_index, unsigned int addr, unsigned int tag, vp::io_req *req);
+  int refill(int line_index, int way, uint8_t *line_data, unsigned int addr, unsigned int tag, vp::io_req *req);
 
-  unsigned int stepLru();
   bool ioReq(vp::io_req *req, int i);
   void enable(bool enable);
   void flush();
@@ -112,6 +107,22 @@ private:
 
 
 
+template<cache_replacement_e REPLACEMENT>
+Cache::req_meth_t Cache::get_req_meth(unsigned int line_size_bits, unsigned int nb_ways_bits)
+{
+#define CACHE_GEOMETRY_METH(line_bits, ways_bits) \
+  if (line_size_bits == line_bits && nb_ways_bits == ways_bits) \
+    return &Cache::req<line_bits, ways_bits, REPLACEMENT>;
+
+  CACHE_GEOMETRIES(CACHE_GEOMETRY_METH)
+
+#undef CACHE_GEOMETRY_METH
+
+  return &Cache::req<CACHE_GENERIC, CACHE_GENERIC, REPLACEMENT>;
+}
+
+
+
 int Cache::build()
 {
   this->nb_ports = this->get_js_config()->get_child_int("nb_ports");
@@ -122,19 +133,49 @@ int Cache::build()
   this->nb_sets = 1 << this->nb_sets_bits;
   this->line_size = 1 << this->line_size_bits;
 
-  this->input_itf.resize(this->nb_ports);
+  this->replacement = CACHE_REPLACEMENT_RANDOM;
+  js::config *replacement_config = this->get_js_config("replacement");
+  if (replacement_config != NULL)
+  {
+    std::string replacement = replacement_config->get_str();
+    if (replacement == "lru")
+      this->replacement = CACHE_REPLACEMENT_LRU;
+    else if (replacement == "plru")
+      this->replacement = CACHE_REPLACEMENT_PLRU;
+    else if (replacement != "random")
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Unknown cache replacement policy (policy: %s)", replacement.c_str());
+      return -1;
+    }
+  }
 
-  this->R1 = 0xd3b6;
-  this->R2 = 0x7775;
+  // The replacement state of a set is a 32 bits tree for pseudo-LRU, and
+  // one byte per way for LRU
+  if (this->replacement == CACHE_REPLACEMENT_PLRU && this->nb_ways_bits > 5)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Pseudo-LRU replacement is limited to 32 ways (nb_ways: %d)", this->nb_ways);
+    return -1;
+  }
+
+  if (this->replacement == CACHE_REPLACEMENT_LRU && this->nb_ways_bits > 8)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "LRU replacement is limited to 256 ways (nb_ways: %d)", this->nb_ways);
+    return -1;
+  }
 
-  this->lru_out = 0;
+  this->input_itf.resize(this->nb_ports);
+
+  req_meth_t req_meth;
+  if (this->replacement == CACHE_REPLACEMENT_LRU)
+    req_meth = get_req_meth<CACHE_REPLACEMENT_LRU>(this->line_size_bits, this->nb_ways_bits);
+  else if (this->replacement == CACHE_REPLACEMENT_PLRU)
+    req_meth = get_req_meth<CACHE_REPLACEMENT_PLRU>(this->line_size_bits, this->nb_ways_bits);
+  else
+    req_meth = get_req_meth<CACHE_REPLACEMENT_RANDOM>(this->line_size_bits, this->nb_ways_bits);
 
   for (int i=0; i<nb_ports; i++)
   {
-    if (this->nb_ways == 4 && this->line_size == 16)
-      this->input_itf[i].set_req_meth_muxed(&Cache::req_l16_w4, i);
-    else
-      this->input_itf[i].set_req_meth_muxed(&Cache::req, i);
+    this->input_itf[i].set_req_meth_muxed(req_meth, i);
     this->new_slave_port("input_" + std::to_string(i), &this->input_itf[i]);
   }
 
@@ -163,15 +204,15 @@ int Cache::build()
 
   traces.new_trace_event("refill", &this->refill_event, 32);
 
-  lines = new cache_line_t[(1<<this->nb_sets_bits)*this->nb_ways];
-  for (int i=0; i<1<<this->nb_sets_bits; i++)
+  this->storage = new cache_storage(this->nb_sets_bits, this->nb_ways_bits, this->line_size_bits);
+
+  // The tag events are kept as the generated GTKWave view shows them
+  this->tag_events.resize(this->nb_sets*this->nb_ways);
+  for (unsigned int i=0; i<this->nb_sets; i++)
   {
-    for (int j=0; j<this->nb_ways; j++)
+    for (unsigned int j=0; j<this->nb_ways; j++)
     {
-      cache_line_t *line = &lines[i*this->nb_ways+j];
-      line->tag = -1;
-      line->data = new uint8_t[1<<this->line_size_bits];
-      traces.new_trace_event("set_" + std::to_string(j) + "/line_" + std::to_string(i), &line->tag_event, 32);
+      traces.new_trace_event("set_" + std::to_string(j) + "/line_" + std::to_string(i), &this->tag_events[i*this->nb_ways+j], 32);
     }
   }
 
@@ -190,38 +231,15 @@ void Cache::start()
 
 
 
-cache_line_t *Cache::refill(int line_index, unsigned int addr, unsigned int tag, vp::io_req *req)
+int Cache::refill(int line_index, int way, uint8_t *line_data, unsigned int addr, unsigned int tag, vp::io_req *req)
 {
-  unsigned int refillWay;
-
-#if 1
-  refillWay = this->stepLru() % this->nb_ways;
-#else
-  int electedAge = 0;
-  int elected = -1;
-  // Go through all lines to find the oldest one
-  // At the same, decrease the age for everyone
-  for (int i=0; i<1<<cache->nb_ways_bits; i++) {
-    if (elected == -1 || linesAge[i] < electedAge) {
-      electedAge = linesAge[i];
-      elected = i;
-    }
-    if (linesAge[i]) linesAge[i]--;
-  }
-  // Set age of elected one to the max
-  linesAge[elected] = (1<<cache->nb_ways_bits) - 1;
-  refillWay = elected;
-#endif
-
-  cache_line_t *line = &this->lines[line_index*this->nb_ways + refillWay];
-
   uint32_t full_addr = this->get_line_base(addr);
 
-  this->trace.msg("Refilling line (addr: 0x%x, index: %d)\n", full_addr, line_index);
+  this->trace.msg("Refilling line (addr: 0x%x, index: %d, way: %d)\n", full_addr, line_index, way);
   // Flush the line in case it is dirty to copy it back outside
   //flush();
 
-  line->tag_event.event((uint8_t *)&full_addr);
+  this->tag_events[line_index*this->nb_ways + way].event((uint8_t *)&full_addr);
 
   // And get the data from outside
   vp::io_req *refill_req = &this->refill_req;
@@ -229,20 +247,22 @@ cache_line_t *Cache::refill(int line_index, unsigned int addr, unsigned int tag,
   refill_req->set_addr(full_addr);
   refill_req->set_is_write(false);
   refill_req->set_size(1<<this->line_size_bits);
-  refill_req->set_data(line->data);
+  refill_req->set_data(line_data);
 
   vp::io_req_status_e err = this->refill_itf.req(refill_req);
   if (err != vp::IO_REQ_OK)
   {
     this->warning.force_warning("UNIMPLEMENTED AT %s %d\n", __FILE__, __LINE__);
-    return NULL;
+    return -1;
   }
 
-  req->set_latency(refill_req->get_full_latency());
+  // Misses are not timed in functional mode
+  if (vp_timing_enabled)
+    req->set_latency(refill_req->get_full_latency());
 
-  line->tag = tag;
+  this->storage->tags[(line_index << this->nb_ways_bits) + way] = tag;
 
-  return line;
+  return 0;
 }
 
 
@@ -252,11 +272,11 @@ void Cache::flush_line(unsigned int addr)
   this->trace.msg("Flushing cache line (addr: 0x%x)\n", addr);
   unsigned int tag = addr >> this->line_size_bits;
   unsigned int line_index = this->get_line_index(addr);
-  for (int i=0; i<this->nb_ways; i++)
+  for (unsigned int i=0; i<this->nb_ways; i++)
   {
-    cache_line_t *line = &this->lines[line_index*this->nb_ways + i];
-    if (line->tag == tag)
-      line->tag= -1;
+    uint32_t *line_tag = &this->storage->tags[line_index*this->nb_ways + i];
+    if (*line_tag == tag)
+      *line_tag = -1;
   }
 }
 
@@ -265,13 +285,7 @@ void Cache::flush_line(unsigned int addr)
 void Cache::flush()
 {
   this->trace.msg("Flushing whole cache\n");
-  for (int i=0; i<1<<this->nb_sets; i++)
-  {
-    for (int j=0; i<j<<this->nb_ways; j++)
-    {
-      this->lines[i*this->nb_ways+j].tag = -1;;
-    }
-  }
+  this->storage->flush();
 }
 
 
@@ -284,9 +298,13 @@ void Cache::enable(bool enable) {
     this->trace.msg("Disabling cache\n");
 }
 
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT>
 vp::io_req_status_e Cache::req(void *__this, vp::io_req *req, int port)
 {
+  typedef cache_access<LINE_SIZE_BITS, NB_WAYS_BITS, REPLACEMENT> access;
+
   Cache *_this = (Cache *)__this;
+  cache_storage *storage = _this->storage;
 
   uint64_t offset = req->get_addr();
   uint8_t *data = req->get_data();
@@ -300,149 +318,48 @@ vp::io_req_status_e Cache::req(void *__this, vp::io_req *req, int port)
   
   _this->io_event[port].event((uint8_t *)&offset);
 
-  unsigned int nb_sets = _this->nb_sets;
-  unsigned int nb_ways = _this->nb_ways;
-  unsigned int line_size = 1 << _this->line_size_bits;
+  const unsigned int line_size_bits = access::line_size_bits(storage);
+  const unsigned int line_size = 1 << line_size_bits;
 
-  unsigned int tag = offset >> _this->line_size_bits;
-  unsigned int line_index = tag & (nb_sets - 1);
-  unsigned int line_offset = offset & (line_size - 1);
+  const unsigned int tag = offset >> line_size_bits;
+  const unsigned int line_index = tag & (storage->nb_sets - 1);
+  const unsigned int line_offset = offset & (line_size - 1);
 
   _this->trace.msg("Cache access (is_write: %d, offset: 0x%x, size: 0x%x, tag: 0x%x, line_index: %d, line_offset: 0x%x)\n", is_write, offset, size, offset, line_index, line_offset);
 
-  cache_line_t *hit_line = NULL;
-  cache_line_t *line = &_this->lines[line_index*nb_ways];
+  int way = access::lookup(storage, line_index, tag);
 
-  for (int i=0; i<nb_ways; i++)
+  if (likely(way >= 0))
   {
-    if (line->tag == tag)
-    {
-      _this->trace.msg("Cache hit (way: %d)\n", i);
-      hit_line = line;
-      break;
-    }
-    line++;
+    _this->trace.msg("Cache hit (way: %d)\n", way);
   }
-
-  if (hit_line == NULL)
+  else
   {
     _this->trace.msg("Cache miss\n");
     _this->refill_event.event((uint8_t *)&offset);
-    hit_line = _this->refill(line_index, offset, tag, req);
-    if (hit_line == NULL)
+    way = access::victim(storage, line_index);
+    if (_this->refill(line_index, way, access::line_data(storage, line_index, way), offset, tag, req))
       return vp::IO_REQ_INVALID;
   }
 
-  if (data)
-  {
-    if (!is_write) {
-      memcpy(data, (void *)hit_line->data, size);
-    } else {
-      //hitLine->setDirty();
-      memcpy((void *)hit_line->data, data, size);
-    }
-  }
+  access::touch(storage, line_index, way);
 
-  return vp::IO_REQ_OK;
-}
-
-
-
-vp::io_req_status_e Cache::req_l16_w4(void *__this, vp::io_req *req, int port)
-{
-  Cache *_this = (Cache *)__this;
-
-  uint64_t offset = req->get_addr();
-  uint8_t *data = req->get_data();
-  uint64_t size = req->get_size();
-  bool is_write = req->get_is_write();
-
-  _this->trace.msg("Received req (port: %d, is_write: %d, offset: 0x%x, size: 0x%x)\n", port, is_write, offset, size);
-
-  if (!_this->enabled)
-    return _this->refill_itf.req_forward(req);
-  
-  _this->io_event[port].event((uint8_t *)&offset);
-
-  const unsigned int line_size_bits = 4;
-  const unsigned int nb_sets = _this->nb_sets;
-  const unsigned int nb_ways = 4;
-  const unsigned int line_size = 16;
-
-  const unsigned int tag = offset >> line_size_bits;
-  const unsigned int line_index = tag & (nb_sets - 1);
-  const unsigned int line_offset = offset & (line_size - 1);
-
-  _this->trace.msg("Cache access (is_write: %d, offset: 0x%x, size: 0x%x, tag: 0x%x, line_index: %d, line_offset: 0x%x)\n", is_write, offset, size, offset, line_index, line_offset);
-
-  cache_line_t *line = &_this->lines[line_index*nb_ways];
-
-  // This case is the mostly used by the ISS and is thus the most optimized.
-  // The ISS will most of the time call the cache without data, just the model the timing
-  // in case there is a miss.
-  if (likely(!data))
-  {
-    if (tag != line[0].tag && tag != line[1].tag && tag != line[2].tag && tag != line[3].tag)
-    {
-      _this->trace.msg("Cache miss\n");
-      _this->refill_event.event((uint8_t *)&offset);
-      if (_this->refill(line_index, offset, tag, req) == NULL)
-        return vp::IO_REQ_INVALID;
-    }
-  }
-  else
+  // The ISS will most of the time call the cache without data, just to model
+  // the timing in case there is a miss.
+  if (data)
   {
-    cache_line_t *hit_line;
-
-    if (tag == line[0].tag) hit_line = &line[0];
-    else if (tag == line[1].tag) hit_line = &line[1];
-    else if (tag == line[2].tag) hit_line = &line[2];
-    else if (tag == line[3].tag) hit_line = &line[3];
-    else
-    {
-      _this->trace.msg("Cache miss\n");
-      _this->refill_event.event((uint8_t *)&offset);
-      hit_line = _this->refill(line_index, offset, tag, req);
-      if (hit_line == NULL)
-        return vp::IO_REQ_INVALID;
-    }
-
+    uint8_t *line_data = access::line_data(storage, line_index, way) + line_offset;
     if (!is_write) {
-      memcpy(data, (void *)hit_line->data, size);
+      memcpy(data, (void *)line_data, size);
     } else {
       //hitLine->setDirty();
-      memcpy((void *)hit_line->data, data, size);
+      memcpy((void *)line_data, data, size);
     }
   }
 
   return vp::IO_REQ_OK;
 }
 
-unsigned int Cache::stepLru()
-{
-  if (1)
-  {
-    // 8 bits LFSR used on GAP FC icache
-    int linear_feedback = !(((this->lru_out >> 7) & 1) ^ ((this->lru_out >> 3) & 1) ^ ((this->lru_out >> 2) & 1) ^ ((this->lru_out >> 1) & 1)); // TAPS for XOR feedback
-
-    this->lru_out = (this->lru_out << 1) | (linear_feedback & 1);
-
-    int way = (this->lru_out >> 1) & (this->nb_ways - 1);
-
-    return way;
-  }
-  else
-  {
-    unsigned int b1 = (((R1 & 0x00000008) >>  3) ^ ((R1 & 0x00001000) >> 12) ^ ((R1 & 0x00004000) >> 14) ^ ((R1 & 0x00008000) >> 15)) & 1;
-    unsigned int b2 = (((R2 & 0x00000008) >>  3) ^ ((R2 & 0x00001000) >> 12) ^ ((R2 & 0x00004000) >> 14) ^ ((R2 & 0x00008000) >> 15)) & 1;
-    R1 <<= 1;
-    R1 |= b1;
-    R2 <<= 1;
-    R2 |= b2;
-    return (((R2 & 0x00010000) >> 15) | ((R1 & 0x00010000) >> 16));
-  }
-}
-
 
 
 void Cache::enable_sync(void *__this, bool active)
@@ -487,6 +404,13 @@ Cache::Cache(const char *config)
 
 
 
+Cache::~Cache()
+{
+  delete this->storage;
+}
+
+
+
 extern "C" void *vp_constructor(const char *config)
 {
   return (void *)new Cache(config);
@@ -28,8 +28,12 @@ void update_external_pccr(iss_t *iss, int id, unsigned int pcer, unsigned int pc
 static inline int iss_exec_account_cycles(iss_t *iss, int cycles);
 
 iss_insn_t *iss_exec_insn_with_trace(iss_t *iss, iss_insn_t *insn);
+iss_insn_t *iss_exec_insn_with_trigger(iss_t *iss, iss_insn_t *insn);
+iss_insn_t *iss_exec_insn_with_trigger_fast(iss_t *iss, iss_insn_t *insn);
 void iss_trace_dump(iss_t *iss, iss_insn_t *insn);
 void iss_trace_init(iss_t *iss);
+int iss_trace_binary_open(iss_t *iss, const char *path);
+void iss_trace_binary_flush(iss_t *iss);
 
 
 static inline void iss_exec_insn_resume(iss_t *iss)
@@ -111,10 +115,12 @@ static inline int iss_exec_step(iss_t *iss)
 static inline int iss_exec_switch_to_fast(iss_t *iss)
 {
 #ifdef VP_TRACE_ACTIVE
-  return false;
-#else
-  return !(iss->cpu.csr.pcmr & CSR_PCMR_ACTIVE);
+  // Traces are checked by the slow handler, which can only be left when
+  // traces are restricted to windows which are all closed
+  if (!iss_trace_fast_path(iss))
+    return false;
 #endif
+  return !(iss->cpu.csr.pcmr & CSR_PCMR_ACTIVE);
 }
 
 static inline int iss_exec_account_cycles(iss_t *iss, int cycles)
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __CPU_ISS_INSN_TRACE_HPP
+#define __CPU_ISS_INSN_TRACE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Binary instruction trace, converted to the text instruction trace by
+// gvsoc-insn-trace.
+//
+// The file starts with the magic, followed by chunks which can be decoded
+// independently once the descriptions of all the previous chunks are known:
+// - uint32 size of the descriptions, uint32 size of the instructions, uint32
+//   number of instructions, uint32 label width and uint32 arguments width
+//   at the beginning of the chunk.
+// - Descriptions, each one starting with a byte giving its type:
+//   - CORE: core, trace path width, trace path. Given before the first
+//     instruction of the core.
+//   - INSN: address, label, arguments, number of values, and for each value
+//     its kind and the text printed before it. Descriptions are numbered in
+//     the order in which they appear.
+// - Instructions: core, description relative to the previous one of the
+//   core, time and cycles relative to the previous instruction of the core,
+//   values. The first instruction of a core in a chunk is relative to 0.
+// All integers in descriptions and instructions are LEB128 varints, relative
+// values are zigzag-encoded, and strings are a length followed by the
+// characters.
+
+#define INSN_TRACE_MAGIC "GVITRC01"
+
+// Initial widths of the label and arguments columns
+#define INSN_TRACE_LABEL_WIDTH 20
+#define INSN_TRACE_ARGS_WIDTH  17
+
+typedef enum
+{
+  INSN_TRACE_DESC_CORE,
+  INSN_TRACE_DESC_INSN
+} insn_trace_desc_e;
+
+typedef enum
+{
+  INSN_TRACE_VALUE_REG,       // 32 bits, "%8.8x "
+  INSN_TRACE_VALUE_ADDR_32,   // "%8.8x "
+  INSN_TRACE_VALUE_ADDR_64    // "%16.16lx "
+} insn_trace_value_e;
+
+typedef struct
+{
+  uint32_t desc_size;
+  uint32_t insn_size;
+  uint32_t nb_insn;
+  uint32_t label_width;
+  uint32_t args_width;
+} insn_trace_chunk_t;
+
+
+static inline void insn_trace_put(std::vector<uint8_t> &buffer, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    buffer.push_back((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  buffer.push_back(value);
+}
+
+static inline void insn_trace_put_signed(std::vector<uint8_t> &buffer, int64_t value)
+{
+  insn_trace_put(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline void insn_trace_put_string(std::vector<uint8_t> &buffer, const char *str, size_t len)
+{
+  insn_trace_put(buffer, len);
+  buffer.insert(buffer.end(), str, str + len);
+}
+
+// Readers return false when the buffer ends before the value
+static inline bool insn_trace_get(const uint8_t **current, const uint8_t *end, uint64_t *value)
+{
+  uint64_t result = 0;
+  int shift = 0;
+
+  while (*current < end && shift < 64)
+  {
+    uint8_t byte = *(*current)++;
+    result |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      *value = result;
+      return true;
+    }
+    shift += 7;
+  }
+
+  return false;
+}
+
+static inline bool insn_trace_get_signed(const uint8_t **current, const uint8_t *end, int64_t *value)
+{
+  uint64_t raw;
+  if (!insn_trace_get(current, end, &raw))
+    return false;
+  *value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+  return true;
+}
+
+static inline bool insn_trace_get_string(const uint8_t **current, const uint8_t *end, std::string *str)
+{
+  uint64_t len;
+  if (!insn_trace_get(current, end, &len) || len > (uint64_t)(end - *current))
+    return false;
+  str->assign((const char *)*current, len);
+  *current += len;
+  return true;
+}
+
+#endif
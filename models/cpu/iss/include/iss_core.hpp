@@ -41,6 +41,8 @@ static inline void iss_exec_insn_terminate(iss_t *iss);
 
 
 int iss_open(iss_t *iss);
+int iss_activate_isa(iss_t *iss);
+void iss_close(iss_t *iss);
 void iss_reset(iss_t *iss, int active);
 void iss_start(iss_t *iss);
 
@@ -61,5 +63,6 @@ bool iss_csr_read(iss_t *iss, iss_reg_t reg, iss_reg_t *value);
 bool iss_csr_write(iss_t *iss, iss_reg_t reg, iss_reg_t value);
 
 int iss_trace_pc_info(iss_addr_t addr, const char **func, const char **inline_func, const char **file, int *line);
+int iss_trace_symbol_addr(const char *symbol, iss_addr_t *addr);
 
 #endif
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __CPU_ISS_SYMBOLIZER_HPP
+#define __CPU_ISS_SYMBOLIZER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <functional>
+#include <vector>
+
+// Debug information index of a binary, giving for each address range the
+// function, the innermost inlined function, the file and the line.
+//
+// The index is built from the ELF symbols and the DWARF line and inline
+// tables of the binary, and is cached next to it in <binary>.gvsym so that
+// the next simulations and tools just map it. The cache file is:
+// - the header below,
+// - the ranges, sorted by address and not overlapping,
+// - the strings, referenced by their offset, the string at offset 0 being
+//   "-" for missing information.
+// Debug information text files generated by pulp-pc-info are also accepted,
+// and indexed the same way.
+
+#define ISS_SYMBOLIZER_MAGIC "GVSYM001"
+
+typedef struct
+{
+  char magic[8];
+  uint64_t binary_size;    // Size and modification time of the binary, to
+  int64_t binary_mtime;    // detect that the cache is outdated
+  uint64_t nb_ranges;
+  uint64_t strings_size;
+} iss_symbolizer_header_t;
+
+typedef struct
+{
+  uint64_t base;
+  uint64_t end;
+  uint32_t func;
+  uint32_t inline_func;
+  uint32_t file;
+  uint32_t line;
+} iss_symbolizer_range_t;
+
+class iss_symbolizer_image;
+
+class iss_symbolizer
+{
+public:
+  ~iss_symbolizer();
+
+  // Adds the debug information of an ELF binary or of a debug information
+  // text file. Returns -1 and fills the error if it can't be read.
+  int load(const char *path, std::string &error);
+
+  // Information about an address, from the first binary which covers it
+  bool lookup(uint64_t addr, const char **func, const char **inline_func, const char **file, int *line);
+
+  // Lowest address of a function
+  bool find_symbol(const char *symbol, uint64_t *addr);
+
+  // Calls the callback for every range of every binary, in address order
+  // for each binary
+  void foreach_range(std::function<void(uint64_t base, uint64_t end, const char *func, const char *inline_func, const char *file, int line)> callback);
+
+  bool empty() { return this->images.size() == 0; }
+
+private:
+  std::vector<iss_symbolizer_image *> images;
+};
+
+#endif
@@ -308,10 +308,16 @@ typedef struct iss_insn_s {
   iss_decoder_item_t *decoder_item;
 
   iss_insn_t *(*saved_handler)(iss_t *, iss_insn_t*);
+  iss_insn_t *(*trigger_handler)(iss_t *, iss_insn_t*);
+  iss_insn_t *(*trigger_fast_handler)(iss_t *, iss_insn_t*);
   iss_insn_t *branch;
 
   int latency;
 
+  // Description of the instruction in the binary instruction trace, -1 if
+  // not yet described
+  int trace_desc;
+
 } iss_insn_t;
 
 typedef struct iss_insn_block_s {
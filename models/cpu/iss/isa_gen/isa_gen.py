@@ -529,7 +529,10 @@ class DecodeTree(object):
              
                 self.dump(' };\n')
 
-                self.dump('%siss_decoder_item_t %s = {\n' % ('' if is_top else 'static ', self.get_name()))
+                # Top trees are only referenced from the ISA list, they are
+                # static so that the file can be compiled twice in a model,
+                # see decoder_release.cpp
+                self.dump('static iss_decoder_item_t %s = {\n' % self.get_name())
                 self.dump('  .is_insn=false,\n')
                 self.dump('  .is_active=false,\n')
                 self.dump('  .opcode_others=0,\n')
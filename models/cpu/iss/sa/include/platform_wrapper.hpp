@@ -48,6 +48,10 @@ typedef struct iss_s
   unsigned char *mem_array;
   size_t mem_size;
 
+  // When not NULL, the program stdout and stderr are appended here instead
+  // of being written to the simulator ones
+  std::string *output;
+
 } iss_t;
 
 void handle_syscall(iss_t *iss, iss_insn_t *insn);
@@ -64,6 +68,15 @@ static inline bool iss_insn_trace_active(iss_t *iss)
 #endif
 }
 
+static inline bool iss_trace_trigger_pc_active(iss_t *iss, iss_addr_t addr)
+{
+  return false;
+}
+
+static inline void iss_trace_trigger_pc(iss_t *iss, iss_addr_t addr)
+{
+}
+
 #define iss_fatal(iss, fmt, x...)
 
 #define iss_warning(iss, fmt, x...)
@@ -125,6 +138,15 @@ static inline int iss_pccr_trace_active(iss_t *iss, unsigned int event)
 
 static inline int iss_fetch_req(iss_t *iss, uint64_t addr, uint8_t *data, uint64_t size, bool is_write)
 {
+  if (data == NULL)
+    return 0;
+
+  if (addr + size > iss->mem_size)
+  {
+    memset(data, 0, size);
+    return -1;
+  }
+
   memcpy(data, iss->mem_array + addr, size);
   return 0;
 }
@@ -170,8 +192,11 @@ static inline void iss_wait_for_interrupt(iss_t *iss)
 {
 }
 
+// Something needs the instructions to be checked, e.g. performance counters
+// were enabled, so the fast loop must be left
 static inline void iss_trigger_check_all(iss_t *iss)
 {
+  iss->fast_mode = 0;
 }
 
 static inline void iss_trigger_irq_check(iss_t *iss)
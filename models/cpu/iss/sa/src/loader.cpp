@@ -18,6 +18,26 @@
  */
 
 #include "sa_iss.hpp"
+#include <stdarg.h>
+
+// Messages about the loading of a binary go with the output of the program
+// when it is captured
+static void loader_msg(iss_t *iss, FILE *file, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  if (iss->output)
+  {
+    char buffer[1024];
+    int len = vsnprintf(buffer, sizeof(buffer), fmt, ap);
+    iss->output->append(buffer, len < (int)sizeof(buffer) ? len : sizeof(buffer) - 1);
+  }
+  else
+  {
+    vfprintf(file, fmt, ap);
+  }
+  va_end(ap);
+}
 
 static int look_for_symbol_group(bfd *abfd, const char *sec_name, unsigned int Flag,
                           const char *s1, unsigned int *v1,
@@ -27,23 +47,21 @@ static int look_for_symbol_group(bfd *abfd, const char *sec_name, unsigned int F
 
 {
         int storage_needed;
-        static asymbol **symbol_table = NULL;
-        static int init_done = 0;
-        static int number_of_symbols = 0;
+        asymbol **symbol_table = NULL;
+        int number_of_symbols = 0;
         int i;
         int found_v1 = 0, found_v2 = 0, found_v3 = 0, found_v4 = 0;
 
-        if (!init_done) {
-                init_done = 1;
-                storage_needed = bfd_get_symtab_upper_bound (abfd);
-                if (storage_needed <= 0) return 0;
+        // Read for each lookup, as several binaries may be loaded
+        storage_needed = bfd_get_symtab_upper_bound (abfd);
+        if (storage_needed <= 0) return 0;
 
-                symbol_table = (asymbol **) malloc (storage_needed);
-    if (symbol_table == NULL) return 0;
+        symbol_table = (asymbol **) malloc (storage_needed);
+        if (symbol_table == NULL) return 0;
+
+        number_of_symbols = bfd_canonicalize_symtab (abfd, symbol_table);
+        if (number_of_symbols < 0) { free(symbol_table); return 0; }
 
-                number_of_symbols = bfd_canonicalize_symtab (abfd, symbol_table);
-                if (number_of_symbols < 0) return 0;
-        }
         for (i = 0; i < number_of_symbols; i++) {
                 asymbol *sym = symbol_table[i];
                 if        (s1 && !found_v1 && (strcmp(sym->name, s1) == 0) && (sym->flags & Flag) && (strcmp(sym->section->name, sec_name) == 0)) {
@@ -56,6 +74,7 @@ static int look_for_symbol_group(bfd *abfd, const char *sec_name, unsigned int F
                         *v4 = sym->value + sym->section->vma; found_v4 = 1;
                 }
         }
+        free(symbol_table);
         return ((!s1 || (s1 && found_v1)) && (!s2 || (s1 && found_v2)) && (!s3 || (s1 && found_v3)) && (!s4 || (s1 && found_v4)));
 }
 
@@ -81,15 +100,15 @@ static int handle_argc_argc(iss_t *iss, struct bfd *abfd, char **prog_argv)
     for (i = 0; prog_argv[i] != NULL; my_argc++, i++) len += strlen (prog_argv[i]) + 1;
 
     if (Trace) {
-      fprintf (stderr,  "Found argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Found argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
-      fprintf (stderr,  "Total buffer length=%d\n", len);
-      for (i = 0; i<my_argc; i++) fprintf (stderr,  "  argv[%d] = \"%s\", L:%d\n", i, prog_argv[i], (int) strlen(prog_argv[i])+1);
+      loader_msg(iss, stderr, "Total buffer length=%d\n", len);
+      for (i = 0; i<my_argc; i++) loader_msg(iss, stderr, "  argv[%d] = \"%s\", L:%d\n", i, prog_argv[i], (int) strlen(prog_argv[i])+1);
     }
   } else {
     if (prog_argv && prog_argv[1] != NULL) {
-      fprintf (stderr,  "Program argc, argv error: Trying to pass arguments but at least one of [argc,argv,argbuf,stack] is undefined\n");
-      fprintf (stderr,  "  Check your crt0\n");
+      loader_msg(iss, stderr, "Program argc, argv error: Trying to pass arguments but at least one of [argc,argv,argbuf,stack] is undefined\n");
+      loader_msg(iss, stderr, "  Check your crt0\n");
     }
     Ok = 0;
   }
@@ -97,38 +116,38 @@ static int handle_argc_argc(iss_t *iss, struct bfd *abfd, char **prog_argv)
   
     Ok &= ((a_argv>a_argc) && (a_argbuf>a_argv) && (a_stack>a_argbuf));   // In the following order: argc,argv,argbuf,stack
     if (!((a_argv>a_argc) && (a_argbuf>a_argv) && (a_stack>a_argbuf))) {
-      fprintf (stderr,  "Program argc, argv error: expecting &argc>argv>&argbuf>&stack\n");
-      fprintf (stderr,  "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Program argc, argv error: expecting &argc>argv>&argbuf>&stack\n");
+      loader_msg(iss, stderr, "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
     }
     Ok &= ((a_argc & 0x3)==0);            // int aligned
     if (!((a_argc & 0x3)==0)) {
-      fprintf (stderr,  "Program argc, argv error: argc is not 4 byte aligned\n");
-      fprintf (stderr,  "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Program argc, argv error: argc is not 4 byte aligned\n");
+      loader_msg(iss, stderr, "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
     }
     Ok &= ((a_argbuf & 0x3)==0);            // int aligned
     if (!((a_argbuf & 0x3)==0)) {
-      fprintf (stderr,  "Program argc, argv error: arg buffer is not 4 byte aligned\n");
-      fprintf (stderr,  "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Program argc, argv error: arg buffer is not 4 byte aligned\n");
+      loader_msg(iss, stderr, "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
     }
     Ok &= (a_argv == (a_argc+4));             // argv right after argc
     if (!(a_argv == (a_argc+4))) {
-      fprintf (stderr,  "Program argc, argv error: expecting &argv = &argc+4\n");
-      fprintf (stderr,  "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Program argc, argv error: expecting &argv = &argc+4\n");
+      loader_msg(iss, stderr, "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
     }
     Ok &= (my_argc <= ((a_argbuf - a_argv)>>2));        // Enough room for argv pointers
     if (!(my_argc <= ((a_argbuf - a_argv)>>2))) {
-      fprintf (stderr,  "Program argc, argv error: Max requested argc exceeded: %d\n", my_argc);
-      fprintf (stderr,  "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Program argc, argv error: Max requested argc exceeded: %d\n", my_argc);
+      loader_msg(iss, stderr, "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
     }
     Ok &= (len <= (a_stack - a_argbuf));          // Enough space in the buffer
     if (!(len <= (a_stack - a_argbuf))) {
-      fprintf (stderr,  "Program argc, argv error: Max argv buffer (argbuf) size exceeded: %d\n", len);
-      fprintf (stderr,  "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
+      loader_msg(iss, stderr, "Program argc, argv error: Max argv buffer (argbuf) size exceeded: %d\n", len);
+      loader_msg(iss, stderr, "    Reading argc=0x%X [%d], argv=0x%X [%d], argbuf=0x%X [%d], stack=0x%X\n",
           a_argc, (a_argv-a_argc), a_argv, (a_argbuf-a_argv), a_argbuf, (a_stack-a_argbuf), a_stack);
     }
     if (Ok) {
@@ -142,25 +161,25 @@ static int handle_argc_argc(iss_t *iss, struct bfd *abfd, char **prog_argv)
         a_argbuf += (unsigned int) strln;
       }
       if (!Ok) {
-        if (Trace) fprintf (stderr,  "At least on write command for argc, argv failed\n");
+        if (Trace) loader_msg(iss, stderr, "At least on write command for argc, argv failed\n");
         storeWord (iss, a_argc, 0);
-      } else if (Trace) fprintf (stderr,  "Sucessfull argc, argv initialization\n");
-    } else if (Trace) fprintf (stderr,  "Failed to check pre conditions for using argc, argv\n");
-  } else if (Trace) fprintf (stderr,  "One of argc, argv, argbuf, stack symbols was not found in loaded elf file\n");
+      } else if (Trace) loader_msg(iss, stderr, "Sucessfull argc, argv initialization\n");
+    } else if (Trace) loader_msg(iss, stderr, "Failed to check pre conditions for using argc, argv\n");
+  } else if (Trace) loader_msg(iss, stderr, "One of argc, argv, argbuf, stack symbols was not found in loaded elf file\n");
 
   if (look_for_symbol_group(abfd, ".text", BSF_LOCAL, "__mem_base", &a_base, "__mem_size", &a_size, NULL, NULL, NULL, NULL)) {
     unsigned int base, size;
     loadWord(iss, a_base, &base);
     loadWord(iss, a_size, &size);
 
-    if (Trace) fprintf(stderr, "Mem Base: [%X] = %X, Mem Size: [%X] = %X\n", a_base, base, a_size, size);
+    if (Trace) loader_msg(iss, stderr, "Mem Base: [%X] = %X, Mem Size: [%X] = %X\n", a_base, base, a_size, size);
     if ((base+size) > iss->mem_size) {
-      fprintf(stderr, "crt0: __mem_base+_mem_size (%X+%X) exceeds simulator allocated memory: %lX\n",
+      loader_msg(iss, stderr, "crt0: __mem_base+_mem_size (%X+%X) exceeds simulator allocated memory: %lX\n",
         base, size, iss->mem_size);
       Ok=0;
     }
   } else {
-    fprintf(stderr, "crt0: can't find __mem_base and/or __mem_size symbols\n");
+    loader_msg(iss, stderr, "crt0: can't find __mem_base and/or __mem_size symbols\n");
     Ok=0;
   }
   return Ok;
@@ -170,7 +189,7 @@ int load_binary(iss_t *iss, const char *name, int argc, char **argv, iss_reg_t *
 {
   bfd *abfd;
   int trace = 0;
-  char *myname;
+  const char *myname = "pulp_iss";
   asection *s;
   int lma_p = 0;
   int verbose_p = 10;
@@ -182,18 +201,22 @@ int load_binary(iss_t *iss, const char *name, int argc, char **argv, iss_reg_t *
   // printf("%p\n", abfd);
   if (!abfd)
     {
-      fprintf (stderr, "%s: can't open %s: %s\n",
+      loader_msg(iss, stderr, "%s: can't open %s: %s\n",
           myname, name, bfd_errmsg (bfd_get_error ()));
-      exit (1);
+      return -1;
     } 
 
   if (!bfd_check_format (abfd, bfd_object))
     {
-      fprintf (stderr, "%s: can't load %s: %s\n",
+      loader_msg(iss, stderr, "%s: can't load %s: %s\n",
          myname, name, bfd_errmsg (bfd_get_error ()));
-      exit (1);
+      bfd_close (abfd);
+      return -1;
     }
 
+  // Closed by the caller, even if the loading fails
+  iss->abfd = abfd;
+
 
   for (s = abfd->sections; s; s = s->next)
     if (strcmp (bfd_get_section_name (abfd, s), ".text") == 0)
@@ -219,7 +242,7 @@ int load_binary(iss_t *iss, const char *name, int argc, char **argv, iss_reg_t *
         buffer = (unsigned char *)malloc (size);
         if (buffer == NULL)
         {
-          printf("%s: insufficient memory to load \"%s\"\n", myname, name);
+          loader_msg(iss, stdout, "%s: insufficient memory to load \"%s\"\n", myname, name);
           return -1;
         }
         if (lma_p)
@@ -228,12 +251,19 @@ int load_binary(iss_t *iss, const char *name, int argc, char **argv, iss_reg_t *
           lma = bfd_section_vma (abfd, s);
         if (verbose_p)
         {
-          printf("Loading section %s, size 0x%lx %s ",
+          loader_msg(iss, stdout, "Loading section %s, size 0x%lx %s ",
            bfd_get_section_name (abfd, s),
            (unsigned long) size,
            (lma_p ? "lma" : "vma"));
-          printf("%lx", lma);
-          printf("\n");
+          loader_msg(iss, stdout, "%lx", lma);
+          loader_msg(iss, stdout, "\n");
+        }
+        if (lma + size > iss->mem_size)
+        {
+          loader_msg(iss, stdout, "%s: section %s of \"%s\" is outside the simulated memory\n",
+           myname, bfd_get_section_name (abfd, s), name);
+          free (buffer);
+          return -1;
         }
         data_count += size;
         bfd_get_section_contents (abfd, s, buffer, 0, size);
@@ -246,7 +276,7 @@ int load_binary(iss_t *iss, const char *name, int argc, char **argv, iss_reg_t *
 
   if (!found_loadable_section)
   {
-    printf(
+    loader_msg(iss, stdout, 
      "%s: no loadable sections \"%s\"\n",
      myname, name);
     return -1;
@@ -254,13 +284,12 @@ int load_binary(iss_t *iss, const char *name, int argc, char **argv, iss_reg_t *
 
   if (verbose_p)
   {
-    printf("Start address 0x%lx\n", bfd_get_start_address (abfd));
+    loader_msg(iss, stdout, "Start address 0x%lx\n", bfd_get_start_address (abfd));
   }
 
   if (!handle_argc_argc(iss, abfd, argv)) {
-  printf("Failed to initialize argc/argv\n"); return -1;
+  loader_msg(iss, stdout, "Failed to initialize argc/argv\n"); return -1;
   }
-  iss->abfd = abfd;
 
   if (bootaddr)
     *bootaddr = bfd_get_start_address (abfd);
@@ -17,77 +17,506 @@
  *          Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
  */
 
+// Runs a binary, or a batch of independent binaries, e.g. the tests of a
+// compiler or library test suite. Binaries of a batch run in parallel, each
+// one on its own ISS instance with its own memory and its own output, and
+// the results are reported as JUnit or JSON.
+//
+// The batch file gives one binary per line, followed by its arguments.
+// Empty lines and lines starting with # are ignored.
+
 #include "sa_iss.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #define MEMORY_SIZE (16*1024*1024)
 
+#define DEFAULT_ISA "rv32imcXpulpv2"
 
 
-int main(int argc, char **argv)
+typedef enum
 {
-  iss_t *iss;
-  iss_reg_t bootaddr;
+  SA_TEST_PASSED,
+  SA_TEST_FAILED,
+  SA_TEST_TIMEOUT,
+  SA_TEST_ERROR
+} sa_test_status_e;
 
-  iss = new iss_t;
+typedef struct
+{
+  std::string binary;
+  std::vector<std::string> args;
 
-  iss->fast_mode = 0;
-  iss->mem_size = MEMORY_SIZE;
-  iss->mem_array = (unsigned char *)malloc(MEMORY_SIZE);
-  if (iss->mem_array == NULL) return -1;
+  sa_test_status_e status;
+  int exit_status;
+  int64_t nb_insns;
+  double duration;
+  std::string output;
+} sa_test_t;
 
-  if (load_binary(iss, argv[1], argc, argv, &bootaddr))
-    return -1;
 
-  iss->cpu.config.isa = strdup("rv32imcXpulpv2");
+static const char *status_names[] = { "passed", "failed", "timeout", "error" };
 
-  if (iss_open(iss)) return -1;
+static std::string isa = DEFAULT_ISA;
+static size_t mem_size = MEMORY_SIZE;
+static int64_t max_insns = 0;
+// The fast loop is the default for batches. Single binaries keep the full
+// check at each instruction, unless the simulator is built with FAST_LOOP
+#ifdef FAST_LOOP
+#define SINGLE_FAST_LOOP true
+#else
+#define SINGLE_FAST_LOOP false
+#endif
 
-  iss_start(iss);
- 
-  iss_pc_set(iss, bootaddr);
+// -1 until given with --fast or --no-fast
+static int fast_loop = -1;
 
-#ifdef FAST_LOOP
+// libbfd is not thread-safe, so binaries are loaded one at a time
+static std::mutex loader_mutex;
+static std::mutex print_mutex;
 
-  // Experimental, not yet fully stable
 
-  do
+static double get_time()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void exec(iss_t *iss, sa_test_t *test)
+{
+  int64_t nb_insns = 0;
+  int64_t end = max_insns ? max_insns : INT64_MAX;
+
+  while (iss->hit_exit == 0 && nb_insns < end)
   {
-    iss->fast_mode = iss_exec_switch_to_fast(iss);
+    iss->fast_mode = fast_loop && iss_exec_switch_to_fast(iss);
 
     if (iss->fast_mode)
     {
-      // The fast mode is only executing instructions
-      // and can be used when there is no check to do
-      // like interupts, HW loops or performance
-      // counters
+      // The fast mode is only executing instructions and is left as soon
+      // as something must be checked, like performance counters, or when
+      // the program exits
       do
       {
         iss_exec_step(iss);
-      } while(iss->fast_mode);
+        nb_insns++;
+      } while(iss->fast_mode && nb_insns < end);
     }
     else
     {
-      // The full mode is checking everything. This could
-      // also always be called to simplify
+      // The full mode is checking everything
       iss_exec_step_check_all(iss);
+      nb_insns++;
     }
-  } while (iss->hit_exit == 0);
+  }
 
-#else
-  
-  while (iss->hit_exit == 0)
+  test->nb_insns = nb_insns;
+
+  if (iss->hit_exit == 0)
+  {
+    test->status = SA_TEST_TIMEOUT;
+  }
+  else
   {
-    iss_exec_step_check_all(iss);
+    test->exit_status = iss->exit_status;
+    test->status = iss->exit_status == 0 ? SA_TEST_PASSED : SA_TEST_FAILED;
   }
+}
 
-#endif
+static void run(sa_test_t *test, bool capture)
+{
+  iss_t *iss = new iss_t();
+  iss_reg_t bootaddr;
+  double start = get_time();
+
+  test->status = SA_TEST_ERROR;
+  test->exit_status = -1;
+  test->nb_insns = 0;
+
+  // Pages are only allocated when the program touches them, so that many
+  // instances can run at once. A few more bytes are mapped as accesses at
+  // the end of the memory are done by words.
+  iss->mem_size = mem_size;
+  iss->mem_array = (unsigned char *)mmap(NULL, mem_size + sizeof(iss_reg_t), PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  iss->output = capture ? &test->output : NULL;
+
+  if (iss->mem_array == MAP_FAILED)
+  {
+    if (capture)
+      test->output += "Failed to allocate memory\n";
+    else
+      fprintf(stderr, "Failed to allocate memory (size: 0x%lx)\n", mem_size);
+    delete iss;
+    return;
+  }
+
+  // Same arguments as when the simulator was running a single binary
+  std::vector<char *> argv;
+  argv.push_back((char *)"pulp_iss");
+  argv.push_back((char *)test->binary.c_str());
+  for (auto &arg: test->args)
+    argv.push_back((char *)arg.c_str());
+  argv.push_back(NULL);
+
+  int err;
+  {
+    std::lock_guard<std::mutex> lock(loader_mutex);
+
+    err = load_binary(iss, test->binary.c_str(), argv.size() - 1, argv.data(), &bootaddr);
+    if (err == 0)
+    {
+      iss->cpu.config.isa = strdup(isa.c_str());
+      err = iss_open(iss);
+    }
+  }
+
+  if (err == 0)
+  {
+    iss_start(iss);
+    iss_pc_set(iss, bootaddr);
+    exec(iss, test);
+    iss_close(iss);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    if (iss->abfd)
+      bfd_close(iss->abfd);
+  }
+
+  free((void *)iss->cpu.config.isa);
+  munmap(iss->mem_array, mem_size + sizeof(iss_reg_t));
+  delete iss;
+
+  test->duration = get_time() - start;
+}
+
+static int read_batch(const char *path, std::vector<sa_test_t *> &tests)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open batch file %s (error: %s)\n", path, strerror(errno));
+    return -1;
+  }
+
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, file) != -1)
+  {
+    std::istringstream stream(line);
+    std::string token;
+    sa_test_t *test = NULL;
+
+    while (stream >> token)
+    {
+      if (test == NULL)
+      {
+        if (token[0] == '#')
+          break;
+        test = new sa_test_t();
+        test->binary = token;
+      }
+      else
+      {
+        test->args.push_back(token);
+      }
+    }
+
+    if (test)
+      tests.push_back(test);
+  }
+
+  free(line);
+  fclose(file);
+  return 0;
+}
+
+static std::string get_name(sa_test_t *test)
+{
+  std::string name = test->binary;
+  for (auto &arg: test->args)
+    name += " " + arg;
+  return name;
+}
+
+static std::string xml_escape(const std::string &str)
+{
+  std::string result;
+  for (unsigned char c: str)
+  {
+    if (c == '&') result += "&amp;";
+    else if (c == '<') result += "&lt;";
+    else if (c == '>') result += "&gt;";
+    else if (c == '"') result += "&quot;";
+    // Control characters are not allowed in XML 1.0
+    else if (c < 0x20 && c != '\n' && c != '\t' && c != '\r') result += '?';
+    else result += c;
+  }
+  return result;
+}
+
+static std::string json_escape(const std::string &str)
+{
+  std::string result;
+  for (unsigned char c: str)
+  {
+    if (c == '"') result += "\\\"";
+    else if (c == '\\') result += "\\\\";
+    else if (c == '\n') result += "\\n";
+    else if (c == '\t') result += "\\t";
+    else if (c < 0x20)
+    {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      result += buffer;
+    }
+    else result += c;
+  }
+  return result;
+}
+
+static int dump_junit(const char *path, std::vector<sa_test_t *> &tests, double duration)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open %s (error: %s)\n", path, strerror(errno));
+    return -1;
+  }
+
+  int nb_failures = 0, nb_errors = 0;
+  for (auto test: tests)
+  {
+    if (test->status == SA_TEST_FAILED || test->status == SA_TEST_TIMEOUT)
+      nb_failures++;
+    else if (test->status == SA_TEST_ERROR)
+      nb_errors++;
+  }
+
+  fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  fprintf(file, "<testsuites>\n");
+  fprintf(file, "  <testsuite name=\"pulp_iss\" tests=\"%ld\" failures=\"%d\" errors=\"%d\" time=\"%.3f\">\n",
+    tests.size(), nb_failures, nb_errors, duration);
+
+  for (auto test: tests)
+  {
+    fprintf(file, "    <testcase classname=\"pulp_iss\" name=\"%s\" time=\"%.3f\">\n", xml_escape(get_name(test)).c_str(), test->duration);
+
+    if (test->status == SA_TEST_FAILED)
+      fprintf(file, "      <failure message=\"Exit status %d\"/>\n", test->exit_status);
+    else if (test->status == SA_TEST_TIMEOUT)
+      fprintf(file, "      <failure message=\"Timeout after %ld instructions\"/>\n", test->nb_insns);
+    else if (test->status == SA_TEST_ERROR)
+      fprintf(file, "      <error message=\"Failed to load binary\"/>\n");
+
+    fprintf(file, "      <system-out>%s</system-out>\n", xml_escape(test->output).c_str());
+    fprintf(file, "    </testcase>\n");
+  }
+
+  fprintf(file, "  </testsuite>\n");
+  fprintf(file, "</testsuites>\n");
+
+  fclose(file);
+  return 0;
+}
+
+static int dump_json(const char *path, std::vector<sa_test_t *> &tests, double duration)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open %s (error: %s)\n", path, strerror(errno));
+    return -1;
+  }
+
+  fprintf(file, "{\n  \"time\": %.3f,\n  \"tests\": [", duration);
+
+  for (size_t i=0; i<tests.size(); i++)
+  {
+    sa_test_t *test = tests[i];
+    fprintf(file, "%s\n    {\n", i ? "," : "");
+    fprintf(file, "      \"name\": \"%s\",\n", json_escape(get_name(test)).c_str());
+    fprintf(file, "      \"status\": \"%s\",\n", status_names[test->status]);
+    fprintf(file, "      \"exit_status\": %d,\n", test->exit_status);
+    fprintf(file, "      \"instructions\": %ld,\n", test->nb_insns);
+    fprintf(file, "      \"time\": %.3f,\n", test->duration);
+    fprintf(file, "      \"output\": \"%s\"\n", json_escape(test->output).c_str());
+    fprintf(file, "    }");
+  }
+
+  fprintf(file, "\n  ]\n}\n");
+
+  fclose(file);
+  return 0;
+}
+
+static int run_batch(const char *path, int nb_jobs, const char *junit_path, const char *json_path)
+{
+  std::vector<sa_test_t *> tests;
+  if (read_batch(path, tests))
+    return -1;
+
+  std::atomic<size_t> next_test(0);
+  std::vector<std::thread> threads;
+  double start = get_time();
+
+  if (nb_jobs > (int)tests.size())
+    nb_jobs = tests.size();
+
+  // The ISA decoding tree is shared by the instances. All the tests having
+  // the same ISA, it is activated once before the threads are started, so
+  // that opening an instance never writes it while others are decoding.
+  iss_t *iss = new iss_t();
+  iss->cpu.config.isa = isa.c_str();
+  int err = iss_activate_isa(iss);
+  delete iss;
+  if (err)
+  {
+    fprintf(stderr, "Unsupported ISA: %s\n", isa.c_str());
+    return -1;
+  }
+
+  for (int i=0; i<nb_jobs; i++)
+  {
+    threads.push_back(std::thread([&tests, &next_test]() {
+      size_t index;
+      while ((index = next_test++) < tests.size())
+      {
+        sa_test_t *test = tests[index];
+        run(test, true);
+
+        std::lock_guard<std::mutex> lock(print_mutex);
+        printf("%-7s %s\n", status_names[test->status], get_name(test).c_str());
+        fflush(stdout);
+      }
+    }));
+  }
+
+  for (auto &thread: threads)
+  {
+    thread.join();
+  }
+
+  double duration = get_time() - start;
+
+  int nb_passed = 0;
+  for (auto test: tests)
+  {
+    if (test->status == SA_TEST_PASSED)
+      nb_passed++;
+  }
+
+  printf("%d/%ld tests passed in %.3f s\n", nb_passed, tests.size(), duration);
+
+  if (junit_path && dump_junit(junit_path, tests, duration))
+    return -1;
+
+  if (json_path && dump_json(json_path, tests, duration))
+    return -1;
+
+  for (auto test: tests)
+  {
+    delete test;
+  }
+
+  return nb_passed == (int)tests.size() ? 0 : 1;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [<options>] <binary> [<args>...]\n", name);
+  fprintf(stderr, "       %s [<options>] [--jobs=<number>] [--junit=<file>] [--json=<file>] --batch=<file>\n", name);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  --isa=<isa>             ISA of the core (default: %s)\n", DEFAULT_ISA);
+  fprintf(stderr, "  --mem-size=<bytes>      size of the memory of each binary (default: 0x%x)\n", MEMORY_SIZE);
+  fprintf(stderr, "  --max-insns=<number>    stop a binary after this number of instructions\n");
+  fprintf(stderr, "  --fast                  only check what is needed at each instruction (default with --batch)\n");
+  fprintf(stderr, "  --no-fast               check everything at each instruction (default for a single binary)\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *batch_path = NULL;
+  const char *junit_path = NULL;
+  const char *json_path = NULL;
+  int nb_jobs = std::thread::hardware_concurrency();
+  int i;
+
+  // Options stop at the binary, the rest are its arguments
+  for (i=1; i<argc && strncmp(argv[i], "--", 2) == 0; i++)
+  {
+    if (strncmp(argv[i], "--isa=", 6) == 0)
+      isa = argv[i] + 6;
+    else if (strncmp(argv[i], "--mem-size=", 11) == 0)
+      mem_size = strtoull(argv[i] + 11, NULL, 0);
+    else if (strncmp(argv[i], "--max-insns=", 12) == 0)
+      max_insns = strtoll(argv[i] + 12, NULL, 0);
+    else if (strcmp(argv[i], "--fast") == 0)
+      fast_loop = 1;
+    else if (strcmp(argv[i], "--no-fast") == 0)
+      fast_loop = 0;
+    else if (strncmp(argv[i], "--batch=", 8) == 0)
+      batch_path = argv[i] + 8;
+    else if (strncmp(argv[i], "--jobs=", 7) == 0)
+      nb_jobs = atoi(argv[i] + 7);
+    else if (strncmp(argv[i], "--junit=", 8) == 0)
+      junit_path = argv[i] + 8;
+    else if (strncmp(argv[i], "--json=", 7) == 0)
+      json_path = argv[i] + 7;
+    else
+    {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+
+  if (nb_jobs < 1)
+    nb_jobs = 1;
+
+  if (fast_loop == -1)
+    fast_loop = batch_path ? true : SINGLE_FAST_LOOP;
+
+  if (batch_path)
+    return run_batch(batch_path, nb_jobs, junit_path, json_path);
+
+  if (i >= argc)
+  {
+    usage(argv[0]);
+    return -1;
+  }
+
+  sa_test_t test;
+  test.binary = argv[i];
+  for (i++; i<argc; i++)
+    test.args.push_back(argv[i]);
+
+  run(&test, false);
+
+  if (test.status == SA_TEST_ERROR)
+    return -1;
+
+  if (test.status == SA_TEST_TIMEOUT)
+  {
+    fprintf(stderr, "Stopped after %ld instructions\n", test.nb_insns);
+    return -1;
+  }
 
-  return iss->exit_status;
+  return test.exit_status;
 }
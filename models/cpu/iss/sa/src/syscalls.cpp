@@ -79,18 +79,42 @@
 #define RV_SYS_getdents 61
 #define RV_SYS_dup 23
 
-static char IO_Buffer[IO_SIZE_MAX];
 
-static void sim_io_error(iss_insn_t *At_PC, const char *Message, ...)
+// Output of the simulated program, which goes to the instance output when
+// it is captured, e.g. when running several binaries in parallel
+static ssize_t sim_io_write(iss_t *iss, int fd, const char *buffer, size_t len)
+{
+  if (iss->output && (fd == STDOUT_FILENO || fd == STDERR_FILENO))
+  {
+    iss->output->append(buffer, len);
+    return len;
+  }
+
+  return write(fd, buffer, len);
+}
+
+static void sim_io_error(iss_t *iss, iss_insn_t *At_PC, const char *Message, ...)
 
 {
   va_list Args;
+  char Buffer[1024];
+  int Len;
+
+  Len = snprintf(Buffer, sizeof(Buffer), "Error At PC=%X:", (unsigned int)At_PC->addr);
 
   va_start(Args, Message);
-  fprintf(stderr, "Error At PC=%X:", At_PC->addr);
-  vfprintf(stderr, Message, Args);
-  fprintf(stderr, ". Aborting simulation\n");
-  exit(0);
+  Len += vsnprintf(Buffer + Len, sizeof(Buffer) - Len, Message, Args);
+  va_end(Args);
+
+  if (Len < (int)sizeof(Buffer))
+    Len += snprintf(Buffer + Len, sizeof(Buffer) - Len, ". Aborting simulation\n");
+  if (Len >= (int)sizeof(Buffer))
+    Len = sizeof(Buffer) - 1;
+
+  sim_io_write(iss, STDERR_FILENO, Buffer, Len);
+
+  // Only this simulated program is stopped, as other ones may be running
+  iss_exit(iss, -1);
 }
 
 static void sim_io_eprintf(const char *Message, ...)
@@ -114,7 +138,7 @@ static int copy_name(iss_t *cpu, iss_insn_t *pc, unsigned int rv32_buff, char *H
     if (c == 0) break;
     Host_buff[i++] = c;
     if (i == (MAX_FNAME_LENGTH-1)) {
-          sim_io_error (pc, "Max file/path name length exceed");
+          sim_io_error (iss, pc, "Max file/path name length exceed");
       i--;
       break;
     }
@@ -159,8 +183,10 @@ void handle_syscall(iss_t *iss, iss_insn_t *pc)
         unsigned int stack = iss_get_reg(iss, 12);
         unsigned int sp = iss_get_reg(iss, 2);
         unsigned int gp = iss_get_reg(iss, 3);
-        printf("Mem request: Head: %8X, Incr: %8X, Stack: %8X, Sp: %8X, Gp: %8X, New Head: %8X, Gap Frame/Stack: %d\n",
+        char Buffer[256];
+        int Len = snprintf(Buffer, sizeof(Buffer), "Mem request: Head: %8X, Incr: %8X, Stack: %8X, Sp: %8X, Gp: %8X, New Head: %8X, Gap Frame/Stack: %d\n",
           head_ptr, incr, stack, sp, gp, (head_ptr+incr), (int) (sp - (head_ptr+incr)));
+        sim_io_write(iss, STDOUT_FILENO, Buffer, Len < (int)sizeof(Buffer) ? Len : sizeof(Buffer) - 1);
 
       }
       break;
@@ -195,6 +221,7 @@ void handle_syscall(iss_t *iss, iss_insn_t *pc)
         int fd = iss_get_reg(iss, 10);     // fd in a0
         unsigned int buffer = iss_get_reg(iss, 11);  // buffer in a1
         size_t Len = iss_get_reg(iss, 12);     // length in a2
+        char IO_Buffer[IO_SIZE_MAX];
         ssize_t Write_Len=0;
         unsigned int Off=0;
         unsigned int i;
@@ -209,7 +236,7 @@ void handle_syscall(iss_t *iss, iss_insn_t *pc)
           unsigned int L = (Len > IO_SIZE_MAX)?IO_SIZE_MAX:Len;
           for (i = 0; i<L; i++) loadByte(iss, (buffer+i+Off), (uint8_t *)&IO_Buffer[i]);
           Off += L;
-          Write_Len += write(fd, IO_Buffer, L);
+          Write_Len += sim_io_write(iss, fd, IO_Buffer, L);
           Len -= L;
         }
         iss_set_reg(iss, 10, Write_Len);   // Ret in a0
@@ -220,6 +247,7 @@ void handle_syscall(iss_t *iss, iss_insn_t *pc)
         int fd = iss_get_reg(iss, 10);     // fd in a0
         unsigned int buffer = iss_get_reg(iss, 11);  // buffer in a1
         size_t Len = iss_get_reg(iss, 12);   // length in a2
+        char IO_Buffer[IO_SIZE_MAX];
         ssize_t Read_Len=0;
         unsigned int Off=0;
         int i;
@@ -477,7 +505,7 @@ void handle_syscall(iss_t *iss, iss_insn_t *pc)
     default:
       errno = EBADRQC;
       iss_set_reg(iss, 10, -1);
-          sim_io_error (pc, "SYS call %X (%d) not supported", sys_fun, sys_fun);
+          sim_io_error (iss, pc, "SYS call %X (%d) not supported", sys_fun, sys_fun);
       break;
   }
 }
\ No newline at end of file
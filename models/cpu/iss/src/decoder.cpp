@@ -24,6 +24,13 @@
 extern iss_isa_set_t __iss_isa_set;
 extern iss_isa_tag_t __iss_isa_tags[];
 
+#ifdef VP_TRACE_ACTIVE
+// Same decoding tree with the instruction handlers compiled without traces,
+// see decoder_release.cpp
+extern iss_isa_set_t __iss_isa_set_release;
+extern iss_isa_tag_t __iss_isa_tags_release[];
+#endif
+
 static int decode_item(iss_t *iss, iss_insn_t *insn, iss_opcode_t opcode, iss_decoder_item_t *item);
 
 static uint64_t decode_ranges(iss_t *iss, iss_opcode_t opcode, iss_decoder_range_set_t *range_set, bool is_signed)
@@ -72,6 +79,7 @@ static int decode_insn(iss_t *iss, iss_insn_t *insn, iss_opcode_t opcode, iss_de
   insn->handler = item->u.insn.handler;
 
   insn->decoder_item = item;
+  insn->trace_desc = -1;
   insn->size = item->u.insn.size;
   insn->nb_out_reg = 0;
   insn->nb_in_reg = 0;
@@ -223,9 +231,16 @@ static int decode_item(iss_t *iss, iss_insn_t *insn, iss_opcode_t opcode, iss_de
 
 static int decode_opcode(iss_t *iss, iss_insn_t *insn, iss_opcode_t opcode)
 {
-  for (int i=0; i<__iss_isa_set.nb_isa; i++)
+  iss_isa_set_t *isa_set = &__iss_isa_set;
+
+#ifdef VP_TRACE_ACTIVE
+  if (iss->trace_release_handlers)
+    isa_set = &__iss_isa_set_release;
+#endif
+
+  for (int i=0; i<isa_set->nb_isa; i++)
   {
-    iss_isa_t *isa = &__iss_isa_set.isa_set[i];
+    iss_isa_t *isa = &isa_set->isa_set[i];
     if (decode_item(iss, insn, opcode, isa->tree) == 0) return 0;
   }
 
@@ -235,9 +250,8 @@ static int decode_opcode(iss_t *iss, iss_insn_t *insn, iss_opcode_t opcode)
 }
 
 
-void iss_decode_activate_isa(iss_t *cpu, char *name)
+static void decode_activate_isa_tags(iss_isa_tag_t *isa, char *name)
 {
-  iss_isa_tag_t *isa = &__iss_isa_tags[0];
   while(isa->name)
   {
     if (strcmp(isa->name, name) == 0)
@@ -246,7 +260,11 @@ void iss_decode_activate_isa(iss_t *cpu, char *name)
       while(*insn_ptr)
       {
         iss_decoder_item_t *insn = *insn_ptr;
-        insn->is_active = true;
+        // The decoding tree is shared by all the cores. It is not written
+        // when the instruction is already active, so that cores opened while
+        // others are decoding only read it if their ISA was activated before.
+        if (!insn->is_active)
+          insn->is_active = true;
         insn_ptr++;
       }
     }
@@ -255,6 +273,15 @@ void iss_decode_activate_isa(iss_t *cpu, char *name)
 }
 
 
+void iss_decode_activate_isa(iss_t *cpu, char *name)
+{
+  decode_activate_isa_tags(__iss_isa_tags, name);
+#ifdef VP_TRACE_ACTIVE
+  decode_activate_isa_tags(__iss_isa_tags_release, name);
+#endif
+}
+
+
 static iss_insn_t *iss_exec_insn_illegal(iss_t *iss, iss_insn_t *insn)
 {
   iss_decoder_msg(iss, "Executing illegal instruction\n");
@@ -285,6 +312,14 @@ iss_insn_t *iss_decode_pc_noexec(iss_t *iss, iss_insn_t *insn)
     insn->fast_handler = iss_exec_insn_with_trace;
   }
 
+  if (iss_trace_trigger_pc_active(iss, insn->addr))
+  {
+    insn->trigger_handler = insn->handler;
+    insn->trigger_fast_handler = insn->fast_handler;
+    insn->handler = iss_exec_insn_with_trigger;
+    insn->fast_handler = iss_exec_insn_with_trigger_fast;
+  }
+
   return insn;
 }
 
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Release copy of the instruction handlers, linked into the debug build of
+// the core. While traces are only enabled by windows which are all closed,
+// the core decodes instructions with this copy, which is compiled without
+// the trace checks, and switches back to the debug handlers when a window is
+// opened. The switch is done between two instructions, by flushing the
+// instruction cache, so the state of the core is kept.
+//
+// Both copies use the same structures, whose layout does not depend on
+// VP_TRACE_ACTIVE. The inline functions which are not inlined are merged by
+// the linker with the debug ones, as this file is linked last, which keeps
+// the debug behavior for them.
+
+#ifdef VP_TRACE_ACTIVE
+
+#undef VP_TRACE_ACTIVE
+
+#define __iss_isa_set __iss_isa_set_release
+#define __iss_isa_tags __iss_isa_tags_release
+
+#include ISS_DECODER_GEN
+
+#endif
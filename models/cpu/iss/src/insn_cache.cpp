@@ -55,6 +55,7 @@ void insn_init(iss_insn_t *insn, iss_addr_t addr) {
   insn->addr = addr;
   insn->next = NULL;
   insn->hwloop_handler = NULL;
+  insn->trace_desc = -1;
 }
 
 static void insn_block_init(iss_insn_block_t *b, iss_addr_t pc)
@@ -82,6 +83,15 @@ void iss_cache_flush(iss_t *iss)
 
 
 
+void iss_cache_free(iss_t *iss)
+{
+  flush_cache(iss, &iss->cpu.insn_cache);
+  iss->cpu.current_insn = NULL;
+  iss->cpu.prev_insn = NULL;
+}
+
+
+
 iss_insn_t *insn_cache_get(iss_t *iss, iss_addr_t pc)
 {
   iss_addr_t pc_base = pc & ~((1 << (ISS_INSN_BLOCK_SIZE_LOG2 + ISS_INSN_PC_BITS)) - 1);
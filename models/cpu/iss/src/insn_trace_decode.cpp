@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Converts a binary instruction trace to the text instruction trace, with
+// the debug information column if debug information files are given. The
+// descriptions of all chunks are read first, then the instructions of the
+// chunks are converted in parallel and written in order.
+
+#include "insn_trace.hpp"
+#include "symbolizer.hpp"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <thread>
+
+#define MAX_DEBUG_INFO_WIDTH 32
+
+
+struct value_desc
+{
+    int kind;
+    std::string prefix;
+};
+
+struct insn_desc
+{
+    uint64_t addr;
+    char mode;
+    std::string label;
+    std::string args;
+    std::vector<value_desc> values;
+};
+
+struct core_desc
+{
+    int path_width;
+    int reg_width;
+    std::string path;
+};
+
+struct chunk_desc
+{
+    insn_trace_chunk_t header;
+    const uint8_t *insns;
+    std::string text;
+    int error;
+};
+
+static std::vector<insn_desc> descs;
+static std::vector<core_desc> cores;
+static iss_symbolizer symbolizer;
+static bool has_debug_info = false;
+
+static int read_descs(const uint8_t *current, const uint8_t *end)
+{
+    while (current < end)
+    {
+        uint8_t type = *current++;
+        uint64_t value;
+
+        if (type == INSN_TRACE_DESC_CORE)
+        {
+            uint64_t id, path_width, reg_width;
+            core_desc core;
+            if (!insn_trace_get(&current, end, &id) || !insn_trace_get(&current, end, &path_width) ||
+                !insn_trace_get(&current, end, &reg_width) || !insn_trace_get_string(&current, end, &core.path) ||
+                id != cores.size())
+                return -1;
+            core.path_width = path_width;
+            core.reg_width = reg_width;
+            cores.push_back(core);
+        }
+        else if (type == INSN_TRACE_DESC_INSN)
+        {
+            insn_desc desc;
+            uint64_t mode, nb_values;
+            if (!insn_trace_get(&current, end, &desc.addr) || !insn_trace_get(&current, end, &mode) ||
+                !insn_trace_get_string(&current, end, &desc.label) || !insn_trace_get_string(&current, end, &desc.args) ||
+                !insn_trace_get(&current, end, &nb_values))
+                return -1;
+
+            desc.mode = mode;
+            for (uint64_t i=0; i<nb_values; i++)
+            {
+                value_desc value_desc;
+                if (!insn_trace_get(&current, end, &value) || !insn_trace_get_string(&current, end, &value_desc.prefix))
+                    return -1;
+                value_desc.kind = value;
+                desc.values.push_back(value_desc);
+            }
+
+            descs.push_back(desc);
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void append(std::string &out, const char *fmt, ...)
+{
+    char buffer[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(buffer, sizeof(buffer), fmt, ap);
+    va_end(ap);
+    out.append(buffer, len < (int)sizeof(buffer) ? len : sizeof(buffer) - 1);
+}
+
+static void pad(std::string &out, const std::string &str, uint32_t *width)
+{
+    out += str;
+    if (str.size() > *width)
+        *width = str.size();
+    else
+        out.append(*width - str.size(), ' ');
+}
+
+// Same column as the one dumped by the cores, including the last character
+// being overwritten by the padding
+static void append_debug_info(std::string &out, uint64_t addr)
+{
+    const char *func = "-", *inline_func = "-", *file = "-";
+    int line = 0;
+
+    symbolizer.lookup(addr, &func, &inline_func, &file, &line);
+
+    char buffer[MAX_DEBUG_INFO_WIDTH + 1];
+    int len = snprintf(buffer, MAX_DEBUG_INFO_WIDTH+1, "%s:%d", inline_func, line) - 1;
+    if (len > MAX_DEBUG_INFO_WIDTH)
+        len = MAX_DEBUG_INFO_WIDTH;
+    if (len < 0)
+        len = 0;
+
+    out.append(buffer, len);
+    out.append(MAX_DEBUG_INFO_WIDTH + 1 - len, ' ');
+}
+
+static int convert_chunk(chunk_desc *chunk)
+{
+    const uint8_t *current = chunk->insns;
+    const uint8_t *end = current + chunk->header.insn_size;
+    uint32_t label_width = chunk->header.label_width;
+    uint32_t args_width = chunk->header.args_width;
+    std::vector<int64_t> core_insn(cores.size(), 0), core_time(cores.size(), 0), core_cycles(cores.size(), 0);
+    std::string &out = chunk->text;
+
+    for (uint32_t i=0; i<chunk->header.nb_insn; i++)
+    {
+        uint64_t core_id;
+        int64_t desc_delta, time_delta, cycles_delta;
+
+        if (!insn_trace_get(&current, end, &core_id) || core_id >= cores.size() ||
+            !insn_trace_get_signed(&current, end, &desc_delta) ||
+            !insn_trace_get_signed(&current, end, &time_delta) ||
+            !insn_trace_get_signed(&current, end, &cycles_delta))
+            return -1;
+
+        core_insn[core_id] += desc_delta;
+        core_time[core_id] += time_delta;
+        core_cycles[core_id] += cycles_delta;
+
+        if (core_insn[core_id] < 0 || core_insn[core_id] >= (int64_t)descs.size())
+            return -1;
+
+        core_desc &core = cores[core_id];
+        insn_desc &desc = descs[core_insn[core_id]];
+
+        append(out, "%ld: %ld: [\033[34m%-*.*s\033[0m] ", core_time[core_id], core_cycles[core_id], core.path_width, core.path_width, core.path.c_str());
+
+        if (has_debug_info)
+            append_debug_info(out, desc.addr);
+
+        append(out, "%c %*.*lx ", desc.mode, core.reg_width, core.reg_width, desc.addr);
+
+        pad(out, desc.label, &label_width);
+        pad(out, desc.args, &args_width);
+
+        for (auto &value_desc: desc.values)
+        {
+            uint64_t value;
+            if (!insn_trace_get(&current, end, &value))
+                return -1;
+
+            out += value_desc.prefix;
+            if (value_desc.kind == INSN_TRACE_VALUE_ADDR_64)
+                append(out, "%16.16lx ", value);
+            else
+                append(out, "%8.8x ", (unsigned int)value);
+        }
+
+        out += "\n";
+    }
+
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--debug-info=<file>]... [--jobs=<number>] [--output=<file>] <binary instruction trace>\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> args;
+    std::string output_path;
+    int nb_jobs = std::thread::hardware_concurrency();
+
+    for (int i=1; i<argc; i++)
+    {
+        if (strncmp(argv[i], "--debug-info=", 13) == 0)
+        {
+            // Like the cores, the column is there even if the file can't
+            // be read
+            std::string error;
+            has_debug_info = true;
+            if (symbolizer.load(argv[i] + 13, error))
+                fprintf(stderr, "Failed to read debug information of %s (error: %s)\n", argv[i] + 13, error.c_str());
+        }
+        else if (strncmp(argv[i], "--jobs=", 7) == 0)
+            nb_jobs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--output=", 9) == 0)
+            output_path = argv[i] + 9;
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() != 1)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (nb_jobs < 1)
+        nb_jobs = 1;
+
+    int fd = open(args[0].c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st))
+    {
+        fprintf(stderr, "Failed to open binary instruction trace %s (error: %s)\n", args[0].c_str(), strerror(errno));
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    const uint8_t *data = size ? (const uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map binary instruction trace %s (error: %s)\n", args[0].c_str(), strerror(errno));
+        return -1;
+    }
+
+    if (size < strlen(INSN_TRACE_MAGIC) || memcmp(data, INSN_TRACE_MAGIC, strlen(INSN_TRACE_MAGIC)) != 0)
+    {
+        fprintf(stderr, "Not a binary instruction trace\n");
+        return -1;
+    }
+
+    FILE *output = stdout;
+    if (output_path != "")
+    {
+        output = fopen(output_path.c_str(), "w");
+        if (output == NULL)
+        {
+            fprintf(stderr, "Failed to open %s (error: %s)\n", output_path.c_str(), strerror(errno));
+            return -1;
+        }
+    }
+
+    // Descriptions are needed by all the following chunks, they are read
+    // sequentially first
+    std::vector<chunk_desc *> chunks;
+    size_t offset = strlen(INSN_TRACE_MAGIC);
+
+    while (offset + sizeof(insn_trace_chunk_t) <= size)
+    {
+        chunk_desc *chunk = new chunk_desc();
+        memcpy(&chunk->header, data + offset, sizeof(insn_trace_chunk_t));
+        offset += sizeof(insn_trace_chunk_t);
+
+        if ((uint64_t)chunk->header.desc_size + chunk->header.insn_size > size - offset)
+        {
+            fprintf(stderr, "Binary instruction trace is truncated, ignoring its last chunk\n");
+            delete chunk;
+            break;
+        }
+
+        if (read_descs(data + offset, data + offset + chunk->header.desc_size))
+        {
+            fprintf(stderr, "Binary instruction trace is corrupted (offset: 0x%lx)\n", offset);
+            delete chunk;
+            break;
+        }
+
+        chunk->insns = data + offset + chunk->header.desc_size;
+        offset += chunk->header.desc_size + chunk->header.insn_size;
+        chunks.push_back(chunk);
+    }
+
+    // Chunks are converted by groups to bound the memory used by their text
+    int error = 0;
+    for (unsigned int first=0; first<chunks.size() && !error; first+=nb_jobs)
+    {
+        unsigned int last = std::min(first + nb_jobs, (unsigned int)chunks.size());
+        std::vector<std::thread> threads;
+
+        for (unsigned int i=first; i<last; i++)
+        {
+            threads.push_back(std::thread([i, &chunks]() { chunks[i]->error = convert_chunk(chunks[i]); }));
+        }
+
+        for (unsigned int i=first; i<last; i++)
+        {
+            threads[i - first].join();
+            fwrite(chunks[i]->text.c_str(), 1, chunks[i]->text.size(), output);
+            chunks[i]->text.clear();
+            chunks[i]->text.shrink_to_fit();
+
+            if (chunks[i]->error && !error)
+            {
+                fprintf(stderr, "Binary instruction trace is corrupted (chunk: %d)\n", i);
+                error = 1;
+            }
+        }
+    }
+
+    if (output != stdout)
+        fclose(output);
+
+    return error ? -1 : 0;
+}
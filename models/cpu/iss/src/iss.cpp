@@ -273,6 +273,14 @@ void iss_reset(iss_t *iss, int active)
   iss_csr_init(iss, active);
 }
 
+// Only activate the instructions of the core ISA in the decoding tree, which is
+// shared by all the instances
+int iss_activate_isa(iss_t *iss)
+{
+  iss_isa_pulpv2_init(iss);
+  return iss_parse_isa(iss);
+}
+
 int iss_open(iss_t *iss)
 {
   iss_isa_pulpv2_init(iss);
@@ -297,6 +305,13 @@ int iss_open(iss_t *iss)
 
 
 
+void iss_close(iss_t *iss)
+{
+  iss_cache_free(iss);
+}
+
+
+
 void iss_start(iss_t *iss)
 {
 }
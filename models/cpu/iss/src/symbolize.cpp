@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Gives the debug information of addresses, read from the standard input,
+// or dumps the debug information of all the addresses of the functions, in
+// the format of the files generated by pulp-pc-info. Each line is:
+// <address> <function> <inline function> <file> <line>
+
+#include "symbolizer.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [--all-file=<file>] <binary>...\n", name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Prints the debug information of the hexadecimal addresses read from the standard input, or of all the addresses of the functions into the given file.\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> args;
+    std::string all_path;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (strncmp(argv[i], "--all-file=", 11) == 0)
+            all_path = argv[i] + 11;
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() == 0)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    iss_symbolizer symbolizer;
+
+    for (auto &binary: args)
+    {
+        std::string error;
+        if (symbolizer.load(binary.c_str(), error))
+        {
+            fprintf(stderr, "Failed to read debug information of %s (error: %s)\n", binary.c_str(), error.c_str());
+            return -1;
+        }
+    }
+
+    if (all_path != "")
+    {
+        FILE *file = fopen(all_path.c_str(), "w");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Failed to open %s (error: %s)\n", all_path.c_str(), strerror(errno));
+            return -1;
+        }
+
+        // One line every 2 bytes, as instructions may be compressed
+        symbolizer.foreach_range([file](uint64_t base, uint64_t end, const char *func, const char *inline_func, const char *file_name, int line) {
+            for (uint64_t addr=base; addr<end; addr+=2)
+                fprintf(file, "%lx %s %s %s %d\n", addr, func, inline_func, file_name, line);
+        });
+
+        fclose(file);
+        return 0;
+    }
+
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, stdin) != -1)
+    {
+        char *end;
+        uint64_t addr = strtoull(line, &end, 16);
+        if (end == line)
+            continue;
+
+        const char *func = "-", *inline_func = "-", *file = "-";
+        int line_number = 0;
+        symbolizer.lookup(addr, &func, &inline_func, &file, &line_number);
+
+        printf("%lx %s %s %s %d\n", addr, func, inline_func, file, line_number);
+    }
+
+    free(line);
+
+    return 0;
+}
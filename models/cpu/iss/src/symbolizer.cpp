@@ -0,0 +1,1556 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "symbolizer.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <unordered_map>
+
+// DWARF constants used to read the line and inline tables
+#define DW_TAG_inlined_subroutine  0x1d
+#define DW_TAG_subprogram          0x2e
+
+#define DW_AT_stmt_list            0x10
+#define DW_AT_low_pc               0x11
+#define DW_AT_high_pc              0x12
+#define DW_AT_name                 0x03
+#define DW_AT_comp_dir             0x1b
+#define DW_AT_abstract_origin      0x31
+#define DW_AT_specification        0x47
+#define DW_AT_ranges               0x55
+#define DW_AT_str_offsets_base     0x72
+#define DW_AT_addr_base            0x73
+#define DW_AT_rnglists_base        0x74
+#define DW_AT_linkage_name         0x6e
+#define DW_AT_MIPS_linkage_name    0x2007
+
+#define DW_FORM_addr               0x01
+#define DW_FORM_block2             0x03
+#define DW_FORM_block4             0x04
+#define DW_FORM_data2              0x05
+#define DW_FORM_data4              0x06
+#define DW_FORM_data8              0x07
+#define DW_FORM_string             0x08
+#define DW_FORM_block              0x09
+#define DW_FORM_block1             0x0a
+#define DW_FORM_data1              0x0b
+#define DW_FORM_flag               0x0c
+#define DW_FORM_sdata              0x0d
+#define DW_FORM_strp               0x0e
+#define DW_FORM_udata              0x0f
+#define DW_FORM_ref_addr           0x10
+#define DW_FORM_ref1               0x11
+#define DW_FORM_ref2               0x12
+#define DW_FORM_ref4               0x13
+#define DW_FORM_ref8               0x14
+#define DW_FORM_ref_udata          0x15
+#define DW_FORM_indirect           0x16
+#define DW_FORM_sec_offset         0x17
+#define DW_FORM_exprloc            0x18
+#define DW_FORM_flag_present       0x19
+#define DW_FORM_strx               0x1a
+#define DW_FORM_addrx              0x1b
+#define DW_FORM_ref_sup4           0x1c
+#define DW_FORM_strp_sup           0x1d
+#define DW_FORM_data16             0x1e
+#define DW_FORM_line_strp          0x1f
+#define DW_FORM_ref_sig8           0x20
+#define DW_FORM_implicit_const     0x21
+#define DW_FORM_loclistx           0x22
+#define DW_FORM_rnglistx           0x23
+#define DW_FORM_ref_sup8           0x24
+#define DW_FORM_strx1              0x25
+#define DW_FORM_strx2              0x26
+#define DW_FORM_strx3              0x27
+#define DW_FORM_strx4              0x28
+#define DW_FORM_addrx1             0x29
+#define DW_FORM_addrx2             0x2a
+#define DW_FORM_addrx3             0x2b
+#define DW_FORM_addrx4             0x2c
+#define DW_FORM_GNU_addr_index     0x1f01
+#define DW_FORM_GNU_str_index      0x1f02
+#define DW_FORM_GNU_ref_alt        0x1f20
+#define DW_FORM_GNU_strp_alt       0x1f21
+
+#define DW_LNS_copy                1
+#define DW_LNS_advance_pc          2
+#define DW_LNS_advance_line        3
+#define DW_LNS_set_file            4
+#define DW_LNS_const_add_pc        8
+#define DW_LNS_fixed_advance_pc    9
+#define DW_LNE_end_sequence        1
+#define DW_LNE_set_address         2
+
+#define DW_LNCT_path               1
+#define DW_LNCT_directory_index    2
+
+#define DW_RLE_end_of_list         0
+#define DW_RLE_base_addressx       1
+#define DW_RLE_startx_endx         2
+#define DW_RLE_startx_length       3
+#define DW_RLE_offset_pair         4
+#define DW_RLE_base_address        5
+#define DW_RLE_start_end           6
+#define DW_RLE_start_length        7
+
+
+class iss_symbolizer_image
+{
+public:
+  ~iss_symbolizer_image();
+
+  const iss_symbolizer_range_t *ranges = NULL;
+  uint64_t nb_ranges = 0;
+  const char *strings = NULL;
+
+  // Either the mapped cache file, or the index built from a text file
+  void *map = NULL;
+  size_t map_size = 0;
+  std::vector<iss_symbolizer_range_t> owned_ranges;
+  std::string owned_strings;
+};
+
+iss_symbolizer_image::~iss_symbolizer_image()
+{
+  if (this->map)
+    munmap(this->map, this->map_size);
+}
+
+
+// Strings of the index, stored once each
+class string_pool
+{
+public:
+  string_pool() { this->get("-"); }
+
+  uint32_t get(const std::string &str)
+  {
+    auto it = this->offsets.find(str);
+    if (it != this->offsets.end())
+      return it->second;
+
+    uint32_t offset = this->strings.size();
+    this->strings.append(str.c_str(), str.size() + 1);
+    this->offsets[str] = offset;
+    return offset;
+  }
+
+  std::string strings;
+
+private:
+  std::unordered_map<std::string, uint32_t> offsets;
+};
+
+
+// Bounded reader of DWARF sections, reads past the end just set the error
+class dwarf_reader
+{
+public:
+  dwarf_reader(const uint8_t *start, const uint8_t *end) : current(start), end(end) {}
+
+  bool check(uint64_t size)
+  {
+    if (this->error || size > (uint64_t)(this->end - this->current))
+    {
+      this->error = true;
+      this->current = this->end;
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t fixed(int size)
+  {
+    if (!this->check(size))
+      return 0;
+    uint64_t value = 0;
+    for (int i=0; i<size; i++)
+      value |= (uint64_t)this->current[i] << (i*8);
+    this->current += size;
+    return value;
+  }
+
+  uint8_t u8() { return this->fixed(1); }
+  uint16_t u16() { return this->fixed(2); }
+  uint32_t u32() { return this->fixed(4); }
+  uint64_t u64() { return this->fixed(8); }
+
+  uint64_t uleb()
+  {
+    uint64_t value = 0;
+    int shift = 0;
+    while (this->check(1))
+    {
+      uint8_t byte = *this->current++;
+      if (shift < 64)
+        value |= (uint64_t)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80))
+        break;
+    }
+    return value;
+  }
+
+  int64_t sleb()
+  {
+    int64_t value = 0;
+    int shift = 0;
+    uint8_t byte = 0;
+    while (this->check(1))
+    {
+      byte = *this->current++;
+      if (shift < 64)
+        value |= (int64_t)(byte & 0x7f) << shift;
+      shift += 7;
+      if (!(byte & 0x80))
+        break;
+    }
+    if (shift < 64 && (byte & 0x40))
+      value |= -((int64_t)1 << shift);
+    return value;
+  }
+
+  const char *str()
+  {
+    const char *result = (const char *)this->current;
+    const uint8_t *zero = (const uint8_t *)memchr(this->current, 0, this->end - this->current);
+    if (this->error || zero == NULL)
+    {
+      this->error = true;
+      this->current = this->end;
+      return "";
+    }
+    this->current = zero + 1;
+    return result;
+  }
+
+  void skip(uint64_t size)
+  {
+    if (this->check(size))
+      this->current += size;
+  }
+
+  // Unit length, which also gives the size of section offsets
+  uint64_t unit_length(bool *is_64)
+  {
+    uint64_t length = this->u32();
+    *is_64 = length == 0xffffffff;
+    if (*is_64)
+      length = this->u64();
+    return length;
+  }
+
+  const uint8_t *current;
+  const uint8_t *end;
+  bool error = false;
+};
+
+
+class elf_section
+{
+public:
+  const uint8_t *data = NULL;
+  uint64_t size = 0;
+
+  const uint8_t *end() { return this->data + this->size; }
+
+  const char *str(uint64_t offset)
+  {
+    if (this->data == NULL || offset >= this->size || memchr(this->data + offset, 0, this->size - offset) == NULL)
+      return "";
+    return (const char *)this->data + offset;
+  }
+};
+
+typedef struct
+{
+  uint64_t base;
+  uint64_t end;
+  uint32_t name;
+} func_range_t;
+
+typedef struct
+{
+  uint64_t base;
+  uint64_t end;
+  uint32_t file;
+  uint32_t line;
+} line_range_t;
+
+typedef struct
+{
+  uint64_t base;
+  uint64_t end;
+  int depth;
+  uint64_t die;
+} scope_range_t;
+
+typedef struct
+{
+  uint32_t attr;
+  uint32_t form;
+  int64_t implicit_const;
+} abbrev_attr_t;
+
+typedef struct
+{
+  uint64_t tag;
+  bool has_children;
+  std::vector<abbrev_attr_t> attrs;
+} abbrev_t;
+
+// Name of a subprogram, or the subprogram giving it
+typedef struct
+{
+  const char *name;
+  uint64_t origin;
+} die_name_t;
+
+
+// Builds the index from the ELF and DWARF sections of a binary
+class dwarf_indexer
+{
+public:
+  int build(const uint8_t *data, size_t size, std::string &error);
+
+  string_pool strings;
+  std::vector<iss_symbolizer_range_t> ranges;
+
+private:
+  int read_sections(std::string &error);
+  void read_symbols();
+  void read_info();
+  void read_unit(dwarf_reader &reader, uint64_t unit_offset);
+  void read_lines();
+  void read_line_unit(dwarf_reader &reader, uint64_t unit_offset);
+  std::unordered_map<uint64_t, abbrev_t> &get_abbrevs(uint64_t offset);
+  void read_ranges(uint64_t offset, bool is_rnglistx, int version, int offset_size, uint64_t base, int depth, uint64_t die);
+  uint64_t read_addrx(uint64_t index);
+  const char *read_strx(uint64_t index, bool is_64);
+  const char *get_name(uint64_t die);
+  void merge();
+
+  const uint8_t *data;
+  size_t size;
+  bool is_64;
+  int addr_size;
+
+  elf_section symtab, symtab_str;
+  elf_section debug_info, debug_abbrev, debug_line, debug_str, debug_line_str;
+  elf_section debug_ranges, debug_rnglists, debug_addr, debug_str_offsets;
+
+  std::vector<func_range_t> funcs;
+  std::vector<line_range_t> lines;
+  std::vector<scope_range_t> scopes;
+  std::unordered_map<uint64_t, std::unordered_map<uint64_t, abbrev_t>> abbrevs;
+  std::unordered_map<uint64_t, die_name_t> die_names;
+  std::unordered_map<uint64_t, std::string> comp_dirs;
+
+  // Current unit bases
+  uint64_t addr_base;
+  uint64_t str_offsets_base;
+  uint64_t rnglists_base;
+};
+
+
+int dwarf_indexer::read_sections(std::string &error)
+{
+  if (this->size < EI_NIDENT || memcmp(this->data, ELFMAG, SELFMAG) != 0)
+  {
+    error = "not an ELF file";
+    return -1;
+  }
+
+  if (this->data[EI_DATA] != ELFDATA2LSB)
+  {
+    error = "only little-endian ELF files are supported";
+    return -1;
+  }
+
+  this->is_64 = this->data[EI_CLASS] == ELFCLASS64;
+  this->addr_size = this->is_64 ? 8 : 4;
+
+  uint64_t shoff, shentsize, shnum, shstrndx;
+
+  if (this->is_64)
+  {
+    if (this->size < sizeof(Elf64_Ehdr))
+      goto truncated;
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)this->data;
+    shoff = ehdr->e_shoff; shentsize = ehdr->e_shentsize; shnum = ehdr->e_shnum; shstrndx = ehdr->e_shstrndx;
+    if (shentsize < sizeof(Elf64_Shdr))
+      goto truncated;
+  }
+  else
+  {
+    if (this->size < sizeof(Elf32_Ehdr))
+      goto truncated;
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)this->data;
+    shoff = ehdr->e_shoff; shentsize = ehdr->e_shentsize; shnum = ehdr->e_shnum; shstrndx = ehdr->e_shstrndx;
+    if (shentsize < sizeof(Elf32_Shdr))
+      goto truncated;
+  }
+
+  if (shoff > this->size || shnum * shentsize > this->size - shoff || shstrndx >= shnum)
+    goto truncated;
+
+  {
+    std::vector<elf_section> sections(shnum);
+    std::vector<uint32_t> names(shnum), types(shnum), links(shnum);
+
+    for (uint64_t i=0; i<shnum; i++)
+    {
+      const uint8_t *shdr = this->data + shoff + i * shentsize;
+      uint64_t offset;
+      if (this->is_64)
+      {
+        const Elf64_Shdr *section = (const Elf64_Shdr *)shdr;
+        offset = section->sh_offset; sections[i].size = section->sh_size;
+        names[i] = section->sh_name; types[i] = section->sh_type; links[i] = section->sh_link;
+      }
+      else
+      {
+        const Elf32_Shdr *section = (const Elf32_Shdr *)shdr;
+        offset = section->sh_offset; sections[i].size = section->sh_size;
+        names[i] = section->sh_name; types[i] = section->sh_type; links[i] = section->sh_link;
+      }
+
+      if (types[i] == SHT_NOBITS || offset > this->size || sections[i].size > this->size - offset)
+        sections[i].size = 0;
+      else
+        sections[i].data = this->data + offset;
+    }
+
+    elf_section &shstrtab = sections[shstrndx];
+
+    for (uint64_t i=0; i<shnum; i++)
+    {
+      std::string name = shstrtab.str(names[i]);
+
+      if (types[i] == SHT_SYMTAB && links[i] < shnum)
+      {
+        this->symtab = sections[i];
+        this->symtab_str = sections[links[i]];
+      }
+      else if (name == ".debug_info") this->debug_info = sections[i];
+      else if (name == ".debug_abbrev") this->debug_abbrev = sections[i];
+      else if (name == ".debug_line") this->debug_line = sections[i];
+      else if (name == ".debug_str") this->debug_str = sections[i];
+      else if (name == ".debug_line_str") this->debug_line_str = sections[i];
+      else if (name == ".debug_ranges") this->debug_ranges = sections[i];
+      else if (name == ".debug_rnglists") this->debug_rnglists = sections[i];
+      else if (name == ".debug_addr") this->debug_addr = sections[i];
+      else if (name == ".debug_str_offsets") this->debug_str_offsets = sections[i];
+    }
+  }
+
+  return 0;
+
+truncated:
+  error = "truncated or invalid ELF file";
+  return -1;
+}
+
+
+void dwarf_indexer::read_symbols()
+{
+  size_t entry_size = this->is_64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+
+  for (uint64_t offset=0; offset + entry_size <= this->symtab.size; offset += entry_size)
+  {
+    uint64_t value, size;
+    uint32_t name;
+    int type;
+    uint16_t shndx;
+
+    if (this->is_64)
+    {
+      const Elf64_Sym *sym = (const Elf64_Sym *)(this->symtab.data + offset);
+      value = sym->st_value; size = sym->st_size; name = sym->st_name; type = ELF64_ST_TYPE(sym->st_info); shndx = sym->st_shndx;
+    }
+    else
+    {
+      const Elf32_Sym *sym = (const Elf32_Sym *)(this->symtab.data + offset);
+      value = sym->st_value; size = sym->st_size; name = sym->st_name; type = ELF32_ST_TYPE(sym->st_info); shndx = sym->st_shndx;
+    }
+
+    if (type != STT_FUNC || size == 0 || shndx == SHN_UNDEF)
+      continue;
+
+    this->funcs.push_back({ value, value + size, this->strings.get(this->symtab_str.str(name)) });
+  }
+}
+
+
+std::unordered_map<uint64_t, abbrev_t> &dwarf_indexer::get_abbrevs(uint64_t offset)
+{
+  auto it = this->abbrevs.find(offset);
+  if (it != this->abbrevs.end())
+    return it->second;
+
+  std::unordered_map<uint64_t, abbrev_t> &result = this->abbrevs[offset];
+
+  if (offset >= this->debug_abbrev.size)
+    return result;
+
+  dwarf_reader reader(this->debug_abbrev.data + offset, this->debug_abbrev.end());
+
+  while (!reader.error)
+  {
+    uint64_t code = reader.uleb();
+    if (code == 0)
+      break;
+
+    abbrev_t &abbrev = result[code];
+    abbrev.tag = reader.uleb();
+    abbrev.has_children = reader.u8();
+
+    while (!reader.error)
+    {
+      abbrev_attr_t attr;
+      attr.attr = reader.uleb();
+      attr.form = reader.uleb();
+      attr.implicit_const = 0;
+      if (attr.attr == 0 && attr.form == 0)
+        break;
+      if (attr.form == DW_FORM_implicit_const)
+        attr.implicit_const = reader.sleb();
+      abbrev.attrs.push_back(attr);
+    }
+  }
+
+  return result;
+}
+
+
+uint64_t dwarf_indexer::read_addrx(uint64_t index)
+{
+  uint64_t offset = this->addr_base + index * this->addr_size;
+  if (offset + this->addr_size > this->debug_addr.size)
+    return 0;
+  dwarf_reader reader(this->debug_addr.data + offset, this->debug_addr.end());
+  return reader.fixed(this->addr_size);
+}
+
+
+const char *dwarf_indexer::read_strx(uint64_t index, bool is_64)
+{
+  int offset_size = is_64 ? 8 : 4;
+  uint64_t offset = this->str_offsets_base + index * offset_size;
+  if (offset + offset_size > this->debug_str_offsets.size)
+    return "";
+  dwarf_reader reader(this->debug_str_offsets.data + offset, this->debug_str_offsets.end());
+  return this->debug_str.str(reader.fixed(offset_size));
+}
+
+
+void dwarf_indexer::read_ranges(uint64_t offset, bool is_rnglistx, int version, int offset_size, uint64_t base, int depth, uint64_t die)
+{
+  if (version < 5)
+  {
+    if (offset >= this->debug_ranges.size)
+      return;
+
+    dwarf_reader reader(this->debug_ranges.data + offset, this->debug_ranges.end());
+    uint64_t max_addr = this->addr_size == 8 ? (uint64_t)-1 : 0xffffffff;
+
+    while (!reader.error)
+    {
+      uint64_t start = reader.fixed(this->addr_size);
+      uint64_t end = reader.fixed(this->addr_size);
+      if (start == 0 && end == 0)
+        break;
+      if (start == max_addr)
+        base = end;
+      else if (start < end)
+        this->scopes.push_back({ base + start, base + end, depth, die });
+    }
+    return;
+  }
+
+  if (is_rnglistx)
+  {
+    // The index selects an entry of the offsets table of the unit, giving
+    // the list relative to the table
+    uint64_t table = this->rnglists_base;
+    if (table > this->debug_rnglists.size)
+      return;
+    dwarf_reader entry(this->debug_rnglists.data + table, this->debug_rnglists.end());
+    entry.skip(offset * offset_size);
+    offset = table + entry.fixed(offset_size);
+  }
+
+  if (offset >= this->debug_rnglists.size)
+    return;
+
+  dwarf_reader reader(this->debug_rnglists.data + offset, this->debug_rnglists.end());
+
+  while (!reader.error)
+  {
+    uint64_t start = 0, end = 0;
+
+    switch (reader.u8())
+    {
+      case DW_RLE_end_of_list:
+        return;
+      case DW_RLE_base_addressx:
+        base = this->read_addrx(reader.uleb());
+        continue;
+      case DW_RLE_startx_endx:
+        start = this->read_addrx(reader.uleb());
+        end = this->read_addrx(reader.uleb());
+        break;
+      case DW_RLE_startx_length:
+        start = this->read_addrx(reader.uleb());
+        end = start + reader.uleb();
+        break;
+      case DW_RLE_offset_pair:
+        start = base + reader.uleb();
+        end = base + reader.uleb();
+        break;
+      case DW_RLE_base_address:
+        base = reader.fixed(this->addr_size);
+        continue;
+      case DW_RLE_start_end:
+        start = reader.fixed(this->addr_size);
+        end = reader.fixed(this->addr_size);
+        break;
+      case DW_RLE_start_length:
+        start = reader.fixed(this->addr_size);
+        end = start + reader.uleb();
+        break;
+      default:
+        return;
+    }
+
+    if (start < end)
+      this->scopes.push_back({ start, end, depth, die });
+  }
+}
+
+
+void dwarf_indexer::read_unit(dwarf_reader &reader, uint64_t unit_offset)
+{
+  bool is_64;
+  uint64_t length = reader.unit_length(&is_64);
+  const uint8_t *unit_end = reader.current + length;
+  if (!reader.check(length))
+    return;
+
+  int offset_size = is_64 ? 8 : 4;
+  int version = reader.u16();
+  uint64_t abbrev_offset;
+  int unit_addr_size;
+
+  if (version < 2 || version > 5)
+  {
+    reader.current = unit_end;
+    return;
+  }
+
+  if (version >= 5)
+  {
+    int unit_type = reader.u8();
+    unit_addr_size = reader.u8();
+    abbrev_offset = reader.fixed(offset_size);
+    if (unit_type == 4 || unit_type == 5)
+      reader.skip(8);
+    else if (unit_type == 2 || unit_type == 6)
+      reader.skip(8 + offset_size);
+  }
+  else
+  {
+    abbrev_offset = reader.fixed(offset_size);
+    unit_addr_size = reader.u8();
+  }
+
+  if (unit_addr_size != 4 && unit_addr_size != 8)
+  {
+    reader.current = unit_end;
+    return;
+  }
+  this->addr_size = unit_addr_size;
+
+  std::unordered_map<uint64_t, abbrev_t> &abbrevs = this->get_abbrevs(abbrev_offset);
+
+  dwarf_reader unit(reader.current, unit_end);
+  reader.current = unit_end;
+
+  this->addr_base = 8;
+  this->str_offsets_base = 8;
+  this->rnglists_base = 0;
+
+  uint64_t unit_base = 0;
+  int depth = 0;
+  bool is_first = true;
+
+  struct attr_value { uint32_t attr; uint32_t form; uint64_t value; const char *str; };
+  std::vector<attr_value> values;
+
+  while (!unit.error && unit.current < unit.end)
+  {
+    uint64_t die = unit.current - this->debug_info.data;
+    uint64_t code = unit.uleb();
+    if (code == 0)
+    {
+      depth--;
+      continue;
+    }
+
+    auto it = abbrevs.find(code);
+    if (it == abbrevs.end())
+      return;
+    abbrev_t &abbrev = it->second;
+
+    values.clear();
+
+    for (abbrev_attr_t &attr: abbrev.attrs)
+    {
+      uint32_t form = attr.form;
+      uint64_t value = 0;
+      const char *str = NULL;
+
+      if (form == DW_FORM_indirect)
+        form = unit.uleb();
+
+      switch (form)
+      {
+        case DW_FORM_addr: value = unit.fixed(unit_addr_size); break;
+        case DW_FORM_block2: unit.skip(unit.u16()); break;
+        case DW_FORM_block4: unit.skip(unit.u32()); break;
+        case DW_FORM_data2: value = unit.u16(); break;
+        case DW_FORM_data4: value = unit.u32(); break;
+        case DW_FORM_data8: value = unit.u64(); break;
+        case DW_FORM_string: str = unit.str(); break;
+        case DW_FORM_block: unit.skip(unit.uleb()); break;
+        case DW_FORM_block1: unit.skip(unit.u8()); break;
+        case DW_FORM_data1: value = unit.u8(); break;
+        case DW_FORM_flag: value = unit.u8(); break;
+        case DW_FORM_sdata: value = unit.sleb(); break;
+        case DW_FORM_strp: str = this->debug_str.str(unit.fixed(offset_size)); break;
+        case DW_FORM_line_strp: str = this->debug_line_str.str(unit.fixed(offset_size)); break;
+        case DW_FORM_udata: value = unit.uleb(); break;
+        case DW_FORM_ref_addr: value = unit.fixed(version == 2 ? unit_addr_size : offset_size); break;
+        case DW_FORM_ref1: value = unit_offset + unit.u8(); break;
+        case DW_FORM_ref2: value = unit_offset + unit.u16(); break;
+        case DW_FORM_ref4: value = unit_offset + unit.u32(); break;
+        case DW_FORM_ref8: value = unit_offset + unit.u64(); break;
+        case DW_FORM_ref_udata: value = unit_offset + unit.uleb(); break;
+        case DW_FORM_sec_offset: value = unit.fixed(offset_size); break;
+        case DW_FORM_exprloc: unit.skip(unit.uleb()); break;
+        case DW_FORM_flag_present: value = 1; break;
+        case DW_FORM_strx: case DW_FORM_GNU_str_index: value = unit.uleb(); break;
+        case DW_FORM_strx1: value = unit.u8(); break;
+        case DW_FORM_strx2: value = unit.u16(); break;
+        case DW_FORM_strx3: value = unit.fixed(3); break;
+        case DW_FORM_strx4: value = unit.u32(); break;
+        case DW_FORM_addrx: case DW_FORM_GNU_addr_index: value = unit.uleb(); break;
+        case DW_FORM_addrx1: value = unit.u8(); break;
+        case DW_FORM_addrx2: value = unit.u16(); break;
+        case DW_FORM_addrx3: value = unit.fixed(3); break;
+        case DW_FORM_addrx4: value = unit.u32(); break;
+        case DW_FORM_ref_sup4: unit.skip(4); break;
+        case DW_FORM_ref_sup8: unit.skip(8); break;
+        case DW_FORM_strp_sup: case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt: unit.skip(offset_size); break;
+        case DW_FORM_data16: unit.skip(16); break;
+        case DW_FORM_ref_sig8: unit.skip(8); break;
+        case DW_FORM_implicit_const: value = attr.implicit_const; break;
+        case DW_FORM_loclistx: case DW_FORM_rnglistx: value = unit.uleb(); break;
+        default:
+          // The size of an unknown form is unknown, the rest of the unit
+          // can't be read
+          return;
+      }
+
+      values.push_back({ attr.attr, form, value, str });
+    }
+
+    // Bases are given by the unit entry and apply to its own attributes
+    if (is_first)
+    {
+      for (attr_value &value: values)
+      {
+        if (value.attr == DW_AT_addr_base) this->addr_base = value.value;
+        else if (value.attr == DW_AT_str_offsets_base) this->str_offsets_base = value.value;
+        else if (value.attr == DW_AT_rnglists_base) this->rnglists_base = value.value;
+      }
+    }
+
+    bool is_scope = abbrev.tag == DW_TAG_subprogram || abbrev.tag == DW_TAG_inlined_subroutine;
+
+    if (is_first || is_scope)
+    {
+      const char *name = NULL;
+      const char *linkage_name = NULL;
+      const char *comp_dir = NULL;
+      uint64_t origin = 0, stmt_list = (uint64_t)-1;
+      uint64_t low_pc = 0, high_pc = 0;
+      bool has_low_pc = false, has_high_pc = false, high_pc_is_offset = false;
+      bool has_ranges = false, ranges_is_rnglistx = false;
+      uint64_t ranges = 0;
+
+      for (attr_value &value: values)
+      {
+        switch (value.attr)
+        {
+          case DW_AT_name:
+          case DW_AT_linkage_name:
+          case DW_AT_MIPS_linkage_name:
+          case DW_AT_comp_dir:
+          {
+            const char *str = value.str;
+            if (value.form == DW_FORM_strx || value.form == DW_FORM_GNU_str_index ||
+                (value.form >= DW_FORM_strx1 && value.form <= DW_FORM_strx4))
+              str = this->read_strx(value.value, is_64);
+            if (str == NULL)
+              break;
+            // Linkage names are preferred, like addr2line does
+            if (value.attr == DW_AT_comp_dir)
+              comp_dir = str;
+            else if (value.attr != DW_AT_name)
+              linkage_name = str;
+            else
+              name = str;
+            break;
+          }
+
+          case DW_AT_abstract_origin:
+          case DW_AT_specification:
+            origin = value.value;
+            break;
+
+          case DW_AT_low_pc:
+            has_low_pc = true;
+            low_pc = value.form == DW_FORM_addr ? value.value : this->read_addrx(value.value);
+            break;
+
+          case DW_AT_high_pc:
+            has_high_pc = true;
+            high_pc_is_offset = value.form != DW_FORM_addr &&
+              !(value.form == DW_FORM_addrx || value.form == DW_FORM_GNU_addr_index || (value.form >= DW_FORM_addrx1 && value.form <= DW_FORM_addrx4));
+            high_pc = value.form == DW_FORM_addr || high_pc_is_offset ? value.value : this->read_addrx(value.value);
+            break;
+
+          case DW_AT_ranges:
+            has_ranges = true;
+            ranges = value.value;
+            ranges_is_rnglistx = value.form == DW_FORM_rnglistx;
+            break;
+
+          case DW_AT_stmt_list:
+            stmt_list = value.value;
+            break;
+        }
+      }
+
+      if (is_first)
+      {
+        // Line tables are only relative to the compilation directory of
+        // their unit, which is remembered for when they are read
+        if (comp_dir && stmt_list != (uint64_t)-1)
+          this->comp_dirs[stmt_list] = comp_dir;
+        unit_base = low_pc;
+      }
+      else
+      {
+        this->die_names[die] = { linkage_name ? linkage_name : name, origin };
+
+        if (has_low_pc && has_high_pc)
+        {
+          if (high_pc_is_offset)
+            high_pc += low_pc;
+          if (low_pc < high_pc)
+            this->scopes.push_back({ low_pc, high_pc, depth, die });
+        }
+        else if (has_ranges)
+        {
+          this->read_ranges(ranges, ranges_is_rnglistx, version, offset_size, unit_base, depth, die);
+        }
+      }
+    }
+
+    is_first = false;
+
+    if (abbrev.has_children)
+      depth++;
+  }
+}
+
+
+void dwarf_indexer::read_info()
+{
+  dwarf_reader reader(this->debug_info.data, this->debug_info.end());
+
+  while (!reader.error && reader.current < reader.end)
+  {
+    this->read_unit(reader, reader.current - this->debug_info.data);
+  }
+}
+
+
+const char *dwarf_indexer::get_name(uint64_t die)
+{
+  // Inlined functions and out-of-line instances get their name from their
+  // abstract instance or their declaration
+  for (int i=0; i<8; i++)
+  {
+    auto it = this->die_names.find(die);
+    if (it == this->die_names.end())
+      return NULL;
+    if (it->second.name)
+      return it->second.name;
+    die = it->second.origin;
+  }
+
+  return NULL;
+}
+
+
+void dwarf_indexer::read_line_unit(dwarf_reader &reader, uint64_t unit_offset)
+{
+  bool is_64;
+  uint64_t length = reader.unit_length(&is_64);
+  const uint8_t *unit_end = reader.current + length;
+  if (!reader.check(length))
+    return;
+
+  dwarf_reader unit(reader.current, unit_end);
+  reader.current = unit_end;
+
+  int offset_size = is_64 ? 8 : 4;
+  int version = unit.u16();
+  if (version < 2 || version > 5)
+    return;
+
+  int unit_addr_size = this->addr_size;
+  if (version >= 5)
+  {
+    unit_addr_size = unit.u8();
+    unit.u8();
+  }
+
+  uint64_t header_length = unit.fixed(offset_size);
+  if (!unit.check(header_length))
+    return;
+  const uint8_t *program = unit.current + header_length;
+
+  int min_insn_length = unit.u8();
+  if (version >= 4)
+    unit.u8();
+  unit.u8();
+  int8_t line_base = unit.u8();
+  int line_range = unit.u8();
+  int opcode_base = unit.u8();
+
+  if (line_range == 0 || opcode_base == 0)
+    return;
+
+  std::vector<uint8_t> opcode_lengths(opcode_base, 0);
+  for (int i=1; i<opcode_base; i++)
+    opcode_lengths[i] = unit.u8();
+
+  std::string comp_dir;
+  auto comp_dir_it = this->comp_dirs.find(unit_offset);
+  if (comp_dir_it != this->comp_dirs.end())
+    comp_dir = comp_dir_it->second;
+
+  std::vector<std::string> dirs;
+  std::vector<uint32_t> files;
+  std::vector<std::pair<std::string, uint64_t>> file_entries;
+
+  if (version >= 5)
+  {
+    // Entries are described by their content and form
+    for (int kind=0; kind<2; kind++)
+    {
+      int nb_formats = unit.u8();
+      std::vector<std::pair<uint64_t, uint64_t>> formats;
+      for (int i=0; i<nb_formats; i++)
+      {
+        uint64_t content = unit.uleb();
+        formats.push_back({ content, unit.uleb() });
+      }
+
+      uint64_t count = unit.uleb();
+      for (uint64_t i=0; i<count && !unit.error; i++)
+      {
+        std::string path;
+        uint64_t dir = 0;
+
+        for (auto &format: formats)
+        {
+          const char *str = NULL;
+          uint64_t value = 0;
+
+          switch (format.second)
+          {
+            case DW_FORM_string: str = unit.str(); break;
+            case DW_FORM_line_strp: str = this->debug_line_str.str(unit.fixed(offset_size)); break;
+            case DW_FORM_strp: str = this->debug_str.str(unit.fixed(offset_size)); break;
+            case DW_FORM_udata: value = unit.uleb(); break;
+            case DW_FORM_data1: value = unit.u8(); break;
+            case DW_FORM_data2: value = unit.u16(); break;
+            case DW_FORM_data4: value = unit.u32(); break;
+            case DW_FORM_data8: value = unit.u64(); break;
+            case DW_FORM_data16: unit.skip(16); break;
+            case DW_FORM_block: unit.skip(unit.uleb()); break;
+            default: return;
+          }
+
+          if (format.first == DW_LNCT_path && str)
+            path = str;
+          else if (format.first == DW_LNCT_directory_index)
+            dir = value;
+        }
+
+        if (kind == 0)
+          dirs.push_back(path);
+        else
+          file_entries.push_back({ path, dir });
+      }
+    }
+  }
+  else
+  {
+    // Directory 0 is the compilation directory and file 0 does not exist
+    dirs.push_back(comp_dir);
+    file_entries.push_back({ "", 0 });
+
+    while (!unit.error)
+    {
+      const char *dir = unit.str();
+      if (*dir == 0)
+        break;
+      dirs.push_back(dir);
+    }
+
+    while (!unit.error)
+    {
+      const char *file = unit.str();
+      if (*file == 0)
+        break;
+      uint64_t dir = unit.uleb();
+      unit.uleb();
+      unit.uleb();
+      file_entries.push_back({ file, dir });
+    }
+  }
+
+  for (auto &entry: file_entries)
+  {
+    std::string path = entry.first;
+    if (path[0] != '/' && entry.second < dirs.size() && dirs[entry.second] != "")
+    {
+      std::string dir = dirs[entry.second];
+      if (dir[0] != '/' && comp_dir != "" && (version < 5 || entry.second != 0))
+        dir = comp_dir + "/" + dir;
+      path = dir + "/" + path;
+    }
+    files.push_back(this->strings.get(path));
+  }
+
+  if (unit.error || program > unit_end)
+    return;
+
+  unit.current = program;
+
+  uint64_t address = 0;
+  uint64_t file = 1;
+  int64_t line = 1;
+  bool has_row = false;
+  line_range_t row = { 0, 0, 0, 0 };
+
+  while (!unit.error && unit.current < unit.end)
+  {
+    int opcode = unit.u8();
+    bool emit = false;
+    bool end_sequence = false;
+
+    if (opcode >= opcode_base)
+    {
+      int adjusted = opcode - opcode_base;
+      address += (adjusted / line_range) * min_insn_length;
+      line += line_base + adjusted % line_range;
+      emit = true;
+    }
+    else if (opcode == 0)
+    {
+      uint64_t length = unit.uleb();
+      if (length == 0 || !unit.check(length))
+        break;
+      const uint8_t *next = unit.current + length;
+      int sub_opcode = unit.u8();
+
+      if (sub_opcode == DW_LNE_end_sequence)
+      {
+        emit = true;
+        end_sequence = true;
+      }
+      else if (sub_opcode == DW_LNE_set_address)
+      {
+        address = unit.fixed(length - 1 <= 8 ? length - 1 : unit_addr_size);
+      }
+
+      unit.current = next;
+    }
+    else
+    {
+      switch (opcode)
+      {
+        case DW_LNS_copy: emit = true; break;
+        case DW_LNS_advance_pc: address += unit.uleb() * min_insn_length; break;
+        case DW_LNS_advance_line: line += unit.sleb(); break;
+        case DW_LNS_set_file: file = unit.uleb(); break;
+        case DW_LNS_const_add_pc: address += ((255 - opcode_base) / line_range) * min_insn_length; break;
+        case DW_LNS_fixed_advance_pc: address += unit.u16(); break;
+        default:
+          for (int i=0; i<opcode_lengths[opcode]; i++)
+            unit.uleb();
+          break;
+      }
+    }
+
+    if (emit)
+    {
+      // Each row covers the addresses until the next one
+      if (has_row && address > row.base)
+      {
+        row.end = address;
+        this->lines.push_back(row);
+      }
+
+      if (end_sequence)
+      {
+        has_row = false;
+        address = 0;
+        file = 1;
+        line = 1;
+      }
+      else
+      {
+        has_row = true;
+        row.base = address;
+        row.file = file < files.size() ? files[file] : 0;
+        row.line = line;
+      }
+    }
+  }
+}
+
+
+void dwarf_indexer::read_lines()
+{
+  dwarf_reader reader(this->debug_line.data, this->debug_line.end());
+
+  while (!reader.error && reader.current < reader.end)
+  {
+    this->read_line_unit(reader, reader.current - this->debug_line.data);
+  }
+}
+
+
+template<typename T> static const T *find_range(const std::vector<T> &ranges, uint64_t addr)
+{
+  // Last range starting before the address
+  auto it = std::upper_bound(ranges.begin(), ranges.end(), addr,
+    [](uint64_t addr, const T &range) { return addr < range.base; });
+  if (it == ranges.begin())
+    return NULL;
+  --it;
+  return addr < it->end ? &*it : NULL;
+}
+
+
+void dwarf_indexer::merge()
+{
+  auto by_base = [](const func_range_t &a, const func_range_t &b) { return a.base < b.base; };
+  std::stable_sort(this->funcs.begin(), this->funcs.end(), by_base);
+  std::stable_sort(this->lines.begin(), this->lines.end(),
+    [](const line_range_t &a, const line_range_t &b) { return a.base < b.base; });
+  std::stable_sort(this->scopes.begin(), this->scopes.end(),
+    [](const scope_range_t &a, const scope_range_t &b) { return a.base < b.base; });
+
+  // Only addresses in functions are indexed, like the text files, or the
+  // ones with line information if there are no function symbols
+  bool use_funcs = this->funcs.size() != 0;
+
+  std::vector<uint64_t> bounds;
+  for (auto &range: this->funcs) { bounds.push_back(range.base); bounds.push_back(range.end); }
+  for (auto &range: this->lines) { bounds.push_back(range.base); bounds.push_back(range.end); }
+  for (auto &range: this->scopes) { bounds.push_back(range.base); bounds.push_back(range.end); }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+  std::unordered_map<uint64_t, uint32_t> scope_names;
+  std::vector<const scope_range_t *> active;
+  size_t next_scope = 0;
+
+  for (size_t i=0; i + 1<bounds.size(); i++)
+  {
+    uint64_t base = bounds[i], end = bounds[i+1];
+
+    while (next_scope < this->scopes.size() && this->scopes[next_scope].base <= base)
+      active.push_back(&this->scopes[next_scope++]);
+
+    const func_range_t *func = find_range(this->funcs, base);
+    const line_range_t *line = find_range(this->lines, base);
+
+    if (use_funcs ? func == NULL : line == NULL)
+      continue;
+
+    // Innermost scope covering the range
+    const scope_range_t *scope = NULL;
+    for (size_t j=0; j<active.size();)
+    {
+      if (active[j]->end <= base)
+      {
+        active[j] = active.back();
+        active.pop_back();
+        continue;
+      }
+      if (scope == NULL || active[j]->depth > scope->depth)
+        scope = active[j];
+      j++;
+    }
+
+    uint32_t inline_func = func ? func->name : 0;
+    if (scope)
+    {
+      auto it = scope_names.find(scope->die);
+      if (it == scope_names.end())
+      {
+        const char *name = this->get_name(scope->die);
+        it = scope_names.insert({ scope->die, name ? this->strings.get(name) : inline_func }).first;
+      }
+      inline_func = it->second;
+    }
+
+    iss_symbolizer_range_t range = { base, end, func ? func->name : 0, inline_func, line ? line->file : 0, line ? line->line : 0 };
+
+    if (this->ranges.size())
+    {
+      iss_symbolizer_range_t &last = this->ranges.back();
+      if (last.end == base && last.func == range.func && last.inline_func == range.inline_func &&
+          last.file == range.file && last.line == range.line)
+      {
+        last.end = end;
+        continue;
+      }
+    }
+
+    this->ranges.push_back(range);
+  }
+}
+
+
+int dwarf_indexer::build(const uint8_t *data, size_t size, std::string &error)
+{
+  this->data = data;
+  this->size = size;
+
+  if (this->read_sections(error))
+    return -1;
+
+  this->read_symbols();
+  this->read_info();
+  this->read_lines();
+  this->merge();
+
+  return 0;
+}
+
+
+// Same format as the files generated by pulp-pc-info:
+// <address> <function> <inline function> <file> <line>
+static void read_text(FILE *file, string_pool &strings, std::vector<iss_symbolizer_range_t> &ranges)
+{
+  char *line = NULL;
+  size_t len = 0;
+
+  while (getline(&line, &len, file) != -1)
+  {
+    char *token = strtok(line, " \n");
+    char *tokens[5];
+    int index = 0;
+    while (token && index < 5)
+    {
+      tokens[index++] = token;
+      token = strtok(NULL, " \n");
+    }
+
+    if (index == 5)
+    {
+      uint64_t base = strtoull(tokens[0], NULL, 16);
+      ranges.push_back({ base, base + 2, strings.get(tokens[1]), strings.get(tokens[2]), strings.get(tokens[3]), (uint32_t)atoi(tokens[4]) });
+    }
+  }
+
+  free(line);
+
+  // The last information given for an address is the one used
+  std::stable_sort(ranges.begin(), ranges.end(),
+    [](const iss_symbolizer_range_t &a, const iss_symbolizer_range_t &b) { return a.base < b.base; });
+
+  std::vector<iss_symbolizer_range_t> merged;
+  for (auto &range: ranges)
+  {
+    if (merged.size() && merged.back().base == range.base)
+    {
+      merged.back() = range;
+      continue;
+    }
+
+    if (merged.size() && merged.back().end > range.base)
+      merged.back().end = range.base;
+    merged.push_back(range);
+  }
+
+  ranges.swap(merged);
+}
+
+
+static bool map_cache(iss_symbolizer_image *image, const std::string &path, struct stat *binary_stat)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(iss_symbolizer_header_t))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const iss_symbolizer_header_t *header = (const iss_symbolizer_header_t *)map;
+  uint64_t ranges_size = header->nb_ranges * sizeof(iss_symbolizer_range_t);
+
+  if (memcmp(header->magic, ISS_SYMBOLIZER_MAGIC, sizeof(header->magic)) != 0 ||
+      header->binary_size != (uint64_t)binary_stat->st_size ||
+      header->binary_mtime != (int64_t)binary_stat->st_mtim.tv_sec * 1000000000 + binary_stat->st_mtim.tv_nsec ||
+      header->nb_ranges > (uint64_t)st.st_size / sizeof(iss_symbolizer_range_t) ||
+      sizeof(iss_symbolizer_header_t) + ranges_size + header->strings_size != (uint64_t)st.st_size ||
+      header->strings_size == 0 || ((const char *)map)[st.st_size - 1] != 0)
+  {
+    munmap(map, st.st_size);
+    return false;
+  }
+
+  image->map = map;
+  image->map_size = st.st_size;
+  image->ranges = (const iss_symbolizer_range_t *)((const char *)map + sizeof(iss_symbolizer_header_t));
+  image->nb_ranges = header->nb_ranges;
+  image->strings = (const char *)image->ranges + ranges_size;
+
+  return true;
+}
+
+
+// The cache is written to a temporary file renamed at the end, so that
+// simulations started in parallel never see it partially written. Failing
+// to write it, for example in a read-only directory, is not an error.
+static void write_cache(const std::string &path, struct stat *binary_stat, std::vector<iss_symbolizer_range_t> &ranges, std::string &strings)
+{
+  std::string tmp_path = path + "." + std::to_string(getpid());
+  FILE *file = fopen(tmp_path.c_str(), "w");
+  if (file == NULL)
+    return;
+
+  iss_symbolizer_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ISS_SYMBOLIZER_MAGIC, sizeof(header.magic));
+  header.binary_size = binary_stat->st_size;
+  header.binary_mtime = (int64_t)binary_stat->st_mtim.tv_sec * 1000000000 + binary_stat->st_mtim.tv_nsec;
+  header.nb_ranges = ranges.size();
+  header.strings_size = strings.size();
+
+  bool error = fwrite(&header, sizeof(header), 1, file) != 1 ||
+    (ranges.size() && fwrite(ranges.data(), sizeof(iss_symbolizer_range_t), ranges.size(), file) != ranges.size()) ||
+    fwrite(strings.c_str(), 1, strings.size(), file) != strings.size();
+
+  if (fclose(file) || error || rename(tmp_path.c_str(), path.c_str()))
+    unlink(tmp_path.c_str());
+}
+
+
+static int load_elf(iss_symbolizer_image *image, const char *path, int fd, struct stat *st, std::string &error)
+{
+  std::string cache_path = std::string(path) + ".gvsym";
+
+  if (map_cache(image, cache_path, st))
+    return 0;
+
+  void *data = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+  {
+    error = strerror(errno);
+    return -1;
+  }
+
+  dwarf_indexer indexer;
+  int result = indexer.build((const uint8_t *)data, st->st_size, error);
+  munmap(data, st->st_size);
+
+  if (result)
+    return -1;
+
+  write_cache(cache_path, st, indexer.ranges, indexer.strings.strings);
+
+  image->owned_ranges.swap(indexer.ranges);
+  image->owned_strings.swap(indexer.strings.strings);
+
+  return 0;
+}
+
+
+int iss_symbolizer::load(const char *path, std::string &error)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st))
+  {
+    error = strerror(errno);
+    if (fd != -1)
+      close(fd);
+    return -1;
+  }
+
+  iss_symbolizer_image *image = new iss_symbolizer_image();
+  char magic[SELFMAG];
+  int result = 0;
+
+  if (pread(fd, magic, SELFMAG, 0) == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0)
+  {
+    result = load_elf(image, path, fd, &st, error);
+  }
+  else
+  {
+    FILE *file = fdopen(dup(fd), "r");
+    if (file == NULL)
+    {
+      error = strerror(errno);
+      result = -1;
+    }
+    else
+    {
+      string_pool strings;
+      read_text(file, strings, image->owned_ranges);
+      image->owned_strings.swap(strings.strings);
+      fclose(file);
+    }
+  }
+
+  close(fd);
+
+  if (result)
+  {
+    delete image;
+    return -1;
+  }
+
+  if (image->map == NULL)
+  {
+    image->ranges = image->owned_ranges.data();
+    image->nb_ranges = image->owned_ranges.size();
+    image->strings = image->owned_strings.c_str();
+  }
+
+  this->images.push_back(image);
+
+  return 0;
+}
+
+
+bool iss_symbolizer::lookup(uint64_t addr, const char **func, const char **inline_func, const char **file, int *line)
+{
+  for (iss_symbolizer_image *image: this->images)
+  {
+    const iss_symbolizer_range_t *end = image->ranges + image->nb_ranges;
+    const iss_symbolizer_range_t *range = std::upper_bound(image->ranges, end, addr,
+      [](uint64_t addr, const iss_symbolizer_range_t &range) { return addr < range.base; });
+
+    if (range == image->ranges || addr >= (--range)->end)
+      continue;
+
+    *func = image->strings + range->func;
+    *inline_func = image->strings + range->inline_func;
+    *file = image->strings + range->file;
+    *line = range->line;
+
+    return true;
+  }
+
+  return false;
+}
+
+
+bool iss_symbolizer::find_symbol(const char *symbol, uint64_t *addr)
+{
+  // Ranges are sorted, the first one of the function is its entry point
+  for (iss_symbolizer_image *image: this->images)
+  {
+    for (uint64_t i=0; i<image->nb_ranges; i++)
+    {
+      if (strcmp(image->strings + image->ranges[i].func, symbol) == 0)
+      {
+        *addr = image->ranges[i].base;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+void iss_symbolizer::foreach_range(std::function<void(uint64_t base, uint64_t end, const char *func, const char *inline_func, const char *file, int line)> callback)
+{
+  for (iss_symbolizer_image *image: this->images)
+  {
+    for (uint64_t i=0; i<image->nb_ranges; i++)
+    {
+      const iss_symbolizer_range_t *range = &image->ranges[i];
+      callback(range->base, range->end, image->strings + range->func, image->strings + range->inline_func,
+        image->strings + range->file, range->line);
+    }
+  }
+}
+
+
+iss_symbolizer::~iss_symbolizer()
+{
+  for (iss_symbolizer_image *image: this->images)
+  {
+    delete image;
+  }
+}
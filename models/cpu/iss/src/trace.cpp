@@ -19,68 +19,31 @@
  */
 
 #include "iss.hpp"
+#include "insn_trace.hpp"
+#include "symbolizer.hpp"
 #include <string.h>
 #include <algorithm>
 #include <vector>
-
-#define PC_INFO_ARRAY_SIZE (64*1024)
+#include <map>
+#include <tuple>
 
 #define MAX_DEBUG_INFO_WIDTH 32
 
-class iss_pc_info {
-public:
-  unsigned int base;
-  char *func;
-  char *inline_func;
-  char *file;
-  int line;
-  iss_pc_info *next;
-};
-
-static bool pc_infos_is_init = false;
-static iss_pc_info *pc_infos[PC_INFO_ARRAY_SIZE];
+static iss_symbolizer symbolizer;
 static std::vector<std::string> binaries;
 
-static void add_pc_info(unsigned int base, char *func, char *inline_func, char *file, int line)
-{
-  iss_pc_info *pc_info = new iss_pc_info();
-
-  int index = base & (PC_INFO_ARRAY_SIZE - 1);
-  pc_info->next = pc_infos[index];
-  pc_infos[index] = pc_info;
-
-  pc_info->base = base;
-  pc_info->func = strdup(func);
-  pc_info->inline_func = strdup(inline_func);
-  pc_info->file = strdup(file);
-  pc_info->line = line;
-}
-
-static iss_pc_info *get_pc_info(unsigned int base)
+int iss_trace_pc_info(iss_addr_t addr, const char **func, const char **inline_func, const char **file, int *line)
 {
-  int index = base & (PC_INFO_ARRAY_SIZE - 1);
-
-  iss_pc_info *pc_info = pc_infos[index];
-
-  while (pc_info && pc_info->base != base)
-  {
-    pc_info = pc_info->next;
-  }
-
-  return pc_info;
+  return symbolizer.lookup(addr, func, inline_func, file, line) ? 0 : -1;
 }
 
-int iss_trace_pc_info(iss_addr_t addr, const char **func, const char **inline_func, const char **file, int *line)
+int iss_trace_symbol_addr(const char *symbol, iss_addr_t *addr)
 {
-  iss_pc_info *info = get_pc_info(addr);
-  if (info == NULL)
+  uint64_t symbol_addr;
+  if (!symbolizer.find_symbol(symbol, &symbol_addr))
     return -1;
 
-  *func = info->func;
-  *inline_func = info->inline_func;
-  *file = info->file;
-  *line = info->line;
-
+  *addr = symbol_addr;
   return 0;
 }
 
@@ -91,24 +54,10 @@ void iss_register_debug_info(iss_t *iss, const char *binary)
 
   binaries.push_back(std::string(binary));
 
-  FILE *file = fopen(binary, "r");
-  if (file != NULL)
+  std::string error;
+  if (symbolizer.load(binary, error))
   {
-    char * line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    while ((read = getline(&line, &len, file)) != -1)
-    {
-      char *token = strtok(line, " ");
-      char *tokens[5];
-      int index = 0;
-      while (token)
-      {
-        tokens[index++] = token;
-        token = strtok(NULL, " ");
-      }
-      if (index == 5) add_pc_info(strtol(tokens[0], NULL, 16), tokens[1], tokens[2], tokens[3], atoi(tokens[4]));
-    }
+    iss_force_warning(iss, "Failed to read debug information (path: %s, error: %s)\n", binary, error.c_str());
   }
 }
 
@@ -266,18 +215,11 @@ static char *iss_trace_dump_arg(iss_t *iss, iss_insn_t *insn, char *buff, iss_in
 
 static char *trace_dump_debug(iss_t *iss, iss_insn_t *insn, char *buff)
 {
-  char *name = (char *)"-";
-  char *file = (char *)"-";
-  uint32_t line = 0;
-  char *inline_func = (char *)"-";
-  iss_pc_info *pc_info = get_pc_info(insn->addr);
-  if (pc_info)
-  {
-    name = pc_info->func;
-    file = pc_info->file;
-    line = pc_info->line;
-    inline_func = pc_info->inline_func;
-  }
+  const char *name = "-";
+  const char *file = "-";
+  int line = 0;
+  const char *inline_func = "-";
+  symbolizer.lookup(insn->addr, &name, &inline_func, &file, &line);
 
   int len = snprintf(buff, MAX_DEBUG_INFO_WIDTH+1, "%s:%d", inline_func, line) - 1;
 
@@ -398,11 +340,292 @@ static void iss_trace_save_args(iss_t *iss, iss_insn_t *insn, iss_insn_arg_t sav
   }
 }
 
+
+// Binary instruction trace. It is shared by all the cores so that
+// instructions are kept in simulation order, as in the text trace. Only
+// what changes from one execution to another is traced for each
+// instruction, the text is produced once per instruction description.
+
+#define INSN_TRACE_CHUNK_SIZE (1<<20)
+
+typedef struct
+{
+  iss_t *iss;
+  int64_t desc;
+  int64_t time;
+  int64_t cycles;
+} insn_trace_core_t;
+
+static FILE *insn_trace_file = NULL;
+static std::vector<uint8_t> insn_trace_descs;
+static std::vector<uint8_t> insn_trace_insns;
+static insn_trace_chunk_t insn_trace_chunk;
+static std::vector<insn_trace_core_t> insn_trace_cores;
+static std::map<std::tuple<iss_addr_t, iss_reg_t, iss_decoder_item_t *>, int> insn_trace_desc_ids;
+static std::vector<std::pair<uint32_t, uint32_t>> insn_trace_desc_widths;
+static uint32_t insn_trace_label_width = INSN_TRACE_LABEL_WIDTH;
+static uint32_t insn_trace_args_width = INSN_TRACE_ARGS_WIDTH;
+
+static void insn_trace_value(std::vector<uint8_t> *desc, insn_trace_value_e kind, const char *prefix, int len)
+{
+  if (desc)
+  {
+    insn_trace_put(*desc, kind);
+    insn_trace_put_string(*desc, prefix, len);
+  }
+}
+
+static void insn_trace_reg_value(iss_t *iss, iss_insn_t *insn, std::vector<uint8_t> *desc, bool is_out, int reg, unsigned int value, uint64_t *values, int *nb_values)
+{
+  if (desc)
+  {
+    char reg_str[16];
+    char prefix[32];
+    iss_trace_dump_reg(iss, insn, reg_str, reg);
+    int len = sprintf(prefix, "%3.3s%c", reg_str, is_out ? '=' : ':');
+    insn_trace_value(desc, INSN_TRACE_VALUE_REG, prefix, len);
+  }
+  values[(*nb_values)++] = value;
+}
+
+// Same values, in the same order, as iss_trace_dump_arg_value. The kind and
+// text of each value is also added to the description if there is one.
+static int insn_trace_values(iss_t *iss, iss_insn_t *insn, iss_insn_arg_t *saved_args, uint64_t *values, std::vector<uint8_t> *desc)
+{
+  insn_trace_value_e addr_kind = sizeof(iss_addr_t) == 8 ? INSN_TRACE_VALUE_ADDR_64 : INSN_TRACE_VALUE_ADDR_32;
+  int nb_values = 0;
+
+  for (int dump_out=1; dump_out>=0; dump_out--)
+  {
+    for (int i=0; i<insn->decoder_item->u.insn.nb_args; i++)
+    {
+      iss_insn_arg_t *insn_arg = &insn->args[i];
+      iss_decoder_arg_t *arg = &insn->decoder_item->u.insn.args[i];
+      iss_insn_arg_t *saved_arg = &saved_args[i];
+
+      if ((arg->type == ISS_DECODER_ARG_TYPE_OUT_REG || arg->type == ISS_DECODER_ARG_TYPE_IN_REG) && insn_arg->u.reg.index != 0)
+      {
+        if ((dump_out && arg->type == ISS_DECODER_ARG_TYPE_OUT_REG) || (!dump_out && arg->type == ISS_DECODER_ARG_TYPE_IN_REG))
+        {
+          insn_trace_reg_value(iss, insn, desc, arg->type == ISS_DECODER_ARG_TYPE_OUT_REG, insn_arg->u.reg.index, saved_arg->u.reg.value, values, &nb_values);
+        }
+      }
+      else if (arg->type == ISS_DECODER_ARG_TYPE_INDIRECT_IMM)
+      {
+        if (!dump_out) insn_trace_reg_value(iss, insn, desc, 0, insn_arg->u.indirect_imm.reg_index, saved_arg->u.indirect_imm.reg_value, values, &nb_values);
+        iss_addr_t addr;
+        if (arg->flags & ISS_DECODER_ARG_FLAG_POSTINC)
+        {
+          addr = saved_arg->u.indirect_imm.reg_value;
+          if (dump_out) insn_trace_reg_value(iss, insn, desc, 1, insn_arg->u.indirect_imm.reg_index, addr + insn_arg->u.indirect_imm.imm, values, &nb_values);
+        }
+        else
+        {
+          addr = saved_arg->u.indirect_imm.reg_value + insn_arg->u.indirect_imm.imm;
+        }
+        if (!dump_out)
+        {
+          insn_trace_value(desc, addr_kind, " PA:", 4);
+          values[nb_values++] = addr;
+        }
+      }
+      else if (arg->type == ISS_DECODER_ARG_TYPE_INDIRECT_REG)
+      {
+        if (!dump_out) insn_trace_reg_value(iss, insn, desc, 0, insn_arg->u.indirect_reg.offset_reg_index, saved_arg->u.indirect_reg.offset_reg_value, values, &nb_values);
+        if (!dump_out) insn_trace_reg_value(iss, insn, desc, 0, insn_arg->u.indirect_reg.base_reg_index, saved_arg->u.indirect_reg.base_reg_value, values, &nb_values);
+        iss_addr_t addr;
+        if (arg->flags & ISS_DECODER_ARG_FLAG_POSTINC)
+        {
+          addr = saved_arg->u.indirect_reg.base_reg_value;
+          if (dump_out) insn_trace_reg_value(iss, insn, desc, 1, insn_arg->u.indirect_reg.base_reg_index, addr + insn_arg->u.indirect_reg.offset_reg_value, values, &nb_values);
+        }
+        else
+        {
+          addr = saved_arg->u.indirect_reg.base_reg_value + saved_arg->u.indirect_reg.offset_reg_value;
+        }
+        if (!dump_out)
+        {
+          insn_trace_value(desc, addr_kind, " PA:", 4);
+          values[nb_values++] = addr;
+        }
+      }
+    }
+  }
+
+  return nb_values;
+}
+
+static void insn_trace_write_chunk()
+{
+  insn_trace_chunk.desc_size = insn_trace_descs.size();
+  insn_trace_chunk.insn_size = insn_trace_insns.size();
+
+  fwrite(&insn_trace_chunk, sizeof(insn_trace_chunk), 1, insn_trace_file);
+  fwrite(insn_trace_descs.data(), 1, insn_trace_descs.size(), insn_trace_file);
+  fwrite(insn_trace_insns.data(), 1, insn_trace_insns.size(), insn_trace_file);
+
+  insn_trace_descs.clear();
+  insn_trace_insns.clear();
+
+  insn_trace_chunk.nb_insn = 0;
+  insn_trace_chunk.label_width = insn_trace_label_width;
+  insn_trace_chunk.args_width = insn_trace_args_width;
+
+  // Instructions of the next chunk are relative to 0, so that chunks can be
+  // decoded independently
+  for (auto &core: insn_trace_cores)
+  {
+    core.desc = 0;
+    core.time = 0;
+    core.cycles = 0;
+  }
+}
+
+static int insn_trace_get_core(iss_t *iss)
+{
+  static int last_core = -1;
+
+  if (last_core != -1 && insn_trace_cores[last_core].iss == iss)
+    return last_core;
+
+  for (unsigned int i=0; i<insn_trace_cores.size(); i++)
+  {
+    if (insn_trace_cores[i].iss == iss)
+    {
+      last_core = i;
+      return i;
+    }
+  }
+
+  last_core = insn_trace_cores.size();
+  insn_trace_cores.push_back({ iss, 0, 0, 0 });
+
+  int path_width;
+  std::string path = iss_insn_trace_path(iss, &path_width);
+  insn_trace_put(insn_trace_descs, INSN_TRACE_DESC_CORE);
+  insn_trace_put(insn_trace_descs, last_core);
+  insn_trace_put(insn_trace_descs, path_width);
+  insn_trace_put(insn_trace_descs, sizeof(iss_addr_t) * 2);
+  insn_trace_put_string(insn_trace_descs, path.c_str(), path.size());
+
+  return last_core;
+}
+
+static int insn_trace_describe(iss_t *iss, iss_insn_t *insn, int mode)
+{
+  auto key = std::make_tuple(insn->addr, insn->opcode, insn->decoder_item);
+  auto it = insn_trace_desc_ids.find(key);
+  if (it != insn_trace_desc_ids.end())
+    return it->second;
+
+  int id = insn_trace_desc_widths.size();
+  insn_trace_desc_ids[key] = id;
+
+  char label[1024];
+  char args[1024];
+  char *buff = args;
+  iss_decoder_arg_t *prev_arg = NULL;
+  int label_len = sprintf(label, "%s ", insn->decoder_item->u.insn.label);
+  int nb_args = insn->decoder_item->u.insn.nb_args;
+  for (int i=0; i<nb_args; i++) {
+    buff = iss_trace_dump_arg(iss, insn, buff, &insn->args[i], &insn->decoder_item->u.insn.args[i], &prev_arg, true);
+  }
+  if (nb_args != 0) buff += sprintf(buff,  " ");
+
+  insn_trace_desc_widths.push_back(std::make_pair(label_len, buff - args));
+
+  insn_trace_put(insn_trace_descs, INSN_TRACE_DESC_INSN);
+  insn_trace_put(insn_trace_descs, insn->addr);
+  insn_trace_put(insn_trace_descs, iss_trace_get_mode(mode));
+  insn_trace_put_string(insn_trace_descs, label, label_len);
+  insn_trace_put_string(insn_trace_descs, args, buff - args);
+
+  std::vector<uint8_t> values_desc;
+  uint64_t values[ISS_MAX_DECODE_ARGS*3];
+  int nb_values = insn_trace_values(iss, insn, iss->cpu.state.saved_args, values, &values_desc);
+  insn_trace_put(insn_trace_descs, nb_values);
+  insn_trace_descs.insert(insn_trace_descs.end(), values_desc.begin(), values_desc.end());
+
+  return id;
+}
+
+int iss_trace_binary_open(iss_t *iss, const char *path)
+{
+  if (insn_trace_file != NULL)
+    return 0;
+
+  insn_trace_file = fopen(path, "w");
+  if (insn_trace_file == NULL)
+    return -1;
+
+  fwrite(INSN_TRACE_MAGIC, 1, strlen(INSN_TRACE_MAGIC), insn_trace_file);
+
+  insn_trace_chunk.nb_insn = 0;
+  insn_trace_chunk.label_width = insn_trace_label_width;
+  insn_trace_chunk.args_width = insn_trace_args_width;
+
+  return 0;
+}
+
+void iss_trace_binary_flush(iss_t *iss)
+{
+  if (insn_trace_file == NULL)
+    return;
+
+  if (insn_trace_descs.size() || insn_trace_insns.size())
+    insn_trace_write_chunk();
+
+  fflush(insn_trace_file);
+}
+
+static void iss_trace_binary_dump(iss_t *iss, iss_insn_t *insn, int mode)
+{
+  int core_id = insn_trace_get_core(iss);
+  insn_trace_core_t *core = &insn_trace_cores[core_id];
+
+  if (unlikely(insn->trace_desc == -1))
+    insn->trace_desc = insn_trace_describe(iss, insn, mode);
+
+  int64_t time, cycles;
+  iss_insn_trace_timestamp(iss, &time, &cycles);
+
+  insn_trace_put(insn_trace_insns, core_id);
+  insn_trace_put_signed(insn_trace_insns, insn->trace_desc - core->desc);
+  insn_trace_put_signed(insn_trace_insns, time - core->time);
+  insn_trace_put_signed(insn_trace_insns, cycles - core->cycles);
+
+  uint64_t values[ISS_MAX_DECODE_ARGS*3];
+  int nb_values = insn_trace_values(iss, insn, iss->cpu.state.saved_args, values, NULL);
+  for (int i=0; i<nb_values; i++)
+  {
+    insn_trace_put(insn_trace_insns, values[i]);
+  }
+
+  core->desc = insn->trace_desc;
+  core->time = time;
+  core->cycles = cycles;
+  insn_trace_chunk.nb_insn++;
+
+  // Same column widths as the text trace
+  std::pair<uint32_t, uint32_t> &widths = insn_trace_desc_widths[insn->trace_desc];
+  if (widths.first > insn_trace_label_width) insn_trace_label_width = widths.first;
+  if (widths.second > insn_trace_args_width) insn_trace_args_width = widths.second;
+
+  if (insn_trace_insns.size() >= INSN_TRACE_CHUNK_SIZE)
+    insn_trace_write_chunk();
+}
+
 void iss_trace_dump(iss_t *iss, iss_insn_t *insn)
 {
   char buffer[1024];
 
   iss_trace_save_args(iss, insn, iss->cpu.state.saved_args, true);
+
+  if (iss_insn_trace_binary(iss))
+  {
+    iss_trace_binary_dump(iss, insn, 3);
+    return;
+  }
   
   iss_trace_dump_insn(iss, insn, buffer, 1024, iss->cpu.state.saved_args, true, 3);
 
@@ -454,11 +677,18 @@ iss_insn_t *iss_exec_insn_with_trace(iss_t *iss, iss_insn_t *insn)
   return next_insn;
 }
 
+iss_insn_t *iss_exec_insn_with_trigger(iss_t *iss, iss_insn_t *insn)
+{
+  iss_trace_trigger_pc(iss, insn->addr);
+  return iss_exec_insn_handler(iss, insn, insn->trigger_handler);
+}
+
+iss_insn_t *iss_exec_insn_with_trigger_fast(iss_t *iss, iss_insn_t *insn)
+{
+  iss_trace_trigger_pc(iss, insn->addr);
+  return iss_exec_insn_handler(iss, insn, insn->trigger_fast_handler);
+}
+
 void iss_trace_init(iss_t *iss)
 {
-  if (!pc_infos_is_init)
-  {
-    pc_infos_is_init = true;
-    memset(pc_infos, 0, sizeof(pc_infos));
-  }
 }
\ No newline at end of file
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __CPU_ISS_ISS_PROFILER_HPP
+#define __CPU_ISS_ISS_PROFILER_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Maximum depth of the call stack. Calls beyond are accounted to the deepest
+// context and drop the oldest frames.
+#define ISS_PROFILE_MAX_DEPTH 256
+
+// Number of frames from the top of the stack searched for the address a
+// return jumps to
+#define ISS_PROFILE_MAX_RET_SEARCH 16
+
+typedef enum
+{
+  ISS_PROFILE_CYCLES,
+  ISS_PROFILE_INSTRUCTIONS,
+  ISS_PROFILE_LOAD_STALLS,
+  ISS_PROFILE_MEM_STALLS,
+  ISS_PROFILE_IMISS,
+  ISS_PROFILE_NB_EVENTS
+} iss_profile_event_e;
+
+// Profiler of the guest code executed by a core. The costs are accounted per
+// instruction and per calling context, which is the stack of call sites
+// leading to the instruction. Calls and returns are detected from the
+// executed instructions, following the RISC-V calling convention.
+// The profile is written at the end of the simulation both in callgrind
+// format, for kcachegrind, and in pprof format.
+class iss_profiler
+{
+public:
+  iss_profiler();
+
+  // Account the instruction about to be executed. The cycles elapsed since
+  // the previous instruction and the events accounted meanwhile are given to
+  // the previous one.
+  inline void account_insn(uint64_t addr, int size, uint32_t opcode, int64_t cycle);
+
+  inline void account_event(iss_profile_event_e event, int64_t incr) { this->pending[event] += incr; }
+
+  // Write <prefix>.callgrind and <prefix>.pb.gz
+  void dump(std::string prefix, std::string name, int64_t cycle);
+
+  bool active = false;
+
+private:
+  typedef enum
+  {
+    INSN_OTHER,
+    INSN_CALL,
+    INSN_RETURN
+  } insn_kind_e;
+
+  // Costs of an instruction in a context
+  typedef struct
+  {
+    uint64_t addr;
+    uint32_t context;
+    uint8_t kind;
+    int64_t costs[ISS_PROFILE_NB_EVENTS];
+  } entry_t;
+
+  // Node of the calling context tree. Nodes are created after their parent,
+  // the root having index 0.
+  typedef struct
+  {
+    uint32_t parent;
+    uint64_t call_site;
+    uint64_t entry;
+    int64_t nb_calls;
+  } context_t;
+
+  typedef struct
+  {
+    uint32_t context;
+    uint64_t return_addr;
+  } frame_t;
+
+  // A context is created for each call site and callee from a given context
+  struct context_key
+  {
+    uint32_t context;
+    uint64_t call_site;
+    uint64_t entry;
+
+    bool operator==(const context_key &other) const
+    {
+      return context == other.context && call_site == other.call_site && entry == other.entry;
+    }
+  };
+
+  struct context_key_hash
+  {
+    size_t operator()(const context_key &key) const
+    {
+      return (key.context * 0x9e3779b97f4a7c15ULL) ^ (key.call_site * 0x85ebca6bULL) ^ key.entry;
+    }
+  };
+
+  static insn_kind_e get_kind(int size, uint32_t opcode);
+  inline entry_t *get_entry(uint64_t addr, int size, uint32_t opcode);
+  entry_t *insert_entry(uint64_t addr, int size, uint32_t opcode);
+  void call(uint64_t call_site, uint64_t return_addr, uint64_t entry);
+  void ret(uint64_t addr);
+
+  void dump_callgrind(FILE *file, std::string name);
+  int dump_pprof(std::string path);
+
+  // Open-addressing hash table of the entries, indexed by context and
+  // address
+  std::vector<entry_t> entries;
+  unsigned int nb_entries;
+
+  std::vector<context_t> contexts;
+  std::unordered_map<context_key, uint32_t, context_key_hash> context_map;
+  // Circular buffer of the frames, the top one being at index
+  // (stack_top + stack_size - 1) % ISS_PROFILE_MAX_DEPTH
+  frame_t stack[ISS_PROFILE_MAX_DEPTH];
+  unsigned int stack_top;
+  unsigned int stack_size;
+  uint32_t context;
+
+  entry_t *current;
+  int64_t last_cycle;
+  int64_t pending[ISS_PROFILE_NB_EVENTS];
+  int current_size;
+};
+
+
+
+inline iss_profiler::entry_t *iss_profiler::get_entry(uint64_t addr, int size, uint32_t opcode)
+{
+  unsigned int mask = this->entries.size() - 1;
+  unsigned int index = ((addr >> 1) * 0x9e3779b1 + this->context * 0x85ebca6b) & mask;
+
+  while (1)
+  {
+    entry_t *entry = &this->entries[index];
+    if (entry->addr == addr && entry->context == this->context)
+      return entry;
+    if (entry->addr == (uint64_t)-1)
+      return this->insert_entry(addr, size, opcode);
+    index = (index + 1) & mask;
+  }
+}
+
+inline void iss_profiler::account_insn(uint64_t addr, int size, uint32_t opcode, int64_t cycle)
+{
+  entry_t *previous = this->current;
+
+  if (previous)
+  {
+    previous->costs[ISS_PROFILE_CYCLES] += cycle - this->last_cycle;
+    for (int i=ISS_PROFILE_LOAD_STALLS; i<ISS_PROFILE_NB_EVENTS; i++)
+    {
+      previous->costs[i] += this->pending[i];
+      this->pending[i] = 0;
+    }
+
+    // The instruction following a call is the entry of the callee, and the
+    // one following a return tells which frame is returned to
+    if (previous->kind == INSN_CALL)
+      this->call(previous->addr, previous->addr + this->current_size, addr);
+    else if (previous->kind == INSN_RETURN)
+      this->ret(addr);
+  }
+
+  this->last_cycle = cycle;
+
+  entry_t *entry = this->get_entry(addr, size, opcode);
+  entry->costs[ISS_PROFILE_INSTRUCTIONS]++;
+  this->current = entry;
+  this->current_size = size;
+}
+
+#endif
@@ -24,6 +24,9 @@
 #include <vp/vp.hpp>
 #include <vp/itf/io.hpp>
 #include <vp/itf/wire.hpp>
+#include <vp/trace/trace_engine.hpp>
+#include <unordered_map>
+#include "iss_profiler.hpp"
 
 #ifdef USE_TRDB
 #define HAVE_DECL_BASENAME 1
@@ -39,6 +42,7 @@ public:
 
   int build();
   void start();
+  void stop();
   void pre_reset();
   void reset(bool active);
 
@@ -52,6 +56,7 @@ public:
   static void exec_first_instr(void *__this, vp::clock_event *event);
   void exec_first_instr(vp::clock_event *event);
   static void exec_instr_check_all(void *__this, vp::clock_event *event);
+  static void exec_instr_functional(void *__this, vp::clock_event *event);
   static inline void exec_misaligned(void *__this, vp::clock_event *event);
 
   static void irq_req_sync(void *__this, int irq);
@@ -79,6 +84,40 @@ public:
 
   inline void trigger_check_all() { current_event = check_all_event; }
 
+  // Handler to be used when nothing special has to be checked, which depends
+  // on whether the platform is simulated with timing or not
+  inline vp::clock_event *get_fast_event() { return vp_timing_enabled ? instr_event : functional_event; }
+
+  // Trace window triggers which are checked by this core
+  void trace_triggers_update();
+  void trace_trigger(vp::trace_trigger *trigger);
+  void trace_trigger_pc(iss_addr_t addr);
+  void trace_trigger_data(iss_addr_t addr, uint8_t *data, int size, bool is_write);
+  void trace_trigger_cycles_enqueue(vp::clock_event *event);
+  static void trace_trigger_cycles_handler(void *__this, vp::clock_event *event);
+
+  std::unordered_map<iss_addr_t, std::vector<vp::trace_trigger *>> trace_pc_triggers;
+  std::vector<vp::trace_trigger *> trace_data_triggers;
+  std::vector<vp::clock_event *> trace_cycles_events;
+  unsigned int trace_nb_triggers = 0;
+  int64_t trace_reset_cycles = -1;
+  // True when the fast handler can be used with traces, see iss_exec_switch_to_fast
+  bool trace_fast_path = false;
+  // Set when the instruction cache must be flushed to take into account the
+  // new traces and triggers
+  bool trace_flush_pending = false;
+  // True when instructions are decoded with the handlers compiled without
+  // traces, which is only changed when the instruction cache is flushed
+  bool trace_release_handlers = false;
+
+  // Set when instructions are traced to the binary instruction trace
+  bool insn_trace_binary = false;
+
+  // Guest code profiler, instructions are accounted from the handler checking
+  // everything while it is active
+  iss_profiler profiler;
+  std::string profile_path;
+
   vp::io_master data;
   vp::io_master fetch;
   vp::io_slave  dbg_unit;
@@ -133,6 +172,10 @@ public:
   vp::trace     ipc_stat_event;
   vp::clock_event *ipc_clock_event;
   int ipc_stat_delay;
+
+  // Number of executed instructions, published as MIPS by the telemetry
+  // engine
+  vp::telemetry_counter telemetry_insns;
   
 #ifdef USE_TRDB
   trdb_ctx *trdb;
@@ -145,8 +188,12 @@ private:
   vp::clock_event *current_event;
   vp::clock_event *instr_event;
   vp::clock_event *check_all_event;
+  vp::clock_event *functional_event;
   vp::clock_event *misaligned_event;
 
+  // PC at which the platform is switched from functional to timed mode
+  iss_addr_t timing_trigger_pc;
+
   int irq_req;
 
   int halt_cause;
@@ -226,6 +273,8 @@ inline int iss_wrapper::data_req_aligned(iss_addr_t addr, uint8_t *data_ptr, int
   if (err == vp::IO_REQ_OK) 
   {
     this->cpu.state.insn_cycles += req->get_latency();
+    if (unlikely(this->profiler.active))
+      this->profiler.account_event(ISS_PROFILE_MEM_STALLS, req->get_latency());
   }
   else if (err == vp::IO_REQ_INVALID) 
   {
@@ -238,6 +287,10 @@ inline int iss_wrapper::data_req_aligned(iss_addr_t addr, uint8_t *data_ptr, int
 
 inline int iss_wrapper::data_req(iss_addr_t addr, uint8_t *data_ptr, int size, bool is_write)
 {
+#ifdef VP_TRACE_ACTIVE
+  if (unlikely(this->trace_data_triggers.size() != 0))
+    this->trace_trigger_data(addr, data_ptr, size, is_write);
+#endif
 
   iss_addr_t addr0 = addr & ADDR_MASK;
   iss_addr_t addr1 = (addr + size - 1) & ADDR_MASK;
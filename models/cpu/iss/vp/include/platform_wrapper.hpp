@@ -44,6 +44,15 @@ static inline void iss_pccr_incr(iss_t *iss, unsigned int event, int incr)
 {
   static uint64_t zero = 0;
   static uint64_t one = 1;
+
+  if (unlikely(iss->profiler.active))
+  {
+    if (event == CSR_PCER_LD_STALL)
+      iss->profiler.account_event(ISS_PROFILE_LOAD_STALLS, incr);
+    else if (event == CSR_PCER_IMISS)
+      iss->profiler.account_event(ISS_PROFILE_IMISS, incr);
+  }
+
   if (iss->pcer_trace_event[event].get_event_active())
   {
     iss->pcer_trace_event[event].event_pulse(incr*iss->get_period(), (uint8_t *)&one, (uint8_t *)&zero);
@@ -86,6 +95,46 @@ static inline bool iss_insn_trace_active(iss_t *iss)
   return iss->insn_trace.get_active();
 }
 
+static inline bool iss_insn_trace_binary(iss_t *iss)
+{
+  return iss->insn_trace_binary;
+}
+
+// Time and cycles printed in the header of the instruction trace
+static inline void iss_insn_trace_timestamp(iss_t *iss, int64_t *time, int64_t *cycles)
+{
+  *time = -1;
+  *cycles = -1;
+  if (iss->get_clock())
+  {
+    *time = iss->get_clock()->get_time();
+    *cycles = iss->get_clock()->get_cycles();
+  }
+}
+
+static inline std::string iss_insn_trace_path(iss_t *iss, int *width)
+{
+  *width = iss->traces.get_trace_manager()->get_max_path_len();
+  return iss->insn_trace.get_name();
+}
+
+// Instructions at the PC of a trace trigger are decoded with a special
+// handler so that other instructions do not pay for the check
+static inline bool iss_trace_trigger_pc_active(iss_t *iss, iss_addr_t addr)
+{
+  return iss->trace_pc_triggers.size() != 0 && iss->trace_pc_triggers.count(addr) != 0;
+}
+
+static inline void iss_trace_trigger_pc(iss_t *iss, iss_addr_t addr)
+{
+  iss->trace_trigger_pc(addr);
+}
+
+static inline bool iss_trace_fast_path(iss_t *iss)
+{
+  return iss->trace_fast_path;
+}
+
 static bool iss_csr_ext_counter_is_bound(iss_t *iss, int id)
 {
   return iss->ext_counter[id].is_bound();
@@ -0,0 +1,508 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include "iss.hpp"
+#include "iss_profiler.hpp"
+#include <string.h>
+#include <map>
+#include <algorithm>
+#include <zlib.h>
+
+#define ISS_PROFILE_INITIAL_ENTRIES 4096
+
+
+static const char *event_names[] = { "Cycles", "Instructions", "LoadStalls", "MemStalls", "ICacheMissCycles" };
+static const char *event_units[] = { "cycles", "count", "cycles", "cycles", "cycles" };
+
+
+iss_profiler::iss_profiler()
+{
+  entry_t empty;
+  memset(&empty, 0, sizeof(empty));
+  empty.addr = (uint64_t)-1;
+  this->entries.assign(ISS_PROFILE_INITIAL_ENTRIES, empty);
+  this->nb_entries = 0;
+
+  // Root context, for the code executed outside any detected call
+  this->contexts.push_back({ 0, 0, 0, 0 });
+  this->context = 0;
+  this->stack_top = 0;
+  this->stack_size = 0;
+
+  this->current = NULL;
+  this->last_cycle = 0;
+  this->current_size = 0;
+  memset(this->pending, 0, sizeof(this->pending));
+}
+
+
+iss_profiler::insn_kind_e iss_profiler::get_kind(int size, uint32_t opcode)
+{
+  // Calls are jumps saving the return address into ra or t0, returns are
+  // jumps to the address in ra or t0, as done by the compilers
+  if (size == 2)
+  {
+    unsigned int quadrant = opcode & 3;
+    unsigned int funct3 = (opcode >> 13) & 7;
+
+    // c.jal
+    if (quadrant == 1 && funct3 == 1)
+      return INSN_CALL;
+
+    if (quadrant == 2 && funct3 == 4 && ((opcode >> 2) & 0x1f) == 0)
+    {
+      unsigned int rs1 = (opcode >> 7) & 0x1f;
+      // c.jalr
+      if ((opcode >> 12) & 1)
+        return rs1 != 0 ? INSN_CALL : INSN_OTHER;
+      // c.jr
+      return rs1 == 1 || rs1 == 5 ? INSN_RETURN : INSN_OTHER;
+    }
+  }
+  else
+  {
+    unsigned int rd = (opcode >> 7) & 0x1f;
+    unsigned int rs1 = (opcode >> 15) & 0x1f;
+    bool link = rd == 1 || rd == 5;
+
+    // jal
+    if ((opcode & 0x7f) == 0x6f)
+      return link ? INSN_CALL : INSN_OTHER;
+
+    // jalr
+    if ((opcode & 0x707f) == 0x67)
+    {
+      if (link)
+        return INSN_CALL;
+      if (rd == 0 && (rs1 == 1 || rs1 == 5))
+        return INSN_RETURN;
+    }
+  }
+
+  return INSN_OTHER;
+}
+
+
+iss_profiler::entry_t *iss_profiler::insert_entry(uint64_t addr, int size, uint32_t opcode)
+{
+  // Keep the table at most half full so that probing stays short
+  if ((this->nb_entries + 1) * 2 > this->entries.size())
+  {
+    std::vector<entry_t> old_entries;
+    old_entries.swap(this->entries);
+
+    entry_t empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.addr = (uint64_t)-1;
+    this->entries.assign(old_entries.size() * 2, empty);
+
+    unsigned int mask = this->entries.size() - 1;
+    for (auto &entry: old_entries)
+    {
+      if (entry.addr == (uint64_t)-1)
+        continue;
+
+      unsigned int index = ((entry.addr >> 1) * 0x9e3779b1 + entry.context * 0x85ebca6b) & mask;
+      while (this->entries[index].addr != (uint64_t)-1)
+        index = (index + 1) & mask;
+      this->entries[index] = entry;
+    }
+
+    this->current = NULL;
+  }
+
+  unsigned int mask = this->entries.size() - 1;
+  unsigned int index = ((addr >> 1) * 0x9e3779b1 + this->context * 0x85ebca6b) & mask;
+  while (this->entries[index].addr != (uint64_t)-1)
+    index = (index + 1) & mask;
+
+  entry_t *entry = &this->entries[index];
+  entry->addr = addr;
+  entry->context = this->context;
+  entry->kind = get_kind(size, opcode);
+  this->nb_entries++;
+
+  return entry;
+}
+
+
+void iss_profiler::call(uint64_t call_site, uint64_t return_addr, uint64_t entry)
+{
+  if (this->stack_size == ISS_PROFILE_MAX_DEPTH)
+  {
+    // The oldest frame is overwritten, its return will be ignored
+    this->stack[this->stack_top] = { this->context, return_addr };
+    this->stack_top = (this->stack_top + 1) % ISS_PROFILE_MAX_DEPTH;
+    return;
+  }
+
+  context_key key = { this->context, call_site, entry };
+  auto it = this->context_map.find(key);
+  uint32_t callee;
+
+  if (it == this->context_map.end())
+  {
+    callee = this->contexts.size();
+    this->contexts.push_back({ this->context, call_site, entry, 0 });
+    this->context_map[key] = callee;
+  }
+  else
+  {
+    callee = it->second;
+  }
+
+  this->contexts[callee].nb_calls++;
+  this->stack[(this->stack_top + this->stack_size) % ISS_PROFILE_MAX_DEPTH] = { this->context, return_addr };
+  this->stack_size++;
+  this->context = callee;
+}
+
+
+void iss_profiler::ret(uint64_t addr)
+{
+  // Frames which are not returned to, e.g. after a longjmp, are dropped.
+  // Returns which do not match any of the top frames, e.g. from a function
+  // called before the profiler was started, are ignored.
+  unsigned int nb_frames = std::min(this->stack_size, (unsigned int)ISS_PROFILE_MAX_RET_SEARCH);
+  for (unsigned int i=1; i<=nb_frames; i++)
+  {
+    frame_t *frame = &this->stack[(this->stack_top + this->stack_size - i) % ISS_PROFILE_MAX_DEPTH];
+    if (frame->return_addr == addr)
+    {
+      this->context = frame->context;
+      this->stack_size -= i;
+      return;
+    }
+  }
+}
+
+
+typedef struct
+{
+  std::string func;
+  std::string file;
+  int line;
+} pc_info_t;
+
+static pc_info_t *get_pc_info(std::unordered_map<uint64_t, pc_info_t> &infos, uint64_t addr)
+{
+  auto it = infos.find(addr);
+  if (it != infos.end())
+    return &it->second;
+
+  pc_info_t &info = infos[addr];
+  const char *func, *inline_func, *file;
+  int line;
+
+  if (iss_trace_pc_info(addr, &func, &inline_func, &file, &line) == 0)
+  {
+    info.func = func;
+    info.file = file;
+    info.line = line;
+  }
+  else
+  {
+    info.func = "???";
+    info.file = "???";
+    info.line = 0;
+  }
+
+  return &info;
+}
+
+
+void iss_profiler::dump(std::string prefix, std::string name, int64_t cycle)
+{
+  // Close the last instruction
+  if (this->current)
+  {
+    this->current->costs[ISS_PROFILE_CYCLES] += cycle - this->last_cycle;
+    for (int i=ISS_PROFILE_LOAD_STALLS; i<ISS_PROFILE_NB_EVENTS; i++)
+    {
+      this->current->costs[i] += this->pending[i];
+      this->pending[i] = 0;
+    }
+    this->last_cycle = cycle;
+  }
+
+  std::string path = prefix + ".callgrind";
+  FILE *file = fopen(path.c_str(), "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open profile (path: %s)\n", path.c_str());
+  }
+  else
+  {
+    this->dump_callgrind(file, name);
+    fclose(file);
+  }
+
+  path = prefix + ".pb.gz";
+  if (this->dump_pprof(path))
+    fprintf(stderr, "Failed to open profile (path: %s)\n", path.c_str());
+}
+
+
+void iss_profiler::dump_callgrind(FILE *file, std::string name)
+{
+  typedef struct
+  {
+    int64_t nb_calls;
+    int64_t costs[ISS_PROFILE_NB_EVENTS];
+  } call_t;
+
+  std::unordered_map<uint64_t, pc_info_t> infos;
+
+  // Inclusive cost of each context, children being after their parent
+  std::vector<std::vector<int64_t>> inclusive(this->contexts.size(), std::vector<int64_t>(ISS_PROFILE_NB_EVENTS, 0));
+
+  // Self cost of each instruction, for all contexts, grouped by function
+  std::map<std::pair<std::string, std::string>, std::map<uint64_t, std::vector<int64_t>>> functions;
+
+  for (auto &entry: this->entries)
+  {
+    if (entry.addr == (uint64_t)-1)
+      continue;
+
+    pc_info_t *info = get_pc_info(infos, entry.addr);
+    std::vector<int64_t> &costs = functions[std::make_pair(info->file, info->func)][entry.addr];
+    costs.resize(ISS_PROFILE_NB_EVENTS, 0);
+
+    for (int i=0; i<ISS_PROFILE_NB_EVENTS; i++)
+    {
+      costs[i] += entry.costs[i];
+      inclusive[entry.context][i] += entry.costs[i];
+    }
+  }
+
+  for (int i=this->contexts.size()-1; i>0; i--)
+  {
+    for (int j=0; j<ISS_PROFILE_NB_EVENTS; j++)
+    {
+      inclusive[this->contexts[i].parent][j] += inclusive[i][j];
+    }
+  }
+
+  // Calls from each function, per call site and callee, for all contexts
+  std::map<std::pair<std::string, std::string>, std::map<std::pair<uint64_t, uint64_t>, call_t>> calls;
+
+  for (unsigned int i=1; i<this->contexts.size(); i++)
+  {
+    context_t *context = &this->contexts[i];
+    pc_info_t *info = get_pc_info(infos, context->call_site);
+    call_t &call = calls[std::make_pair(info->file, info->func)][std::make_pair(context->call_site, context->entry)];
+
+    call.nb_calls += context->nb_calls;
+    for (int j=0; j<ISS_PROFILE_NB_EVENTS; j++)
+    {
+      call.costs[j] += inclusive[i][j];
+    }
+  }
+
+  fprintf(file, "version: 1\ncreator: gvsoc\ncmd: %s\npositions: instr line\nevents:", name.c_str());
+  for (int i=0; i<ISS_PROFILE_NB_EVENTS; i++)
+  {
+    fprintf(file, " %s", event_names[i]);
+  }
+  fprintf(file, "\nsummary:");
+  for (int i=0; i<ISS_PROFILE_NB_EVENTS; i++)
+  {
+    fprintf(file, " %ld", inclusive[0][i]);
+  }
+  fprintf(file, "\n");
+
+  for (auto &function: functions)
+  {
+    fprintf(file, "\nfl=%s\nfn=%s\n", function.first.first.c_str(), function.first.second.c_str());
+
+    for (auto &insn: function.second)
+    {
+      fprintf(file, "0x%lx %d", insn.first, get_pc_info(infos, insn.first)->line);
+      for (auto cost: insn.second)
+      {
+        fprintf(file, " %ld", cost);
+      }
+      fprintf(file, "\n");
+    }
+
+    for (auto &call: calls[function.first])
+    {
+      pc_info_t *callee = get_pc_info(infos, call.first.second);
+
+      fprintf(file, "cfl=%s\ncfn=%s\ncalls=%ld 0x%lx %d\n0x%lx %d", callee->file.c_str(), callee->func.c_str(),
+        call.second.nb_calls, call.first.second, callee->line, call.first.first, get_pc_info(infos, call.first.first)->line);
+      for (int i=0; i<ISS_PROFILE_NB_EVENTS; i++)
+      {
+        fprintf(file, " %ld", call.second.costs[i]);
+      }
+      fprintf(file, "\n");
+    }
+  }
+}
+
+
+// Minimal protobuf encoding of the pprof profile.proto messages
+
+static void pb_varint(std::string &buffer, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    buffer += (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  buffer += (char)value;
+}
+
+static void pb_uint(std::string &buffer, int field, uint64_t value)
+{
+  pb_varint(buffer, field << 3);
+  pb_varint(buffer, value);
+}
+
+static void pb_bytes(std::string &buffer, int field, const std::string &value)
+{
+  pb_varint(buffer, (field << 3) | 2);
+  pb_varint(buffer, value.size());
+  buffer += value;
+}
+
+static void pb_packed(std::string &buffer, int field, const std::vector<uint64_t> &values)
+{
+  std::string packed;
+  for (auto value: values)
+  {
+    pb_varint(packed, value);
+  }
+  pb_bytes(buffer, field, packed);
+}
+
+int iss_profiler::dump_pprof(std::string path)
+{
+  std::unordered_map<uint64_t, pc_info_t> infos;
+  std::vector<std::string> strings = { "" };
+  std::unordered_map<std::string, uint64_t> string_ids = { { "", 0 } };
+  std::map<std::pair<std::string, std::string>, uint64_t> function_ids;
+  std::unordered_map<uint64_t, uint64_t> location_ids;
+  std::string profile, functions, locations;
+
+  auto get_string = [&](const std::string &str) {
+    auto it = string_ids.find(str);
+    if (it != string_ids.end())
+      return it->second;
+    uint64_t id = strings.size();
+    strings.push_back(str);
+    string_ids[str] = id;
+    return id;
+  };
+
+  auto get_location = [&](uint64_t addr) {
+    auto it = location_ids.find(addr);
+    if (it != location_ids.end())
+      return it->second;
+
+    pc_info_t *info = get_pc_info(infos, addr);
+    auto key = std::make_pair(info->file, info->func);
+    auto fit = function_ids.find(key);
+    uint64_t function_id;
+    if (fit == function_ids.end())
+    {
+      function_id = function_ids.size() + 1;
+      function_ids[key] = function_id;
+
+      std::string function;
+      pb_uint(function, 1, function_id);
+      pb_uint(function, 2, get_string(info->func));
+      pb_uint(function, 3, get_string(info->func));
+      pb_uint(function, 4, get_string(info->file));
+      pb_bytes(functions, 5, function);
+    }
+    else
+    {
+      function_id = fit->second;
+    }
+
+    uint64_t id = location_ids.size() + 1;
+    location_ids[addr] = id;
+
+    std::string line, location;
+    pb_uint(line, 1, function_id);
+    pb_uint(line, 2, info->line);
+    pb_uint(location, 1, id);
+    pb_uint(location, 3, addr);
+    pb_bytes(location, 4, line);
+    pb_bytes(locations, 4, location);
+
+    return id;
+  };
+
+  for (int i=0; i<ISS_PROFILE_NB_EVENTS; i++)
+  {
+    std::string value_type;
+    pb_uint(value_type, 1, get_string(event_names[i]));
+    pb_uint(value_type, 2, get_string(event_units[i]));
+    pb_bytes(profile, 1, value_type);
+  }
+
+  // One sample per instruction and context, whose stack is the instruction
+  // followed by the call sites of the context
+  for (auto &entry: this->entries)
+  {
+    if (entry.addr == (uint64_t)-1)
+      continue;
+
+    std::vector<uint64_t> stack = { get_location(entry.addr) };
+    for (uint32_t context=entry.context; context!=0; context=this->contexts[context].parent)
+    {
+      stack.push_back(get_location(this->contexts[context].call_site));
+    }
+
+    std::vector<uint64_t> values(entry.costs, entry.costs + ISS_PROFILE_NB_EVENTS);
+
+    std::string sample;
+    pb_packed(sample, 1, stack);
+    pb_packed(sample, 2, values);
+    pb_bytes(profile, 2, sample);
+  }
+
+  profile += locations;
+  profile += functions;
+
+  // Strings must be added last as the other messages are still adding some
+  std::string period_type;
+  pb_uint(period_type, 1, get_string(event_names[ISS_PROFILE_CYCLES]));
+  pb_uint(period_type, 2, get_string(event_units[ISS_PROFILE_CYCLES]));
+
+  for (auto &str: strings)
+  {
+    pb_bytes(profile, 6, str);
+  }
+
+  pb_bytes(profile, 11, period_type);
+  pb_uint(profile, 12, 1);
+
+  gzFile file = gzopen(path.c_str(), "wb");
+  if (file == NULL)
+    return -1;
+
+  gzwrite(file, profile.data(), profile.size());
+  gzclose(file);
+
+  return 0;
+}
@@ -36,6 +36,13 @@
 #define HALT_CAUSE_HALT      15
 #define HALT_CAUSE_STEP      15
 
+// Maximum number of instructions executed per clock event in functional mode
+#define ISS_FUNCTIONAL_BATCH 64
+
+#ifndef GV_SEMIHOSTING_TIMING_ENABLE
+#define GV_SEMIHOSTING_TIMING_ENABLE 0x110
+#endif
+
 #ifdef USE_TRDB
 
 #define trdb_get_packet(ptr,member) \
@@ -74,6 +81,7 @@ static inline void trdb_record_instruction(iss_wrapper *_this, iss_insn_t *insn)
 do { \
   \
   _this->trace.msg("Executing instruction\n"); \
+  _this->telemetry_insns.inc(); \
   if (_this->pc_trace_event.get_event_active()) \
   { \
     _this->pc_trace_event.event((uint8_t *)&_this->cpu.current_insn->addr); \
@@ -139,9 +147,27 @@ void iss_wrapper::exec_instr_check_all(void *__this, vp::clock_event *event)
 
   // Switch back to optimize instruction handler only
   // if HW counters are disabled as they are checked with the slow handler
-  if (iss_exec_switch_to_fast(_this))
+  if (iss_exec_switch_to_fast(_this) && !_this->profiler.active)
+  {
+    _this->current_event = _this->get_fast_event();
+  }
+
+  // Instructions are decoded again when traces are switched, as the trace
+  // handlers are selected at decode time. This can not be done while an
+  // instruction is executed, which is why it is delayed until here.
+  // The handlers compiled without traces do not check the data triggers, so
+  // they are only used while there is none.
+  if (unlikely(_this->trace_flush_pending))
   {
-    _this->current_event = _this->instr_event;
+    _this->trace_flush_pending = false;
+    _this->trace_release_handlers = _this->trace_fast_path && _this->trace_data_triggers.size() == 0;
+    iss_cache_flush(_this);
+  }
+
+  if (unlikely(_this->profiler.active))
+  {
+    iss_insn_t *insn = _this->cpu.current_insn;
+    _this->profiler.account_insn(insn->addr, insn->size, insn->opcode, _this->get_cycles());
   }
 
   EXEC_INSTR_COMMON(_this, event, iss_exec_step_nofetch_perf);
@@ -154,11 +180,171 @@ void iss_wrapper::exec_instr_check_all(void *__this, vp::clock_event *event)
   }
 }
 
+void iss_wrapper::exec_instr_functional(void *__this, vp::clock_event *event)
+{
+  iss_t *_this = (iss_t *)__this;
+
+  // The platform has been switched to timed mode, go back to the normal
+  // handlers through the slow one, which selects them depending on the
+  // profiler and on the trace windows
+  if (vp_timing_enabled)
+  {
+    _this->trigger_check_all();
+    exec_instr_check_all(__this, event);
+    return;
+  }
+
+  // As timing is not modeled, execute several instructions per event to
+  // save the time engine overhead. The batch is interrupted as soon as the
+  // slow handler is needed, e.g. for an interrupt, or the core stops.
+  for (int i=0; i<ISS_FUNCTIONAL_BATCH; i++)
+  {
+    if (unlikely(_this->cpu.current_insn->addr == _this->timing_trigger_pc))
+    {
+      _this->trace.msg("Reached timing trigger, switching to timed mode (pc: 0x%lx)\n", _this->timing_trigger_pc);
+      vp_timing_enabled = true;
+      _this->trigger_check_all();
+      break;
+    }
+
+    _this->telemetry_insns.inc();
+
+    if (iss_exec_step_nofetch(_this) < 0)
+    {
+      if (_this->misaligned_access.get())
+      {
+        _this->event_enqueue(_this->misaligned_event, _this->misaligned_latency);
+      }
+      else
+      {
+        _this->is_active_reg.set(false);
+        _this->stalled.set(true);
+      }
+      return;
+    }
+
+    if (_this->current_event != _this->functional_event || !_this->is_active_reg.get() || vp_timing_enabled)
+      break;
+  }
+
+  _this->enqueue_next_instr(1);
+}
+
+void iss_wrapper::trace_triggers_update()
+{
+  vp::trace_engine *engine = this->traces.get_trace_manager();
+  std::vector<vp::trace_trigger *> &triggers = engine->get_triggers();
+
+  // Triggers can only be added, only the new ones need to be registered
+  for (unsigned int i=this->trace_nb_triggers; i<triggers.size(); i++)
+  {
+    vp::trace_trigger *trigger = triggers[i];
+    iss_addr_t addr;
+
+    switch (trigger->type)
+    {
+      case vp::TRACE_TRIGGER_PC:
+        this->trace_pc_triggers[trigger->value].push_back(trigger);
+        break;
+
+      case vp::TRACE_TRIGGER_SYMBOL:
+        if (iss_trace_symbol_addr(trigger->symbol.c_str(), &addr))
+          this->warning.force_warning("Unknown trace trigger symbol, debug binaries must be specified (symbol: %s)\n", trigger->symbol.c_str());
+        else
+          this->trace_pc_triggers[addr].push_back(trigger);
+        break;
+
+      case vp::TRACE_TRIGGER_ADDR:
+      case vp::TRACE_TRIGGER_MAGIC:
+        this->trace_data_triggers.push_back(trigger);
+        break;
+
+      case vp::TRACE_TRIGGER_CYCLES: {
+        vp::clock_event *event = this->event_new(iss_wrapper::trace_trigger_cycles_handler);
+        event->get_args()[0] = (void *)trigger;
+        this->trace_cycles_events.push_back(event);
+        this->trace_trigger_cycles_enqueue(event);
+        break;
+      }
+    }
+  }
+
+  this->trace_nb_triggers = triggers.size();
+  this->trace_fast_path = engine->is_idle();
+  this->trace_flush_pending = true;
+  this->trigger_check_all();
+}
+
+void iss_wrapper::trace_trigger(vp::trace_trigger *trigger)
+{
+  this->trace.msg("Reached trace trigger (window: %d, open: %d)\n", trigger->window, trigger->open);
+  this->traces.get_trace_manager()->set_window(trigger->window, trigger->open);
+}
+
+void iss_wrapper::trace_trigger_pc(iss_addr_t addr)
+{
+  auto it = this->trace_pc_triggers.find(addr);
+  if (it != this->trace_pc_triggers.end())
+  {
+    for (auto trigger: it->second)
+    {
+      this->trace_trigger(trigger);
+    }
+  }
+}
+
+void iss_wrapper::trace_trigger_data(iss_addr_t addr, uint8_t *data, int size, bool is_write)
+{
+  for (auto trigger: this->trace_data_triggers)
+  {
+    if (trigger->type == vp::TRACE_TRIGGER_ADDR)
+    {
+      if (trigger->value >= addr && trigger->value < addr + size)
+        this->trace_trigger(trigger);
+    }
+    else if (is_write && size == 4 && *(uint32_t *)data == (uint32_t)trigger->value)
+    {
+      this->trace_trigger(trigger);
+    }
+  }
+}
+
+// Cycle triggers are relative to the end of the reset of the core
+void iss_wrapper::trace_trigger_cycles_enqueue(vp::clock_event *event)
+{
+  if (this->trace_reset_cycles == -1)
+    return;
+
+  vp::trace_trigger *trigger = (vp::trace_trigger *)event->get_args()[0];
+  int64_t cycles = this->trace_reset_cycles + trigger->value - this->get_cycles();
+
+  if (event->is_enqueued())
+    this->event_cancel(event);
+
+  if (cycles > 0)
+    this->event_enqueue(event, cycles);
+}
+
+void iss_wrapper::trace_trigger_cycles_handler(void *__this, vp::clock_event *event)
+{
+  iss_t *_this = (iss_t *)__this;
+  _this->trace_trigger((vp::trace_trigger *)event->get_args()[0]);
+}
+
 void iss_wrapper::exec_first_instr(vp::clock_event *event)
 {
-  current_event = event_new(iss_wrapper::exec_instr);
-  iss_start(this);
-  exec_instr((void *)this, event);
+  if (vp_timing_enabled)
+  {
+    current_event = this->profiler.active ? check_all_event : this->instr_event;
+    iss_start(this);
+    exec_instr((void *)this, event);
+  }
+  else
+  {
+    current_event = functional_event;
+    iss_start(this);
+    exec_instr_functional((void *)this, event);
+  }
 }
 
 void iss_wrapper::exec_first_instr(void *__this, vp::clock_event *event)
@@ -803,6 +989,17 @@ void iss_wrapper::handle_ebreak()
       break;
     }
     
+    case GV_SEMIHOSTING_TIMING_ENABLE: {
+      // Switch the whole platform between functional and timed modes, e.g.
+      // to fast-forward the boot and simulate the region of interest with
+      // timing
+      vp_timing_enabled = this->cpu.regfile.regs[11] != 0;
+      this->trace.msg("Switching timing mode (timing: %d)\n", vp_timing_enabled);
+      if (this->current_event == this->instr_event)
+        this->current_event = this->get_fast_event();
+      break;
+    }
+
     default:
       this->warning.force_warning("Unknown ebreak call (id: %d)\n", id);
       break;
@@ -981,7 +1178,7 @@ int iss_wrapper::build()
   power.new_trace("power_trace", &power_trace);
 
   this->new_reg("bootaddr", &this->bootaddr_reg, get_config_int("boot_addr"));
-  this->new_reg("fetch_enable", &this->fetch_enable_reg, get_js_config()->get("fetch_enable")->get_bool());
+  this->new_reg("fetch_enable", &this->fetch_enable_reg, get_js_config("fetch_enable")->get_bool());
   this->new_reg("is_active", &this->is_active_reg, false);
   this->new_reg("stalled", &this->stalled, false);
   this->new_reg("wfi", &this->wfi, false);
@@ -990,9 +1187,9 @@ int iss_wrapper::build()
   this->new_reg("step_mode", &this->step_mode, false);
   this->new_reg("do_step", &this->do_step, false);
 
-  power.new_event("power_insn", &insn_power, this->get_js_config()->get("**/insn"), &power_trace);
-  power.new_event("power_clock_gated", &clock_gated_power, this->get_js_config()->get("**/clock_gated"), &power_trace);
-  power.new_leakage_event("leakage", &leakage_power, this->get_js_config()->get("**/leakage"), &power_trace);
+  power.new_event("power_insn", &insn_power, this->get_js_config("**/insn"), &power_trace);
+  power.new_event("power_clock_gated", &clock_gated_power, this->get_js_config("**/clock_gated"), &power_trace);
+  power.new_leakage_event("leakage", &leakage_power, this->get_js_config("**/leakage"), &power_trace);
 
   data.set_resp_meth(&iss_wrapper::data_response);
   data.set_grant_meth(&iss_wrapper::data_grant);
@@ -1031,6 +1228,7 @@ int iss_wrapper::build()
   current_event = event_new(iss_wrapper::exec_first_instr);
   instr_event = event_new(iss_wrapper::exec_instr);
   check_all_event = event_new(iss_wrapper::exec_instr_check_all);
+  functional_event = event_new(iss_wrapper::exec_instr_functional);
   misaligned_event = event_new(iss_wrapper::exec_misaligned);
 
   this->riscv_dbg_unit = this->get_js_config()->get_child_bool("riscv_dbg_unit");
@@ -1059,11 +1257,59 @@ void iss_wrapper::start()
 
   if (iss_open(this)) throw logic_error("Error while instantiating the ISS");
 
-  for (auto x:this->get_js_config()->get("**/debug_binaries")->get_elems())
+  for (auto x:this->get_js_config("**/debug_binaries")->get_elems())
   {
     iss_register_debug_info(this, x->get_str().c_str());
   }
 
+  // In functional mode, the platform can be switched to timed mode when the
+  // core reaches a PC, given either directly or with a function name
+  this->timing_trigger_pc = (iss_addr_t)-1;
+  js::config *trigger_conf = this->get_js_config("timing_trigger");
+  if (trigger_conf != NULL)
+  {
+    js::config *conf = trigger_conf->get("pc");
+    if (conf != NULL)
+      this->timing_trigger_pc = strtoll(conf->get_str().c_str(), NULL, 0);
+
+    conf = trigger_conf->get("symbol");
+    if (conf != NULL && iss_trace_symbol_addr(conf->get_str().c_str(), &this->timing_trigger_pc))
+      vp_warning_always(&this->warning, "Unknown timing trigger symbol, debug binaries must be specified (symbol: %s)\n", conf->get_str().c_str());
+  }
+
+  vp::telemetry_engine *telemetry = (vp::telemetry_engine *)this->get_service("telemetry");
+  if (telemetry)
+    telemetry->reg_counter(this->get_path(), "mips", &this->telemetry_insns, vp::TELEMETRY_RATE, 1e-6);
+
+#ifdef VP_TRACE_ACTIVE
+  // Trace windows are only meaningful when traces are compiled in
+  this->traces.get_trace_manager()->reg_window_listener([this]() { this->trace_triggers_update(); });
+  this->trace_triggers_update();
+#endif
+
+
+  // Binary instruction trace, shared by all cores, used instead of the text
+  // one when the instruction trace is active
+  js::config *insn_trace_conf = this->get_js_config("**/gvsoc/insn_trace_binary");
+  if (insn_trace_conf != NULL && insn_trace_conf->get_str() != "")
+  {
+    if (iss_trace_binary_open(this, insn_trace_conf->get_str().c_str()))
+      this->warning.force_warning("Failed to open binary instruction trace (path: %s, error: %s)\n", insn_trace_conf->get_str().c_str(), strerror(errno));
+    else
+      this->insn_trace_binary = true;
+  }
+
+  // Guest code profile, written at the end of the simulation to files whose
+  // names are the given prefix followed by the path of the core
+  js::config *profile_conf = this->get_js_config("**/gvsoc/profile");
+  if (profile_conf != NULL && profile_conf->get_str() != "")
+  {
+    std::string name = this->get_path();
+    std::replace(name.begin(), name.end(), '/', '.');
+    this->profile_path = profile_conf->get_str() + name;
+    this->profiler.active = true;
+    this->trigger_check_all();
+  }
 
   trace.msg("ISS start (fetch: %d, is_active: %d, boot_addr: 0x%lx)\n", fetch_enable_reg.get(), is_active_reg.get(), get_config_int("boot_addr"));
 
@@ -1075,6 +1321,18 @@ void iss_wrapper::start()
   this->leakage_power.power_on();
 }
 
+void iss_wrapper::stop()
+{
+  if (this->insn_trace_binary)
+    iss_trace_binary_flush(this);
+
+  if (this->profiler.active)
+  {
+    this->profiler.dump(this->profile_path, this->get_path(), this->get_cycles());
+    this->profiler.active = false;
+  }
+}
+
 void iss_wrapper::pre_reset()
 {
   if (this->is_active_reg.get())
@@ -1115,6 +1373,12 @@ void iss_wrapper::reset(bool active)
     iss_pc_set(this, this->bootaddr_reg.get() + this->bootaddr_offset);
     iss_irq_set_vector_table(this, this->bootaddr_reg.get());
 
+    this->trace_reset_cycles = this->get_cycles();
+    for (auto event: this->trace_cycles_events)
+    {
+      this->trace_trigger_cycles_enqueue(event);
+    }
+
     check_state();
   }
 }
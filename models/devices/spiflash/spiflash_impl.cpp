@@ -490,7 +490,7 @@ void spiflash::start()
   this->trace.msg("Building spiFlash (size: 0x%x)\n", this->size);
 
   // Preload the memory
-  js::config *stim_file_conf = this->get_js_config()->get("stim_file");
+  js::config *stim_file_conf = this->get_js_config("stim_file");
   if (stim_file_conf != NULL)
   {
     string path = stim_file_conf->get_str();
@@ -509,7 +509,7 @@ void spiflash::start()
     }
   }
 
-  js::config *slm_stim_file_conf = this->get_js_config()->get("slm_stim_file");
+  js::config *slm_stim_file_conf = this->get_js_config("slm_stim_file");
   if (slm_stim_file_conf != NULL)
   {
     string path = stim_file_conf->get_str();
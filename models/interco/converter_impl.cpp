@@ -191,6 +191,11 @@ vp::io_req_status_e converter::req(void *__this, vp::io_req *req)
 
   _this->trace.msg("Received IO req (req: %p, offset: 0x%llx, size: 0x%llx, is_write: %d)\n", req, offset, size, is_write);
 
+  // Backdoor requests are not timed and can't be stalled, and neither are
+  // requests in functional mode
+  if (req->is_backdoor() || !vp_timing_enabled)
+    return _this->out.req_forward(req);
+
   if (_this->ongoing_req)
   {
     _this->trace.msg("Stalling request (req: %p)\n", req);
@@ -22,6 +22,7 @@
 #include <vp/itf/io.hpp>
 #include <stdio.h>
 #include <math.h>
+#include <vector>
 
 class interleaver : public vp::component
 {
@@ -40,6 +41,10 @@ public:
   static void response(void *_this, vp::io_req *req);
 
 private:
+
+  void split(uint64_t offset, uint64_t size, uint8_t *data);
+  vp::io_req_status_e req_bulk(vp::io_req *req);
+
   vp::trace     trace;
 
   vp::io_master **out;
@@ -52,6 +57,10 @@ private:
   int stage_bits;
   uint64_t offset_mask;
   uint64_t remove_offset;
+
+  // Segments of the current request for each output, kept from one request
+  // to the other to avoid allocations
+  std::vector<std::vector<vp::io_req_segment_t>> segments;
 };
 
 interleaver::interleaver(const char *config)
@@ -60,6 +69,97 @@ interleaver::interleaver(const char *config)
 
 }
 
+// Adds to the segments of each output the parts of an access going to it
+void interleaver::split(uint64_t offset, uint64_t size, uint8_t *data)
+{
+  uint64_t port_size = 1<<this->interleaving_bits;
+  uint64_t align_size = offset & (port_size - 1);
+  if (align_size) align_size = port_size - align_size;
+
+  offset -= this->remove_offset;
+
+  while(size) {
+
+    uint64_t loop_size = port_size;
+    if (align_size) {
+      loop_size = align_size;
+      align_size = 0;
+    }
+    if (loop_size > size) loop_size = size;
+
+    int output_id = (offset >> this->interleaving_bits) & ((1 << this->stage_bits) - 1);
+    uint64_t new_offset = ((offset & this->offset_mask) >> this->stage_bits) + (offset & ((1<<this->interleaving_bits)-1));
+
+    this->segments[output_id].push_back({ new_offset, data, loop_size });
+
+    size -= loop_size;
+    offset += loop_size;
+    if (data)
+      data += loop_size;
+  }
+}
+
+// Requests covering several words are sent as one bulk request per output,
+// which the outputs not supporting them receive word by word as before
+vp::io_req_status_e interleaver::req_bulk(vp::io_req *req)
+{
+  uint64_t init_offset = req->get_addr();
+  uint64_t init_size = req->get_size();
+  uint8_t *init_data = req->get_data();
+  vp::io_req_segment_t *init_segments = req->get_segments();
+  int init_nb_segments = req->get_nb_segments();
+  vp::io_req_status_e status = vp::IO_REQ_OK;
+
+  if (req->is_bulk())
+  {
+    for (int i=0; i<init_nb_segments; i++)
+      this->split(init_segments[i].addr, init_segments[i].size, init_segments[i].data);
+  }
+  else
+  {
+    this->split(init_offset, init_size, init_data);
+  }
+
+  for (int i=0; i<this->nb_slaves; i++)
+  {
+    std::vector<vp::io_req_segment_t> &segments = this->segments[i];
+    if (segments.size() == 0 || status != vp::IO_REQ_OK)
+    {
+      segments.clear();
+      continue;
+    }
+
+    this->trace.msg("Forwarding interleaved bulk packet (port: %d, offset: 0x%x, segments: %d)\n", i, segments[0].addr, segments.size());
+
+    if (!this->out[i])
+    {
+      status = vp::IO_REQ_INVALID;
+      segments.clear();
+      continue;
+    }
+
+    uint64_t size = 0;
+    for (auto &segment: segments)
+      size += segment.size;
+
+    req->set_addr(segments[0].addr);
+    req->set_size(size);
+    req->set_data(segments[0].data);
+    req->set_segments(segments.data(), segments.size());
+
+    if (this->out[i]->req_forward(req)) status = vp::IO_REQ_INVALID;
+
+    segments.clear();
+  }
+
+  req->set_addr(init_offset);
+  req->set_size(init_size);
+  req->set_data(init_data);
+  req->set_segments(init_segments, init_nb_segments);
+
+  return status;
+}
+
 vp::io_req_status_e interleaver::req(void *__this, vp::io_req *req)
 {
   interleaver *_this = (interleaver *)__this;
@@ -78,6 +178,9 @@ vp::io_req_status_e interleaver::req(void *__this, vp::io_req *req)
   int align_size = offset & (port_size - 1);
   if (align_size) align_size = port_size - align_size;
 
+  if (req->is_bulk() || (uint64_t)(align_size ? align_size : port_size) < size)
+    return _this->req_bulk(req);
+
   offset -= _this->remove_offset;
 
   while(size) {
@@ -130,6 +233,7 @@ int interleaver::build()
   traces.new_trace("trace", &trace, vp::DEBUG);
 
   in.set_req_meth(&interleaver::req);
+  in.set_bulk(true);
   new_slave_port("input", &in);
 
   nb_slaves = get_config_int("nb_slaves");
@@ -141,6 +245,8 @@ int interleaver::build()
   offset_mask = -1;
   offset_mask &= ~((1 << (interleaving_bits + stage_bits)) - 1);
 
+  segments.resize(nb_slaves);
+
   out = new vp::io_master *[nb_slaves];
   for (int i=0; i<nb_slaves; i++)
   {
@@ -155,6 +261,7 @@ int interleaver::build()
   {
     masters_in[i] = new vp::io_slave();
     masters_in[i]->set_req_meth(&interleaver::req);
+    masters_in[i]->set_bulk(true);
     new_slave_port("in_" + std::to_string(i), masters_in[i]);
   }
   return 0;
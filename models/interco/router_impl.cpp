@@ -23,6 +23,7 @@
 #include <vp/itf/wire.hpp>
 #include <stdio.h>
 #include <math.h>
+#include <vector>
 
 class router;
 
@@ -72,6 +73,8 @@ public:
   MapEntry *right = NULL;
   vp::io_slave *port = NULL;
   vp::io_master *itf = NULL;
+  // Number of requests routed to this entry, sampled by the telemetry engine
+  vp::telemetry_counter nb_reqs;
 };
 
 class io_master_map : public vp::io_master
@@ -92,6 +95,8 @@ public:
 
   int build();
 
+  void start();
+
   static vp::io_req_status_e req(void *__this, vp::io_req *req);
 
 
@@ -107,6 +112,7 @@ private:
   bool init = false;
 
   void init_entries();
+  MapEntry *get_entry(uint64_t offset, uint64_t size);
   MapEntry *firstMapEntry = NULL;
   MapEntry *defaultMapEntry = NULL;
   MapEntry *errorMapEntry = NULL;
@@ -117,6 +123,10 @@ private:
 
   int bandwidth = 0;
   int latency = 0;
+
+  // Segments of the bulk request being forwarded, with the target offsets.
+  // The ones of the caller are kept untouched.
+  std::vector<vp::io_req_segment_t> segments;
 };
 
 router::router(const char *config)
@@ -157,22 +167,9 @@ void MapEntry::insert(router *router)
   }
 }
 
-vp::io_req_status_e router::req(void *__this, vp::io_req *req)
+MapEntry *router::get_entry(uint64_t offset, uint64_t size)
 {
-  router *_this = (router *)__this;
-  
-  if (!_this->init)
-  {
-    _this->init = true;
-    _this->init_entries();
-  }
-
-  MapEntry *entry = _this->topMapEntry;
-  uint64_t offset = req->get_addr();
-  bool isRead = !req->get_is_write();
-  uint64_t size = req->get_size();  
-
-  _this->trace.msg("Received IO req (offset: 0x%llx, size: 0x%llx, isRead: %d)\n", offset, size, isRead);
+  MapEntry *entry = this->topMapEntry;
 
   if (entry)
   {
@@ -190,17 +187,67 @@ vp::io_req_status_e router::req(void *__this, vp::io_req *req)
   }
 
   if (!entry) {
-    if (_this->errorMapEntry && offset >= _this->errorMapEntry->base && offset + size - 1 <= _this->errorMapEntry->base + _this->errorMapEntry->size - 1) {
+    if (this->errorMapEntry && offset >= this->errorMapEntry->base && offset + size - 1 <= this->errorMapEntry->base + this->errorMapEntry->size - 1) {
     } else {
-      entry = _this->defaultMapEntry;
+      entry = this->defaultMapEntry;
     }
   }
 
+  return entry;
+}
+
+vp::io_req_status_e router::req(void *__this, vp::io_req *req)
+{
+  router *_this = (router *)__this;
+  
+  if (!_this->init)
+  {
+    _this->init = true;
+    _this->init_entries();
+  }
+
+  uint64_t offset = req->get_addr();
+  bool isRead = !req->get_is_write();
+  uint64_t size = req->get_size();  
+
+  _this->trace.msg("Received IO req (offset: 0x%llx, size: 0x%llx, isRead: %d)\n", offset, size, isRead);
+
+  MapEntry *entry = _this->get_entry(offset, size);
+
   if (!entry) {
     //_this->trace.msg(&warning, "Invalid access (offset: 0x%llx, size: 0x%llx, isRead: %d)\n", offset, size, isRead);
     return vp::IO_REQ_INVALID;
   }
 
+  // Bulk requests are forwarded as a whole only if all their segments go to
+  // the same entry, otherwise their segments are routed one by one, each one
+  // being counted when it comes back here
+  int nb_segments = 1;
+  vp::io_req_segment_t *init_segments = NULL;
+  if (unlikely(req->is_bulk()))
+  {
+    init_segments = req->get_segments();
+    nb_segments = req->get_nb_segments();
+    for (int i=0; i<nb_segments; i++)
+    {
+      if (_this->get_entry(init_segments[i].addr, init_segments[i].size) != entry)
+        return req->split(&router::req, _this, _this);
+    }
+
+    if (entry->remove_offset || entry->add_offset)
+    {
+      _this->segments.assign(init_segments, init_segments + nb_segments);
+      for (auto &segment: _this->segments)
+      {
+        if (entry->remove_offset) segment.addr -= entry->remove_offset;
+        if (entry->add_offset) segment.addr += entry->add_offset;
+      }
+      req->set_segments(_this->segments.data(), nb_segments);
+    }
+  }
+
+  entry->nb_reqs.inc();
+
   if (entry == _this->defaultMapEntry) {
     _this->trace.msg("Routing to default entry (target: %s)\n", entry->target_name.c_str());
   } else {
@@ -232,8 +279,8 @@ vp::io_req_status_e router::req(void *__this, vp::io_req *req)
     entry->nextPacketTime = routerTime + req->getLength();
 
 #endif
-  } else {
-    req->inc_latency(entry->latency + _this->latency);
+  } else if (vp_timing_enabled) {
+    req->inc_latency((entry->latency + _this->latency) * nb_segments);
   }
 
   // Forward the request to the target port
@@ -252,6 +299,8 @@ vp::io_req_status_e router::req(void *__this, vp::io_req *req)
     if (!entry->itf->is_bound())
     {
       _this->warning.msg("Invalid access, trying to route to non-connected interface (offset: 0x%llx, size: 0x%llx, is_write: %d)\n", offset, size, !isRead);
+      if (init_segments != NULL)
+        req->set_segments(init_segments, nb_segments);
       return vp::IO_REQ_INVALID;
     }
     req->arg_push(req->resp_port);
@@ -260,6 +309,35 @@ vp::io_req_status_e router::req(void *__this, vp::io_req *req)
       req->arg_pop();
   }
 
+  if (init_segments != NULL)
+    req->set_segments(init_segments, nb_segments);
+
+  // The storage returned by a backdoor request must not go beyond the mapping,
+  // as the next addresses may be routed to another target. The default entry
+  // stops at the next mapped entry.
+  if (unlikely(req->is_backdoor()) && req->get_actual_size() != 0)
+  {
+    uint64_t max_size = 0;
+    if (entry->size != 0)
+    {
+      max_size = entry->base + entry->size - offset;
+    }
+    else
+    {
+      for (MapEntry *next = _this->firstMapEntry; next; next = next->next)
+      {
+        if (next->base > offset)
+        {
+          max_size = next->base - offset;
+          break;
+        }
+      }
+    }
+
+    if (max_size != 0 && req->get_actual_size() > max_size)
+      req->set_actual_size(max_size);
+  }
+
   if (entry->id != -1) 
   {
     int64_t latency = req->get_latency();
@@ -274,9 +352,9 @@ vp::io_req_status_e router::req(void *__this, vp::io_req *req)
       counter->write_stalls += latency;
   
     if (isRead)
-      counter->nb_read++;
+      counter->nb_read += nb_segments;
     else
-      counter->nb_write++;
+      counter->nb_write += nb_segments;
 
   }
 
@@ -308,6 +386,7 @@ int router::build()
   traces.new_trace("trace", &trace, vp::DEBUG);
 
   in.set_req_meth(&router::req);
+  in.set_bulk(true);
   new_slave_port("input", &in);
 
   out.set_resp_meth(&router::response);
@@ -317,7 +396,7 @@ int router::build()
   bandwidth = get_config_int("bandwidth");
   latency = get_config_int("latency");
 
-  js::config *mappings = get_js_config()->get("mappings");
+  js::config *mappings = get_js_config("mappings");
 
   if (mappings != NULL)
   {
@@ -385,6 +464,32 @@ int router::build()
   return 0;
 }
 
+void router::start()
+{
+  vp::telemetry_engine *telemetry = (vp::telemetry_engine *)this->get_service("telemetry");
+  if (telemetry == NULL)
+    return;
+
+  // Entries bound through the default output port have no name, they are
+  // numbered in address order
+  std::vector<MapEntry *> entries;
+  for (MapEntry *entry = this->firstMapEntry; entry; entry = entry->next)
+    entries.push_back(entry);
+  if (this->defaultMapEntry)
+    entries.push_back(this->defaultMapEntry);
+  if (this->errorMapEntry)
+    entries.push_back(this->errorMapEntry);
+
+  int nb_unnamed = 0;
+  for (MapEntry *entry: entries)
+  {
+    std::string name = entry->target_name;
+    if (name == "")
+      name = "out" + std::to_string(nb_unnamed++);
+    telemetry->reg_counter(this->get_path(), "io_reqs/" + name, &entry->nb_reqs);
+  }
+}
+
 extern "C" void *vp_constructor(const char *config)
 {
   return (void *)new router(config);
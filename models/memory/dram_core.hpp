@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __MEMORY_DRAM_CORE_HPP
+#define __MEMORY_DRAM_CORE_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// All the timings are in cycles of the DRAM clock
+
+
+typedef enum
+{
+  // Rows stay open after an access, until a conflict or a refresh
+  DRAM_PAGE_OPEN,
+  // Rows are closed after an access unless another queued access hits them
+  DRAM_PAGE_CLOSED
+} dram_page_policy_e;
+
+typedef enum
+{
+  // Bursts are handled in arrival order
+  DRAM_SCHEDULER_FCFS,
+  // Bursts hitting an open row go first, then the oldest ones
+  DRAM_SCHEDULER_FR_FCFS
+} dram_scheduler_e;
+
+
+typedef struct
+{
+  int nb_banks;
+  // Bytes of a row of a bank
+  int row_size;
+  // Bytes transferred by a column command
+  int burst_size;
+  // Number of requests which can be queued
+  int queue_size;
+  // Number of row hits which can bypass an older access to another row of
+  // the same bank, with FR-FCFS
+  int max_row_hits;
+  dram_page_policy_e page_policy;
+  dram_scheduler_e scheduler;
+
+  // Activate to column command
+  int tRCD;
+  // Precharge to activate
+  int tRP;
+  // Activate to precharge
+  int tRAS;
+  // Read to precharge
+  int tRTP;
+  // Read to data
+  int tCL;
+  // Write to data
+  int tWL;
+  // End of write data to precharge
+  int tWR;
+  // Refresh to activate
+  int tRFC;
+  // Refresh interval, 0 to disable refresh
+  int tREFI;
+  // Data transfer of a burst
+  int tBURST;
+} dram_config_t;
+
+
+typedef struct
+{
+  int64_t nb_reqs;
+  int64_t nb_bursts;
+  int64_t nb_row_hits;
+  int64_t nb_row_misses;
+  int64_t nb_row_conflicts;
+  int64_t nb_refreshes;
+  int64_t nb_data_cycles;
+} dram_stats_t;
+
+
+// Called when the last burst of a request has been scheduled, with the
+// cycle where its data transfer is over
+typedef void (dram_done_t)(void *_this, void *ctx, int64_t end_cycle);
+
+
+// Bank and row-buffer state machine of a DRAM controller, with a single
+// data bus shared by the banks. Addresses are mapped as row:bank:column.
+// Requests are split into bursts, and one command (PRE, ACT, RD or WR) is
+// issued per cycle at most.
+class dram_controller
+{
+public:
+  inline dram_controller(dram_config_t *config, dram_done_t *done, void *_this);
+
+  inline void reset();
+
+  // Queue a request, return false if the queue is full
+  inline bool push(uint64_t addr, uint64_t size, bool is_write, void *ctx, int64_t cycle);
+
+  inline bool is_full() { return this->nb_reqs >= this->config.queue_size; }
+  inline bool is_empty() { return this->nb_reqs == 0; }
+
+  // Issue the command of this cycle, if any, and return the next cycle
+  // where a command may be issued, or -1 if the queue is empty. Cycles can
+  // be skipped between calls.
+  inline int64_t step(int64_t cycle);
+
+  inline int64_t get_nb_reqs() { return this->nb_reqs; }
+
+  dram_config_t config;
+  dram_stats_t stats;
+
+private:
+
+  typedef enum
+  {
+    HIT,
+    MISS,
+    CONFLICT
+  } access_e;
+
+  typedef struct
+  {
+    void *ctx;
+    int nb_bursts;
+    int64_t end_cycle;
+  } request_t;
+
+  typedef struct
+  {
+    request_t *req;
+    unsigned int bank;
+    uint64_t row;
+    bool is_write;
+    access_e access;
+  } burst_t;
+
+  typedef struct
+  {
+    bool open;
+    uint64_t row;
+    int64_t act_ready;
+    int64_t col_ready;
+    int64_t pre_ready;
+    // Row hits issued while an access to another row was waiting
+    int nb_hits;
+  } bank_t;
+
+  inline bool has_hit(unsigned int bank, uint64_t row, size_t except);
+  inline bool has_conflict(unsigned int bank, uint64_t row);
+  inline int64_t col_cycle(burst_t *burst);
+  inline bool refresh(int64_t cycle, int64_t *next);
+  inline void column(size_t index, int64_t cycle);
+
+  dram_done_t *done;
+  void *_this;
+
+  std::vector<bank_t> banks;
+  // Bursts in arrival order
+  std::vector<burst_t> bursts;
+  int nb_reqs;
+
+  // First cycle where the data bus is free
+  int64_t bus_ready;
+  int64_t next_refresh;
+};
+
+
+
+inline dram_controller::dram_controller(dram_config_t *config, dram_done_t *done, void *_this)
+: config(*config), done(done), _this(_this)
+{
+  if (this->config.nb_banks < 1)
+    this->config.nb_banks = 1;
+  if (this->config.queue_size < 1)
+    this->config.queue_size = 1;
+  if (this->config.max_row_hits < 1)
+    this->config.max_row_hits = 1;
+
+  this->banks.resize(this->config.nb_banks);
+  this->reset();
+}
+
+inline void dram_controller::reset()
+{
+  for (auto &burst: this->bursts)
+  {
+    if (--burst.req->nb_bursts == 0)
+      delete burst.req;
+  }
+  this->bursts.clear();
+
+  for (auto &bank: this->banks)
+  {
+    bank.open = false;
+    bank.row = 0;
+    bank.act_ready = 0;
+    bank.col_ready = 0;
+    bank.pre_ready = 0;
+    bank.nb_hits = 0;
+  }
+
+  memset(&this->stats, 0, sizeof(this->stats));
+  this->nb_reqs = 0;
+  this->bus_ready = 0;
+  this->next_refresh = this->config.tREFI;
+}
+
+inline bool dram_controller::push(uint64_t addr, uint64_t size, bool is_write, void *ctx, int64_t cycle)
+{
+  if (this->is_full())
+    return false;
+
+  uint64_t burst_size = this->config.burst_size;
+  uint64_t row_size = this->config.row_size;
+  uint64_t first = addr / burst_size;
+  uint64_t last = size ? (addr + size - 1) / burst_size : first;
+
+  request_t *req = new request_t;
+  req->ctx = ctx;
+  req->nb_bursts = last - first + 1;
+  req->end_cycle = cycle;
+
+  for (uint64_t i=first; i<=last; i++)
+  {
+    uint64_t row_index = i * burst_size / row_size;
+    burst_t burst = { req, (unsigned int)(row_index % this->config.nb_banks), row_index / this->config.nb_banks, is_write, HIT };
+    this->bursts.push_back(burst);
+  }
+
+  this->nb_reqs++;
+  this->stats.nb_reqs++;
+
+  return true;
+}
+
+inline bool dram_controller::has_hit(unsigned int bank, uint64_t row, size_t except)
+{
+  for (size_t i=0; i<this->bursts.size(); i++)
+  {
+    if (i != except && this->bursts[i].bank == bank && this->bursts[i].row == row)
+      return true;
+  }
+  return false;
+}
+
+inline bool dram_controller::has_conflict(unsigned int bank, uint64_t row)
+{
+  for (auto &burst: this->bursts)
+  {
+    if (burst.bank == bank && burst.row != row)
+      return true;
+  }
+  return false;
+}
+
+// First cycle where the column command of a burst hitting the open row can
+// be issued, including the data bus availability
+inline int64_t dram_controller::col_cycle(burst_t *burst)
+{
+  bank_t *bank = &this->banks[burst->bank];
+  int64_t bus = this->bus_ready - (burst->is_write ? this->config.tWL : this->config.tCL);
+  return bank->col_ready > bus ? bank->col_ready : bus;
+}
+
+// All-bank refresh, which needs all the banks to be precharged. Refreshes
+// due while the controller was idle are accounted at once.
+inline bool dram_controller::refresh(int64_t cycle, int64_t *next)
+{
+  if (this->config.tREFI <= 0 || cycle < this->next_refresh)
+    return false;
+
+  int64_t start = this->next_refresh;
+  for (auto &bank: this->banks)
+  {
+    if (bank.open && bank.pre_ready > start)
+      start = bank.pre_ready;
+  }
+
+  if (start > cycle)
+  {
+    *next = start;
+    return true;
+  }
+
+  int64_t last = this->next_refresh;
+  while (this->next_refresh <= cycle)
+  {
+    last = this->next_refresh;
+    this->next_refresh += this->config.tREFI;
+    this->stats.nb_refreshes++;
+  }
+  if (start < last)
+    start = last;
+
+  for (auto &bank: this->banks)
+  {
+    int64_t ready = start + (bank.open ? this->config.tRP : 0) + this->config.tRFC;
+    bank.open = false;
+    bank.nb_hits = 0;
+    if (bank.act_ready < ready)
+      bank.act_ready = ready;
+  }
+
+  *next = cycle + 1;
+  return true;
+}
+
+inline void dram_controller::column(size_t index, int64_t cycle)
+{
+  burst_t burst = this->bursts[index];
+  bank_t *bank = &this->banks[burst.bank];
+
+  this->bursts.erase(this->bursts.begin() + index);
+
+  int64_t data_start = cycle + (burst.is_write ? this->config.tWL : this->config.tCL);
+  int64_t data_end = data_start + this->config.tBURST;
+  this->bus_ready = data_end;
+
+  bank->col_ready = cycle + this->config.tBURST;
+  int64_t pre_ready = burst.is_write ? data_end + this->config.tWR : cycle + this->config.tRTP;
+  if (bank->pre_ready < pre_ready)
+    bank->pre_ready = pre_ready;
+
+  if (this->has_conflict(burst.bank, burst.row))
+    bank->nb_hits++;
+
+  // Auto-precharge
+  if (this->config.page_policy == DRAM_PAGE_CLOSED && !this->has_hit(burst.bank, burst.row, (size_t)-1))
+  {
+    bank->open = false;
+    bank->nb_hits = 0;
+    int64_t act_ready = bank->pre_ready + this->config.tRP;
+    if (bank->act_ready < act_ready)
+      bank->act_ready = act_ready;
+  }
+
+  this->stats.nb_bursts++;
+  this->stats.nb_data_cycles += this->config.tBURST;
+  if (burst.access == HIT)
+    this->stats.nb_row_hits++;
+  else if (burst.access == MISS)
+    this->stats.nb_row_misses++;
+  else
+    this->stats.nb_row_conflicts++;
+
+  request_t *req = burst.req;
+  if (req->end_cycle < data_end)
+    req->end_cycle = data_end;
+
+  if (--req->nb_bursts == 0)
+  {
+    this->nb_reqs--;
+    this->done(this->_this, req->ctx, req->end_cycle);
+    delete req;
+  }
+}
+
+inline int64_t dram_controller::step(int64_t cycle)
+{
+  if (this->bursts.size() == 0)
+    return -1;
+
+  int64_t next;
+  if (this->refresh(cycle, &next))
+    return next;
+
+  // Row hits first, the oldest one which is ready
+  if (this->config.scheduler == DRAM_SCHEDULER_FR_FCFS)
+  {
+    for (size_t i=0; i<this->bursts.size(); i++)
+    {
+      burst_t *burst = &this->bursts[i];
+      bank_t *bank = &this->banks[burst->bank];
+      if (bank->open && bank->row == burst->row && this->col_cycle(burst) <= cycle &&
+        (bank->nb_hits < this->config.max_row_hits || !this->has_conflict(burst->bank, burst->row)))
+      {
+        this->column(i, cycle);
+        return cycle + 1;
+      }
+    }
+  }
+
+  // Otherwise the oldest burst whose next command is ready. With FCFS, only
+  // the oldest burst is considered.
+  next = -1;
+  size_t nb_candidates = this->config.scheduler == DRAM_SCHEDULER_FCFS ? 1 : this->bursts.size();
+
+  for (size_t i=0; i<nb_candidates; i++)
+  {
+    burst_t *burst = &this->bursts[i];
+    bank_t *bank = &this->banks[burst->bank];
+    int64_t ready;
+
+    if (!bank->open)
+    {
+      ready = bank->act_ready;
+      if (ready <= cycle)
+      {
+        bank->open = true;
+        bank->row = burst->row;
+        bank->nb_hits = 0;
+        bank->col_ready = cycle + this->config.tRCD;
+        bank->pre_ready = cycle + this->config.tRAS;
+        if (burst->access == HIT)
+          burst->access = MISS;
+        return cycle + 1;
+      }
+    }
+    else if (bank->row == burst->row)
+    {
+      ready = this->col_cycle(burst);
+      if (ready <= cycle && this->config.scheduler == DRAM_SCHEDULER_FCFS)
+      {
+        this->column(i, cycle);
+        return cycle + 1;
+      }
+      if (this->config.scheduler == DRAM_SCHEDULER_FR_FCFS)
+      {
+        // Hit held back by the row hit limit, it goes again once the
+        // conflicting access is served
+        if (ready <= cycle)
+          continue;
+      }
+    }
+    else
+    {
+      // With FR-FCFS, the row is not closed while it still has hits to
+      // serve, unless the row hit limit is reached
+      if (this->config.scheduler == DRAM_SCHEDULER_FR_FCFS && bank->nb_hits < this->config.max_row_hits &&
+        this->has_hit(burst->bank, bank->row, i))
+        continue;
+
+      ready = bank->pre_ready;
+      if (ready <= cycle)
+      {
+        bank->open = false;
+        bank->nb_hits = 0;
+        bank->act_ready = cycle + this->config.tRP;
+        burst->access = CONFLICT;
+        return cycle + 1;
+      }
+    }
+
+    if (next == -1 || ready < next)
+      next = ready;
+  }
+
+  if (this->config.tREFI > 0 && (next == -1 || this->next_refresh < next))
+    next = this->next_refresh;
+
+  return next == -1 || next <= cycle ? cycle + 1 : next;
+}
+
+#endif
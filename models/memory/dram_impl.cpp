@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <queue>
+#include "dram_core.hpp"
+
+// DRAM with banks and row buffers, timed by a native controller model. The
+// component must be in the clock domain of the DRAM, as all the timings are
+// given in its cycles. The data is accessed when the request is received,
+// and the response is sent when the controller has transferred its last
+// burst.
+
+class dram : public vp::component
+{
+
+public:
+
+  dram(const char *config);
+
+  int build();
+  void start();
+  void stop();
+  void reset(bool active);
+
+  static vp::io_req_status_e req(void *__this, vp::io_req *req);
+
+private:
+
+  typedef std::pair<int64_t, vp::io_req *> pending_resp_t;
+
+  vp::io_req_status_e access(vp::io_req *req);
+  void check_state(bool new_req);
+
+  int get_param(const char *name, int default_value);
+
+  static void done(void *__this, void *ctx, int64_t end_cycle);
+  static void step_handler(void *__this, vp::clock_event *event);
+  static void resp_handler(void *__this, vp::clock_event *event);
+
+  vp::trace     trace;
+  vp::io_slave in;
+
+  uint64_t size = 0;
+  uint8_t *mem_data = NULL;
+
+  dram_config_t config;
+  dram_controller *controller = NULL;
+
+  vp::io_req *first_stalled_req = NULL;
+  vp::io_req *last_stalled_req = NULL;
+
+  // Requests whose bursts are scheduled, by end cycle
+  std::priority_queue<pending_resp_t, std::vector<pending_resp_t>, std::greater<pending_resp_t>> pending_resps;
+
+  vp::clock_event *step_event;
+  vp::clock_event *resp_event;
+};
+
+dram::dram(const char *config)
+: vp::component(config)
+{
+
+}
+
+vp::io_req_status_e dram::access(vp::io_req *req)
+{
+  uint64_t offset = req->get_addr();
+  uint8_t *data = req->get_data();
+  uint64_t size = req->get_size();
+
+  if (offset + size > this->size) {
+    this->trace.force_warning("Received out-of-bound request (reqAddr: 0x%x, reqSize: 0x%x, memSize: 0x%x)\n", offset, size, this->size);
+    return vp::IO_REQ_INVALID;
+  }
+
+  if (data)
+  {
+    if (req->get_is_write())
+      memcpy((void *)&this->mem_data[offset], (void *)data, size);
+    else
+      memcpy((void *)data, (void *)&this->mem_data[offset], size);
+  }
+
+  return vp::IO_REQ_OK;
+}
+
+vp::io_req_status_e dram::req(void *__this, vp::io_req *req)
+{
+  dram *_this = (dram *)__this;
+
+  uint64_t offset = req->get_addr();
+  uint64_t size = req->get_size();
+
+  _this->trace.msg("DRAM access (req: %p, offset: 0x%x, size: 0x%x, is_write: %d)\n", req, offset, size, req->get_is_write());
+
+  if (unlikely(req->is_backdoor()))
+  {
+    if (offset >= _this->size)
+      return vp::IO_REQ_INVALID;
+
+    req->set_data(&_this->mem_data[offset]);
+    req->set_actual_size(_this->size - offset);
+    return vp::IO_REQ_OK;
+  }
+
+  vp::io_req_status_e status = _this->access(req);
+  if (status != vp::IO_REQ_OK || !vp_timing_enabled)
+    return status;
+
+  if (_this->first_stalled_req != NULL || !_this->controller->push(offset, size, req->get_is_write(), req, _this->get_cycles()))
+  {
+    _this->trace.msg("Stalling request (req: %p)\n", req);
+
+    if (_this->first_stalled_req)
+      _this->last_stalled_req->set_next(req);
+    else
+      _this->first_stalled_req = req;
+    req->set_next(NULL);
+    _this->last_stalled_req = req;
+
+    return vp::IO_REQ_DENIED;
+  }
+
+  _this->check_state(true);
+
+  return vp::IO_REQ_PENDING;
+}
+
+void dram::done(void *__this, void *ctx, int64_t end_cycle)
+{
+  dram *_this = (dram *)__this;
+  vp::io_req *req = (vp::io_req *)ctx;
+
+  _this->trace.msg("Scheduled request (req: %p, end_cycle: %ld)\n", req, end_cycle);
+
+  _this->pending_resps.push(pending_resp_t(end_cycle, req));
+}
+
+void dram::check_state(bool new_req)
+{
+  int64_t cycle = this->get_cycles();
+
+  // A new request may have a command to issue before the one the
+  // controller is waiting for, so it is stepped on the next cycle
+  if (!this->controller->is_empty())
+  {
+    if (!this->step_event->is_enqueued())
+      this->event_enqueue(this->step_event, 1);
+    else if (new_req && this->step_event->get_cycle() > cycle + 1)
+      this->event_reenqueue(this->step_event, 1);
+  }
+
+  if (!this->pending_resps.empty())
+  {
+    int64_t end_cycle = this->pending_resps.top().first;
+    int64_t latency = end_cycle > cycle ? end_cycle - cycle : 1;
+
+    if (!this->resp_event->is_enqueued())
+      this->event_enqueue(this->resp_event, latency);
+    else if (this->resp_event->get_cycle() > cycle + latency)
+      this->event_reenqueue(this->resp_event, latency);
+  }
+}
+
+void dram::step_handler(void *__this, vp::clock_event *event)
+{
+  dram *_this = (dram *)__this;
+  int64_t cycle = _this->get_cycles();
+
+  int64_t next = _this->controller->step(cycle);
+
+  // Requests leaving the queue make room for the stalled ones
+  while (_this->first_stalled_req && !_this->controller->is_full())
+  {
+    vp::io_req *req = _this->first_stalled_req;
+    _this->first_stalled_req = req->get_next();
+
+    _this->trace.msg("Unstalling request (req: %p)\n", req);
+
+    _this->controller->push(req->get_addr(), req->get_size(), req->get_is_write(), req, cycle);
+    req->get_resp_port()->grant(req);
+  }
+
+  // The step event may have been enqueued by a request received during a
+  // grant
+  if (next != -1)
+  {
+    int64_t latency = next > cycle ? next - cycle : 1;
+    if (!_this->step_event->is_enqueued())
+      _this->event_enqueue(_this->step_event, latency);
+    else if (_this->step_event->get_cycle() > cycle + latency)
+      _this->event_reenqueue(_this->step_event, latency);
+  }
+
+  _this->check_state(false);
+}
+
+void dram::resp_handler(void *__this, vp::clock_event *event)
+{
+  dram *_this = (dram *)__this;
+  int64_t cycle = _this->get_cycles();
+
+  while (!_this->pending_resps.empty() && _this->pending_resps.top().first <= cycle)
+  {
+    vp::io_req *req = _this->pending_resps.top().second;
+    _this->pending_resps.pop();
+
+    _this->trace.msg("Replying to request (req: %p)\n", req);
+    req->get_resp_port()->resp(req);
+  }
+
+  _this->check_state(false);
+}
+
+void dram::reset(bool active)
+{
+  if (active)
+  {
+    this->controller->reset();
+    this->first_stalled_req = NULL;
+    this->pending_resps = decltype(this->pending_resps)();
+  }
+}
+
+int dram::get_param(const char *name, int default_value)
+{
+  js::config *config = this->get_js_config(name);
+  return config != NULL ? config->get_int() : default_value;
+}
+
+int dram::build()
+{
+  traces.new_trace("trace", &trace, vp::DEBUG);
+  in.set_req_meth(&dram::req);
+  new_slave_port("input", &in);
+
+  // Default parameters are the ones of a DDR3-1600 device
+  this->config.nb_banks = this->get_param("nb_banks", 8);
+  this->config.row_size = this->get_param("row_size", 2048);
+  this->config.burst_size = this->get_param("burst_size", 64);
+  this->config.queue_size = this->get_param("queue_size", 16);
+  this->config.max_row_hits = this->get_param("max_row_hits", 16);
+  this->config.tRCD = this->get_param("timing/RCD", 11);
+  this->config.tRP = this->get_param("timing/RP", 11);
+  this->config.tRAS = this->get_param("timing/RAS", 28);
+  this->config.tRTP = this->get_param("timing/RTP", 6);
+  this->config.tCL = this->get_param("timing/CL", 11);
+  this->config.tWL = this->get_param("timing/WL", 8);
+  this->config.tWR = this->get_param("timing/WR", 12);
+  this->config.tRFC = this->get_param("timing/RFC", 128);
+  this->config.tREFI = this->get_param("timing/REFI", 6240);
+  this->config.tBURST = this->get_param("timing/BURST", 4);
+
+  if (this->config.row_size <= 0 || this->config.burst_size <= 0 || this->config.row_size % this->config.burst_size)
+  {
+    snprintf(vp_error, VP_ERROR_SIZE, "Row size must be a multiple of the burst size (row_size: %d, burst_size: %d)", this->config.row_size, this->config.burst_size);
+    return -1;
+  }
+
+  this->config.page_policy = DRAM_PAGE_OPEN;
+  js::config *page_policy_config = this->get_js_config("page_policy");
+  if (page_policy_config != NULL)
+  {
+    std::string page_policy = page_policy_config->get_str();
+    if (page_policy == "closed")
+      this->config.page_policy = DRAM_PAGE_CLOSED;
+    else if (page_policy != "open")
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Unknown DRAM page policy (policy: %s)", page_policy.c_str());
+      return -1;
+    }
+  }
+
+  this->config.scheduler = DRAM_SCHEDULER_FR_FCFS;
+  js::config *scheduler_config = this->get_js_config("scheduler");
+  if (scheduler_config != NULL)
+  {
+    std::string scheduler = scheduler_config->get_str();
+    if (scheduler == "fcfs")
+      this->config.scheduler = DRAM_SCHEDULER_FCFS;
+    else if (scheduler != "fr-fcfs")
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Unknown DRAM scheduler (scheduler: %s)", scheduler.c_str());
+      return -1;
+    }
+  }
+
+  this->controller = new dram_controller(&this->config, &dram::done, this);
+
+  this->step_event = this->event_new(dram::step_handler);
+  this->resp_event = this->event_new(dram::resp_handler);
+
+  return 0;
+}
+
+void dram::start()
+{
+  size = get_config_int("size");
+
+  trace.msg("Building DRAM (size: 0x%lx, nb_banks: %d, row_size: %d, burst_size: %d)\n", size,
+    this->config.nb_banks, this->config.row_size, this->config.burst_size);
+
+  if (size)
+  {
+    mem_data = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_data == MAP_FAILED)
+    {
+      this->trace.fatal("Unable to allocate memory (size: 0x%lx, error: %s)\n", size, strerror(errno));
+      return;
+    }
+  }
+}
+
+void dram::stop()
+{
+  dram_stats_t *stats = &this->controller->stats;
+
+  this->trace.msg("DRAM statistics (requests: %ld, bursts: %ld, row hits: %ld, row misses: %ld, row conflicts: %ld, refreshes: %ld, data cycles: %ld)\n",
+    stats->nb_reqs, stats->nb_bursts, stats->nb_row_hits, stats->nb_row_misses, stats->nb_row_conflicts,
+    stats->nb_refreshes, stats->nb_data_cycles);
+}
+
+extern "C" void *vp_constructor(const char *config)
+{
+  return (void *)new dram(config);
+}
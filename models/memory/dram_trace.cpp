@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Replays a DRAMSys trace (.stl) on the DRAM controller model, so that its
+// latencies can be compared with the ones reported by DRAMSys for the same
+// device. Each line of the trace is:
+// <cycle>: <read|write> <address> [<data>]
+// The controller parameters have the names of the DRAM component properties,
+// e.g. --nb_banks=8 or --timing/RCD=11.
+
+#include "dram_core.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+
+typedef struct
+{
+  int64_t cycle;
+  uint64_t addr;
+  bool is_write;
+  int64_t start_cycle;
+  int64_t end_cycle;
+} trace_req_t;
+
+
+static void done(void *_this, void *ctx, int64_t end_cycle)
+{
+  ((trace_req_t *)ctx)->end_cycle = end_cycle;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [--<parameter>=<value>]... [--size=<bytes>] [--verbose] <trace file>\n", name);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Parameters: nb_banks, row_size, burst_size, queue_size, max_row_hits, page_policy (open|closed),\n");
+  fprintf(stderr, "scheduler (fr-fcfs|fcfs), timing/RCD, timing/RP, timing/RAS, timing/RTP, timing/CL, timing/WL,\n");
+  fprintf(stderr, "timing/WR, timing/RFC, timing/REFI, timing/BURST\n");
+}
+
+static int set_param(dram_config_t *config, const char *name, const char *value)
+{
+  struct { const char *name; int *param; } params[] = {
+    { "nb_banks", &config->nb_banks },
+    { "row_size", &config->row_size },
+    { "burst_size", &config->burst_size },
+    { "queue_size", &config->queue_size },
+    { "max_row_hits", &config->max_row_hits },
+    { "timing/RCD", &config->tRCD },
+    { "timing/RP", &config->tRP },
+    { "timing/RAS", &config->tRAS },
+    { "timing/RTP", &config->tRTP },
+    { "timing/CL", &config->tCL },
+    { "timing/WL", &config->tWL },
+    { "timing/WR", &config->tWR },
+    { "timing/RFC", &config->tRFC },
+    { "timing/REFI", &config->tREFI },
+    { "timing/BURST", &config->tBURST },
+  };
+
+  if (strcmp(name, "page_policy") == 0)
+  {
+    if (strcmp(value, "open") && strcmp(value, "closed"))
+      return -1;
+    config->page_policy = strcmp(value, "open") == 0 ? DRAM_PAGE_OPEN : DRAM_PAGE_CLOSED;
+    return 0;
+  }
+
+  if (strcmp(name, "scheduler") == 0)
+  {
+    if (strcmp(value, "fr-fcfs") && strcmp(value, "fcfs"))
+      return -1;
+    config->scheduler = strcmp(value, "fcfs") == 0 ? DRAM_SCHEDULER_FCFS : DRAM_SCHEDULER_FR_FCFS;
+    return 0;
+  }
+
+  for (auto &param: params)
+  {
+    if (strcmp(name, param.name) == 0)
+    {
+      *param.param = atoi(value);
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static int read_trace(const char *path, std::vector<trace_req_t> &reqs)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Failed to open %s (error: %s)\n", path, strerror(errno));
+    return -1;
+  }
+
+  char *line = NULL;
+  size_t len = 0;
+  int line_number = 0;
+  while (getline(&line, &len, file) != -1)
+  {
+    line_number++;
+
+    char *current = line;
+    while (*current == ' ' || *current == '\t')
+      current++;
+    if (*current == '#' || *current == '\n' || *current == 0)
+      continue;
+
+    trace_req_t req;
+    char command[16];
+    if (sscanf(current, "%ld: %15s %lx", &req.cycle, command, &req.addr) != 3 ||
+      (strcmp(command, "read") && strcmp(command, "write")))
+    {
+      fprintf(stderr, "%s:%d: invalid trace line\n", path, line_number);
+      free(line);
+      fclose(file);
+      return -1;
+    }
+
+    req.is_write = strcmp(command, "write") == 0;
+    req.start_cycle = -1;
+    req.end_cycle = -1;
+    reqs.push_back(req);
+  }
+
+  free(line);
+  fclose(file);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> args;
+  bool verbose = false;
+  int size = 0;
+
+  // Same defaults as the DRAM component
+  dram_config_t config = {
+    8, 2048, 64, 16, 16, DRAM_PAGE_OPEN, DRAM_SCHEDULER_FR_FCFS,
+    11, 11, 28, 6, 11, 8, 12, 128, 6240, 4
+  };
+
+  for (int i=1; i<argc; i++)
+  {
+    if (strcmp(argv[i], "--verbose") == 0)
+      verbose = true;
+    else if (strncmp(argv[i], "--size=", 7) == 0)
+      size = atoi(argv[i] + 7);
+    else if (strncmp(argv[i], "--", 2) == 0)
+    {
+      std::string option = argv[i] + 2;
+      size_t pos = option.find('=');
+      if (pos == std::string::npos || set_param(&config, option.substr(0, pos).c_str(), option.c_str() + pos + 1))
+      {
+        fprintf(stderr, "Invalid option: %s\n", argv[i]);
+        usage(argv[0]);
+        return -1;
+      }
+    }
+    else
+      args.push_back(argv[i]);
+  }
+
+  if (args.size() != 1)
+  {
+    usage(argv[0]);
+    return -1;
+  }
+
+  if (config.row_size <= 0 || config.burst_size <= 0 || config.row_size % config.burst_size)
+  {
+    fprintf(stderr, "Row size must be a multiple of the burst size (row_size: %d, burst_size: %d)\n", config.row_size, config.burst_size);
+    return -1;
+  }
+
+  // DRAMSys requests are one burst
+  if (size == 0)
+    size = config.burst_size;
+
+  std::vector<trace_req_t> reqs;
+  if (read_trace(args[0].c_str(), reqs))
+    return -1;
+
+  dram_controller controller(&config, done, NULL);
+
+  // Requests are queued in trace order, as soon as they are issued and
+  // there is room in the queue
+  size_t next_req = 0;
+  int64_t cycle = 0;
+  while (next_req < reqs.size() || !controller.is_empty())
+  {
+    while (next_req < reqs.size() && reqs[next_req].cycle <= cycle && !controller.is_full())
+    {
+      trace_req_t *req = &reqs[next_req++];
+      req->start_cycle = cycle;
+      controller.push(req->addr, size, req->is_write, req, cycle);
+    }
+
+    int64_t next = controller.step(cycle);
+
+    // The controller is stepped again at the next command or request
+    if (next_req < reqs.size() && !controller.is_full())
+    {
+      int64_t arrival = reqs[next_req].cycle > cycle ? reqs[next_req].cycle : cycle + 1;
+      if (next == -1 || arrival < next)
+        next = arrival;
+    }
+    cycle = next;
+  }
+
+  int64_t total_latency = 0, max_latency = 0, end_cycle = 0;
+  for (auto &req: reqs)
+  {
+    int64_t latency = req.end_cycle - req.cycle;
+    total_latency += latency;
+    if (latency > max_latency)
+      max_latency = latency;
+    if (req.end_cycle > end_cycle)
+      end_cycle = req.end_cycle;
+
+    if (verbose)
+      printf("%ld: %s 0x%lx: start %ld, end %ld, latency %ld\n", req.cycle, req.is_write ? "write" : "read",
+        req.addr, req.start_cycle, req.end_cycle, latency);
+  }
+
+  dram_stats_t *stats = &controller.stats;
+  int64_t nb_bursts = stats->nb_bursts ? stats->nb_bursts : 1;
+
+  printf("Requests:           %ld\n", stats->nb_reqs);
+  printf("Bursts:             %ld\n", stats->nb_bursts);
+  printf("Row hits:           %ld (%.1f%%)\n", stats->nb_row_hits, 100.0 * stats->nb_row_hits / nb_bursts);
+  printf("Row misses:         %ld (%.1f%%)\n", stats->nb_row_misses, 100.0 * stats->nb_row_misses / nb_bursts);
+  printf("Row conflicts:      %ld (%.1f%%)\n", stats->nb_row_conflicts, 100.0 * stats->nb_row_conflicts / nb_bursts);
+  printf("Refreshes:          %ld\n", stats->nb_refreshes);
+  printf("Total cycles:       %ld\n", end_cycle);
+  printf("Average latency:    %.2f cycles\n", reqs.size() ? (double)total_latency / reqs.size() : 0.0);
+  printf("Maximum latency:    %ld cycles\n", max_latency);
+  printf("Bus utilization:    %.1f%%\n", end_cycle ? 100.0 * stats->nb_data_cycles / end_cycle : 0.0);
+  printf("Bandwidth:          %.2f bytes per cycle\n", end_cycle ? (double)stats->nb_bursts * config.burst_size / end_cycle : 0.0);
+
+  return 0;
+}
@@ -22,6 +22,7 @@
 #include <vp/itf/io.hpp>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 
 class memory : public vp::component
 {
@@ -38,6 +39,8 @@ public:
 
 private:
 
+  vp::io_req_status_e access(vp::io_req *req, uint64_t offset, uint64_t size, uint8_t *data, int64_t cycles);
+
   static void power_callback(void *__this, vp::clock_event *event);
 
   vp::trace     trace;
@@ -46,8 +49,9 @@ private:
   uint64_t size = 0;
   bool check = false;
   int width_bits = 0;
+  uint64_t pause_offset = -1;
 
-  uint8_t *mem_data;
+  uint8_t *mem_data = NULL;
   uint8_t *check_mem;
 
   int64_t next_packet_start;
@@ -91,66 +95,108 @@ vp::io_req_status_e memory::req(void *__this, vp::io_req *req)
   uint8_t *data = req->get_data();
   uint64_t size = req->get_size();
 
-  _this->trace.msg("Memory access (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
+  // Uninitialized accesses can't be checked if the data is written directly
+  if (unlikely(req->is_backdoor()))
+  {
+    if (offset >= _this->size)
+      return vp::IO_REQ_INVALID;
+
+    if (_this->check_mem == NULL)
+    {
+      req->set_data(&_this->mem_data[offset]);
+      req->set_actual_size(_this->size - offset);
+    }
+    return vp::IO_REQ_OK;
+  }
+
+  int64_t cycles = _this->width_bits != 0 && vp_timing_enabled ? _this->get_cycles() : 0;
+
+  // The segments of a bulk request are handled as if they were received one
+  // after the other during the same cycle
+  if (req->is_bulk())
+  {
+    vp::io_req_segment_t *segments = req->get_segments();
+    for (int i=0; i<req->get_nb_segments(); i++)
+    {
+      vp::io_req_status_e status = _this->access(req, segments[i].addr, segments[i].size, segments[i].data, cycles);
+      if (status != vp::IO_REQ_OK)
+        return status;
+    }
+    return vp::IO_REQ_OK;
+  }
+
+  return _this->access(req, offset, size, data, cycles);
+}
+
+vp::io_req_status_e memory::access(vp::io_req *req, uint64_t offset, uint64_t size, uint8_t *data, int64_t cycles)
+{
+  this->trace.msg("Memory access (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
 
   // Impact the memory bandwith on the packet
-  if (_this->width_bits != 0) {
+  if (this->width_bits != 0 && vp_timing_enabled) {
 #define MAX(a,b) (((a)>(b))?(a):(b))
-    int duration = MAX(size >> _this->width_bits, 1);
+    int duration = MAX(size >> this->width_bits, 1);
     req->set_duration(duration);
-    int64_t cycles = _this->get_cycles();
-    int64_t diff = _this->next_packet_start - cycles;
+    int64_t diff = this->next_packet_start - cycles;
     if (diff > 0) {
-      _this->trace.msg("Delayed packet (latency: %ld)\n", diff);
+      this->trace.msg("Delayed packet (latency: %ld)\n", diff);
       req->inc_latency(diff);
     }
-    _this->next_packet_start = MAX(_this->next_packet_start, cycles) + duration;
+    this->next_packet_start = MAX(this->next_packet_start, cycles) + duration;
   }
 
-  if (offset + size > _this->size) {
-    _this->trace.force_warning("Received out-of-bound request (reqAddr: 0x%x, reqSize: 0x%x, memSize: 0x%x)\n", offset, size, _this->size);
+  // Magic store used to pause the platform once it has booted, e.g. to fork
+  // it for each test of a regression
+  if (unlikely(offset == this->pause_offset) && req->get_is_write())
+  {
+    this->trace.msg("Pausing platform\n");
+    this->get_time_engine()->pause();
+  }
+
+  if (offset + size > this->size) {
+    this->trace.force_warning("Received out-of-bound request (reqAddr: 0x%x, reqSize: 0x%x, memSize: 0x%x)\n", offset, size, this->size);
     return vp::IO_REQ_INVALID;
   }
 
-  if (_this->power_trace.get_active())
+  if (this->power_trace.get_active())
   {
-    _this->last_access_timestamp = _this->get_time();
+    this->last_access_timestamp = this->get_time();
 
     if (req->get_is_write())
     {
       if (size == 1)
-        _this->write_8_power.account_event();
+        this->write_8_power.account_event();
       else if (size == 2)
-        _this->write_16_power.account_event();
+        this->write_16_power.account_event();
       else if (size == 4)
-        _this->write_32_power.account_event();
+        this->write_32_power.account_event();
     }
     else
     {
       if (size == 1)
-        _this->read_8_power.account_event();
+        this->read_8_power.account_event();
       else if (size == 2)
-        _this->read_16_power.account_event();
+        this->read_16_power.account_event();
       else if (size == 4)
-        _this->read_32_power.account_event();
+        this->read_32_power.account_event();
     }
 
-    if (!_this->power_event->is_enqueued())
-      _this->event_enqueue(_this->power_event, 1);
+    if (!this->power_event->is_enqueued())
+      this->event_enqueue(this->power_event, 1);
   }
 
 #ifdef VP_TRACE_ACTIVE
-  if (_this->power_trigger)
+  if (this->power_trigger)
   {
     if (req->get_is_write() && size == 4)
     {
       if (*(uint32_t *)data == 0xabbaabba)
       {
-        _this->power.get_engine()->start_capture();
+        this->power.get_engine()->start_capture();
       }
       else if (*(uint32_t *)data == 0xdeadcaca)
       {
-        _this->power.get_engine()->stop_capture();
+        this->power.get_engine()->stop_capture();
       }
     }
   }
@@ -158,17 +204,17 @@ vp::io_req_status_e memory::req(void *__this, vp::io_req *req)
 
 
   if (req->get_is_write()) {
-    if (_this->check_mem) {
+    if (this->check_mem) {
       for (unsigned int i=0; i<size; i++) {
-        _this->check_mem[(offset + i) / 8] |= 1 << ((offset + i) % 8);
+        this->check_mem[(offset + i) / 8] |= 1 << ((offset + i) % 8);
       }
     }
     if (data)
-      memcpy((void *)&_this->mem_data[offset], (void *)data, size);
+      memcpy((void *)&this->mem_data[offset], (void *)data, size);
   } else {
-    if (_this->check_mem) {
+    if (this->check_mem) {
       for (unsigned int i=0; i<size; i++) {
-        int access = (_this->check_mem[(offset + i) / 8] >> ((offset + i) % 8)) & 1;
+        int access = (this->check_mem[(offset + i) / 8] >> ((offset + i) % 8)) & 1;
         if (!access) {
           //trace.msg("Unitialized access (offset: 0x%x, size: 0x%x, isRead: %d)\n", offset, size, isRead);
           return vp::IO_REQ_INVALID;
@@ -176,7 +222,7 @@ vp::io_req_status_e memory::req(void *__this, vp::io_req *req)
       }
     }
     if (data)
-      memcpy((void *)data, (void *)&_this->mem_data[offset], size);
+      memcpy((void *)data, (void *)&this->mem_data[offset], size);
   }
 
   return vp::IO_REQ_OK;
@@ -194,21 +240,22 @@ int memory::build()
 {
   traces.new_trace("trace", &trace, vp::DEBUG);
   in.set_req_meth(&memory::req);
+  in.set_bulk(true);
   new_slave_port("input", &in);
 
-  js::config *config = get_js_config()->get("power_trigger");
+  js::config *config = get_js_config("power_trigger");
   this->power_trigger = config != NULL && config->get_bool();
 
   if (power.new_trace("power_trace", &power_trace)) return -1;
 
-  power.new_leakage_event("leakage", &leakage_power, this->get_js_config()->get("**/leakage"), &power_trace);
-  power.new_event("idle", &idle_power, this->get_js_config()->get("**/idle"), &power_trace);
-  power.new_event("read_8", &read_8_power, this->get_js_config()->get("**/read_8"), &power_trace);
-  power.new_event("read_16", &read_16_power, this->get_js_config()->get("**/read_16"), &power_trace);
-  power.new_event("read_32", &read_32_power, this->get_js_config()->get("**/read_32"), &power_trace);
-  power.new_event("write_8", &write_8_power, this->get_js_config()->get("**/write_8"), &power_trace);
-  power.new_event("write_16", &write_16_power, this->get_js_config()->get("**/write_16"), &power_trace);
-  power.new_event("write_32", &write_32_power, this->get_js_config()->get("**/write_32"), &power_trace);
+  power.new_leakage_event("leakage", &leakage_power, this->get_js_config("**/leakage"), &power_trace);
+  power.new_event("idle", &idle_power, this->get_js_config("**/idle"), &power_trace);
+  power.new_event("read_8", &read_8_power, this->get_js_config("**/read_8"), &power_trace);
+  power.new_event("read_16", &read_16_power, this->get_js_config("**/read_16"), &power_trace);
+  power.new_event("read_32", &read_32_power, this->get_js_config("**/read_32"), &power_trace);
+  power.new_event("write_8", &write_8_power, this->get_js_config("**/write_8"), &power_trace);
+  power.new_event("write_16", &write_16_power, this->get_js_config("**/write_16"), &power_trace);
+  power.new_event("write_32", &write_32_power, this->get_js_config("**/write_32"), &power_trace);
 
   power_event = this->event_new(memory::power_callback);
 
@@ -221,10 +268,23 @@ void memory::start()
   check = get_config_bool("check");
   width_bits = get_config_int("width_bits");
 
-  trace.msg("Building memory (size: 0x%x, check: %d)\n", size, check);
+  js::config *pause_conf = this->get_js_config("pause_offset");
+  if (pause_conf != NULL)
+    pause_offset = pause_conf->get_int();
 
-  mem_data = new uint8_t[size];
+  trace.msg("Building memory (size: 0x%x, check: %d)\n", size, check);
 
+  // Anonymous mapping so that the loader can replace pages by zero pages
+  // through the backdoor
+  if (size)
+  {
+    mem_data = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_data == MAP_FAILED)
+    {
+      this->trace.fatal("Unable to allocate memory (size: 0x%lx, error: %s)\n", size, strerror(errno));
+      return;
+    }
+  }
 
   // Special option to check for uninitialized accesses
   if (check)
@@ -238,12 +298,16 @@ void memory::start()
 
 
   // Initialize the memory with a special value to detect uninitialized
-  // variables
-  memset(mem_data, 0x57, size);
+  // variables. As this touches every page, it can be skipped with the
+  // zero_init option, in which case the memory is only allocated where the
+  // platform accesses it and reads as zero elsewhere.
+  js::config *zero_init_conf = this->get_js_config("zero_init");
+  if (zero_init_conf == NULL || !zero_init_conf->get_bool())
+    memset(mem_data, 0x57, size);
 
 
   // Preload the memory
-  js::config *stim_file_conf = this->get_js_config()->get("stim_file");
+  js::config *stim_file_conf = this->get_js_config("stim_file");
   if (stim_file_conf != NULL)
   {
     string path = stim_file_conf->get_str();
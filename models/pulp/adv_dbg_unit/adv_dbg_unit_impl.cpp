@@ -601,7 +601,7 @@ int adv_dbg_unit::build()
   traces.new_trace("debug", &debug, vp::DEBUG);
 
   this->confreg_length = 4;
-  if (get_js_config()->get("confreg_length") != NULL)
+  if (get_js_config("confreg_length") != NULL)
   {
     this->confreg_length = get_js_config()->get_child_int("confreg_length");
   }
@@ -619,7 +619,7 @@ int adv_dbg_unit::build()
 
   new_master_port("io", &io_itf);
 
-  if (get_js_config()->get("confreg_instr") == NULL)
+  if (get_js_config("confreg_instr") == NULL)
     this->confreg_instr = 7;
   else
     this->confreg_instr = get_js_config()->get_int("confreg_instr");
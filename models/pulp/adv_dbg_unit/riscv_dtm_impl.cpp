@@ -812,7 +812,7 @@ int riscv_dtm::build()
 
   this->tclk = 0;
 
-  for (auto hart: this->get_js_config()->get("harts")->get_elems())
+  for (auto hart: this->get_js_config("harts")->get_elems())
   {
     int hart_id = hart->get_elem(0)->get_int();
     string target = hart->get_elem(1)->get_str();
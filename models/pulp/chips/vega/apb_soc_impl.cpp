@@ -623,8 +623,8 @@ int apb_soc_ctrl::build()
   new_slave_port("bootsel", &bootsel_itf);
   this->new_reg("bootsel", &this->r_bootsel, 0, false);
 
-  cluster_power_event = this->get_js_config()->get("cluster_power_event")->get_int();
-  cluster_clock_gate_event = this->get_js_config()->get("cluster_clock_gate_event")->get_int();
+  cluster_power_event = this->get_js_config("cluster_power_event")->get_int();
+  cluster_clock_gate_event = this->get_js_config("cluster_clock_gate_event")->get_int();
 
   core_status = 0;
   this->jtag_reg_ext.set(0);
@@ -202,10 +202,10 @@ void efuse::start()
 {
   string path;
 
-  js::config *stim_file_conf = this->get_js_config()->get("stim_file");
+  js::config *stim_file_conf = this->get_js_config("stim_file");
   if (stim_file_conf)
   {
-    js::config *format = this->get_js_config()->get("format");
+    js::config *format = this->get_js_config("format");
 
     path = stim_file_conf->get_str();
 
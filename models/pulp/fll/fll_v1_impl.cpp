@@ -352,10 +352,10 @@ int fll::build()
 
   new_master_port("clock_out", &fll_clock_itf);
 
-  this->status_reg_reset = get_js_config()->get("regmap/status/reset")->get_int();
-  this->conf1_reg_reset = get_js_config()->get("regmap/conf1/reset")->get_int();
-  this->conf2_reg_reset = get_js_config()->get("regmap/conf2/reset")->get_int();
-  this->integrator_reg_reset = get_js_config()->get("regmap/integrator/reset")->get_int();
+  this->status_reg_reset = get_js_config("regmap/status/reset")->get_int();
+  this->conf1_reg_reset = get_js_config("regmap/conf1/reset")->get_int();
+  this->conf2_reg_reset = get_js_config("regmap/conf2/reset")->get_int();
+  this->integrator_reg_reset = get_js_config("regmap/integrator/reset")->get_int();
 
   return 0;
 }
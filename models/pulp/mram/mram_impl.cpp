@@ -113,7 +113,7 @@ void mram::start()
   // variables
   memset(mem_data, 0x57, size);
   // Preload the mram
-  js::config *stim_file_conf = this->get_js_config()->get("stim_file");
+  js::config *stim_file_conf = this->get_js_config("stim_file");
   if (stim_file_conf != NULL)
   {
     string path = stim_file_conf->get_str();
@@ -595,7 +595,7 @@ int padframe::build()
 
   this->traces.new_trace_event("ref_clock", &this->ref_clock_trace, 1);
 
-  js::config *groups = get_js_config()->get("groups");
+  js::config *groups = get_js_config("groups");
 
   for (auto& group: groups->get_childs())
   {
@@ -728,7 +728,7 @@ void pmu::reset(bool active)
     this->wakeup_seq = 0;
 
     // These are the sequences corresponding to the interrupts
-    js::config *icrs_config = this->get_js_config()->get("icrs");
+    js::config *icrs_config = this->get_js_config("icrs");
     if (icrs_config != NULL)
     {
       for (int i=0; i<this->nb_interrupts; i++)
@@ -756,7 +756,7 @@ void pmu::reset(bool active)
 
 void pmu::start()
 {
-  js::config *sequences = this->get_js_config()->get("regmap/sequences");
+  js::config *sequences = this->get_js_config("regmap/sequences");
   for (auto x: sequences->get_childs())
   {
     js::config *seq_config = x.second;
@@ -790,7 +790,7 @@ void pmu::start()
   {
     pmu_icu *icu = (pmu_icu *)this->picl_slaves[i+2];
 
-    js::config *icu_states_config = this->get_js_config()->get("icu_states");
+    js::config *icu_states_config = this->get_js_config("icu_states");
     if (icu_states_config != NULL)
     {
       for (int j=0; j<icu_states_config->get_size(); j++)
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __PULP_STDOUT_STDOUT_ACCESS_HPP
+#define __PULP_STDOUT_STDOUT_ACCESS_HPP
+
+#include <stdint.h>
+
+// Default offset of the multi-byte window. Below it, runtimes store one
+// character per access whatever the size of the store. From it, all the
+// bytes of a store are printed, up to the first null one.
+#define STDOUT_MULTI_BYTE_OFFSET 0x800
+
+// Each core has its own 8-byte channel in both windows
+#define STDOUT_CHANNEL_SIZE 0x8
+
+typedef struct
+{
+  int cluster_id;
+  int core_id;
+  // Number of characters to print from the start of the data
+  int nb_chars;
+} stdout_access_t;
+
+
+// Decode a write of size bytes at the specified offset of the stdout
+// component
+static inline stdout_access_t stdout_decode_access(uint64_t offset, uint8_t *data, uint64_t size, uint64_t multi_byte_offset)
+{
+  stdout_access_t access;
+  bool multi_byte = offset >= multi_byte_offset;
+
+  if (multi_byte)
+    offset -= multi_byte_offset;
+
+  access.core_id = (offset >> 3) & 0xf;
+  access.cluster_id = (offset >> 7) & 0x3f;
+
+  if (!multi_byte)
+  {
+    access.nb_chars = 1;
+  }
+  else
+  {
+    access.nb_chars = 0;
+    while (access.nb_chars < (int)size && data[access.nb_chars] != 0)
+      access.nb_chars++;
+  }
+
+  return access;
+}
+
+#endif
@@ -14,7 +14,7 @@
  * limitations under the License.
  */
 
-/* 
+/*
  * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
  */
 
@@ -22,10 +22,82 @@
 #include <vp/itf/io.hpp>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <thread>
 #include <vector>
+#include "stdout_access.hpp"
 
 #define MAX_PUTC_LENGTH 1024
 
+// Default size in bytes of each per-core ring buffer. Must be a power of 2.
+#define STDOUT_RING_SIZE (1<<16)
+
+// Size of the buffer used by the writer thread to gather lines before
+// issuing a single write to the output file.
+#define STDOUT_CHUNK_SIZE (1<<20)
+
+// Default period in microseconds at which the writer thread wakes-up to
+// flush pending lines, even if no ring buffer is getting full.
+#define STDOUT_FLUSH_PERIOD 10000
+
+// Binary log layout: a file header made of STDOUT_LOG_MAGIC followed by
+// records made of a stdout_log_record_t and then the line bytes.
+#define STDOUT_LOG_MAGIC "GVSTDOUT"
+
+typedef enum {
+  STDOUT_OUTPUT_TERMINAL,
+  STDOUT_OUTPUT_FILE,
+  STDOUT_OUTPUT_CORE_FILES
+} stdout_output_e;
+
+typedef struct {
+  int64_t timestamp;
+  uint32_t size;
+} stdout_line_header_t;
+
+typedef struct {
+  int64_t timestamp;
+  uint16_t cluster_id;
+  uint16_t core_id;
+  uint32_t size;
+} stdout_log_record_t;
+
+
+// One output stream per core. The simulation thread accumulates characters
+// into the line buffer and commits full lines into the ring buffer, from
+// which the writer thread pulls them. The ring is single-producer,
+// single-consumer, so only the head and tail indexes need to be atomic.
+class Stdout_channel
+{
+public:
+  Stdout_channel(int cluster_id, int core_id, int ring_size);
+
+  inline uint32_t get_free() { return this->ring_size - (this->head.load(std::memory_order_relaxed) - this->tail.load(std::memory_order_acquire)); }
+  inline uint32_t get_used() { return this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_relaxed); }
+
+  void push(void *data, uint32_t size, uint64_t index);
+  void pop(void *data, uint32_t size, uint64_t index);
+
+  int cluster_id;
+  int core_id;
+  int fd = -1;
+
+  char line[MAX_PUTC_LENGTH];
+  int line_pos = 0;
+  int64_t line_timestamp = -1;
+
+  uint8_t *ring;
+  uint32_t ring_size;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+};
+
+
 class Stdout : public vp::component
 {
 
@@ -35,26 +107,113 @@ public:
 
   int build();
   void start();
+  void stop();
+  void fork_prepare();
+  void fork_child();
 
   static vp::io_req_status_e req(void *__this, vp::io_req *req);
 
 private:
 
+  void putc_channel(Stdout_channel *channel, char c);
+  void commit_line(Stdout_channel *channel);
+  void writer_routine();
+  bool drain_channel(Stdout_channel *channel);
+  bool drain_all();
+  void chunk_append(int fd, void *data, uint32_t size);
+  void chunk_flush();
+  void write_fd(int fd, void *data, size_t size);
+  int open_file(std::string path);
+  void open_outputs();
+  void close_outputs();
+  void stop_writer();
+  std::string get_config_str_default(std::string name, std::string default_value);
+  int get_config_int_default(std::string name, int default_value);
+
   vp::trace     trace;
   vp::io_slave in;
 
   int nb_cluster;
   int nb_core;
+  uint64_t multi_byte_offset;
+
+  std::vector<Stdout_channel *> channels;
+
+  stdout_output_e output;
+  std::string output_path;
+  std::string binary_log;
+  int output_fd = -1;
+  int log_fd = -1;
+  int ring_size;
+  int flush_period;
+
+  // Set when the output is a terminal, where lines are expected as soon as
+  // they are printed
+  bool is_tty = false;
 
-  std::vector <char *> putc_buffer;
-  int *putc_buffer_pos;
+  // Writer thread state, only accessed by the writer thread except during
+  // build and stop
+  char *chunk;
+  uint32_t chunk_size = 0;
+  int chunk_fd = -1;
 
+  std::thread *thread = NULL;
+  pthread_mutex_t mutex;
+  // Held while draining the rings, which is also done by the simulation
+  // thread when lines are written synchronously
+  pthread_mutex_t drain_mutex;
+  pthread_cond_t cond;
+  pthread_cond_t space_cond;
+  bool end = false;
 };
 
+
+
+Stdout_channel::Stdout_channel(int cluster_id, int core_id, int ring_size)
+: cluster_id(cluster_id), core_id(core_id), ring_size(ring_size), head(0), tail(0)
+{
+  this->ring = new uint8_t[ring_size];
+}
+
+void Stdout_channel::push(void *data, uint32_t size, uint64_t index)
+{
+  uint32_t pos = index & (this->ring_size - 1);
+  uint32_t first = this->ring_size - pos;
+  if (first >= size)
+  {
+    memcpy((void *)&this->ring[pos], data, size);
+  }
+  else
+  {
+    memcpy((void *)&this->ring[pos], data, first);
+    memcpy((void *)this->ring, (void *)((uint8_t *)data + first), size - first);
+  }
+}
+
+void Stdout_channel::pop(void *data, uint32_t size, uint64_t index)
+{
+  uint32_t pos = index & (this->ring_size - 1);
+  uint32_t first = this->ring_size - pos;
+  if (first >= size)
+  {
+    memcpy(data, (void *)&this->ring[pos], size);
+  }
+  else
+  {
+    memcpy(data, (void *)&this->ring[pos], first);
+    memcpy((void *)((uint8_t *)data + first), (void *)this->ring, size - first);
+  }
+}
+
+
+
 Stdout::Stdout(const char *config)
 : vp::component(config)
 {
-
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_mutex_init(&this->drain_mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+  pthread_cond_init(&this->space_cond, NULL);
 }
 
 vp::io_req_status_e Stdout::req(void *__this, vp::io_req *req)
@@ -67,27 +226,278 @@ vp::io_req_status_e Stdout::req(void *__this, vp::io_req *req)
 
   _this->trace.msg("Stdout access (offset: 0x%x, size: 0x%x, is_write: %d)\n", offset, size, req->get_is_write());
 
-  int core_id = (offset >> 3) & 0xf;
-  int cluster_id = (offset >> 7) & 0x3f;
+  stdout_access_t access = stdout_decode_access(offset, data, size, _this->multi_byte_offset);
 
-  if (core_id >= _this->nb_core || cluster_id >= _this->nb_cluster)
+  if (access.core_id >= _this->nb_core || access.cluster_id >= _this->nb_cluster)
   {
-    _this->trace.warning("Accessing invalid stdout channel (coreId: %d, clusterId: %d)\n", core_id, cluster_id);
+    _this->trace.warning("Accessing invalid stdout channel (coreId: %d, clusterId: %d)\n", access.core_id, access.cluster_id);
     return vp::IO_REQ_INVALID;
   }
-  
-  _this->putc_buffer[cluster_id*_this->nb_core+core_id][_this->putc_buffer_pos[cluster_id*_this->nb_core+core_id]++] = *data;
-  if (*data == '\n' || _this->putc_buffer_pos[cluster_id*_this->nb_core+core_id] == MAX_PUTC_LENGTH - 1) {
-    _this->putc_buffer[cluster_id*_this->nb_core+core_id][_this->putc_buffer_pos[cluster_id*_this->nb_core+core_id]] = 0;
-      //if (stdoutPrefix) fprintf(stdout, "# [STDOUT-CL%d_PE%d] ", clusterId, coreId);
-    fwrite((void *)_this->putc_buffer[cluster_id*_this->nb_core+core_id], 1, _this->putc_buffer_pos[cluster_id*_this->nb_core+core_id], stdout);
-  //  if (stdoutToFile) fwrite((void *)putcBuffer[clusterId][coreId], 1, putcBufferPos[clusterId][coreId], stdoutFiles[clusterId][coreId]);
-    _this->putc_buffer_pos[cluster_id*_this->nb_core+core_id] = 0;
-  }
+
+  if (!req->get_is_write())
+    return vp::IO_REQ_OK;
+
+  Stdout_channel *channel = _this->channels[access.cluster_id*_this->nb_core+access.core_id];
+  for (int i=0; i<access.nb_chars; i++)
+    _this->putc_channel(channel, data[i]);
 
   return vp::IO_REQ_OK;
 }
 
+void Stdout::putc_channel(Stdout_channel *channel, char c)
+{
+  if (channel->line_pos == 0)
+    channel->line_timestamp = this->get_time();
+
+  channel->line[channel->line_pos++] = c;
+
+  if (c == '\n' || channel->line_pos == MAX_PUTC_LENGTH - 1)
+    this->commit_line(channel);
+}
+
+void Stdout::commit_line(Stdout_channel *channel)
+{
+  stdout_line_header_t header = { .timestamp=channel->line_timestamp, .size=(uint32_t)channel->line_pos };
+  uint32_t needed = sizeof(header) + header.size;
+
+  if (channel->get_free() < needed)
+  {
+    // The writer thread is late, wake it up and block until it has made
+    // enough room. This only happens if the guest is printing faster than
+    // the output can absorb.
+    pthread_mutex_lock(&this->mutex);
+    pthread_cond_signal(&this->cond);
+    while (channel->get_free() < needed)
+    {
+      pthread_cond_wait(&this->space_cond, &this->mutex);
+    }
+    pthread_mutex_unlock(&this->mutex);
+  }
+
+  uint64_t head = channel->head.load(std::memory_order_relaxed);
+  channel->push((void *)&header, sizeof(header), head);
+  channel->push((void *)channel->line, header.size, head + sizeof(header));
+  channel->head.store(head + needed, std::memory_order_release);
+
+  channel->line_pos = 0;
+
+  // Lines going to the terminal are written now if it is interactive, or if
+  // trace messages, which the simulation thread prints directly, may be
+  // interleaved with them. Other lines are written later by the writer
+  // thread.
+  if (channel->fd == STDOUT_FILENO && (this->is_tty || this->traces.get_trace_manager()->has_msg_traces()))
+  {
+    this->drain_all();
+    return;
+  }
+
+  // Only notify the writer when the ring is getting full, otherwise it
+  // will wake-up by itself at the next flush period. This keeps the
+  // common path free of any system call.
+  if (channel->get_used() >= channel->ring_size / 2)
+  {
+    pthread_cond_signal(&this->cond);
+  }
+}
+
+void Stdout::write_fd(int fd, void *data, size_t size)
+{
+  // The lines are written directly to the file descriptor, so what other
+  // threads printed so far through stdio, e.g. traces, must go out first to
+  // keep both in order on the terminal
+  if (fd == STDOUT_FILENO)
+    fflush(stdout);
+
+  uint8_t *buffer = (uint8_t *)data;
+  while (size > 0)
+  {
+    ssize_t done = ::write(fd, (void *)buffer, size);
+    if (done < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    buffer += done;
+    size -= done;
+  }
+}
+
+void Stdout::chunk_flush()
+{
+  if (this->chunk_size)
+  {
+    this->write_fd(this->chunk_fd, this->chunk, this->chunk_size);
+    this->chunk_size = 0;
+  }
+}
+
+void Stdout::chunk_append(int fd, void *data, uint32_t size)
+{
+  if (fd != this->chunk_fd || this->chunk_size + size > STDOUT_CHUNK_SIZE)
+  {
+    this->chunk_flush();
+    this->chunk_fd = fd;
+  }
+
+  if (size > STDOUT_CHUNK_SIZE)
+  {
+    this->write_fd(fd, data, size);
+    return;
+  }
+
+  memcpy((void *)&this->chunk[this->chunk_size], data, size);
+  this->chunk_size += size;
+}
+
+bool Stdout::drain_channel(Stdout_channel *channel)
+{
+  uint64_t tail = channel->tail.load(std::memory_order_relaxed);
+  uint64_t head = channel->head.load(std::memory_order_acquire);
+  bool drained = tail != head;
+  char line[MAX_PUTC_LENGTH];
+
+  while (tail != head)
+  {
+    stdout_line_header_t header;
+    channel->pop((void *)&header, sizeof(header), tail);
+    channel->pop((void *)line, header.size, tail + sizeof(header));
+    tail += sizeof(header) + header.size;
+
+    this->chunk_append(channel->fd, (void *)line, header.size);
+
+    if (this->log_fd != -1)
+    {
+      stdout_log_record_t record = { .timestamp=header.timestamp, .cluster_id=(uint16_t)channel->cluster_id,
+        .core_id=(uint16_t)channel->core_id, .size=header.size
+      };
+      // The log goes through its own writes so that the text output can
+      // keep gathering lines from several channels into the same chunk.
+      this->write_fd(this->log_fd, (void *)&record, sizeof(record));
+      this->write_fd(this->log_fd, (void *)line, header.size);
+    }
+  }
+
+  channel->tail.store(tail, std::memory_order_release);
+
+  return drained;
+}
+
+bool Stdout::drain_all()
+{
+  // Lines pending in other channels are written first so that the output
+  // keeps the order in which the lines were committed
+  pthread_mutex_lock(&this->drain_mutex);
+  bool drained = false;
+  for (auto channel: this->channels)
+  {
+    drained |= this->drain_channel(channel);
+  }
+  this->chunk_flush();
+  pthread_mutex_unlock(&this->drain_mutex);
+
+  return drained;
+}
+
+void Stdout::writer_routine()
+{
+  while(1)
+  {
+    pthread_mutex_lock(&this->mutex);
+    if (!this->end)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += (int64_t)this->flush_period * 1000;
+      ts.tv_sec += ts.tv_nsec / 1000000000;
+      ts.tv_nsec = ts.tv_nsec % 1000000000;
+      pthread_cond_timedwait(&this->cond, &this->mutex, &ts);
+    }
+    bool end = this->end;
+    pthread_mutex_unlock(&this->mutex);
+
+    bool drained = this->drain_all();
+
+    if (drained)
+    {
+      pthread_mutex_lock(&this->mutex);
+      pthread_cond_broadcast(&this->space_cond);
+      pthread_mutex_unlock(&this->mutex);
+    }
+
+    // The end flag is only taken into account after a full drain, as it is
+    // set once the simulation thread has committed its last lines.
+    if (end)
+      break;
+  }
+}
+
+int Stdout::open_file(std::string path)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1)
+    throw std::logic_error("Unable to open file: " + path);
+  return fd;
+}
+
+std::string Stdout::get_config_str_default(std::string name, std::string default_value)
+{
+  js::config *config = this->get_js_config(name);
+  return config != NULL ? config->get_str() : default_value;
+}
+
+int Stdout::get_config_int_default(std::string name, int default_value)
+{
+  js::config *config = this->get_js_config(name);
+  return config != NULL ? config->get_int() : default_value;
+}
+
+void Stdout::open_outputs()
+{
+  if (this->output == STDOUT_OUTPUT_TERMINAL)
+  {
+    this->output_fd = STDOUT_FILENO;
+    this->is_tty = isatty(STDOUT_FILENO);
+  }
+  else if (this->output == STDOUT_OUTPUT_FILE)
+    this->output_fd = this->open_file(this->output_path != "" ? this->output_path : "stdout.log");
+
+  for (auto channel: this->channels)
+  {
+    if (this->output == STDOUT_OUTPUT_CORE_FILES)
+    {
+      std::string prefix = this->output_path != "" ? this->output_path : "stdout";
+      channel->fd = this->open_file(prefix + "_cl" + std::to_string(channel->cluster_id) + "_pe" + std::to_string(channel->core_id) + ".log");
+    }
+    else
+    {
+      channel->fd = this->output_fd;
+    }
+  }
+
+  if (this->binary_log != "")
+  {
+    this->log_fd = this->open_file(this->binary_log);
+    this->write_fd(this->log_fd, (void *)STDOUT_LOG_MAGIC, strlen(STDOUT_LOG_MAGIC));
+  }
+}
+
+void Stdout::close_outputs()
+{
+  for (auto channel: this->channels)
+  {
+    if (channel->fd != -1 && channel->fd != STDOUT_FILENO && channel->fd != this->output_fd)
+      close(channel->fd);
+    channel->fd = -1;
+  }
+  if (this->output_fd != -1 && this->output_fd != STDOUT_FILENO)
+    close(this->output_fd);
+  this->output_fd = -1;
+  if (this->log_fd != -1)
+    close(this->log_fd);
+  this->log_fd = -1;
+}
+
 int Stdout::build()
 {
   traces.new_trace("trace", &trace, vp::DEBUG);
@@ -96,20 +506,120 @@ int Stdout::build()
 
   nb_cluster = get_config_int("max_cluster");
   nb_core = get_config_int("max_core_per_cluster");
+  this->multi_byte_offset = this->get_config_int_default("multi_byte_offset", STDOUT_MULTI_BYTE_OFFSET);
+
+  if ((uint64_t)nb_cluster * 16 * STDOUT_CHANNEL_SIZE > this->multi_byte_offset)
+  {
+    this->trace.force_warning("Stdout multi-byte window overlaps the channels (multi_byte_offset: 0x%lx)\n", this->multi_byte_offset);
+    return -1;
+  }
+
+  this->ring_size = this->get_config_int_default("buffer_size", STDOUT_RING_SIZE);
+  this->flush_period = this->get_config_int_default("flush_period", STDOUT_FLUSH_PERIOD);
+
+  if ((this->ring_size & (this->ring_size - 1)) != 0 || this->ring_size < MAX_PUTC_LENGTH + (int)sizeof(stdout_line_header_t))
+  {
+    this->trace.force_warning("Invalid stdout buffer size, must be a power of 2 big enough for one line (size: %d)\n", this->ring_size);
+    return -1;
+  }
+
+  std::string output = this->get_config_str_default("output", "terminal");
+  this->output_path = this->get_config_str_default("output_path", "");
+  this->binary_log = this->get_config_str_default("binary_log", "");
+
+  if (output == "terminal")
+  {
+    this->output = STDOUT_OUTPUT_TERMINAL;
+  }
+  else if (output == "file")
+  {
+    this->output = STDOUT_OUTPUT_FILE;
+  }
+  else if (output == "core_files")
+  {
+    this->output = STDOUT_OUTPUT_CORE_FILES;
+  }
+  else
+  {
+    this->trace.force_warning("Invalid stdout output (output: %s)\n", output.c_str());
+    return -1;
+  }
 
-  putc_buffer_pos = new int[nb_cluster*nb_core];
   for (int j=0; j<nb_cluster; j++) {
     for (int i=0; i<nb_core; i++) {
-      putc_buffer.push_back(new char[MAX_PUTC_LENGTH]);
-      putc_buffer_pos[j*nb_core+i] = 0;
+      this->channels.push_back(new Stdout_channel(j, i, this->ring_size));
     }
   }
 
+  this->open_outputs();
+
+  this->chunk = new char[STDOUT_CHUNK_SIZE];
+
   return 0;
 }
 
 void Stdout::start()
 {
+  this->thread = new std::thread(&Stdout::writer_routine, this);
+}
+
+void Stdout::stop_writer()
+{
+  pthread_mutex_lock(&this->mutex);
+  this->end = true;
+  pthread_cond_broadcast(&this->cond);
+  pthread_mutex_unlock(&this->mutex);
+
+  this->thread->join();
+  delete this->thread;
+  this->thread = NULL;
+}
+
+void Stdout::stop()
+{
+  if (this->thread == NULL)
+    return;
+
+  // Commit what is left in the line buffers so that no output is lost if the
+  // guest did not terminate its last line.
+  for (auto channel: this->channels)
+  {
+    if (channel->line_pos)
+      this->commit_line(channel);
+  }
+
+  this->stop_writer();
+
+  this->close_outputs();
+}
+
+void Stdout::fork_prepare()
+{
+  // Everything printed so far goes to the output of the parent, the writer
+  // thread is stopped as it would not exist anymore in the child.
+  if (this->thread != NULL)
+    this->stop_writer();
+}
+
+void Stdout::fork_child()
+{
+  // Output files are opened again, relative to the working directory of the
+  // child, after closing the ones inherited from the parent
+  if (this->output != STDOUT_OUTPUT_TERMINAL || this->binary_log != "")
+  {
+    this->close_outputs();
+    this->open_outputs();
+  }
+
+  // The fork server redirects the standard output of the child
+  this->is_tty = this->output == STDOUT_OUTPUT_TERMINAL && isatty(STDOUT_FILENO);
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_mutex_init(&this->drain_mutex, NULL);
+  pthread_cond_init(&this->cond, NULL);
+  pthread_cond_init(&this->space_cond, NULL);
+  this->end = false;
+  this->thread = new std::thread(&Stdout::writer_routine, this);
 }
 
 extern "C" void *vp_constructor(const char *config)
@@ -73,7 +73,7 @@ Hyper_periph_v2::Hyper_periph_v2(udma *top, int id, int itf_id) : Udma_periph(to
   this->top->new_reg(itf_name + "/clk_div", &this->r_clk_div, 0);
   //hyper_itf.set_cs_sync_meth(&Hyper_periph_v2::cs_sync);
 
-  js::config *config = this->top->get_js_config()->get("hyper/eot_events");
+  js::config *config = this->top->get_js_config("hyper/eot_events");
   if (config)
     this->eot_event = config->get_elem(itf_id)->get_int();
   else
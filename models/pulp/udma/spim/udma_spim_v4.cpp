@@ -38,7 +38,7 @@ Spim_periph_v4::Spim_periph_v4(udma *top, int id, int itf_id) : Udma_periph(top,
   qspim_itf.set_sync_meth(&Spim_periph_v4::slave_sync);
   top->new_master_port(this, itf_name, &qspim_itf);
 
-  js::config *config = this->top->get_js_config()->get("spim/eot_events");
+  js::config *config = this->top->get_js_config("spim/eot_events");
   if (config)
     this->eot_event = config->get_elem(itf_id)->get_int();
   else
@@ -680,12 +680,12 @@ int udma::build()
 
   trace.msg("Instantiating udma channels (nb_periphs: %d)\n", nb_periphs);
 
-  js::config *interfaces = get_js_config()->get("interfaces");
+  js::config *interfaces = get_js_config("interfaces");
 
   for (int i=0; i<interfaces->get_size(); i++)
   {
     std::string name = interfaces->get_elem(i)->get_str();
-    js::config *interface = get_js_config()->get(name);
+    js::config *interface = get_js_config(name);
 
     if (interface == NULL)
     {
@@ -19,6 +19,7 @@
  */
 
 #include <vp/vp.hpp>
+#include <vp/context.hpp>
 #include <vp/itf/io.hpp>
 #include <stdio.h>
 #include <string.h>
@@ -33,7 +34,6 @@
 #include <vector>
 #include <thread>
 #include <unistd.h>
-#include <ucontext.h>
 
 
 typedef struct {
@@ -94,7 +94,8 @@ static vector<vp::cpi_master *> cpi_masters;
 static vector<cpi_handle_t *> cpi_handles;
 static vector<gpio_handle_t *> gpio_handles;
 
-static ucontext_t main_context;
+// Context of the engine, which tasks switch back to when they wait
+static vp::context main_context;
 
 static dpi_task *active_task;
 
@@ -112,10 +113,10 @@ protected:
 
 private:
   static void wait_handler(void *__this, vp::clock_event *event);
-  static void entry_stub(int id);
+  static void entry_stub(void *__this);
 
   dpi_wrapper *top;
-  ucontext_t context;
+  vp::context context;
   int id;
   vp::clock_event *wait_evt;
   bool is_started;
@@ -199,26 +200,27 @@ void dpi_task::wait_ps(int64_t t)
   int64_t period = this->top->get_period();
   int64_t cycles = (t + period - 1) / period;
   this->top->event_enqueue(this->wait_evt, cycles);
-  swapcontext(&this->context, &main_context);
+  this->context.switch_to(&main_context);
 }
 
 
 void dpi_task::wait_event()
 {
   top->enqueue_waiting_for_event(this);
-  swapcontext(&this->context, &main_context);
+  this->context.switch_to(&main_context);
 }
 
 void dpi_task::wait_handler(void *__this, vp::clock_event *event)
 {
   dpi_task *_this = (dpi_task *)__this;
   active_task = _this;
-  swapcontext(&main_context, &_this->context);
+  main_context.switch_to(&_this->context);
 }
 
-void dpi_task::entry_stub(int id)
+void dpi_task::entry_stub(void *__this)
 {
-  dpi_start_task(id);
+  dpi_task *_this = (dpi_task *)__this;
+  dpi_start_task(_this->id);
 }
 
 void dpi_task::start()
@@ -226,13 +228,7 @@ void dpi_task::start()
   this->wait_evt = top->event_new(this, dpi_task::wait_handler);
   top->event_enqueue(this->wait_evt, 0);
 
-  getcontext(&this->context);
-
-  this->context.uc_stack.ss_sp = malloc(65536);
-  this->context.uc_stack.ss_size = 65536;
-  this->context.uc_link = &main_context;
-
-  makecontext(&this->context, (void (*)())dpi_task::entry_stub, 1, this->id);
+  this->context.init(dpi_task::entry_stub, (void *)this);
 }
 
 
@@ -302,7 +298,7 @@ void dpi_wrapper::raise_event()
     dpi_task *next = current->next;
 
     active_task = current;
-    swapcontext(&main_context, &current->context);
+    main_context.switch_to(&current->context);
 
     current = next;
   }
@@ -20,6 +20,7 @@
 
 #include <vp/vp.hpp>
 #include <vp/launcher_internal.hpp>
+#include <vp/ioreq_ring.hpp>
 #include <vp/itf/io.hpp>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -48,8 +49,16 @@ private:
   FILE *snd_file;
   FILE *rcv_file;
 
+  // Shared-memory transport, NULL when pipes are used
+  gv_ioreq_shm_t *shm;
+  // Records sent to the host, which never wait for room in the ring, as
+  // they are produced while holding the engine lock
+  gv_ioreq_backlog *to_host;
+
   static vp::io_req_status_e req(void *__this, vp::io_req *req);
   void binding_routine();
+  void shm_binding_routine();
+  void shm_handle_req(gv_ioreq_desc_t *req, void *payload);
 
 };
 
@@ -70,6 +79,26 @@ vp::io_req_status_e injector::req(void *__this, vp::io_req *req)
 
   _this->trace.msg("IO access (offset: 0x%lx, size: 0x%lx, is_write: %d)\n", offset, size, req->get_is_write());
 
+  if (_this->shm)
+  {
+    // This is called by the engine thread, and the binding thread only
+    // produces records while holding the engine lock, so that the ring has a
+    // single producer at a time
+    void *payload;
+    gv_ioreq_desc_t *desc = _this->to_host->reserve(is_write ? size : 0, &payload);
+    if (desc == NULL) return vp::IO_REQ_INVALID;
+
+    *desc = { .type=GV_IOREQ_DESC_TYPE_REQUEST, .addr=(uint64_t)offset, .size=(uint64_t)size,
+      .is_write=(int64_t)is_write, .timestamp=_this->get_time(), .response_cb=NULL, .response_context=NULL,
+      .binding=(void *)_this->binding_context, .req=req
+    };
+    if (is_write) memcpy(payload, data, size);
+
+    _this->to_host->commit();
+
+    return vp::IO_REQ_PENDING;
+  }
+
   if (_this->snd_file == NULL)
   {
     _this->trace.force_warning("Accessing injector while it is not connected\n");
@@ -150,6 +179,78 @@ void injector::binding_routine()
   }
 }
 
+void injector::shm_handle_req(gv_ioreq_desc_t *req, void *payload)
+{
+  this->trace.msg("Received IO req from external binding (addr: 0x%llx, size: 0x%llx, is_write: %d)\n", req->addr, req->size, req->is_write);
+
+  // Read data is directly produced into the payload of the response, and
+  // written data directly taken from the payload of the request
+  void *resp_payload;
+  gv_ioreq_desc_t *resp = this->to_host->reserve(req->is_write ? 0 : req->size, &resp_payload);
+  if (resp == NULL) return;
+
+  *resp = *req;
+
+  vp::io_req *io_req = &ext_req;
+  io_req->init();
+  io_req->set_addr(req->addr);
+  io_req->set_size(req->size);
+  io_req->set_is_write(req->is_write);
+  io_req->set_data(req->is_write ? (uint8_t *)payload : (uint8_t *)resp_payload);
+
+  this->get_clock()->sync();
+
+  int err = this->out.req(io_req);
+
+  resp->user_req.state = err != vp::IO_REQ_OK ? GV_IOREQ_DONE_ERROR : GV_IOREQ_DONE;
+  resp->user_req.latency = this->get_time() + io_req->get_latency() + io_req->get_duration();
+  resp->type = GV_IOREQ_DESC_TYPE_RESPONSE;
+}
+
+void injector::shm_binding_routine()
+{
+  this->get_clock()->get_engine()->wait_running();
+
+  gv_ioreq_ring *ring = &this->shm->to_fabric;
+  bool pending = false;
+
+  while(1)
+  {
+    // Records which did not fit in the ring are sent again periodically
+    int count = ring->wait(pending ? GV_IOREQ_RING_RETRY_US : -1);
+
+    // The whole batch is handled with a single engine lock and the responses
+    // are sent together
+    this->get_clock()->get_engine()->lock();
+
+    for (int i=0; i<count; i++)
+    {
+      // Each record is released as soon as it is handled, so that the host
+      // can go on sending records
+      void *payload;
+      gv_ioreq_desc_t *req = ring->get(0, &payload);
+
+      if (req->type == GV_IOREQ_DESC_TYPE_REQUEST)
+      {
+        this->shm_handle_req(req, payload);
+        ring->release(1);
+      }
+      else
+      {
+        vp::io_req *ioreq = (vp::io_req *)req->req;
+        if (!ioreq->get_is_write()) memcpy(ioreq->get_data(), payload, ioreq->get_size());
+        ring->release(1);
+        ioreq->set_latency(0);
+        ioreq->get_resp_port()->resp(ioreq);
+      }
+    }
+
+    pending = !this->to_host->flush();
+
+    this->get_clock()->get_engine()->unlock();
+  }
+}
+
 int injector::build()
 {
   in.set_req_meth(&injector::req);
@@ -164,6 +265,19 @@ int injector::build()
 
   this->binding_context = (void *)(long)this->get_js_config()->get_int("context");
 
+  this->shm = NULL;
+  js::config *shm_fd_config = this->get_js_config("shm_fd");
+  if (shm_fd_config != NULL && shm_fd_config->get_int() != -1)
+  {
+    this->shm = gv_ioreq_shm_map(shm_fd_config->get_int());
+    if (this->shm == NULL)
+    {
+      snprintf(vp_error, VP_ERROR_SIZE, "Failed to map shared memory: %s",  strerror(errno));
+      return -1;
+    }
+    this->to_host = new gv_ioreq_backlog(&this->shm->to_host, &this->shm->to_fabric);
+  }
+
   if (snd_fd != -1)
   {
     snd_file = fdopen(snd_fd, "w");
@@ -197,7 +311,12 @@ int injector::build()
 
 void injector::start()
 {
-  if (rcv_file)
+  if (this->shm)
+  {
+    this->get_clock()->retain();
+    new std::thread(&injector::shm_binding_routine, this);
+  }
+  else if (rcv_file)
   {
     this->get_clock()->retain();
     new std::thread(&injector::binding_routine, this);
@@ -17,53 +17,54 @@
 # Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
  
 import vp_core as vp
-from elftools.elf.elffile import ELFFile
+import ctypes
 import os
 
 class component(vp.component):
 
     implementation = 'utils.loader_impl'
 
-    def load(self):
-
-
+    def get_binaries(self):
         binaries = self.get_json().get_child_str('load-binary_eval')
         if binaries is not None:
-            binaries = [eval(binaries)]
-        else:
-            binaries = self.get_json().get('binaries').get_dict()
+            return [eval(binaries)]
 
+        binaries = self.get_json().get('binaries')
+        if binaries is not None:
+            return binaries.get_dict()
+
+        return None
 
-        elffile = None
+    # The native builder loads the binaries resolved here, as it can not
+    # evaluate the python expression
+    def describe(self):
+        binaries = self.get_binaries()
+        return {} if binaries is None else { 'binaries': binaries }
+
+    def load(self):
+
+        binaries = self.get_binaries()
+
+
+        entry = None
 
         if binaries is not None:
+            module = self.get_impl().module
+            module.loader_load_elf.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_uint64)]
+            module.loader_load_elf.restype = ctypes.c_int
+
             for binary in binaries:
-                with open(binary, 'rb') as file:
-                    elffile = ELFFile(file)
-                    for segment in elffile.iter_segments():
-                        if segment['p_type'] == 'PT_LOAD':
-                            self.get_impl().module.loader_io_req(
-                                self.get_impl().instance,
-                                segment['p_paddr'],
-                                segment['p_filesz'],
-                                True,
-                                segment.data()
-                            )
-                            if segment['p_filesz'] < segment['p_memsz']:
-                                self.get_impl().module.loader_memset(
-                                    self.get_impl().instance,
-                                    segment['p_paddr'] + segment['p_filesz'],
-                                    segment['p_memsz'] - segment['p_filesz'],
-                                    0
-                                )
+                binary_entry = ctypes.c_uint64()
+                if module.loader_load_elf(self.get_impl().instance, binary.encode('utf-8'), ctypes.byref(binary_entry)) != 0:
+                    raise Exception('Unable to load binary: ' + binary)
+                entry = binary_entry.value
 
             set_pc_addr = self.get_json().get_child_int('set_pc_addr')
             set_pc_offset = self.get_json().get_child_int('set_pc_offset')
             start_addr = self.get_json().get_child_int('start_addr')
             start_value = self.get_json().get_child_int('start_value')
 
-            if set_pc_addr is not None and elffile is not None:
-                entry = elffile.header['e_entry']
+            if set_pc_addr is not None and entry is not None:
                 if set_pc_offset is not None:
                     entry += set_pc_offset
                 self.get_impl().module.loader_io_req(
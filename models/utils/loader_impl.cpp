@@ -22,6 +22,29 @@
 #include <vp/itf/io.hpp>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Copies are split so that big segments are also loaded by several threads
+#define LOADER_CHUNK_SIZE (4*1024*1024)
+
+// Below this size, segments are loaded by the caller thread
+#define LOADER_PARALLEL_MIN_SIZE (1024*1024)
+
+typedef struct
+{
+  uint8_t *dest;
+  const uint8_t *src;     // NULL for zero-filling
+  uint64_t size;
+} loader_copy_t;
 
 class loader : public vp::component
 {
@@ -35,6 +58,7 @@ public:
 
   void io_req(uint64_t addr, uint64_t size, bool is_write, uint8_t *data);
   void memset(uint64_t addr, uint64_t size, uint8_t value);
+  int load_elf(const char *path, uint64_t *entry);
   bool send_req(vp::io_req *req);
 
   static vp::io_req_status_e req(void *__this, vp::io_req *req);
@@ -45,6 +69,8 @@ public:
 private:
 
   void do_io_req(uint64_t addr, uint64_t size, bool is_write, uint8_t *data);
+  void load_area(uint64_t addr, const uint8_t *src, uint64_t size, std::vector<loader_copy_t> *copies);
+  static void copy(loader_copy_t *copy);
   std::list<vp::io_req *> pending_reqs;
   vp::trace     trace;
   vp::io_master out;
@@ -135,10 +161,204 @@ void loader::memset(uint64_t addr, uint64_t size, uint8_t value)
 {
   trace.msg("Padding section (base: 0x%x, size: 0x%x, value: %d)\n", addr, size, value);
 
-  uint8_t data[size];
-  ::memset((void *)data, value, size);
+  std::vector<uint8_t> data(size, value);
+
+  this->do_io_req(addr, size, true, data.data());
+}
+
+void loader::copy(loader_copy_t *copy)
+{
+  if (copy->src)
+  {
+    ::memcpy(copy->dest, copy->src, copy->size);
+    return;
+  }
+
+  // Whole pages are dropped instead of being written, the storage of the
+  // backdoor targets being anonymous mappings, they are then zero pages
+  // allocated only when the simulation accesses them
+  uintptr_t page_size = getpagesize();
+  uint8_t *end = copy->dest + copy->size;
+  uint8_t *first_page = (uint8_t *)(((uintptr_t)copy->dest + page_size - 1) & ~(page_size - 1));
+  uint8_t *last_page = (uint8_t *)((uintptr_t)end & ~(page_size - 1));
+
+  if (first_page < last_page && madvise(first_page, last_page - first_page, MADV_DONTNEED) == 0)
+  {
+    ::memset(copy->dest, 0, first_page - copy->dest);
+    ::memset(last_page, 0, end - last_page);
+  }
+  else
+  {
+    ::memset(copy->dest, 0, copy->size);
+  }
+}
+
+// Writes an area of a segment, or zero-fills it if there is no source.
+// The targets are asked through backdoor requests for their storage, so that
+// the area is copied directly and possibly by several threads, and areas
+// going to targets not supporting them are sent as normal requests.
+void loader::load_area(uint64_t addr, const uint8_t *src, uint64_t size, std::vector<loader_copy_t> *copies)
+{
+  while (size)
+  {
+    vp::io_req req;
+    req.init();
+    req.set_backdoor(true);
+    req.set_addr(addr);
+    req.set_size(0);
+    req.set_is_write(true);
+    req.set_data(NULL);
+
+    uint64_t area_size = size;
+
+    if (this->out.req(&req) == vp::IO_REQ_OK && req.get_data() != NULL && req.get_actual_size() != 0)
+    {
+      area_size = std::min(size, req.get_actual_size());
+
+      trace.msg("Loading area through backdoor (base: 0x%lx, size: 0x%lx, zero: %d)\n", addr, area_size, src == NULL);
+
+      for (uint64_t offset=0; offset<area_size; offset+=LOADER_CHUNK_SIZE)
+      {
+        loader_copy_t copy = { req.get_data() + offset, src ? src + offset : NULL, std::min(area_size - offset, (uint64_t)LOADER_CHUNK_SIZE) };
+        if (copies)
+          copies->push_back(copy);
+        else
+          loader::copy(&copy);
+      }
+    }
+    else if (src)
+    {
+      this->io_req(addr, size, true, (uint8_t *)src);
+    }
+    else
+    {
+      this->memset(addr, size, 0);
+    }
+
+    addr += area_size;
+    if (src)
+      src += area_size;
+    size -= area_size;
+  }
+}
+
+int loader::load_elf(const char *path, uint64_t *entry)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st))
+  {
+    this->warning.force_warning("Unable to open binary (path: %s, error: %s)\n", path, strerror(errno));
+    if (fd != -1)
+      close(fd);
+    return -1;
+  }
+
+  uint64_t size = st.st_size;
+  const uint8_t *elf = size ? (const uint8_t *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+
+  if (elf == MAP_FAILED)
+  {
+    this->warning.force_warning("Unable to map binary (path: %s, error: %s)\n", path, strerror(errno));
+    return -1;
+  }
+
+  bool is_64 = size >= EI_NIDENT && elf[EI_CLASS] == ELFCLASS64;
+  if (size < EI_NIDENT || memcmp(elf, ELFMAG, SELFMAG) != 0 || size < (is_64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr)))
+  {
+    this->warning.force_warning("Invalid ELF binary (path: %s)\n", path);
+    if (elf)
+      munmap((void *)elf, size);
+    return -1;
+  }
+
+  *entry = is_64 ? ((Elf64_Ehdr *)elf)->e_entry : ((Elf32_Ehdr *)elf)->e_entry;
+  uint64_t phoff = is_64 ? ((Elf64_Ehdr *)elf)->e_phoff : ((Elf32_Ehdr *)elf)->e_phoff;
+  int phnum = is_64 ? ((Elf64_Ehdr *)elf)->e_phnum : ((Elf32_Ehdr *)elf)->e_phnum;
+  uint64_t phsize = is_64 ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+
+  typedef struct { uint64_t paddr; uint64_t offset; uint64_t filesz; uint64_t memsz; } segment_t;
+  std::vector<segment_t> segments;
+  uint64_t total_size = 0;
+
+  for (int i=0; i<phnum; i++)
+  {
+    if (phoff + (i + 1) * phsize > size)
+      break;
+
+    segment_t segment;
+    uint32_t type;
+    if (is_64)
+    {
+      const Elf64_Phdr *phdr = (const Elf64_Phdr *)(elf + phoff) + i;
+      type = phdr->p_type; segment = { phdr->p_paddr, phdr->p_offset, phdr->p_filesz, phdr->p_memsz };
+    }
+    else
+    {
+      const Elf32_Phdr *phdr = (const Elf32_Phdr *)(elf + phoff) + i;
+      type = phdr->p_type; segment = { phdr->p_paddr, phdr->p_offset, phdr->p_filesz, phdr->p_memsz };
+    }
+
+    if (type != PT_LOAD)
+      continue;
+
+    if (segment.offset > size || segment.filesz > size - segment.offset)
+    {
+      this->warning.force_warning("Truncated ELF binary (path: %s)\n", path);
+      munmap((void *)elf, size);
+      return -1;
+    }
+
+    segments.push_back(segment);
+    total_size += std::max(segment.filesz, segment.memsz);
+  }
+
+  // Segments can only be loaded in parallel if they don't overlap, otherwise
+  // they are loaded in order
+  std::vector<segment_t> sorted = segments;
+  std::sort(sorted.begin(), sorted.end(), [](const segment_t &a, const segment_t &b) { return a.paddr < b.paddr; });
+  bool parallel = total_size >= LOADER_PARALLEL_MIN_SIZE;
+  for (size_t i=1; i<sorted.size(); i++)
+  {
+    if (sorted[i].paddr < sorted[i-1].paddr + std::max(sorted[i-1].filesz, sorted[i-1].memsz))
+      parallel = false;
+  }
+
+  std::vector<loader_copy_t> copies;
+
+  for (auto &segment: segments)
+  {
+    trace.msg("Loading segment (base: 0x%lx, file size: 0x%lx, memory size: 0x%lx)\n", segment.paddr, segment.filesz, segment.memsz);
+
+    this->load_area(segment.paddr, elf + segment.offset, segment.filesz, parallel ? &copies : NULL);
+    if (segment.filesz < segment.memsz)
+      this->load_area(segment.paddr + segment.filesz, NULL, segment.memsz - segment.filesz, parallel ? &copies : NULL);
+  }
+
+  if (copies.size())
+  {
+    std::atomic<size_t> next(0);
+    int nb_threads = std::min((size_t)std::max(std::thread::hardware_concurrency(), 1U), copies.size());
+    std::vector<std::thread> threads;
 
-  this->do_io_req(addr, size, true, data);
+    for (int i=0; i<nb_threads; i++)
+    {
+      threads.push_back(std::thread([&copies, &next]() {
+        size_t index;
+        while ((index = next++) < copies.size())
+          loader::copy(&copies[index]);
+      }));
+    }
+
+    for (auto &thread: threads)
+      thread.join();
+  }
+
+  if (elf)
+    munmap((void *)elf, size);
+
+  return 0;
 }
 
 extern "C" void loader_io_req(void *__this, uint64_t addr, uint64_t size, bool is_write, uint8_t *data)
@@ -153,6 +373,12 @@ extern "C" void loader_memset(void *__this, uint64_t addr, uint64_t size, uint8_
   _this->memset(addr, size, value);
 }
 
+extern "C" int loader_load_elf(void *__this, const char *path, uint64_t *entry)
+{
+  loader *_this = (loader *)__this;
+  return _this->load_elf(path, entry);
+}
+
 extern "C" void *vp_constructor(const char *config)
 {
   return (void *)new loader(config);
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+
+// This model sends bulk requests through the router and the interleaver to
+// targets which do not support them, and checks that their segments are all
+// handled and that the segments of the caller are left untouched.
+// With the pending property, it instead sends one to a target replying
+// asynchronously, which must stop the simulation with a fatal error.
+
+#include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
+#include <stdio.h>
+#include <string.h>
+
+
+class master : public vp::component
+{
+
+public:
+
+  master(const char *config);
+
+  int build();
+
+  void start();
+
+  static void test(void *_this, vp::clock_event *event);
+
+  static void resp(void *_this, vp::io_req *req);
+
+private:
+
+  // Send a bulk request with the specified segments and check that it is
+  // handled synchronously without modifying them
+  bool bulk(vp::io_req_segment_t *segments, int nb_segments, bool is_write);
+
+  // Read back with a normal request what a bulk write stored
+  bool check(uint64_t addr, const char *expected, uint64_t size);
+
+  vp::trace     trace;
+  vp::io_master out;
+  bool pending;
+};
+
+bool master::bulk(vp::io_req_segment_t *segments, int nb_segments, bool is_write)
+{
+  vp::io_req_segment_t init_segments[nb_segments];
+  uint64_t size = 0;
+
+  for (int i=0; i<nb_segments; i++)
+  {
+    init_segments[i] = segments[i];
+    size += segments[i].size;
+  }
+
+  vp::io_req *req = this->out.req_new(segments[0].addr, segments[0].data, size, is_write);
+  req->set_segments(segments, nb_segments);
+
+  vp::io_req_status_e status = this->out.req(req);
+  bool ok = status == vp::IO_REQ_OK && req->get_segments() == segments && req->get_nb_segments() == nb_segments;
+
+  for (int i=0; i<nb_segments; i++)
+  {
+    if (segments[i].addr != init_segments[i].addr || segments[i].data != init_segments[i].data || segments[i].size != init_segments[i].size)
+      ok = false;
+  }
+
+  if (!ok)
+    printf("Bulk request failed or modified its segments (status: %d, addr: 0x%llx, nb_segments: %d)\n", status, (unsigned long long)segments[0].addr, nb_segments);
+
+  this->out.req_del(req);
+
+  return ok;
+}
+
+bool master::check(uint64_t addr, const char *expected, uint64_t size)
+{
+  uint8_t data[size];
+  vp::io_req *req = this->out.req_new(addr, data, size, false);
+  vp::io_req_status_e status = this->out.req(req);
+  this->out.req_del(req);
+
+  if (status != vp::IO_REQ_OK || memcmp(data, expected, size) != 0)
+  {
+    printf("Wrong data read back (status: %d, addr: 0x%llx, size: 0x%llx)\n", status, (unsigned long long)addr, (unsigned long long)size);
+    return false;
+  }
+
+  return true;
+}
+
+void master::test(void *__this, vp::clock_event *event)
+{
+  master *_this = (master *)__this;
+  bool ok = true;
+  uint8_t data[] = "abcdefghijklmnopqrstuvwx";
+
+  _this->event_del(event);
+
+  if (_this->pending)
+  {
+    vp::io_req_segment_t segments[] = {
+      { 0x3000, &data[0], 4 },
+      { 0x3010, &data[4], 4 },
+    };
+
+    _this->bulk(segments, 2, true);
+
+    printf("Asynchronous segment was not rejected\n");
+    exit(1);
+  }
+
+  // Both segments go to the same entry, which removes an offset
+  {
+    vp::io_req_segment_t segments[] = {
+      { 0x1010, &data[0], 4 },
+      { 0x1020, &data[4], 4 },
+    };
+
+    ok &= _this->bulk(segments, 2, true);
+    ok &= _this->check(0x1010, "abcd", 4);
+    ok &= _this->check(0x1020, "efgh", 4);
+  }
+
+  // The segments are routed to different entries, and the second one is
+  // split by the interleaver into one bulk request per bank
+  {
+    vp::io_req_segment_t segments[] = {
+      { 0x1030, &data[8], 4 },
+      { 0x2000, &data[12], 12 },
+    };
+
+    ok &= _this->bulk(segments, 2, true);
+    ok &= _this->check(0x1030, "ijkl", 4);
+    ok &= _this->check(0x2000, "mnopqrstuvwx", 12);
+    ok &= _this->check(0x2004, "qrst", 4);
+  }
+
+  // Bulk reads going through the interleaver
+  {
+    uint8_t read_data[8];
+    vp::io_req_segment_t segments[] = {
+      { 0x2004, &read_data[0], 4 },
+      { 0x2000, &read_data[4], 4 },
+    };
+
+    ok &= _this->bulk(segments, 2, false);
+    if (memcmp(read_data, "qrstmnop", 8) != 0)
+    {
+      printf("Wrong data read with a bulk request\n");
+      ok = false;
+    }
+  }
+
+  printf("Bulk requests: %s\n", ok ? "OK" : "FAILED");
+  exit(ok ? 0 : 1);
+}
+
+void master::resp(void *_this, vp::io_req *req)
+{
+}
+
+int master::build()
+{
+  traces.new_trace("trace", &trace, vp::DEBUG);
+
+  pending = get_config_bool("pending");
+
+  out.set_resp_meth(&master::resp);
+  new_master_port("out", &out);
+
+  return 0;
+}
+
+void master::start()
+{
+  event_enqueue(event_new(master::test), 1);
+}
+
+master::master(const char *config)
+: vp::component(config)
+{
+}
+
+extern "C" void *vp_constructor(const char *config)
+{
+  return (void *)new master(config);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+
+// Memory which does not support bulk requests, so that the segments of the
+// bulk requests it receives are sent to it one by one.
+// It can also reply asynchronously to check that such a target is rejected.
+
+#include <vp/vp.hpp>
+#include <vp/itf/io.hpp>
+#include <stdio.h>
+#include <string.h>
+
+
+class target : public vp::component
+{
+
+public:
+
+  target(const char *config);
+
+  int build();
+
+  static vp::io_req_status_e req(void *__this, vp::io_req *req);
+
+  static void send_resp(void *_this, vp::clock_event *event);
+
+private:
+
+  vp::io_slave in;
+  vp::trace    trace;
+
+  uint64_t size;
+  uint8_t *data;
+  bool pending;
+};
+
+void target::send_resp(void *__this, vp::clock_event *event)
+{
+  target *_this = (target *)__this;
+  vp::io_req *req = (vp::io_req *)event->get_args()[0];
+  _this->event_del(event);
+  req->get_resp_port()->resp(req);
+}
+
+vp::io_req_status_e target::req(void *__this, vp::io_req *req)
+{
+  target *_this = (target *)__this;
+  uint64_t offset = req->get_addr();
+  uint64_t size = req->get_size();
+
+  _this->trace.msg("Received IO req (offset: 0x%llx, size: 0x%llx, is_write: %d)\n", offset, size, req->get_is_write());
+
+  if (req->is_bulk() || offset + size > _this->size)
+    return vp::IO_REQ_INVALID;
+
+  if (req->get_is_write())
+    memcpy(&_this->data[offset], req->get_data(), size);
+  else
+    memcpy(req->get_data(), &_this->data[offset], size);
+
+  if (_this->pending)
+  {
+    _this->event_enqueue(_this->event_new(target::send_resp, req), 1);
+    return vp::IO_REQ_PENDING;
+  }
+
+  return vp::IO_REQ_OK;
+}
+
+int target::build()
+{
+  traces.new_trace("trace", &trace, vp::DEBUG);
+
+  size = get_config_int("size");
+  pending = get_config_bool("pending");
+  data = new uint8_t[size];
+  memset(data, 0, size);
+
+  in.set_req_meth(&target::req);
+  new_slave_port("in", &in);
+
+  return 0;
+}
+
+target::target(const char *config)
+: vp::component(config)
+{
+}
+
+extern "C" void *vp_constructor(const char *config)
+{
+  return (void *)new target(config);
+}
@@ -0,0 +1,53 @@
+#
+# Copyright (C) 2018 ETH Zurich and University of Bologna
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ 
+import vp_core as vp
+
+class component(vp.component):
+
+    def build(self):
+
+        clock = self.new('clock', component='vp/clock_domain', config=self.get_config().get_config('clock_domain'))
+
+        master = self.new('master', component='master', config=self.get_config('master'))
+
+        ico = self.new('ico', component='interco/router', config=self.get_config('ico'))
+
+        ilv = self.new('ilv', component='interco/interleaver', config=self.get_config('ilv'))
+
+        mem = self.new('mem', component='target', config=self.get_config('mem'))
+        bank0 = self.new('bank0', component='target', config=self.get_config('bank'))
+        bank1 = self.new('bank1', component='target', config=self.get_config('bank'))
+        pending = self.new('pending', component='target', config=self.get_config('pending'))
+
+        master.get_port('out').bind_to(ico.get_port('in'))
+
+        ico.get_port('mem').bind_to(mem.get_port('in'))
+        ico.get_port('ilv').bind_to(ilv.get_port('in_0'))
+        ico.get_port('pending').bind_to(pending.get_port('in'))
+
+        ilv.get_port('out_0').bind_to(bank0.get_port('in'))
+        ilv.get_port('out_1').bind_to(bank1.get_port('in'))
+
+        clock.get_port('out').bind_to(master.get_port('clock'))
+        clock.get_port('out').bind_to(ico.get_port('clock'))
+        clock.get_port('out').bind_to(ilv.get_port('clock'))
+        clock.get_port('out').bind_to(mem.get_port('clock'))
+        clock.get_port('out').bind_to(bank0.get_port('clock'))
+        clock.get_port('out').bind_to(bank1.get_port('clock'))
+        clock.get_port('out').bind_to(pending.get_port('clock'))
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks the victims selected by the cache replacement policies against
+// straightforward models of them, for the specialized geometries and for
+// the generic path, including the biggest number of ways each policy
+// supports.
+
+#include "unit_test.hpp"
+#include "cache_core.hpp"
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#define TEST_NB_SETS_BITS 2
+#define TEST_NB_STEPS     20000
+
+
+// Ways ordered from the least to the most recently used. After a flush, the
+// storage considers way 0 as the least recently used one.
+class lru_model
+{
+public:
+  lru_model(int nb_ways)
+  {
+    for (int i=0; i<nb_ways; i++)
+      this->order.push_back(i);
+  }
+
+  void touch(int way)
+  {
+    this->order.erase(std::find(this->order.begin(), this->order.end(), way));
+    this->order.push_back(way);
+  }
+
+  int victim() { return this->order.front(); }
+
+private:
+  std::vector<int> order;
+};
+
+
+// One flag per tree node, telling if the victim is in the upper half below
+// it. Nodes are numbered as a heap, root being node 1.
+class plru_model
+{
+public:
+  plru_model(int nb_ways_bits) : nb_ways_bits(nb_ways_bits), upper(2 << nb_ways_bits, false) {}
+
+  void touch(int way)
+  {
+    int node = 1;
+    for (int level=this->nb_ways_bits-1; level>=0; level--)
+    {
+      bool is_upper = (way >> level) & 1;
+      this->upper[node] = !is_upper;
+      node = node * 2 + is_upper;
+    }
+  }
+
+  int victim()
+  {
+    int node = 1;
+    for (int level=0; level<this->nb_ways_bits; level++)
+      node = node * 2 + this->upper[node];
+    return node - (1 << this->nb_ways_bits);
+  }
+
+private:
+  int nb_ways_bits;
+  std::vector<bool> upper;
+};
+
+
+// 8 bits LFSR used on GAP FC icache, as the cache model did before it was
+// specialized
+class random_model
+{
+public:
+  random_model(int nb_ways) : nb_ways(nb_ways) {}
+
+  void touch(int way) {}
+
+  int victim()
+  {
+    int feedback = !(((this->lfsr >> 7) & 1) ^ ((this->lfsr >> 3) & 1) ^ ((this->lfsr >> 2) & 1) ^ ((this->lfsr >> 1) & 1));
+    this->lfsr = (this->lfsr << 1) | (feedback & 1);
+    return (this->lfsr >> 1) & (this->nb_ways - 1);
+  }
+
+private:
+  int nb_ways;
+  uint8_t lfsr = 0;
+};
+
+
+static uint32_t rand_state = 1;
+
+static uint32_t get_rand()
+{
+  rand_state = rand_state * 1103515245 + 12345;
+  return rand_state >> 8;
+}
+
+
+// Replays the same accesses on the storage and on one model per set. Each
+// step either touches a random way, as for a hit, or refills the victim, as
+// for a miss.
+template<int LINE_SIZE_BITS, int NB_WAYS_BITS, cache_replacement_e REPLACEMENT, class MODEL>
+static void test_policy(const char *name, int line_size_bits, int nb_ways_bits)
+{
+  typedef cache_access<LINE_SIZE_BITS, NB_WAYS_BITS, REPLACEMENT> access;
+
+  cache_storage c(TEST_NB_SETS_BITS, nb_ways_bits, line_size_bits);
+  int nb_ways = 1 << nb_ways_bits;
+  bool generic = NB_WAYS_BITS == CACHE_GENERIC;
+
+  std::vector<MODEL> models;
+  for (unsigned int i=0; i<c.nb_sets; i++)
+    models.push_back(REPLACEMENT == CACHE_REPLACEMENT_PLRU ? MODEL(nb_ways_bits) : MODEL(nb_ways));
+
+  // A miss in the random policy does not depend on the set, the same model
+  // is used for all of them
+  MODEL *random = &models[0];
+
+  for (int step=0; step<TEST_NB_STEPS; step++)
+  {
+    unsigned int set = get_rand() & (c.nb_sets - 1);
+    MODEL *model = REPLACEMENT == CACHE_REPLACEMENT_RANDOM ? random : &models[set];
+    int way;
+
+    if (get_rand() % 3 == 0)
+    {
+      way = access::victim(&c, set);
+      int expected = model->victim();
+      CHECK(way == expected, "wrong victim (policy: %s, ways: %d, generic: %d, step: %d, expected: %d, got: %d)",
+        name, nb_ways, generic, step, expected, way);
+      if (way != expected)
+        return;
+    }
+    else
+    {
+      way = get_rand() & (nb_ways - 1);
+    }
+
+    access::touch(&c, set, way);
+    model->touch(way);
+
+    // With several ways, the line which has just been accessed is never the
+    // next one to be replaced
+    if (REPLACEMENT != CACHE_REPLACEMENT_RANDOM && nb_ways > 1)
+    {
+      CHECK(models[set].victim() != way, "model selects the last accessed way (policy: %s)", name);
+    }
+  }
+
+  // Refilling a flushed set replaces each way once before any of them is
+  // replaced again
+  c.flush();
+  if (REPLACEMENT != CACHE_REPLACEMENT_RANDOM)
+  {
+    std::vector<bool> refilled(nb_ways, false);
+    for (int i=0; i<nb_ways; i++)
+    {
+      int way = access::victim(&c, 0);
+      CHECK(!refilled[way], "way replaced twice after flush (policy: %s, ways: %d, generic: %d, way: %d)",
+        name, nb_ways, generic, way);
+      refilled[way] = true;
+      access::touch(&c, 0, way);
+    }
+  }
+}
+
+template<cache_replacement_e REPLACEMENT, class MODEL>
+static void test_geometries(const char *name, int max_nb_ways_bits)
+{
+#define CACHE_GEOMETRY_TEST(line_bits, ways_bits) \
+  test_policy<line_bits, ways_bits, REPLACEMENT, MODEL>(name, line_bits, ways_bits); \
+  test_policy<CACHE_GENERIC, CACHE_GENERIC, REPLACEMENT, MODEL>(name, line_bits, ways_bits);
+
+  CACHE_GEOMETRIES(CACHE_GEOMETRY_TEST)
+
+#undef CACHE_GEOMETRY_TEST
+
+  // Only the generic path handles the bigger caches
+  for (int ways_bits=4; ways_bits<=max_nb_ways_bits; ways_bits++)
+  {
+    test_policy<CACHE_GENERIC, CACHE_GENERIC, REPLACEMENT, MODEL>(name, 4, ways_bits);
+  }
+}
+
+
+int main()
+{
+  // These are the biggest numbers of ways accepted by the cache model
+  test_geometries<CACHE_REPLACEMENT_LRU, lru_model>("lru", 8);
+  test_geometries<CACHE_REPLACEMENT_PLRU, plru_model>("plru", 5);
+  test_geometries<CACHE_REPLACEMENT_RANDOM, random_model>("random", 8);
+
+  return unit_test_exit();
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks that the config index resolves paths to the same configs as
+// get_from_list, first on a small tree where "*" and "**" have several
+// candidates, and then on random trees, from every node and with random
+// paths, including lookups from a subtree before its root is indexed.
+
+#include "unit_test.hpp"
+#include <vp/config.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include <algorithm>
+
+
+static const char *keys[] = { "a", "b", "c", "d", "e" };
+#define NB_KEYS (sizeof(keys) / sizeof(keys[0]))
+
+static uint32_t rand_state = 1;
+
+static uint32_t get_rand(uint32_t max)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+  return (rand_state >> 8) % max;
+}
+
+
+static void add_token(std::vector<jsmntok_t> &tokens, jsmntype_t type, int size, const char *str)
+{
+  jsmntok_t tok;
+  memset(&tok, 0, sizeof(tok));
+  tok.type = type;
+  tok.size = size;
+  tok.str = strdup(str);
+  tokens.push_back(tok);
+}
+
+// Tokens of a random object, as the JSON parser would give them, with
+// distinct keys taken from a small set so that the same key appears at
+// several places
+static void gen_object(std::vector<jsmntok_t> &tokens, int depth)
+{
+  std::vector<const char *> childs(keys, keys + NB_KEYS);
+  for (int i=NB_KEYS-1; i>0; i--)
+    std::swap(childs[i], childs[get_rand(i + 1)]);
+  childs.resize(depth == 0 ? 0 : get_rand(NB_KEYS));
+
+  add_token(tokens, JSMN_OBJECT, childs.size(), "");
+
+  for (auto key: childs)
+  {
+    add_token(tokens, JSMN_STRING, 0, key);
+
+    switch (get_rand(5))
+    {
+      case 0:
+        add_token(tokens, JSMN_STRING, 0, key);
+        break;
+      case 1:
+        add_token(tokens, JSMN_PRIMITIVE, 0, "12");
+        break;
+      case 2:
+        add_token(tokens, JSMN_ARRAY, 1, "");
+        add_token(tokens, JSMN_PRIMITIVE, 0, "true");
+        break;
+      default:
+        gen_object(tokens, depth - 1);
+        break;
+    }
+  }
+}
+
+static vp::config *build_config(std::vector<jsmntok_t> &tokens)
+{
+  return new vp::config_object(tokens.data());
+}
+
+static void get_nodes(vp::config *config, std::vector<vp::config *> &nodes)
+{
+  nodes.push_back(config);
+  for (auto &x: config->get_childs())
+    get_nodes(x.second, nodes);
+}
+
+static std::vector<std::string> split(const std::string &path)
+{
+  std::vector<std::string> tokens;
+  std::string token;
+  std::istringstream stream(path);
+  while (std::getline(stream, token, '/'))
+    tokens.push_back(token);
+  return tokens;
+}
+
+static std::string gen_path()
+{
+  std::string path;
+  int len = 1 + get_rand(4);
+  for (int i=0; i<len; i++)
+  {
+    int kind = get_rand(NB_KEYS + 3);
+    const char *name = kind < (int)NB_KEYS ? keys[kind] : kind == NB_KEYS ? "*" : kind == NB_KEYS + 1 ? "**" : "z";
+    path += (i == 0 ? "" : "/") + std::string(name);
+  }
+  return path;
+}
+
+static void check_lookup(vp::config_index *index, vp::config *config, const std::string &path)
+{
+  vp::config *expected = config->get_from_list(split(path));
+  vp::config *result = index->get(config, path);
+  CHECK(result == expected, "wrong result (path: %s, expected: %p, got: %p)", path.c_str(), expected, result);
+}
+
+
+// Small tree where get_from_list takes the first match in key order, at any
+// depth, so that "**/b" returns a nested node before the direct one
+static void test_order()
+{
+  std::vector<jsmntok_t> tokens;
+  add_token(tokens, JSMN_OBJECT, 3, "");
+  add_token(tokens, JSMN_STRING, 0, "a");
+    add_token(tokens, JSMN_OBJECT, 2, "");
+    add_token(tokens, JSMN_STRING, 0, "x");
+      add_token(tokens, JSMN_OBJECT, 1, "");
+      add_token(tokens, JSMN_STRING, 0, "b");
+      add_token(tokens, JSMN_STRING, 0, "nested");
+    add_token(tokens, JSMN_STRING, 0, "y");
+      add_token(tokens, JSMN_OBJECT, 1, "");
+      add_token(tokens, JSMN_STRING, 0, "c");
+      add_token(tokens, JSMN_PRIMITIVE, 0, "3");
+  add_token(tokens, JSMN_STRING, 0, "b");
+  add_token(tokens, JSMN_STRING, 0, "direct");
+  add_token(tokens, JSMN_STRING, 0, "c");
+    add_token(tokens, JSMN_OBJECT, 1, "");
+    add_token(tokens, JSMN_STRING, 0, "b");
+    add_token(tokens, JSMN_STRING, 0, "last");
+
+  vp::config *root = build_config(tokens);
+  vp::config_index index;
+
+  vp::config *result = index.get(root, "**/b");
+  CHECK(result && result->get_str() == "nested", "wrong result for **/b (got: %s)", result ? result->get_str().c_str() : "NULL");
+
+  result = index.get(root, "b");
+  CHECK(result && result->get_str() == "direct", "wrong result for b (got: %s)", result ? result->get_str().c_str() : "NULL");
+
+  // As for "**", the element following "*" is also matched against the
+  // childs themselves
+  result = index.get(root, "*/b");
+  CHECK(result && result->get_str() == "direct", "wrong result for */b (got: %s)", result ? result->get_str().c_str() : "NULL");
+
+  result = index.get(root, "c/*/b");
+  CHECK(result && result->get_str() == "last", "wrong result for c/*/b (got: %s)", result ? result->get_str().c_str() : "NULL");
+
+  result = index.get(root, "**/y/c");
+  CHECK(result && result->get_int() == 3, "wrong result for **/y/c");
+
+  CHECK(index.get(root, "**/x/c") == NULL, "unexpected result for **/x/c");
+  CHECK(index.get(root, "a/**/b") != NULL, "no result for a/**/b");
+
+  const char *paths[] = { "", "**", "*", "**/**/b", "*/*/b", "**/*/b", "*/**/c", "a/*", "a/**", "**/z", "z/**", "b/**" };
+  for (auto path: paths)
+  {
+    check_lookup(&index, root, path);
+  }
+}
+
+
+// Random trees, looked up from every node, in a random order, so that
+// subtrees are sometimes indexed before their root. The engine index used
+// by config_object::get is checked as well.
+static void test_random()
+{
+  for (int tree=0; tree<50; tree++)
+  {
+    std::vector<jsmntok_t> tokens;
+    gen_object(tokens, 5);
+    vp::config *root = build_config(tokens);
+
+    std::vector<vp::config *> nodes;
+    get_nodes(root, nodes);
+    for (int i=nodes.size()-1; i>0; i--)
+      std::swap(nodes[i], nodes[get_rand(i + 1)]);
+
+    std::vector<std::string> paths;
+    for (int i=0; i<40; i++)
+      paths.push_back(gen_path());
+
+    vp::config_index index;
+
+    for (auto node: nodes)
+    {
+      for (auto &path: paths)
+      {
+        check_lookup(&index, node, path);
+
+        vp::config *expected = node->get_from_list(split(path));
+        CHECK(node->get(path) == expected, "wrong result from config::get (path: %s)", path.c_str());
+      }
+    }
+
+    if (nb_errors)
+      return;
+  }
+}
+
+
+int main()
+{
+  test_order();
+  test_random();
+
+  return unit_test_exit();
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks the cycles at which the DRAM controller completes fixed traces,
+// covering row hits, misses and conflicts, writes, the shared data bus, the
+// schedulers, the page policies and refresh. Timings are small and all
+// different so that the expected cycles can be derived by hand from the
+// command sequence. Each trace is replayed by stepping the controller on
+// every cycle, and by only stepping it on the cycles it returns, which must
+// give the same result.
+
+#include "unit_test.hpp"
+#include "dram_core.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Addresses are mapped as row:bank:column, with 2 banks of 256-byte rows
+#define ROW(bank, row) (((row) * 2 + (bank)) * 256)
+
+
+typedef struct
+{
+  int64_t cycle;
+  uint64_t addr;
+  bool is_write;
+  // Cycle where the data transfer of the request must be over
+  int64_t expected_end;
+  int64_t end;
+} test_req_t;
+
+typedef struct
+{
+  int64_t nb_row_hits;
+  int64_t nb_row_misses;
+  int64_t nb_row_conflicts;
+  int64_t nb_refreshes;
+} test_stats_t;
+
+
+static dram_config_t get_config(dram_scheduler_e scheduler, dram_page_policy_e page_policy, int tREFI)
+{
+  dram_config_t config;
+  config.nb_banks = 2;
+  config.row_size = 256;
+  config.burst_size = 64;
+  config.queue_size = 16;
+  config.max_row_hits = 16;
+  config.page_policy = page_policy;
+  config.scheduler = scheduler;
+  config.tRCD = 3;
+  config.tRP = 4;
+  config.tRAS = 8;
+  config.tRTP = 2;
+  config.tCL = 5;
+  config.tWL = 4;
+  config.tWR = 3;
+  config.tRFC = 20;
+  config.tREFI = tREFI;
+  config.tBURST = 2;
+  return config;
+}
+
+static void done(void *_this, void *ctx, int64_t end_cycle)
+{
+  ((test_req_t *)ctx)->end = end_cycle;
+}
+
+// Requests are queued in trace order, at their cycle
+static void replay(const char *name, dram_config_t *config, test_req_t *reqs, int nb_reqs,
+  test_stats_t *expected, bool every_cycle)
+{
+  dram_controller controller(config, done, NULL);
+
+  for (int i=0; i<nb_reqs; i++)
+    reqs[i].end = -1;
+
+  int next_req = 0;
+  int64_t cycle = 0;
+  while (next_req < nb_reqs || !controller.is_empty())
+  {
+    while (next_req < nb_reqs && reqs[next_req].cycle <= cycle && !controller.is_full())
+    {
+      test_req_t *req = &reqs[next_req++];
+      controller.push(req->addr, config->burst_size, req->is_write, req, cycle);
+    }
+
+    int64_t next = controller.step(cycle);
+
+    if (every_cycle)
+    {
+      cycle++;
+      continue;
+    }
+
+    if (next_req < nb_reqs)
+    {
+      int64_t arrival = reqs[next_req].cycle > cycle ? reqs[next_req].cycle : cycle + 1;
+      if (next == -1 || arrival < next)
+        next = arrival;
+    }
+
+    CHECK(next > cycle, "controller did not advance (test: %s, cycle: %ld)", name, cycle);
+    if (next <= cycle)
+      return;
+    cycle = next;
+  }
+
+  for (int i=0; i<nb_reqs; i++)
+  {
+    CHECK(reqs[i].end == reqs[i].expected_end, "wrong end cycle (test: %s, every cycle: %d, request: %d, expected: %ld, got: %ld)",
+      name, every_cycle, i, reqs[i].expected_end, reqs[i].end);
+  }
+
+  dram_stats_t *stats = &controller.stats;
+  CHECK(stats->nb_row_hits == expected->nb_row_hits && stats->nb_row_misses == expected->nb_row_misses &&
+    stats->nb_row_conflicts == expected->nb_row_conflicts && stats->nb_refreshes == expected->nb_refreshes,
+    "wrong stats (test: %s, every cycle: %d, hits: %ld/%ld, misses: %ld/%ld, conflicts: %ld/%ld, refreshes: %ld/%ld)",
+    name, every_cycle, stats->nb_row_hits, expected->nb_row_hits, stats->nb_row_misses, expected->nb_row_misses,
+    stats->nb_row_conflicts, expected->nb_row_conflicts, stats->nb_refreshes, expected->nb_refreshes);
+}
+
+static void test_trace(const char *name, dram_config_t config, test_req_t *reqs, int nb_reqs, test_stats_t expected)
+{
+  replay(name, &config, reqs, nb_reqs, &expected, false);
+  replay(name, &config, reqs, nb_reqs, &expected, true);
+}
+
+
+// Isolated accesses, one at a time
+static void test_accesses()
+{
+  test_req_t reqs[] = {
+    // Miss: ACT at 0, RD at 0 + tRCD, data at 3 + tCL during tBURST
+    { 0, ROW(0, 0), false, 10 },
+    // Hit on the open row: RD at 20
+    { 20, ROW(0, 0) + 64, false, 27 },
+    // Conflict: PRE at 40, ACT at 40 + tRP, RD at 44 + tRCD
+    { 40, ROW(0, 1), false, 54 },
+    // Write miss on the other bank: ACT at 60, WR at 63, data at 63 + tWL
+    { 60, ROW(1, 0), true, 69 },
+  };
+
+  test_trace("accesses", get_config(DRAM_SCHEDULER_FCFS, DRAM_PAGE_OPEN, 0), reqs, 4, { 1, 2, 1, 0 });
+}
+
+// Accesses to both banks at the same cycle, the second one waits for the
+// data bus. FR-FCFS is used so that the second bank can be activated while
+// the first one is waiting for tRCD.
+static void test_data_bus()
+{
+  test_req_t reqs[] = {
+    { 0, ROW(0, 0), false, 10 },
+    { 0, ROW(1, 0), false, 12 },
+    // RD at 30, data from 35 to 37, the second RD is delayed to 32
+    { 30, ROW(0, 0) + 64, false, 37 },
+    { 30, ROW(1, 0) + 64, false, 39 },
+  };
+
+  // The second ACT is issued at 1, its RD at 4 is delayed to 5 by the bus
+  test_trace("data bus", get_config(DRAM_SCHEDULER_FR_FCFS, DRAM_PAGE_OPEN, 0), reqs, 4, { 2, 2, 0, 0 });
+}
+
+// A hit queued after a conflict on the same bank
+static void test_schedulers()
+{
+  // FR-FCFS serves the hit at 20, then PRE at 22 when tRTP allows it, ACT
+  // at 26 and RD at 29
+  test_req_t fr_fcfs_reqs[] = {
+    { 0, ROW(0, 0), false, 10 },
+    { 20, ROW(0, 1), false, 36 },
+    { 20, ROW(0, 0) + 64, false, 27 },
+  };
+
+  test_trace("fr-fcfs", get_config(DRAM_SCHEDULER_FR_FCFS, DRAM_PAGE_OPEN, 0), fr_fcfs_reqs, 3, { 1, 1, 1, 0 });
+
+  // FCFS closes the row at 20 for the conflict, RD at 27, and the former hit
+  // is now a conflict, with PRE at 32 when tRAS allows it, ACT at 36 and RD
+  // at 39
+  test_req_t fcfs_reqs[] = {
+    { 0, ROW(0, 0), false, 10 },
+    { 20, ROW(0, 1), false, 34 },
+    { 20, ROW(0, 0) + 64, false, 46 },
+  };
+
+  test_trace("fcfs", get_config(DRAM_SCHEDULER_FCFS, DRAM_PAGE_OPEN, 0), fcfs_reqs, 3, { 0, 1, 2, 0 });
+}
+
+// With the closed page policy, the row is precharged after the access, so
+// that the next access to it is a miss instead of a hit, and an access to
+// another row is a miss instead of a conflict
+static void test_closed_page()
+{
+  test_req_t reqs[] = {
+    { 0, ROW(0, 0), false, 10 },
+    { 20, ROW(0, 0) + 64, false, 30 },
+    { 40, ROW(0, 1), false, 50 },
+  };
+
+  test_trace("closed page", get_config(DRAM_SCHEDULER_FCFS, DRAM_PAGE_CLOSED, 0), reqs, 3, { 0, 3, 0, 0 });
+}
+
+// Refresh every 100 cycles, which closes the rows
+static void test_refresh()
+{
+  test_req_t reqs[] = {
+    { 0, ROW(0, 0), false, 10 },
+    // Refresh at 100 precharges the open bank, ACT at 100 + tRP + tRFC, so
+    // that the access to the row is a miss
+    { 100, ROW(0, 0) + 64, false, 134 },
+    // The refreshes at 200, 300 and 400 are accounted when the controller
+    // wakes up, the last one is over at 424, ACT at 451
+    { 450, ROW(0, 0), false, 461 },
+  };
+
+  test_trace("refresh", get_config(DRAM_SCHEDULER_FR_FCFS, DRAM_PAGE_OPEN, 100), reqs, 3, { 0, 3, 0, 4 });
+}
+
+
+int main()
+{
+  test_accesses();
+  test_data_bus();
+  test_schedulers();
+  test_closed_page();
+  test_refresh();
+
+  return unit_test_exit();
+}
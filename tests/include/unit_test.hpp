@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __UNIT_TEST_HPP__
+#define __UNIT_TEST_HPP__
+
+// Harness of the unit tests under tests, see tests/unit_test.mk. A failed
+// CHECK is reported and the test goes on, so that all the failures are
+// listed, and unit_test_exit gives the result from main.
+
+#include <stdio.h>
+
+static int nb_errors = 0;
+
+#define CHECK(cond, ...)          \
+  do {                            \
+    if (!(cond))                  \
+    {                             \
+      printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);        \
+      printf("\n");               \
+      nb_errors++;                \
+    }                             \
+  } while(0)
+
+static inline int unit_test_exit()
+{
+  if (nb_errors)
+  {
+    printf("%d error(s)\n", nb_errors);
+    return 1;
+  }
+
+  printf("OK\n");
+  return 0;
+}
+
+#endif
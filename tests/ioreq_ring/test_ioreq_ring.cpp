@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks that records and payloads go through the ring unchanged when the
+// slots wrap around and when payloads skip the end of the arena, first from
+// a single thread with known positions, and then between two threads which
+// have to wait for each other. Records which do not fit in a full ring must
+// be kept in order by the backlog, and the consumer woken up when it starts
+// keeping them.
+
+#include "unit_test.hpp"
+#include "vp/ioreq_ring.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+
+static void fill(uint8_t *data, uint64_t size, uint64_t seed)
+{
+  for (uint64_t i=0; i<size; i++)
+    data[i] = (uint8_t)(seed * 31 + i);
+}
+
+static bool check(uint8_t *data, uint64_t size, uint64_t seed)
+{
+  for (uint64_t i=0; i<size; i++)
+  {
+    if (data[i] != (uint8_t)(seed * 31 + i))
+      return false;
+  }
+  return true;
+}
+
+static int push(gv_ioreq_ring *ring, uint64_t id, uint64_t size, void **payload_ret=NULL)
+{
+  void *payload;
+  gv_ioreq_desc_t *desc = ring->reserve(size, &payload);
+  if (desc == NULL)
+    return -1;
+  desc->addr = id;
+  desc->size = size;
+  fill((uint8_t *)payload, size, id);
+  if (payload_ret)
+    *payload_ret = payload;
+  return 0;
+}
+
+static void pop(gv_ioreq_ring *ring, int index, uint64_t id, void **payload_ret=NULL)
+{
+  void *payload;
+  gv_ioreq_desc_t *desc = ring->get(index, &payload);
+  CHECK(desc->addr == id, "wrong record (expected: %lu, got: %lu)", id, desc->addr);
+  CHECK(check((uint8_t *)payload, desc->size, id), "corrupted payload (record: %lu)", id);
+  if (payload_ret)
+    *payload_ret = payload;
+}
+
+
+// Slots are reused several times, with batches which are not a divider of
+// the number of slots, so that batches also straddle the end of the slots
+static void test_slot_wrap(gv_ioreq_ring *ring)
+{
+  ring->init();
+
+  uint64_t id = 0, next = 0;
+  const int batch = 100;
+
+  while (id < 5 * GV_IOREQ_RING_SLOTS)
+  {
+    for (int i=0; i<batch; i++)
+      push(ring, id++, 8);
+    ring->commit();
+
+    int count = ring->wait();
+    CHECK(count == batch, "wrong number of records (expected: %d, got: %d)", batch, count);
+    for (int i=0; i<count; i++)
+      pop(ring, i, next++);
+    ring->release(count);
+  }
+
+  // The ring can then be completely filled
+  for (int i=0; i<GV_IOREQ_RING_SLOTS; i++)
+    push(ring, id++, 0);
+  ring->commit();
+  CHECK(ring->wait() == GV_IOREQ_RING_SLOTS, "ring can not be filled");
+  for (int i=0; i<GV_IOREQ_RING_SLOTS; i++)
+    pop(ring, i, next++);
+  ring->release(GV_IOREQ_RING_SLOTS);
+}
+
+
+// A payload which does not fit before the end of the arena starts at its
+// beginning, and the skipped bytes are only reused once it is released
+static void test_arena_skip(gv_ioreq_ring *ring)
+{
+  ring->init();
+
+  void *first, *second, *third;
+  const uint64_t size = GV_IOREQ_RING_ARENA_SIZE / 3;
+
+  push(ring, 0, size, &first);
+  push(ring, 1, size, &second);
+  ring->commit();
+  CHECK(ring->wait() == 2, "wrong number of records");
+  pop(ring, 0, 0);
+  ring->release(1);
+
+  // Only the first third is free, which is where the third payload must
+  // go, as it does not fit in the remaining end of the arena
+  push(ring, 2, size, &third);
+  ring->commit();
+  CHECK(third == first, "payload was not moved to the beginning of the arena (offset: %ld)",
+    (uint8_t *)third - (uint8_t *)first);
+
+  CHECK(ring->wait() == 2, "wrong number of records");
+  void *payload;
+  pop(ring, 0, 1, &payload);
+  CHECK(payload == second, "wrong payload position");
+  pop(ring, 1, 2, &payload);
+  CHECK(payload == third, "wrong payload position");
+  ring->release(2);
+
+  // A payload of the size of the arena fits once everything is released,
+  // and a bigger one can never fit
+  CHECK(push(ring, 3, GV_IOREQ_RING_ARENA_SIZE) == 0, "payload of the arena size was rejected");
+  ring->commit();
+  CHECK(ring->wait() == 1, "wrong number of records");
+  pop(ring, 0, 3);
+  ring->release(1);
+
+  CHECK(push(ring, 4, GV_IOREQ_RING_ARENA_SIZE + 1) == -1, "payload bigger than the arena was accepted");
+}
+
+
+// Records are kept in the backlog once the ring is full, and even when room
+// is made, until the older ones are flushed
+static void test_backlog(gv_ioreq_ring *ring, gv_ioreq_ring *flush_ring)
+{
+  ring->init();
+  flush_ring->init();
+
+  gv_ioreq_backlog backlog(ring, flush_ring);
+  const uint64_t size = GV_IOREQ_RING_ARENA_SIZE / 4;
+  uint64_t id = 0, next = 0;
+
+  for (int i=0; i<6; i++)
+  {
+    void *payload;
+    gv_ioreq_desc_t *desc = backlog.reserve(size, &payload);
+    desc->addr = id;
+    desc->size = size;
+    fill((uint8_t *)payload, size, id++);
+  }
+  backlog.commit();
+
+  CHECK(flush_ring->wait(0) == 0, "consumer not notified when records are kept");
+  CHECK(ring->wait() == 4, "wrong number of records in the ring");
+  CHECK(!backlog.flush(), "records flushed to a full ring");
+
+  pop(ring, 0, next++);
+  ring->release(1);
+
+  // There is room for one record, but the new one must come after the kept
+  // ones
+  void *payload;
+  gv_ioreq_desc_t *desc = backlog.reserve(8, &payload);
+  desc->addr = id;
+  desc->size = 8;
+  fill((uint8_t *)payload, 8, id++);
+  CHECK(!backlog.flush(), "backlog empty while the ring is full");
+
+  while (next < id)
+  {
+    int count = ring->wait();
+    for (int i=0; i<count; i++)
+    {
+      pop(ring, 0, next++);
+      ring->release(1);
+    }
+    backlog.flush();
+  }
+
+  CHECK(backlog.flush(), "records left in the backlog");
+  CHECK(ring->wait(0) == 0, "unexpected records in the ring");
+}
+
+
+#define NB_RECORDS 200000
+
+static void *producer_routine(void *arg)
+{
+  gv_ioreq_ring *ring = (gv_ioreq_ring *)arg;
+
+  for (uint64_t id=0; id<NB_RECORDS; id++)
+  {
+    // Big payloads now and then to make the arena wrap and fill up
+    uint64_t size = id % 97 == 0 ? GV_IOREQ_RING_ARENA_SIZE / 4 + id % 13 : id % 200;
+    push(ring, id, size);
+    if (id % 7 == 0)
+      ring->commit();
+  }
+  ring->commit();
+
+  return NULL;
+}
+
+static void test_threads(gv_ioreq_ring *ring)
+{
+  ring->init();
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, producer_routine, (void *)ring);
+
+  uint64_t next = 0;
+  while (next < NB_RECORDS)
+  {
+    int count = ring->wait();
+    for (int i=0; i<count; i++)
+      pop(ring, i, next++);
+    ring->release(count);
+
+    if (nb_errors)
+      exit(1);
+  }
+
+  pthread_join(thread, NULL);
+}
+
+
+int main()
+{
+  gv_ioreq_shm_t *shm;
+  if (gv_ioreq_shm_create(&shm) == -1)
+  {
+    printf("Unable to create shared memory\n");
+    return 1;
+  }
+
+  test_slot_wrap(&shm->to_fabric);
+  test_arena_skip(&shm->to_fabric);
+  test_backlog(&shm->to_fabric, &shm->to_host);
+  test_threads(&shm->to_host);
+
+  return unit_test_exit();
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Fake model library, with the entry points the native builder is using
+// during elaboration, see test_model.hpp
+
+#include "test_model.hpp"
+#include <stdint.h>
+
+class test_port
+{
+public:
+  test_port(std::string comp, std::string name) : comp(comp), name(name) {}
+  std::string comp;
+  std::string name;
+};
+
+class test_comp
+{
+public:
+  std::string path;
+  std::vector<const char *> port_names[2];
+  std::vector<void *> ports[2];
+};
+
+
+static test_model_state_t state;
+static void *next_config;
+
+
+extern "C" test_model_state_t *test_model_get_state()
+{
+  return &state;
+}
+
+extern "C" void vp_comp_set_next_config_handle(void *config)
+{
+  next_config = config;
+}
+
+extern "C" void *vp_constructor(const char *config)
+{
+  return (void *)new test_comp();
+}
+
+extern "C" void vp_comp_conf(void *comp, const char *path, void *parent)
+{
+  ((test_comp *)comp)->path = path;
+  state.configs[path] = next_config;
+}
+
+extern "C" int vp_build(void *__comp)
+{
+  test_comp *comp = (test_comp *)__comp;
+  for (auto &port: state.ports[comp->path])
+  {
+    test_port *ref = new test_port(comp->path, port.first);
+    comp->port_names[port.second].push_back(ref->name.c_str());
+    comp->ports[port.second].push_back((void *)ref);
+  }
+  return 0;
+}
+
+extern "C" int vp_comp_get_ports(void *__comp, bool master, int size, const char *names[], void *ports[])
+{
+  test_comp *comp = (test_comp *)__comp;
+  for (int i=0; i<size; i++)
+  {
+    names[i] = comp->port_names[master][i];
+    ports[i] = comp->ports[master][i];
+  }
+  return comp->ports[master].size();
+}
+
+extern "C" int vp_comp_get_services(void *comp, int size, const char *names[], void *services[])
+{
+  return 0;
+}
+
+extern "C" void vp_comp_set_services(void *comp, int nb_services, const char *names[], void *services[])
+{
+}
+
+extern "C" void vp_port_bind_to(void *__master, void *__slave, const char *config)
+{
+  test_port *master = (test_port *)__master;
+  test_port *slave = (test_port *)__slave;
+  state.bindings.push_back({ master->comp + "->" + master->name, slave->comp + "->" + slave->name, config ? config : "" });
+}
+
+extern "C" void vp_port_finalize(void *port) {}
+extern "C" void vp_post_post_build(void *comp) {}
+extern "C" void vp_pre_start(void *comp) {}
+extern "C" void vp_start(void *comp) {}
+extern "C" void vp_reset(void *comp, int active) {}
+extern "C" void vp_load(void *comp) {}
+extern "C" void vp_stop(void *comp) {}
+extern "C" char *vp_get_error() { return (char *)""; }
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+#ifndef __TEST_MODEL_HPP__
+#define __TEST_MODEL_HPP__
+
+#include <string>
+#include <vector>
+#include <map>
+
+// Model library used for all the implementations of the platform. It only
+// declares the ports it is asked for and records what the builder does
+// with them, so that the test can check the elaborated platform. The
+// library is opened once whatever the implementation name, so the state is
+// shared by all the components.
+
+typedef struct
+{
+  std::string master;
+  std::string slave;
+  std::string config;
+} test_model_binding_t;
+
+typedef struct
+{
+  // Ports to declare, per component path, with whether they are masters
+  std::map<std::string, std::vector<std::pair<std::string, bool>>> ports;
+  // Config handle given to each component, per path
+  std::map<std::string, void *> configs;
+  // Calls to vp_port_bind_to, as "<path>-><port>"
+  std::vector<test_model_binding_t> bindings;
+} test_model_state_t;
+
+extern "C" test_model_state_t *test_model_get_state();
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks that the native builder elaborates a chip built around soc_ico,
+// whose python class is creating components and bindings, from the
+// description generated by gvsoc-describe. All implementations are the
+// fake model of test_model.cpp, which records the bindings done by the
+// builder. They must be the ones python would do, with the mapping configs
+// computed by soc_ico, and the interleaver must get the stage bits computed
+// by its python class.
+//
+// Usage: test_native_builder <gvsoc-describe> <plt_config.json> <python path>
+
+#include "unit_test.hpp"
+#include "test_model.hpp"
+#include "vp/builder.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#define TEST_DESC_NAME   "plt_desc.json"
+#define TEST_MODEL_NAME  "test_model.so"
+#define TEST_MODELS_DIR  "models"
+
+#define SOC              "/sys/board/chip/soc"
+#define SOC_ICO          SOC "/soc_ico"
+
+// Mapping configs, as generated by vp_core.map_config
+#define L2_SHARED_MAP    "{\"base\": 469827584, \"size\": 65536, \"add_offset\": 0, \"remove_offset\": 0}"
+#define ROM_MAP          "{\"base\": 436207616, \"size\": 8192, \"add_offset\": 0, \"remove_offset\": 436207616}"
+#define L2_PRIV0_MAP     "{\"base\": 469762048, \"size\": 32768, \"add_offset\": 0, \"remove_offset\": 469762048}"
+#define L2_ALIAS_MAP     "{\"base\": 0, \"size\": 32768, \"add_offset\": 0, \"remove_offset\": 0}"
+#define APB_MAP          "{\"base\": 437256192, \"size\": 1048576, \"add_offset\": 0, \"remove_offset\": 0}"
+#define STDOUT_MAP       "{\"base\": 438239232, \"size\": 4096, \"add_offset\": 0, \"remove_offset\": 438239232}"
+
+
+// Implementations selected by the python classes, only these ones can be
+// opened by the builder
+static const char *implementations[] = {
+  "vp.power_engine_impl", "vp.time_domain_impl", "vp.trace_domain_impl", "vp.telemetry_engine_impl",
+  "utils.composite_impl", "utils.injector_impl", "interco.router_impl", "interco.interleaver_impl",
+  "memory.memory_impl", "pulp.stdout.stdout_v3_impl"
+};
+
+// Ports declared by the models, with whether they are masters
+static const struct { const char *path; const char *name; bool is_master; } ports[] = {
+  { SOC "/fc", "data", true },
+  { SOC "/fc", "fetch", true },
+  { SOC_ICO "/ll", "in", false },
+  { SOC_ICO "/ll", "out", true },
+  { SOC_ICO "/apb", "in", false },
+  { SOC_ICO "/apb", "out", true },
+  { SOC_ICO "/hb", "in", false },
+  { SOC_ICO "/hb", "out_0", true },
+  { SOC_ICO "/hb", "out_1", true },
+  { SOC_ICO "/fc_fetch_ico", "in", false },
+  { SOC_ICO "/fc_fetch_ico", "out", true },
+  { SOC_ICO "/fc_data_ico", "in", false },
+  { SOC_ICO "/fc_data_ico", "out", true },
+  { SOC "/rom", "input", false },
+  { SOC "/l2_priv0", "input", false },
+  { SOC "/l2_shared_0", "input", false },
+  { SOC "/l2_shared_1", "input", false },
+  { SOC "/stdout", "input", false },
+};
+
+// Bindings of the model ports, in the order the builder must do them,
+// which is the order of the master components in the tree, and then the
+// order of the bindings in python
+static const test_model_binding_t expected_bindings[] = {
+  { SOC_ICO "/ll->out", SOC "/rom->input", ROM_MAP },
+  { SOC_ICO "/ll->out", SOC "/l2_priv0->input", L2_PRIV0_MAP },
+  { SOC_ICO "/ll->out", SOC "/l2_priv0->input", L2_ALIAS_MAP },
+  { SOC_ICO "/ll->out", SOC_ICO "/apb->in", APB_MAP },
+  { SOC_ICO "/apb->out", SOC "/stdout->input", STDOUT_MAP },
+  { SOC_ICO "/hb->out_0", SOC "/l2_shared_0->input", "" },
+  { SOC_ICO "/hb->out_1", SOC "/l2_shared_1->input", "" },
+  { SOC_ICO "/fc_fetch_ico->out", SOC_ICO "/hb->in", L2_SHARED_MAP },
+  { SOC_ICO "/fc_fetch_ico->out", SOC_ICO "/ll->in", "" },
+  { SOC_ICO "/fc_data_ico->out", SOC_ICO "/hb->in", L2_SHARED_MAP },
+  { SOC_ICO "/fc_data_ico->out", SOC_ICO "/ll->in", "" },
+  { SOC "/fc->data", SOC_ICO "/fc_data_ico->in", "" },
+  { SOC "/fc->fetch", SOC_ICO "/fc_fetch_ico->in", "" },
+};
+
+#define NB_IMPLEMENTATIONS (sizeof(implementations) / sizeof(implementations[0]))
+#define NB_PORTS (sizeof(ports) / sizeof(ports[0]))
+#define NB_BINDINGS (sizeof(expected_bindings) / sizeof(expected_bindings[0]))
+
+
+static int describe(const char *describer, const char *config, const char *python_path)
+{
+  std::string cmd = std::string("PYTHONPATH=") + python_path + " " + describer + " --config=" + config +
+    " --output=" TEST_DESC_NAME;
+
+  int status = system(cmd.c_str());
+  CHECK(status == 0, "platform description failed (command: %s)", cmd.c_str());
+  return status;
+}
+
+// The builder is finding the models from the implementation names, the
+// same way python is doing it, so each one is a link to the fake model
+static void install_models()
+{
+  char model[PATH_MAX];
+  CHECK(realpath(TEST_MODEL_NAME, model) != NULL, "fake model not found (path: %s)", TEST_MODEL_NAME);
+
+  for (auto implementation: implementations)
+  {
+    std::string path = TEST_MODELS_DIR;
+    mkdir(path.c_str(), 0755);
+
+    std::string name = implementation;
+    size_t start = 0, end;
+    while ((end = name.find('.', start)) != std::string::npos)
+    {
+      path += "/" + name.substr(start, end - start);
+      mkdir(path.c_str(), 0755);
+      start = end + 1;
+    }
+    path += "/" + name.substr(start) + ".so";
+
+    unlink(path.c_str());
+    CHECK(symlink(model, path.c_str()) == 0, "can not install model (path: %s)", path.c_str());
+  }
+
+  setenv("PYTHONPATH", TEST_MODELS_DIR, 1);
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc != 4)
+  {
+    fprintf(stderr, "Usage: %s <gvsoc-describe> <plt_config.json> <python path>\n", argv[0]);
+    return 1;
+  }
+
+  if (describe(argv[1], argv[2], argv[3]))
+    return unit_test_exit();
+
+  install_models();
+  if (nb_errors)
+    return unit_test_exit();
+
+  // The builder opens the same library, so this is the state of all the
+  // components
+  void *handle = dlopen("./" TEST_MODEL_NAME, RTLD_NOW | RTLD_LOCAL);
+  CHECK(handle != NULL, "can not open fake model (error: %s)", dlerror());
+  if (handle == NULL)
+    return unit_test_exit();
+
+  test_model_state_t *(*get_state)() = (test_model_state_t *(*)())dlsym(handle, "test_model_get_state");
+  test_model_state_t *state = get_state();
+
+  for (auto &port: ports)
+  {
+    state->ports[port.path].push_back(std::pair<std::string, bool>(port.name, port.is_master));
+  }
+
+  gv_builder *builder = new gv_builder(TEST_DESC_NAME);
+  int status = builder->parse();
+  if (status == 0)
+    status = builder->build();
+
+  CHECK(status == 0, "platform elaboration failed (error: %s)", builder->get_error().c_str());
+  if (status != 0)
+    return unit_test_exit();
+
+  // Bindings done through the python ports of soc_ico and soc
+  CHECK(state->bindings.size() == NB_BINDINGS, "wrong number of bindings (expected: %ld, got: %ld)",
+    NB_BINDINGS, state->bindings.size());
+
+  for (unsigned int i=0; i<state->bindings.size() && i<NB_BINDINGS; i++)
+  {
+    test_model_binding_t *binding = &state->bindings[i];
+    const test_model_binding_t *expected = &expected_bindings[i];
+    CHECK(binding->master == expected->master && binding->slave == expected->slave && binding->config == expected->config,
+      "wrong binding (index: %d, expected: %s -> %s %s, got: %s -> %s %s)", i,
+      expected->master.c_str(), expected->slave.c_str(), expected->config.c_str(),
+      binding->master.c_str(), binding->slave.c_str(), binding->config.c_str());
+  }
+
+  // Components whose config is not modified by python get their sub-tree
+  // of the platform config, while the interleaver gets the stage bits
+  // computed by its class
+  js::config *config = builder->get_config();
+
+  CHECK(state->configs[SOC_ICO "/ll"] == config->get("system_tree/board/chip/soc/soc_ico/ll_ico"),
+    "router does not get its platform config");
+  CHECK(state->configs[SOC "/rom"] == config->get("system_tree/board/chip/soc/rom"),
+    "memory does not get its platform config");
+  CHECK(state->configs[""] != NULL, "engines do not get any config");
+
+  js::config *hb_config = (js::config *)state->configs[SOC_ICO "/hb"];
+  CHECK(hb_config != NULL && hb_config->get_child_int("stage_bits") == 1 && hb_config->get_child_int("nb_slaves") == 2,
+    "interleaver does not get the config computed in python");
+
+  // soc_ico has no implementation, it only forwards its ports
+  CHECK(state->configs.find(SOC_ICO) == state->configs.end(), "soc_ico was instantiated");
+  CHECK(state->configs.size() == 16, "wrong number of components (expected: 16, got: %ld)", state->configs.size());
+
+  builder->stop();
+
+  return unit_test_exit();
+}
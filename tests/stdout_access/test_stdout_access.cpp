@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks which characters of a store are printed by the stdout component.
+// Stores to the legacy window print one character whatever their size,
+// while 4 and 8-byte stores to the multi-byte window are printed in full,
+// up to the first null byte, on the channel of the same core.
+
+#include "unit_test.hpp"
+#include "stdout_access.hpp"
+#include <string.h>
+#include <string>
+
+// Offset of the channel of a core in a window
+#define CHANNEL(window, cluster, core) ((window) + (cluster) * 16 * STDOUT_CHANNEL_SIZE + (core) * STDOUT_CHANNEL_SIZE)
+
+
+static std::string print(uint64_t offset, const char *str, int size, int cluster_id, int core_id)
+{
+  uint8_t data[8];
+  memset(data, 0, sizeof(data));
+  memcpy(data, str, strnlen(str, size));
+
+  stdout_access_t access = stdout_decode_access(offset, data, size, STDOUT_MULTI_BYTE_OFFSET);
+
+  CHECK(access.cluster_id == cluster_id && access.core_id == core_id,
+    "wrong channel (offset: 0x%lx, cluster: %d, core: %d)", offset, access.cluster_id, access.core_id);
+
+  return std::string((char *)data, access.nb_chars);
+}
+
+
+int main()
+{
+  std::string str;
+
+  // Legacy window, one character per store
+  str = print(CHANNEL(0, 0, 0), "a", 1, 0, 0);
+  CHECK(str == "a", "byte store printed as '%s'", str.c_str());
+  str = print(CHANNEL(0, 1, 3), "abcd", 4, 1, 3);
+  CHECK(str == "a", "legacy word store printed as '%s'", str.c_str());
+
+  // Multi-byte window
+  str = print(CHANNEL(STDOUT_MULTI_BYTE_OFFSET, 0, 0), "abcd", 4, 0, 0);
+  CHECK(str == "abcd", "word store printed as '%s'", str.c_str());
+  str = print(CHANNEL(STDOUT_MULTI_BYTE_OFFSET, 2, 7), "abcdefgh", 8, 2, 7);
+  CHECK(str == "abcdefgh", "double-word store printed as '%s'", str.c_str());
+  str = print(CHANNEL(STDOUT_MULTI_BYTE_OFFSET, 0, 1), "ab\n", 8, 0, 1);
+  CHECK(str == "ab\n", "partial double-word store printed as '%s'", str.c_str());
+  str = print(CHANNEL(STDOUT_MULTI_BYTE_OFFSET, 0, 1), "", 4, 0, 1);
+  CHECK(str == "", "null word store printed as '%s'", str.c_str());
+
+  return unit_test_exit();
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks that messages captured for the binary trace log are printed by
+// gvsoc-trace-log exactly as printf would have printed them. The arguments
+// are captured with the same function as the engine, and the records are
+// written as the logging thread writes them.
+//
+// Usage: test_trace_log <gvsoc-trace-log>
+
+#include "unit_test.hpp"
+#include "vp/trace/trace_log.hpp"
+#include "trace_log_format.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#define TEST_LOG_PATH    "test_trace_log.bin"
+#define TEST_OUTPUT_PATH "test_trace_log.txt"
+
+
+typedef struct
+{
+  int trace;
+  std::string line;
+} expected_message;
+
+
+static FILE *log_file;
+static std::vector<std::string> traces;
+static std::vector<bool> dumped_traces;
+static std::map<std::string, uint32_t> format_ids;
+static std::vector<expected_message> expected;
+static int64_t current_time = 0;
+
+
+static void write_string(uint8_t type, int32_t id, const std::string &str)
+{
+  uint32_t len = str.size();
+  fwrite(&type, 1, 1, log_file);
+  fwrite(&id, sizeof(id), 1, log_file);
+  fwrite(&len, sizeof(len), 1, log_file);
+  fwrite(str.c_str(), 1, len, log_file);
+}
+
+static int new_trace(std::string name)
+{
+  traces.push_back(name);
+  dumped_traces.push_back(false);
+  return traces.size() - 1;
+}
+
+// Records the message in the log and the text printf gives for it
+static void log_message(int trace, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void log_message(int trace, const char *fmt, ...)
+{
+  va_list ap;
+  std::vector<uint64_t> args;
+
+  va_start(ap, fmt);
+  trace_log_store_args(args, fmt, ap);
+  va_end(ap);
+
+  char text[1024];
+  va_start(ap, fmt);
+  vsnprintf(text, sizeof(text), fmt, ap);
+  va_end(ap);
+
+  if (!dumped_traces[trace])
+  {
+    write_string(TRACE_LOG_TRACE, trace, traces[trace]);
+    dumped_traces[trace] = true;
+  }
+
+  auto it = format_ids.find(fmt);
+  if (it == format_ids.end())
+  {
+    uint32_t id = format_ids.size();
+    it = format_ids.insert(std::make_pair(std::string(fmt), id)).first;
+    write_string(TRACE_LOG_FORMAT, id, fmt);
+  }
+
+  current_time += 1000;
+  int64_t cycles = current_time / 100;
+
+  uint8_t type = TRACE_LOG_MESSAGE;
+  int32_t trace_id = trace;
+  uint32_t format_id = it->second;
+  uint32_t nb_args = args.size();
+  fwrite(&type, 1, 1, log_file);
+  fwrite(&trace_id, sizeof(trace_id), 1, log_file);
+  fwrite(&format_id, sizeof(format_id), 1, log_file);
+  fwrite(&current_time, sizeof(current_time), 1, log_file);
+  fwrite(&cycles, sizeof(cycles), 1, log_file);
+  fwrite(&nb_args, sizeof(nb_args), 1, log_file);
+  fwrite(args.data(), 8, nb_args, log_file);
+
+  expected.push_back({ trace, std::to_string(current_time) + ": " + std::to_string(cycles) + ": [" + text });
+}
+
+
+// Decodes the log with the traces matching the filter, or all of them, and
+// compares the output with the expected messages
+static int check_decode(const char *decoder, const char *trace_filter)
+{
+  std::string cmd = std::string(decoder) + " --output=" + TEST_OUTPUT_PATH;
+  if (trace_filter)
+    cmd += std::string(" --trace=") + trace_filter;
+  cmd += " " TEST_LOG_PATH;
+
+  int status = system(cmd.c_str());
+  CHECK(status == 0, "decoder returned an error (command: %s)", cmd.c_str());
+  if (status != 0)
+    return -1;
+
+  // Trace names are aligned on the longest decoded one
+  size_t max_path_len = 0;
+  std::vector<bool> enabled;
+  for (auto &name: traces)
+  {
+    bool match = trace_filter == NULL || name.find(trace_filter) != std::string::npos;
+    enabled.push_back(match);
+    if (match && name.size() > max_path_len)
+      max_path_len = name.size();
+  }
+
+  std::string expected_output;
+  for (auto &message: expected)
+  {
+    if (!enabled[message.trace])
+      continue;
+
+    std::string name = traces[message.trace];
+    name.resize(max_path_len, ' ');
+    size_t prefix_len = message.line.find('[') + 1;
+    expected_output += message.line.substr(0, prefix_len - 1) + "[\033[34m" + name + "\033[0m] " +
+      message.line.substr(prefix_len);
+  }
+
+  FILE *file = fopen(TEST_OUTPUT_PATH, "r");
+  CHECK(file != NULL, "decoder output not found");
+  if (file == NULL)
+    return -1;
+
+  std::string output;
+  char buffer[4096];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    output.append(buffer, len);
+  fclose(file);
+
+  if (output != expected_output)
+  {
+    size_t pos = 0;
+    while (pos < output.size() && pos < expected_output.size() && output[pos] == expected_output[pos])
+      pos++;
+    size_t line_start = expected_output.rfind('\n', pos == 0 ? 0 : pos - 1);
+    line_start = line_start == std::string::npos ? 0 : line_start + 1;
+    CHECK(false, "wrong decoded output (filter: %s)", trace_filter ? trace_filter : "none");
+    printf("expected: %s\n", expected_output.substr(line_start, expected_output.find('\n', pos) - line_start).c_str());
+    printf("got:      %s\n", output.substr(line_start, output.find('\n', pos) - line_start).c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: %s <gvsoc-trace-log>\n", argv[0]);
+    return 1;
+  }
+
+  log_file = fopen(TEST_LOG_PATH, "w");
+  CHECK(log_file != NULL, "can not create %s", TEST_LOG_PATH);
+  if (log_file == NULL)
+    return unit_test_exit();
+  fwrite(TRACE_LOG_MAGIC, 1, strlen(TRACE_LOG_MAGIC), log_file);
+
+  int core = new_trace("/sys/board/chip/soc/fc/insn");
+  int udma = new_trace("/sys/board/chip/soc/udma/trace");
+  int mem = new_trace("/sys/board/chip/soc/l2");
+
+  log_message(core, "Plain message\n");
+  log_message(core, "%d %i %u %x %X %o\n", -5, 42, 0x80000000U, 0xdeadbeefU, 0xabcU, 8U);
+  log_message(udma, "%hhx %hx %hhd %hd %hhu %hu\n", -1, -1, 200, 40000, 300, 70000);
+  log_message(udma, "%ld %lx %lu %lld %llx %zu\n", -1L, -1L, 0x8000000000000000UL, -123456789012LL, 0x123456789abcdefULL, (size_t)77);
+  log_message(core, "%c%c|%5c|%-3c|\n", 'o', 'k', 'r', 'l');
+  log_message(mem, "%s|%10s|%-10s|%.3s|\n", "abc", "right", "left", "truncated");
+  log_message(mem, "%s|%3s|\n", "", "");
+
+  // The precision bounds a string which is not null-terminated
+  char not_terminated[4] = { 'a', 'b', 'c', 'd' };
+  log_message(mem, "%.*s|%.4s|\n", 4, not_terminated, not_terminated);
+
+  log_message(core, "%*d|%-*d|%.*f|%*.*e|%0*x\n", 6, 12, 5, -3, 2, 3.14159, 12, 3, 1234.5678, 8, 0xbeefU);
+  log_message(core, "%f %.2f %e %g %G %a %08.3f\n", 3.14159, -2.5, 1e-10, 1e20, 0.0001, 1.0, -1.5);
+  log_message(udma, "%p %p\n", (void *)0x1c000000, (void *)NULL);
+  log_message(udma, "100%% done, %d%%\n", 50);
+  log_message(udma, "%#x %#o %+d % d %'d\n", 0x10U, 8U, 5, 7, 1000000);
+
+  // Bigger than the buffer used to format each argument
+  std::string long_string(300, 'x');
+  long_string += "end";
+  log_message(mem, "long %s, %310d\n", long_string.c_str(), 9);
+
+  // Formats are recorded once and then referred to by their id
+  for (int i=0; i<10; i++)
+  {
+    log_message(i & 1 ? core : mem, "Iteration %d, address 0x%8.8x\n", i, 0xfffffff0U + i);
+  }
+
+  fclose(log_file);
+
+  if (check_decode(argv[1], NULL) == 0)
+    check_decode(argv[1], "udma");
+
+  return unit_test_exit();
+}
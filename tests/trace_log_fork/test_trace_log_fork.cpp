@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2018 ETH Zurich and University of Bologna
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Authors: Germain Haugou, ETH (germain.haugou@iis.ee.ethz.ch)
+ */
+
+// Checks that the deferred trace log is forked as the fork server does it.
+// The parent logs many messages just before forking, so that the logging
+// thread is busy writing them. Each child must then log its own messages
+// without hanging, to its own binary log in its directory, and the messages
+// logged before the fork must only be in the log of the parent.
+//
+// Usage: test_trace_log_fork <gvsoc-trace-log>
+
+#include "unit_test.hpp"
+#include "vp/vp.hpp"
+#include "vp/trace/trace_log.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+#define TEST_LOG_NAME        "test_trace_log_fork.bin"
+#define TEST_OUTPUT_NAME     "test_trace_log_fork.txt"
+#define TEST_NB_CHILDS       4
+#define TEST_NB_MESSAGES     20000
+#define TEST_NB_CHILD_MSG    1000
+// Seconds after which a child is considered as deadlocked
+#define TEST_CHILD_TIMEOUT   20
+
+char vp_error[VP_ERROR_SIZE];
+
+
+// The logging thread only needs the name and the id of the trace in binary
+// mode
+class test_trace : public vp::trace
+{
+public:
+  test_trace(std::string name, int id)
+  {
+    this->name = name;
+    this->id = id;
+  }
+};
+
+
+static void log_message(vp::trace_log *log, vp::trace *trace, int64_t time, const char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  log->log(trace, time, time / 100, fmt, ap);
+  va_end(ap);
+}
+
+
+// Decodes the log in the directory and returns the text of its messages,
+// without their header
+static std::vector<std::string> decode(const char *decoder, std::string dir)
+{
+  std::vector<std::string> messages;
+  std::string output = dir + "/" TEST_OUTPUT_NAME;
+  std::string cmd = std::string(decoder) + " --output=" + output + " " + dir + "/" TEST_LOG_NAME;
+
+  int status = system(cmd.c_str());
+  CHECK(status == 0, "decoder returned an error (command: %s)", cmd.c_str());
+  if (status != 0)
+    return messages;
+
+  FILE *file = fopen(output.c_str(), "r");
+  CHECK(file != NULL, "decoder output not found (path: %s)", output.c_str());
+  if (file == NULL)
+    return messages;
+
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, file) != -1)
+  {
+    char *text = strstr(line, "] ");
+    messages.push_back(text ? text + 2 : line);
+  }
+
+  free(line);
+  fclose(file);
+
+  return messages;
+}
+
+
+static void check_messages(const char *decoder, std::string dir, std::vector<std::string> &expected)
+{
+  std::vector<std::string> messages = decode(decoder, dir);
+
+  CHECK(messages.size() == expected.size(), "wrong number of messages (dir: %s, expected: %ld, got: %ld)",
+    dir.c_str(), expected.size(), messages.size());
+
+  for (size_t i=0; i<messages.size() && i<expected.size(); i++)
+  {
+    CHECK(messages[i] == expected[i], "wrong message (dir: %s, index: %ld, expected: %s, got: %s)",
+      dir.c_str(), i, expected[i].c_str(), messages[i].c_str());
+    if (messages[i] != expected[i])
+      break;
+  }
+}
+
+
+static void run_child(vp::trace_log *log, vp::trace *trace, int child)
+{
+  alarm(TEST_CHILD_TIMEOUT);
+
+  std::string dir = "child" + std::to_string(child);
+  if (chdir(dir.c_str()))
+    _exit(1);
+
+  log->fork_child();
+
+  for (int i=0; i<TEST_NB_CHILD_MSG; i++)
+  {
+    log_message(log, trace, TEST_NB_MESSAGES * 1000 + i * 1000, "Child %d message %d\n", child, i);
+  }
+
+  log->close();
+
+  _exit(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: %s <gvsoc-trace-log>\n", argv[0]);
+    return 1;
+  }
+
+  vp::trace_log *log = new vp::trace_log();
+  CHECK(log->open(TEST_LOG_NAME) == 0, "can not open trace log (error: %s)", vp_error);
+  if (nb_errors)
+    return unit_test_exit();
+
+  test_trace trace("/sys/board/chip/soc/fc/insn", 0);
+
+  std::vector<std::string> parent_expected;
+  for (int i=0; i<TEST_NB_MESSAGES; i++)
+  {
+    log_message(log, &trace, i * 1000, "Parent message %d\n", i);
+    parent_expected.push_back("Parent message " + std::to_string(i) + "\n");
+  }
+
+  // Same sequence as the fork server, the children are forked while the
+  // parent is not logging anymore
+  log->fork_prepare();
+  fflush(NULL);
+
+  std::vector<pid_t> pids;
+  for (int child=0; child<TEST_NB_CHILDS; child++)
+  {
+    std::string dir = "child" + std::to_string(child);
+    mkdir(dir.c_str(), 0755);
+
+    pid_t pid = fork();
+    if (pid == 0)
+      run_child(log, &trace, child);
+
+    CHECK(pid != -1, "can not fork child %d", child);
+    pids.push_back(pid);
+  }
+
+  for (int child=0; child<(int)pids.size(); child++)
+  {
+    int status;
+    waitpid(pids[child], &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0, "child %d failed (%s: %d)", child,
+      WIFEXITED(status) ? "status" : "signal", WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status));
+  }
+
+  log->close();
+
+  check_messages(argv[1], ".", parent_expected);
+
+  for (int child=0; child<(int)pids.size(); child++)
+  {
+    std::vector<std::string> expected;
+    for (int i=0; i<TEST_NB_CHILD_MSG; i++)
+      expected.push_back("Child " + std::to_string(child) + " message " + std::to_string(i) + "\n");
+
+    check_messages(argv[1], "child" + std::to_string(child), expected);
+  }
+
+  return unit_test_exit();
+}
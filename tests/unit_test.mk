@@ -0,0 +1,35 @@
+# Rules shared by the unit tests, which are compiled directly against the
+# sources they check, without building the platform.
+#
+# A test lists its executables in UNIT_TESTS, with their sources in
+# <name>_SRCS and optionally <name>_CFLAGS, <name>_LDFLAGS, the headers they
+# depend on in <name>_DEPS, and the arguments given to them in <name>_ARGS.
+# Executables only needed by the tests, like decoders, go in UNIT_TEST_TOOLS.
+# They are all built and run in ROOT_VP_BUILD_DIR, each test fails if one of
+# them fails.
+
+ROOT_VP_BUILD_DIR ?= $(CURDIR)/build
+
+UNIT_TEST_DIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+UNIT_TEST_HEADERS = $(UNIT_TEST_DIR)/include/unit_test.hpp
+
+define declare_unit_test
+
+$(ROOT_VP_BUILD_DIR)/$(1): $($(1)_SRCS) $($(1)_DEPS) $(UNIT_TEST_HEADERS)
+	@mkdir -p `dirname $$@`
+	g++ -std=c++11 -O2 -Wall -I$(UNIT_TEST_DIR)/include $($(1)_CFLAGS) $($(1)_SRCS) -o $$@ $($(1)_LDFLAGS)
+
+endef
+
+$(foreach test, $(UNIT_TESTS) $(UNIT_TEST_TOOLS), $(eval $(call declare_unit_test,$(test))))
+
+build: $(foreach test, $(UNIT_TESTS) $(UNIT_TEST_TOOLS), $(ROOT_VP_BUILD_DIR)/$(test))
+
+clean:
+	rm -rf $(ROOT_VP_BUILD_DIR)
+
+run: build
+	$(foreach test, $(UNIT_TESTS), cd $(ROOT_VP_BUILD_DIR) && ./$(test) $($(test)_ARGS) &&) true
+
+
+.PHONY: clean build run
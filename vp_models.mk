@@ -48,6 +48,13 @@ export PYTHONPATH := $(VP_INSTALL_PATH):$(INSTALL_DIR)/lib:$(PYTHONPATH)
 
 
 VP_COMP_EXT := .so
+
+# Flags for the static version of the models, used to build a monolithic
+# simulator. The C entry points of each model are renamed with the
+# implementation name so that all models can be linked together.
+VP_STATIC_ENTRY_POINTS = vp_constructor vp_trace_add_paths vp_trace_level vp_trace_window vp_trace_trigger loader_io_req loader_memset loader_load_elf vp_set_time_engine vp_trace_exchange_max_path_len
+VP_STATIC_CFLAGS = $(filter-out -fpic,$(VP_COMP_CFLAGS)) -O3 -flto -fno-fat-lto-objects
+VP_STATIC_INSTALL_PATH ?= $(INSTALL_DIR)/lib/static
 #$(shell python3-config --extension-suffix)
 
 include $(VP_MAKEFILE_LIST)
@@ -117,6 +124,64 @@ endef
 
 
 
+define declare_static_implementation
+
+$(eval $(1)_STATIC_CPP_OBJS = $(patsubst %.cc, $(VP_BUILD_DIR)/$(1)/static/%.o, $(patsubst %.cpp, $(VP_BUILD_DIR)/$(1)/static/%.o, $(filter %.cpp %.cc, $($(1)_SRCS)))))
+$(eval $(1)_STATIC_C_OBJS = $(patsubst %.c, $(VP_BUILD_DIR)/$(1)/static/%.o, $(filter %.c, $($(1)_SRCS))))
+$(eval $(1)_STATIC_CFLAGS = $(foreach entry, $(VP_STATIC_ENTRY_POINTS), -D$(entry)=$(entry)_$(subst /,_,$(1))))
+$(eval $(1)_STATIC_NAMESPACE = gv_static_$(subst /,_,$(1)))
+
+-include $($(1)_STATIC_CPP_OBJS:.o=.d) $($(1)_STATIC_C_OBJS:.o=.d)
+
+# Different models are using the same C++ class names, e.g. interleaver or
+# apb_soc_ctrl, which would collide in the simulator. The C++ code of each
+# model is then put into its own namespace, after preprocessing, by
+# gvsoc-static-wrap. The objects still contain the LTO IR, so that models
+# are optimized together with the engine when the simulator is linked.
+$(VP_BUILD_DIR)/$(1)/static/%.o: %.cpp $($(1)_DEPS)
+	@mkdir -p `dirname $$@`
+	$(CPP) -E $$< -o $$(@:.o=.ii) -MT $$@ $($(1)_CFLAGS) $($(1)_CPPFLAGS) $(VP_STATIC_CFLAGS) $(VP_COMP_CPPFLAGS) $($(1)_STATIC_CFLAGS)
+	gvsoc-static-wrap --namespace $($(1)_STATIC_NAMESPACE) --root $(CURDIR) --root $(VP_BUILD_DIR) --input $$(@:.o=.ii) --output $$(@:.o=.ns.ii)
+	$(CPP) -c $$(@:.o=.ns.ii) -o $$@ $(filter-out -MMD -MP, $($(1)_CFLAGS) $($(1)_CPPFLAGS) $(VP_STATIC_CFLAGS) $(VP_COMP_CPPFLAGS))
+
+$(VP_BUILD_DIR)/$(1)/static/%.o: %.cc $($(1)_DEPS)
+	@mkdir -p `dirname $$@`
+	$(CPP) -E $$< -o $$(@:.o=.ii) -MT $$@ $($(1)_CFLAGS) $($(1)_CPPFLAGS) $(VP_STATIC_CFLAGS) $(VP_COMP_CPPFLAGS) $($(1)_STATIC_CFLAGS)
+	gvsoc-static-wrap --namespace $($(1)_STATIC_NAMESPACE) --root $(CURDIR) --root $(VP_BUILD_DIR) --input $$(@:.o=.ii) --output $$(@:.o=.ns.ii)
+	$(CPP) -c $$(@:.o=.ns.ii) -o $$@ $(filter-out -MMD -MP, $($(1)_CFLAGS) $($(1)_CPPFLAGS) $(VP_STATIC_CFLAGS) $(VP_COMP_CPPFLAGS))
+
+$(VP_BUILD_DIR)/$(1)/static/%.o: %.c $($(1)_DEPS)
+	@mkdir -p `dirname $$@`
+	$(CC) -c $$< -o $$@ $($(1)_CFLAGS) $(VP_STATIC_CFLAGS) $($(1)_STATIC_CFLAGS)
+
+# The C++ objects of a model are merged into a single one, which keeps the
+# LTO IR, so that all of them are linked even if they are not referenced.
+$(VP_BUILD_DIR)/static/$(1).o: $($(1)_STATIC_CPP_OBJS)
+	@mkdir -p `dirname $$@`
+	$(CPP) -r -nostdlib -flto -flinker-output=rel $$^ -o $$@
+
+# C code can't be put into a namespace, so C objects are kept as separate
+# members of the archive. Models compiled from the same C sources, like the
+# ISS variants, then share the objects pulled by the first one.
+$(VP_BUILD_DIR)/static/$(1).a: $(VP_BUILD_DIR)/static/$(1).o $($(1)_STATIC_C_OBJS)
+	@mkdir -p `dirname $$@`
+	rm -f $$@
+	gcc-ar rcs $$@ $$^
+
+$(VP_STATIC_INSTALL_PATH)/$(1).a: $(VP_BUILD_DIR)/static/$(1).a
+	install -D $$^ $$@
+
+# Libraries needed by the model, to be added when linking the simulator
+$(VP_STATIC_INSTALL_PATH)/$(1).ldflags: $(VP_BUILD_DIR)/static/$(1).a
+	@mkdir -p `dirname $$@`
+	echo "$($(1)_LDFLAGS)" > $$@
+
+VP_STATIC_INSTALL_TARGETS += $(VP_STATIC_INSTALL_PATH)/$(1).a $(VP_STATIC_INSTALL_PATH)/$(1).ldflags
+
+endef
+
+
+
 define declare_component
 
 $(VP_PY_INSTALL_PATH)/$(1).py: $(1).py
@@ -141,6 +206,8 @@ $(foreach implementation, $(IMPLEMENTATIONS), $(eval $(call declare_implementati
 
 $(foreach implementation, $(IMPLEMENTATIONS), $(eval $(call declare_debug_implementation,$(implementation))))
 
+$(foreach implementation, $(IMPLEMENTATIONS), $(eval $(call declare_static_implementation,$(implementation))))
+
 $(foreach component, $(COMPONENTS), $(eval $(call declare_component,$(component))))
 
 $(foreach file, $(VP_HEADERS), $(eval $(call declareInstallFile,$(file))))
@@ -150,5 +217,7 @@ $(foreach file, $(VP_HEADERS), $(eval $(call declareInstallFile,$(file))))
 vp_build: $(VP_INSTALL_HEADERS) $(VP_INSTALL_TARGETS)
 	find $(VP_PY_INSTALL_PATH) -type d -exec touch {}/__init__.py \;
 
+vp_static_build: $(VP_INSTALL_HEADERS) $(VP_STATIC_INSTALL_TARGETS)
+
 vp_clean:
 	rm -rf $(VP_BUILD_DIR)